@@ -0,0 +1,38 @@
+# Script mode helper of add_hlsl: runs the shader compiler command following "--"
+# and reports the size of OUTPUT and how long the compile took.
+#
+#   cmake -DNAME=<identifier> -DOUTPUT=<file.cso> -P CompileShader.cmake -- <compiler> <arguments>...
+
+set(COMMAND "")
+set(IS_COMMAND FALSE)
+math(EXPR LAST_ARG "${CMAKE_ARGC} - 1")
+foreach(ARG_IDX RANGE ${LAST_ARG})
+    if(IS_COMMAND)
+        list(APPEND COMMAND "${CMAKE_ARGV${ARG_IDX}}")
+    elseif("${CMAKE_ARGV${ARG_IDX}}" STREQUAL "--")
+        set(IS_COMMAND TRUE)
+    endif()
+endforeach()
+
+# %f (microseconds) needs CMake 3.23, older versions only measure whole seconds
+if(CMAKE_VERSION VERSION_LESS 3.23)
+    string(TIMESTAMP BEGIN "%s000000")
+else()
+    string(TIMESTAMP BEGIN "%s%f")
+endif()
+
+execute_process(COMMAND ${COMMAND} RESULT_VARIABLE RESULT)
+
+if(CMAKE_VERSION VERSION_LESS 3.23)
+    string(TIMESTAMP END "%s000000")
+else()
+    string(TIMESTAMP END "%s%f")
+endif()
+
+if(NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "Compiling ${NAME} failed: ${RESULT}")
+endif()
+
+math(EXPR ELAPSED_MS "(${END} - ${BEGIN}) / 1000")
+file(SIZE ${OUTPUT} BYTECODE_SIZE)
+message(STATUS "${NAME}: ${BYTECODE_SIZE} bytes, ${ELAPSED_MS} ms")
@@ -0,0 +1,190 @@
+# Script mode helper of add_hlsl: turns the compiled shader INPUT into a header
+# OUTPUT declaring it as Shaders::NAME, together with its reflection as
+# Shaders::NAME_reflection parsed from the compiler's assembly LISTING.
+# Vertex shaders also get the structs the vertex (and instance) buffers have
+# to match, Shaders::NAME_vertex and Shaders::NAME_instance.
+#
+#   cmake -DINPUT=<file.cso> -DLISTING=<file.asm> -DOUTPUT=<file.hpp> -DNAME=<identifier>
+#         -DPROFILE=<profile> [-DSOURCE=<file.hlsl>] -P EmbedShader.cmake
+
+file(READ ${INPUT} HEX_BYTECODE HEX)
+file(SIZE ${INPUT} BYTECODE_SIZE)
+
+# 16 bytes per line
+set(BYTECODE "")
+string(LENGTH "${HEX_BYTECODE}" HEX_LENGTH)
+set(OFFSET 0)
+while(OFFSET LESS HEX_LENGTH)
+    string(SUBSTRING "${HEX_BYTECODE}" ${OFFSET} 32 LINE)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " LINE "${LINE}")
+    string(STRIP "${LINE}" LINE)
+    string(APPEND BYTECODE "\t\t${LINE}\n")
+    math(EXPR OFFSET "${OFFSET} + 32")
+endwhile()
+string(REGEX REPLACE ",\n$" "" BYTECODE "${BYTECODE}")
+
+# The listing looks the same for FXC (// comments) and DXC (; comments):
+#
+#   Input signature:
+#
+#   Name                 Index   Mask Register SysValue  Format   Used
+#   -------------------- ----- ------ -------- -------- ------- ------
+#   Color                    0   xyzw        0     NONE   float   xyzw
+#
+#   Resource Bindings:
+#
+#   Name                                 Type  Format         Dim      [ID]      HLSL Bind  Count
+#   ------------------------------ ---------- ------- ----------- ------- -------------- ------
+#   cb                                cbuffer      NA          NA     CB0      cb0,space1      1
+#
+# Semicolons and brackets would split the lines of a CMake list, they are dropped first.
+# Every line gets a leading | so foreach keeps the empty ones that end a table.
+file(READ ${LISTING} LISTING_TEXT)
+string(REGEX REPLACE "[][;]" "" LISTING_TEXT "${LISTING_TEXT}")
+string(REPLACE "\n" ";|" LISTING_LINES "|${LISTING_TEXT}")
+
+string(REGEX MATCH "^vs_" IS_VERTEX_SHADER "${PROFILE}")
+
+set(SECTION "")
+set(IS_IN_TABLE FALSE)
+set(INPUTS "")
+set(INPUT_COUNT 0)
+set(VERTEX_MEMBERS "")
+set(INSTANCE_MEMBERS "")
+set(RESOURCES "")
+set(RESOURCE_COUNT 0)
+foreach(LINE ${LISTING_LINES})
+    string(REGEX REPLACE "^[| \t/]+" "" LINE "${LINE}")
+    string(STRIP "${LINE}" LINE)
+
+    if(LINE STREQUAL "Input signature:")
+        set(SECTION input)
+        set(IS_IN_TABLE FALSE)
+    elseif(LINE STREQUAL "Resource Bindings:")
+        set(SECTION resource)
+        set(IS_IN_TABLE FALSE)
+    elseif(NOT SECTION)
+    elseif(LINE MATCHES "^-+ ")
+        set(IS_IN_TABLE TRUE)
+    elseif(NOT IS_IN_TABLE)
+    elseif(LINE STREQUAL "")
+        set(SECTION "")
+        set(IS_IN_TABLE FALSE)
+    elseif(LINE MATCHES "^no ")
+    elseif(SECTION STREQUAL "input" AND IS_VERTEX_SHADER)
+        string(REGEX REPLACE "[ \t]+" ";" FIELDS "${LINE}")
+        list(GET FIELDS 0 SEMANTIC)
+        list(GET FIELDS 1 SEMANTIC_IDX)
+        list(GET FIELDS 2 MASK)
+        list(GET FIELDS 4 SYSTEM_VALUE)
+        list(GET FIELDS 5 FORMAT)
+
+        # System values like SV_VertexID are generated, not fetched
+        if(SYSTEM_VALUE STREQUAL "NONE")
+            string(LENGTH "${MASK}" COMPONENT_COUNT)
+            if(FORMAT MATCHES "uint")
+                set(COMPONENT_TYPE Uint)
+                set(MEMBER_TYPE uint32_t)
+            elseif(FORMAT MATCHES "int")
+                set(COMPONENT_TYPE Int)
+                set(MEMBER_TYPE int32_t)
+            else()
+                set(COMPONENT_TYPE Float)
+                set(MEMBER_TYPE float)
+            endif()
+
+            set(MEMBER ${SEMANTIC})
+            if(NOT SEMANTIC_IDX EQUAL 0)
+                set(MEMBER ${SEMANTIC}${SEMANTIC_IDX})
+            endif()
+            if(COMPONENT_COUNT EQUAL 1)
+                set(MEMBER_DECLARATION "\t\t${MEMBER_TYPE} ${MEMBER};\n")
+            else()
+                set(MEMBER_DECLARATION "\t\t${MEMBER_TYPE} ${MEMBER}[${COMPONENT_COUNT}];\n")
+            endif()
+
+            if(SEMANTIC MATCHES "^Instance")
+                string(APPEND INSTANCE_MEMBERS "${MEMBER_DECLARATION}")
+                string(APPEND INPUTS "\t\t{ \"${SEMANTIC}\", ${SEMANTIC_IDX}, Core::ShaderComponentType::${COMPONENT_TYPE}, ${COMPONENT_COUNT}, 1, true, offsetof(${NAME}_instance, ${MEMBER}) },\n")
+            else()
+                string(APPEND VERTEX_MEMBERS "${MEMBER_DECLARATION}")
+                string(APPEND INPUTS "\t\t{ \"${SEMANTIC}\", ${SEMANTIC_IDX}, Core::ShaderComponentType::${COMPONENT_TYPE}, ${COMPONENT_COUNT}, 0, false, offsetof(${NAME}_vertex, ${MEMBER}) },\n")
+            endif()
+            math(EXPR INPUT_COUNT "${INPUT_COUNT} + 1")
+        endif()
+    elseif(SECTION STREQUAL "resource")
+        string(REGEX REPLACE "[ \t]+" ";" FIELDS "${LINE}")
+        list(GET FIELDS 0 RESOURCE_NAME)
+        list(GET FIELDS -2 BIND)
+        list(GET FIELDS -1 COUNT)
+
+        string(REGEX MATCH "^([a-z]+)([0-9]+)(,space([0-9]+))?$" BIND_MATCH "${BIND}")
+        if(NOT BIND_MATCH)
+            message(FATAL_ERROR "${NAME}: can not parse the binding of ${RESOURCE_NAME}: ${BIND}")
+        endif()
+        set(BIND_POINT ${CMAKE_MATCH_2})
+        set(SPACE 0)
+        if(CMAKE_MATCH_4)
+            set(SPACE ${CMAKE_MATCH_4})
+        endif()
+        if(CMAKE_MATCH_1 STREQUAL "cb")
+            set(RESOURCE_TYPE ConstantBuffer)
+        elseif(CMAKE_MATCH_1 STREQUAL "t")
+            set(RESOURCE_TYPE ShaderResource)
+        elseif(CMAKE_MATCH_1 STREQUAL "u")
+            set(RESOURCE_TYPE UnorderedAccess)
+        else()
+            set(RESOURCE_TYPE Sampler)
+        endif()
+        if(NOT COUNT MATCHES "^[0-9]+$")
+            set(COUNT UINT32_MAX)
+        endif()
+
+        string(APPEND RESOURCES "\t\t{ \"${RESOURCE_NAME}\", Core::ShaderResourceType::${RESOURCE_TYPE}, ${BIND_POINT}, ${SPACE}, ${COUNT} },\n")
+        math(EXPR RESOURCE_COUNT "${RESOURCE_COUNT} + 1")
+    endif()
+endforeach()
+
+set(REFLECTION "")
+if(VERTEX_MEMBERS)
+    string(APPEND REFLECTION "\n\tstruct ${NAME}_vertex\n\t{\n${VERTEX_MEMBERS}\t};\n")
+endif()
+if(INSTANCE_MEMBERS)
+    string(APPEND REFLECTION "\n\tstruct ${NAME}_instance\n\t{\n${INSTANCE_MEMBERS}\t};\n")
+endif()
+set(INPUTS_POINTER nullptr)
+if(INPUTS)
+    string(APPEND REFLECTION "\n\tinline constexpr Core::ShaderInputElement ${NAME}_inputs[] = {\n${INPUTS}\t};\n")
+    set(INPUTS_POINTER ${NAME}_inputs)
+endif()
+set(RESOURCES_POINTER nullptr)
+if(RESOURCES)
+    string(APPEND REFLECTION "\n\tinline constexpr Core::ShaderResourceBinding ${NAME}_resources[] = {\n${RESOURCES}\t};\n")
+    set(RESOURCES_POINTER ${NAME}_resources)
+endif()
+string(APPEND REFLECTION "\n\tinline constexpr Core::ShaderReflection ${NAME}_reflection = { ${INPUTS_POINTER}, ${INPUT_COUNT}, ${RESOURCES_POINTER}, ${RESOURCE_COUNT} };\n")
+
+set(CONTENT "// Generated by cmake/EmbedShader.cmake from ${SOURCE}, do not edit.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include \"core/shader_reflection.hpp\"
+
+namespace Shaders
+{
+	// ${BYTECODE_SIZE} bytes
+	inline constexpr unsigned char ${NAME}[] = {
+${BYTECODE}
+	};
+${REFLECTION}}
+")
+
+# Leave the header untouched when nothing changed, so nothing including it rebuilds.
+if(EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} PREVIOUS_CONTENT)
+endif()
+if(NOT "${PREVIOUS_CONTENT}" STREQUAL "${CONTENT}")
+    file(WRITE ${OUTPUT} "${CONTENT}")
+endif()
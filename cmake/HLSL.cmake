@@ -1,125 +1,235 @@
-function(add_hlsl)
-
-    # Find glslc compiler.
-    find_program(CMAKE_HLSL_COMPILER glslc REQUIRED)
-    mark_as_advanced(CMAKE_HLSL_COMPILER)
-
-    # Find spirv linker.
-    find_program(CMAKE_HLSL_LINKER spirv-link REQUIRED)
-    mark_as_advanced(CMAKE_HLSL_LINKER)
+# add_hlsl(<target>
+#     SOURCE <file.hlsl>
+#     PROFILE <vs_5_0 | ps_6_0 | ...>
+#     NAME <identifier>
+#     [ENTRY <entry point, defaults to main>]
+#     [INCLUDE <directories>...]
+#     [DEFINES <NAME=VALUE>...])
+#
+# Compiles one shader stage and embeds the bytecode into <target> as
+# `Shaders::<NAME>`, a constexpr unsigned char array declared in the generated
+# header "shaders/<NAME>.hpp". The header also holds the reflection the build
+# parsed from the assembly listing (see EmbedShader.cmake), input layout and
+# resource bindings. Shader model 6 profiles are compiled with DXC,
+# which also runs on Linux, older profiles need FXC from the Windows SDK.
+# Every compile prints the bytecode size and compile time of the stage.
+#
+# add_hlsl_permutations(<target>
+#     SOURCE <file.hlsl>
+#     PROFILE <profile>
+#     NAME <identifier>
+#     [ENTRY <entry point>]
+#     [INCLUDE <directories>...]
+#     [DEFINES <NAME=VALUE>...]
+#     [KEYS <keys>...])
+#
+# Compiles one stage per combination of the feature bits the shader declares
+# with a "// FEATURES: A B ..." line, each feature is defined to 0 or 1. KEYS
+# restricts the build to the listed combinations, by default all are built.
+# The generated header "shaders/<NAME>.hpp" declares the feature bits as
+# `Shaders::<NAME>_features` and the variants as `Shaders::<NAME>`, a
+# Core::ShaderPermutations table indexed by the key (the or of the bits).
+
+set(HLSL_COMPILE_SCRIPT "${CMAKE_CURRENT_LIST_DIR}/CompileShader.cmake")
+set(HLSL_EMBED_SCRIPT "${CMAKE_CURRENT_LIST_DIR}/EmbedShader.cmake")
+set(HLSL_GENERATED_DIR "${CMAKE_BINARY_DIR}/generated")
+
+function(add_hlsl TARGET)
 
     # Parse arguments.
     set(prefix ADD_HLSL)
     set(flags "")
-    set(singleValues OUTPUT VERSION SOURCE COMPUTE VERTEX FRAGMENT GEOMETRY TESSCTRL TESSEVAL RAYGEN RAYCHIT RAYAHIT RAYMISS)
-    set(multiValues INCLUDE)
-    include (CMakeParseArguments)
+    set(singleValues SOURCE PROFILE NAME ENTRY)
+    set(multiValues INCLUDE DEFINES)
     cmake_parse_arguments(${prefix} "${flags}" "${singleValues}" "${multiValues}" ${ARGN})
 
-    # Prepare directory
-    make_directory(${CMAKE_CURRENT_BINARY_DIR}/CMakeFiles/${ADD_HLSL_OUTPUT}.dir)
-
-    # Create common variables
-    set(ADD_HLSL_COMPILE_FLAGS -g -O -Os)
-    set(ADD_HLSL_OBJECT_DIR "${CMAKE_CURRENT_BINARY_DIR}/CMakeFiles/${ADD_HLSL_OUTPUT}.dir")
-    set(ADD_HLSL_OBJECTS "")
-
-    # Prepend -I for each include directory
-    set(ADD_HLSL_INCLUDE_DIRS "")
-    foreach(INCLUDE ${ADD_HLSL_INCLUDE})
-        get_filename_component(ABS_INCLUDE ${INCLUDE} ABSOLUTE)
-        list(APPEND ADD_HLSL_INCLUDE_DIRS -I${ABS_INCLUDE})
-    endforeach()
-
-    # NOTE: This is a bit crude, because most of the generators does not support DEPFILE.
-    # Therefore we scan the whole include directories to scan for any possible dependencies.
-    set(ADD_HLSL_INCLUDE_DEPS "")
-    foreach(INCLUDE ${ADD_HLSL_INCLUDE})
-        get_filename_component(ABS_INCLUDE ${INCLUDE} ABSOLUTE)
-        file(GLOB_RECURSE FILES ${ABS_INCLUDE}/*.hlsli)
-        list(APPEND ADD_HLSL_INCLUDE_DEPS ${FILES})
-    endforeach()
+    if(NOT ADD_HLSL_SOURCE OR NOT ADD_HLSL_PROFILE OR NOT ADD_HLSL_NAME)
+        message(FATAL_ERROR "add_hlsl needs SOURCE, PROFILE and NAME")
+    endif()
+    if(NOT ADD_HLSL_ENTRY)
+        set(ADD_HLSL_ENTRY main)
+    endif()
+
+    get_filename_component(SOURCE ${ADD_HLSL_SOURCE} ABSOLUTE)
+    set(ADD_HLSL_OBJECT "${CMAKE_CURRENT_BINARY_DIR}/CMakeFiles/${TARGET}.dir/shaders/${ADD_HLSL_NAME}.cso")
+    set(ADD_HLSL_LISTING "${CMAKE_CURRENT_BINARY_DIR}/CMakeFiles/${TARGET}.dir/shaders/${ADD_HLSL_NAME}.asm")
+    set(ADD_HLSL_HEADER "${HLSL_GENERATED_DIR}/shaders/${ADD_HLSL_NAME}.hpp")
+
+    # Shader model 6 and later is DXIL, which only DXC produces.
+    string(REGEX MATCH "_([0-9]+)_" SHADER_MODEL_MATCH ${ADD_HLSL_PROFILE})
+    if(CMAKE_MATCH_1 GREATER_EQUAL 6)
+        find_program(DXC_EXECUTABLE dxc REQUIRED)
+        mark_as_advanced(DXC_EXECUTABLE)
+
+        set(ADD_HLSL_FLAGS -nologo -T ${ADD_HLSL_PROFILE} -E ${ADD_HLSL_ENTRY})
+        foreach(INCLUDE ${ADD_HLSL_INCLUDE})
+            get_filename_component(ABS_INCLUDE ${INCLUDE} ABSOLUTE)
+            list(APPEND ADD_HLSL_FLAGS -I ${ABS_INCLUDE})
+        endforeach()
+        foreach(DEFINE ${ADD_HLSL_DEFINES})
+            list(APPEND ADD_HLSL_FLAGS -D ${DEFINE})
+        endforeach()
+
+        # DXC writes a make style depfile, so only the shaders whose includes changed are rebuilt.
+        set(ADD_HLSL_DEPFILE "${ADD_HLSL_OBJECT}.d")
+        set(ADD_HLSL_COMMAND ${DXC_EXECUTABLE} ${ADD_HLSL_FLAGS} -MD -MF ${ADD_HLSL_DEPFILE} -Fo ${ADD_HLSL_OBJECT} -Fc ${ADD_HLSL_LISTING} ${SOURCE})
+        set(ADD_HLSL_DEPENDENCY_ARGS DEPFILE ${ADD_HLSL_DEPFILE})
+    else()
+        find_program(FXC_EXECUTABLE fxc REQUIRED)
+        mark_as_advanced(FXC_EXECUTABLE)
+
+        set(ADD_HLSL_FLAGS /nologo /T ${ADD_HLSL_PROFILE} /E ${ADD_HLSL_ENTRY})
+        foreach(INCLUDE ${ADD_HLSL_INCLUDE})
+            get_filename_component(ABS_INCLUDE ${INCLUDE} ABSOLUTE)
+            list(APPEND ADD_HLSL_FLAGS /I ${ABS_INCLUDE})
+        endforeach()
+        foreach(DEFINE ${ADD_HLSL_DEFINES})
+            list(APPEND ADD_HLSL_FLAGS /D ${DEFINE})
+        endforeach()
+
+        # NOTE: FXC can not write dependency files.
+        # Therefore we scan the whole include directories to scan for any possible dependencies.
+        set(ADD_HLSL_INCLUDE_DEPS "")
+        foreach(INCLUDE ${ADD_HLSL_INCLUDE})
+            get_filename_component(ABS_INCLUDE ${INCLUDE} ABSOLUTE)
+            file(GLOB_RECURSE FILES ${ABS_INCLUDE}/*.hlsli)
+            list(APPEND ADD_HLSL_INCLUDE_DEPS ${FILES})
+        endforeach()
+
+        set(ADD_HLSL_COMMAND ${FXC_EXECUTABLE} ${ADD_HLSL_FLAGS} /Fo ${ADD_HLSL_OBJECT} /Fc ${ADD_HLSL_LISTING} ${SOURCE})
+        set(ADD_HLSL_DEPENDENCY_ARGS DEPENDS ${ADD_HLSL_INCLUDE_DEPS})
+    endif()
+
+    get_filename_component(ADD_HLSL_OBJECT_DIR ${ADD_HLSL_OBJECT} DIRECTORY)
+    add_custom_command(
+            OUTPUT  ${ADD_HLSL_OBJECT}
+            BYPRODUCTS ${ADD_HLSL_LISTING}
+            COMMAND ${CMAKE_COMMAND} -E make_directory ${ADD_HLSL_OBJECT_DIR}
+            COMMAND ${CMAKE_COMMAND}
+                -DNAME=${ADD_HLSL_NAME}
+                -DOUTPUT=${ADD_HLSL_OBJECT}
+                -P ${HLSL_COMPILE_SCRIPT}
+                -- ${ADD_HLSL_COMMAND}
+            MAIN_DEPENDENCY ${SOURCE}
+            DEPENDS ${HLSL_COMPILE_SCRIPT}
+            ${ADD_HLSL_DEPENDENCY_ARGS}
+            COMMENT "Compiling ${ADD_HLSL_SOURCE} (${ADD_HLSL_PROFILE})"
+            VERBATIM)
 
-    # Define sub-targets for the final target.
-    # Each sub-target is a shader spirv file with entry.
-    # All different shader stages use the same compiling logic, so we define a macro.
-    macro(add_hlsl_subtarget STAGE ENTRY)
-        set(ADD_HLSL_SUBTARGET "${ADD_HLSL_OBJECT_DIR}/${ENTRY}.spv")
-        list(APPEND ADD_HLSL_OBJECTS ${ADD_HLSL_SUBTARGET})
-        get_filename_component(SOURCE ${ADD_HLSL_SOURCE} ABSOLUTE)
-        add_custom_command(
-                OUTPUT  ${ADD_HLSL_SUBTARGET}
-                COMMAND ${CMAKE_COMMAND} -E make_directory ${ADD_HLSL_OBJECT_DIR}
-                COMMAND ${CMAKE_HLSL_COMPILER} -MD --target-env=${ADD_HLSL_VERSION}
-                -fshader-stage=${STAGE}
-                -fentry-point=${ENTRY}
-                ${ADD_HLSL_INCLUDE_DIRS}
-                ${SOURCE}
-                ${ADD_HLSL_COMPILE_FLAGS} -o ${ADD_HLSL_SUBTARGET}
-                MAIN_DEPENDENCY ${SOURCE}
-                DEPENDS ${ADD_HLSL_INCLUDE_DEPS}
-                WORKING_DIRECTORY ${ADD_HLSL_OBJECT_DIR}
-                BYPRODUCTS ${ADD_HLSL_SUBTARGET}.d)
-    endmacro()
-
-    # Add compute shaders.
-    foreach(ENTRY ${ADD_HLSL_COMPUTE})
-        add_hlsl_subtarget(compute ${ENTRY})
-    endforeach()
+    add_custom_command(
+            OUTPUT  ${ADD_HLSL_HEADER}
+            COMMAND ${CMAKE_COMMAND}
+                -DINPUT=${ADD_HLSL_OBJECT}
+                -DLISTING=${ADD_HLSL_LISTING}
+                -DPROFILE=${ADD_HLSL_PROFILE}
+                -DOUTPUT=${ADD_HLSL_HEADER}
+                -DNAME=${ADD_HLSL_NAME}
+                -DSOURCE=${ADD_HLSL_SOURCE}
+                -P ${HLSL_EMBED_SCRIPT}
+            DEPENDS ${ADD_HLSL_OBJECT} ${HLSL_EMBED_SCRIPT}
+            COMMENT "Embedding ${ADD_HLSL_NAME}"
+            VERBATIM)
+
+    target_sources(${TARGET} PRIVATE ${ADD_HLSL_HEADER})
+    get_target_property(TARGET_TYPE ${TARGET} TYPE)
+    if(NOT TARGET_TYPE STREQUAL "UTILITY")
+        target_include_directories(${TARGET} PRIVATE ${HLSL_GENERATED_DIR})
+    endif()
+
+endfunction()
+
+function(add_hlsl_permutations TARGET)
 
-    # Add vertex shaders.
-    foreach(ENTRY ${ADD_HLSL_VERTEX})
-        add_hlsl_subtarget(vertex ${ENTRY})
-    endforeach()
+    # Parse arguments.
+    set(prefix ADD_HLSL)
+    set(flags "")
+    set(singleValues SOURCE PROFILE NAME ENTRY)
+    set(multiValues INCLUDE DEFINES KEYS)
+    cmake_parse_arguments(${prefix} "${flags}" "${singleValues}" "${multiValues}" ${ARGN})
 
-    # Add fragment shaders.
-    foreach(ENTRY ${ADD_HLSL_FRAGMENT})
-        add_hlsl_subtarget(fragment ${ENTRY})
+    if(NOT ADD_HLSL_SOURCE OR NOT ADD_HLSL_PROFILE OR NOT ADD_HLSL_NAME)
+        message(FATAL_ERROR "add_hlsl_permutations needs SOURCE, PROFILE and NAME")
+    endif()
+
+    # The feature list is read at configure time, so editing it has to configure again.
+    get_filename_component(SOURCE ${ADD_HLSL_SOURCE} ABSOLUTE)
+    set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${SOURCE})
+    file(STRINGS ${SOURCE} FEATURE_LINES REGEX "^//[ \t]*FEATURES:")
+    set(FEATURES "")
+    foreach(FEATURE_LINE ${FEATURE_LINES})
+        string(REGEX REPLACE "^//[ \t]*FEATURES:" "" FEATURE_LINE "${FEATURE_LINE}")
+        separate_arguments(FEATURE_LINE)
+        list(APPEND FEATURES ${FEATURE_LINE})
     endforeach()
 
-    # Add geometry shaders.
-    foreach(ENTRY ${ADD_HLSL_GEOMETRY})
-        add_hlsl_subtarget(geometry ${ENTRY})
+    list(LENGTH FEATURES FEATURE_COUNT)
+    math(EXPR PERMUTATION_COUNT "1 << ${FEATURE_COUNT}")
+    math(EXPR LAST_KEY "${PERMUTATION_COUNT} - 1")
+    if(NOT ADD_HLSL_KEYS)
+        foreach(KEY RANGE ${LAST_KEY})
+            list(APPEND ADD_HLSL_KEYS ${KEY})
+        endforeach()
+    endif()
+
+    set(PASS_ARGS PROFILE ${ADD_HLSL_PROFILE} INCLUDE ${ADD_HLSL_INCLUDE})
+    if(ADD_HLSL_ENTRY)
+        list(APPEND PASS_ARGS ENTRY ${ADD_HLSL_ENTRY})
+    endif()
+
+    # Every permutation is its own custom command, so the build tool compiles them in parallel.
+    set(INCLUDES "")
+    foreach(KEY ${ADD_HLSL_KEYS})
+        if(KEY GREATER LAST_KEY)
+            message(FATAL_ERROR "${ADD_HLSL_NAME}: key ${KEY} uses a feature ${ADD_HLSL_SOURCE} does not declare")
+        endif()
+
+        set(DEFINES ${ADD_HLSL_DEFINES})
+        set(BIT 0)
+        foreach(FEATURE ${FEATURES})
+            math(EXPR IS_ENABLED "(${KEY} >> ${BIT}) & 1")
+            list(APPEND DEFINES ${FEATURE}=${IS_ENABLED})
+            math(EXPR BIT "${BIT} + 1")
+        endforeach()
+
+        add_hlsl(${TARGET} SOURCE ${ADD_HLSL_SOURCE} NAME ${ADD_HLSL_NAME}_${KEY} DEFINES ${DEFINES} ${PASS_ARGS})
+        string(APPEND INCLUDES "#include \"shaders/${ADD_HLSL_NAME}_${KEY}.hpp\"\n")
     endforeach()
 
-    # Add tessctrl shaders.
-    foreach(ENTRY ${ADD_HLSL_TESSCTRL})
-        add_hlsl_subtarget(tesscontrol ${ENTRY})
+    set(FEATURE_BITS "")
+    set(BIT 0)
+    foreach(FEATURE ${FEATURES})
+        string(APPEND FEATURE_BITS "\t\tstatic constexpr Core::ShaderKey ${FEATURE} = 1u << ${BIT};\n")
+        math(EXPR BIT "${BIT} + 1")
     endforeach()
 
-    # Add tesseval shaders.
-    foreach(ENTRY ${ADD_HLSL_TESSEVAL})
-        add_hlsl_subtarget(tesseval ${ENTRY})
+    set(VARIANTS "")
+    foreach(KEY RANGE ${LAST_KEY})
+        list(FIND ADD_HLSL_KEYS ${KEY} KEY_IDX)
+        if(KEY_IDX EQUAL -1)
+            string(APPEND VARIANTS "\t\t{},\n")
+        else()
+            string(APPEND VARIANTS "\t\t{ ${ADD_HLSL_NAME}_${KEY}, sizeof(${ADD_HLSL_NAME}_${KEY}), &${ADD_HLSL_NAME}_${KEY}_reflection },\n")
+        endif()
     endforeach()
 
-    # Add rgen shaders.
-    foreach(ENTRY ${ADD_HLSL_RAYGEN})
-        add_hlsl_subtarget(rgen ${ENTRY})
-    endforeach()
+    file(CONFIGURE OUTPUT "${HLSL_GENERATED_DIR}/shaders/${ADD_HLSL_NAME}.hpp" @ONLY CONTENT
+"// Generated by add_hlsl_permutations from ${ADD_HLSL_SOURCE}, do not edit.
+#pragma once
 
-    # Add rchit shaders.
-    foreach(ENTRY ${ADD_HLSL_RAYCHIT})
-        add_hlsl_subtarget(rchit ${ENTRY})
-    endforeach()
+#include \"core/shader_permutation.hpp\"
 
-    # Add rahit shaders.
-    foreach(ENTRY ${ADD_HLSL_RAYAHIT})
-        add_hlsl_subtarget(rahit ${ENTRY})
-    endforeach()
+${INCLUDES}
+namespace Shaders
+{
+\tstruct ${ADD_HLSL_NAME}_features
+\t{
+${FEATURE_BITS}\t};
 
-    # Add rmiss shaders.
-    foreach(ENTRY ${ADD_HLSL_RAYMISS})
-        add_hlsl_subtarget(rmiss ${ENTRY})
-    endforeach()
+\tinline constexpr Core::ShaderPermutations<${PERMUTATION_COUNT}> ${ADD_HLSL_NAME} = { {
+${VARIANTS}\t} };
+}
+")
 
-    # Build shader library target
-    set(OUTPUT_FILE "${CMAKE_CURRENT_BINARY_DIR}/${ADD_HLSL_OUTPUT}")
-    get_filename_component(OUTPUT_FILE ${OUTPUT_FILE} ABSOLUTE)
-    get_filename_component(OUTPUT_DIRECTORY ${OUTPUT_FILE} DIRECTORY)
-    add_custom_command(
-            OUTPUT  ${ADD_HLSL_OUTPUT}
-            COMMAND ${CMAKE_COMMAND} -E make_directory ${OUTPUT_DIRECTORY}
-            COMMAND ${CMAKE_HLSL_LINKER} --target-env ${ADD_HLSL_VERSION} ${ADD_HLSL_OBJECTS} -o ${ADD_HLSL_OUTPUT}
-            DEPENDS ${ADD_HLSL_OBJECTS})
+    target_sources(${TARGET} PRIVATE "${HLSL_GENERATED_DIR}/shaders/${ADD_HLSL_NAME}.hpp")
 
-endfunction()
\ No newline at end of file
+endfunction()
@@ -1,2 +0,0 @@
-fxc src\shaders\main.pix.hlsl /Fo src\shaders\main.pix.cso /T ps_5_0
-fxc src\shaders\main.vert.hlsl /Fo src\shaders\main.vert.cso /T vs_5_0
\ No newline at end of file
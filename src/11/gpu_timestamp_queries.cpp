@@ -0,0 +1,104 @@
+#include "gpu_timestamp_queries.hpp"
+
+#include "exception.hpp"
+
+namespace DX11
+{
+
+	using Microsoft::WRL::ComPtr;
+
+	GpuTimestampQueries::GpuTimestampQueries(
+		ComPtr<ID3D11Device> device,
+		ComPtr<ID3D11DeviceContext> device_context,
+		uint32_t frame_slot_count,
+		uint32_t max_timestamps_per_frame) :
+		m_device_context(device_context),
+		m_frame_slots(frame_slot_count),
+		m_ticks(max_timestamps_per_frame),
+		m_max_timestamps_per_frame(max_timestamps_per_frame)
+	{
+		D3D11_QUERY_DESC disjoint_desc;
+		disjoint_desc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+		disjoint_desc.MiscFlags = 0;
+
+		D3D11_QUERY_DESC timestamp_desc;
+		timestamp_desc.Query = D3D11_QUERY_TIMESTAMP;
+		timestamp_desc.MiscFlags = 0;
+
+		for (auto& slot : m_frame_slots)
+		{
+			DX_THROW_INFO(device->CreateQuery(&disjoint_desc, &slot.disjoint_query));
+
+			slot.timestamp_queries.resize(max_timestamps_per_frame);
+			for (auto& query : slot.timestamp_queries)
+			{
+				DX_THROW_INFO(device->CreateQuery(&timestamp_desc, &query));
+			}
+		}
+	}
+
+	uint32_t GpuTimestampQueries::frame_slot_count() const
+	{
+		return static_cast<uint32_t>(m_frame_slots.size());
+	}
+
+	uint32_t GpuTimestampQueries::max_timestamps_per_frame() const
+	{
+		return m_max_timestamps_per_frame;
+	}
+
+	void GpuTimestampQueries::begin_frame(uint32_t frame_slot)
+	{
+		auto& slot = m_frame_slots[frame_slot];
+		slot.begin_cpu_ns = Core::Profiler::now();
+		m_device_context->Begin(slot.disjoint_query.Get());
+	}
+
+	void GpuTimestampQueries::write_timestamp(uint32_t frame_slot, uint32_t timestamp_idx)
+	{
+		m_device_context->End(m_frame_slots[frame_slot].timestamp_queries[timestamp_idx].Get());
+	}
+
+	void GpuTimestampQueries::end_frame(uint32_t frame_slot, uint32_t timestamp_count)
+	{
+		m_device_context->End(m_frame_slots[frame_slot].disjoint_query.Get());
+	}
+
+	bool GpuTimestampQueries::read_timestamps(uint32_t frame_slot, uint32_t timestamp_count, Core::GpuTimestamps& timestamps)
+	{
+		auto& slot = m_frame_slots[frame_slot];
+
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+		if (m_device_context->GetData(
+			slot.disjoint_query.Get(),
+			&disjoint,
+			sizeof(disjoint),
+			D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		{
+			return false;
+		}
+
+		for (uint32_t timestamp_idx = 0; timestamp_idx < timestamp_count; ++timestamp_idx)
+		{
+			if (m_device_context->GetData(
+				slot.timestamp_queries[timestamp_idx].Get(),
+				&m_ticks[timestamp_idx],
+				sizeof(uint64_t),
+				D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			{
+				return false;
+			}
+		}
+
+		// DX11 has no clock calibration, so the first timestamp of the frame is
+		// pinned to the CPU time the frame started. This places GPU regions too
+		// early on the timeline by however far the GPU lagged behind the CPU.
+		timestamps.ticks = m_ticks.data();
+		timestamps.frequency = disjoint.Frequency;
+		timestamps.calibration_gpu_tick = timestamp_count > 0 ? m_ticks[0] : 0;
+		timestamps.calibration_cpu_ns = slot.begin_cpu_ns;
+		timestamps.is_reliable = !disjoint.Disjoint;
+		return true;
+	}
+
+}
@@ -0,0 +1,51 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_GPU_TIMESTAMP_QUERIES_HPP
+#define DIRECTX_PLAYGROUND_SRC_GPU_TIMESTAMP_QUERIES_HPP
+
+#include <d3d11.h>
+#include <wrl.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "core/gpu_profiler.hpp"
+
+namespace DX11
+{
+
+	// One D3D11_QUERY_TIMESTAMP_DISJOINT query per frame slot, wrapping that
+	// frame's D3D11_QUERY_TIMESTAMP queries
+	class GpuTimestampQueries : public Core::GpuQuerySource
+	{
+	public:
+		GpuTimestampQueries(
+			Microsoft::WRL::ComPtr<ID3D11Device> device,
+			Microsoft::WRL::ComPtr<ID3D11DeviceContext> device_context,
+			uint32_t frame_slot_count = 4,
+			uint32_t max_timestamps_per_frame = 64);
+		GpuTimestampQueries(const GpuTimestampQueries&) = delete;
+		GpuTimestampQueries& operator=(const GpuTimestampQueries&) = delete;
+
+		uint32_t frame_slot_count() const override;
+		uint32_t max_timestamps_per_frame() const override;
+
+		void begin_frame(uint32_t frame_slot) override;
+		void write_timestamp(uint32_t frame_slot, uint32_t timestamp_idx) override;
+		void end_frame(uint32_t frame_slot, uint32_t timestamp_count) override;
+		bool read_timestamps(uint32_t frame_slot, uint32_t timestamp_count, Core::GpuTimestamps& timestamps) override;
+	private:
+		struct FrameSlot
+		{
+			Microsoft::WRL::ComPtr<ID3D11Query> disjoint_query;
+			std::vector<Microsoft::WRL::ComPtr<ID3D11Query>> timestamp_queries;
+			uint64_t begin_cpu_ns = 0;
+		};
+
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_device_context;
+		std::vector<FrameSlot> m_frame_slots;
+		std::vector<uint64_t> m_ticks;
+		uint32_t m_max_timestamps_per_frame;
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_GPU_TIMESTAMP_QUERIES_HPP
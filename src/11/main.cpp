@@ -2,6 +2,12 @@
 #include <cassert>
 
 #include "renderer.hpp"
+#include "core/benchmark.hpp"
+#include "core/job_system.hpp"
+#include "core/profiler.hpp"
+#include "core/render_queue.hpp"
+#include "core/scene.hpp"
+#include "core/shader_hot_reload.hpp"
 
 void xmain(int argc, const char** argv)
 {
@@ -16,12 +22,34 @@ void xmain(int argc, const char** argv)
 
 	assert(window.create(window_desc, event_queue));
 
+	PROFILE_THREAD_NAME("Main");
+
+	Core::JobSystem job_system;
+
 	auto h_wnd = window.getHwnd();
 	DX11::Renderer renderer(h_wnd);
 
+	const auto benchmark_config = Core::parse_benchmark_config(argc, argv);
+	Core::BenchmarkRecorder benchmark_recorder(benchmark_config);
+	Core::RenderQueue render_queue;
+
+#if defined(DIRECTX_PLAYGROUND_SHADER_HOT_RELOAD)
+	Core::ShaderHotReload shader_hot_reload(
+		DIRECTX_PLAYGROUND_SHADER_DIR,
+		[](const std::string& path, const Core::ShaderSource& source, std::vector<unsigned char>& bytecode, std::string& errors)
+		{
+			return Core::compile_shader_file(DIRECTX_PLAYGROUND_FXC, path, source, bytecode, errors);
+		});
+	const uint32_t vertex_shader_id = shader_hot_reload.add_shader({ "main.vert.hlsl", "vs_5_0", "main", { "INSTANCING=0" } });
+	const uint32_t pixel_shader_id = shader_hot_reload.add_shader({ "main.pix.hlsl", "ps_5_0" });
+#endif
+
 	bool is_running = true;
 	while (is_running)
 	{
+		PROFILE_ZONE("Frame");
+		benchmark_recorder.begin_frame();
+
 		event_queue.update();
 
 		while (!event_queue.empty())
@@ -38,6 +66,42 @@ void xmain(int argc, const char** argv)
 			event_queue.pop();
 		}
 
-		renderer.render();
+#if defined(DIRECTX_PLAYGROUND_SHADER_HOT_RELOAD)
+		for (const auto& reload : shader_hot_reload.take_reloads())
+		{
+			if (!reload.is_compiled)
+			{
+				OutputDebugStringA(reload.errors.c_str());
+				continue;
+			}
+
+			// Compiled, so only creating the shader objects can have failed
+			if (reload.shader_id == vertex_shader_id && !renderer.reload_vertex_shader(reload.bytecode))
+			{
+				OutputDebugStringA("Creating the reloaded vertex shader or its input layout failed, keeping the previous one\n");
+			}
+			else if (reload.shader_id == pixel_shader_id && !renderer.reload_pixel_shader(reload.bytecode))
+			{
+				OutputDebugStringA("Creating the reloaded pixel shader failed, keeping the previous one\n");
+			}
+		}
+#endif
+
+		Core::render_scene(job_system, renderer, benchmark_config.scene, render_queue);
+		benchmark_recorder.end_cpu_work();
+		renderer.present();
+
+		benchmark_recorder.end_frame();
+		benchmark_recorder.add_gpu_samples(renderer.gpu_profiler());
+
+		if (benchmark_config.is_enabled && benchmark_recorder.is_finished())
+		{
+			benchmark_recorder.write_json(renderer.name());
+			is_running = false;
+		}
 	}
+
+#if defined(DIRECTX_PLAYGROUND_PROFILE)
+	Core::Profiler::write_chrome_trace("profile.json");
+#endif
 }
@@ -1,20 +1,65 @@
 #include "renderer.hpp"
 
 #include "exception.hpp"
+#include "core/profiler.hpp"
+#include "core/scene.hpp"
+#include "shaders/main_pix_sm5.hpp"
+#include "shaders/main_vert_sm5.hpp"
 
 #include <d3d11.h>
 #include <dxgi.h>
 #include <cassert>
 #include <comdef.h>
-#include <d3dcompiler.h>
+#include <cstddef>
+#include <type_traits>
 
 namespace DX11
 {
 
 	using Microsoft::WRL::ComPtr;
 
+	// Core::Vertex has to match what main.vert.hlsl reads, member by member. Its members are
+	// Core::Float4 and Float2 where the reflection has float arrays of the same size.
+	static_assert(sizeof(Core::Vertex) == sizeof(Shaders::main_vert_sm5_0_vertex));
+	static_assert(std::is_same_v<std::remove_extent_t<decltype(Shaders::main_vert_sm5_0_vertex::Color)>, float>);
+	static_assert(sizeof(Core::Vertex::color) == sizeof(Shaders::main_vert_sm5_0_vertex::Color));
+	static_assert(offsetof(Core::Vertex, color) == offsetof(Shaders::main_vert_sm5_0_vertex, Color));
+	static_assert(std::is_same_v<std::remove_extent_t<decltype(Shaders::main_vert_sm5_0_vertex::Position)>, float>);
+	static_assert(sizeof(Core::Vertex::pos) == sizeof(Shaders::main_vert_sm5_0_vertex::Position));
+	static_assert(offsetof(Core::Vertex, pos) == offsetof(Shaders::main_vert_sm5_0_vertex, Position));
+
+	namespace
+	{
+
+		constexpr uint32_t max_input_element_count = D3D11_IA_VERTEX_INPUT_STRUCTURE_ELEMENT_COUNT;
+
+		// The layout comes from the reflection generated at build time, nothing is reflected here
+		uint32_t create_input_element_desc(
+			const Core::ShaderReflection& reflection,
+			D3D11_INPUT_ELEMENT_DESC (&input_element_desc)[max_input_element_count])
+		{
+			assert(reflection.input_count <= max_input_element_count);
+			for (uint32_t input_idx = 0; input_idx < reflection.input_count; ++input_idx)
+			{
+				const Core::ShaderInputElement& input = reflection.inputs[input_idx];
+				D3D11_INPUT_ELEMENT_DESC& desc = input_element_desc[input_idx];
+				desc.SemanticName = input.semantic;
+				desc.SemanticIndex = input.semantic_idx;
+				desc.Format = static_cast<DXGI_FORMAT>(Core::input_element_dxgi_format(input));
+				desc.InputSlot = input.input_slot;
+				desc.AlignedByteOffset = input.offset;
+				desc.InputSlotClass = input.is_per_instance ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+				desc.InstanceDataStepRate = input.is_per_instance ? 1 : 0;
+			}
+			return reflection.input_count;
+		}
+
+	}
+
 	Renderer::Renderer(HWND h_wnd)
 	{
+		PROFILE_FUNCTION();
+
 		DXGI_SWAP_CHAIN_DESC swapchain_descriptor;
 		swapchain_descriptor.BufferCount = 1;
 		swapchain_descriptor.BufferDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
@@ -50,96 +95,77 @@ namespace DX11
 
 		DX_THROW_INFO(m_swapchain->GetBuffer(0, __uuidof(ID3D11Resource), &back_buffer));
 		DX_THROW_INFO(m_device->CreateRenderTargetView(back_buffer.Get(), nullptr, &m_render_target_view));
+
+		m_gpu_timestamp_queries = std::make_unique<GpuTimestampQueries>(m_device, m_device_context);
+		m_gpu_profiler = std::make_unique<Core::GpuProfiler>(*m_gpu_timestamp_queries);
+
+		constexpr Core::ShaderBytecode vertex_shader_bytecode = Shaders::main_vert_sm5.select<0>();
+		constexpr Core::ShaderBytecode pixel_shader_bytecode = Shaders::main_pix_sm5.select<0>();
+
+		{
+			PROFILE_ZONE("CreatePixelShader");
+			DX_THROW_INFO(m_device->CreatePixelShader(pixel_shader_bytecode.data, pixel_shader_bytecode.size, nullptr, &m_pixel_shader));
+		}
+
+		{
+			PROFILE_ZONE("CreateVertexShader");
+			DX_THROW_INFO(m_device->CreateVertexShader(vertex_shader_bytecode.data, vertex_shader_bytecode.size, nullptr, &m_vertex_shader));
+		}
+
+		D3D11_INPUT_ELEMENT_DESC input_element_desc[max_input_element_count];
+		const uint32_t input_element_count = create_input_element_desc(*vertex_shader_bytecode.reflection, input_element_desc);
+
+		{
+			PROFILE_ZONE("CreateInputLayout");
+			DX_THROW_INFO(m_device->CreateInputLayout(input_element_desc, input_element_count, vertex_shader_bytecode.data, vertex_shader_bytecode.size, &m_input_layout));
+		}
 	}
 
-	struct Vertex
+	const char* Renderer::name() const
 	{
-		float color[4];
-		float pos[2];
-	};
+		return "dx11";
+	}
 
-	void Renderer::render()
+	const Core::GpuProfiler* Renderer::gpu_profiler() const
 	{
-		const float color[] = { 1.0f, 0.0f, 0.0f, 1.0f };
-		m_device_context->ClearRenderTargetView(m_render_target_view.Get(), color);
+		return m_gpu_profiler.get();
+	}
 
-		ComPtr<ID3D11Buffer> vertex_buffer;
+	void Renderer::begin_frame()
+	{
+		PROFILE_FUNCTION();
 
-		Vertex vertices[3] = {
-			{
-				{ 1.0f, 0.0f, 0.0f, 1.0f },
-				{ 0.0f, 0.5f }
-			},
-			{
-				{ 0.0f, 1.0f, 0.0f, 1.0f },
-				{ 1.0f, -0.5f }
-			},
-			{
-				{ 0.0f, 0.0f, 1.0f, 1.0f },
-				{ -0.5f, -0.5f }
-			},
-		};
+		m_gpu_profiler->begin_frame();
+		m_gpu_frame_region = m_gpu_profiler->begin_region("Frame");
+
+		ComPtr<ID3D11Buffer> vertex_buffer;
 
 		D3D11_BUFFER_DESC buffer_desc;
 		buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-		buffer_desc.ByteWidth = sizeof(vertices);
+		buffer_desc.ByteWidth = sizeof(Core::scene_vertices);
 		buffer_desc.CPUAccessFlags = 0;
 		buffer_desc.MiscFlags = 0;
-		buffer_desc.StructureByteStride = sizeof(Vertex);
+		buffer_desc.StructureByteStride = sizeof(Core::Vertex);
 		buffer_desc.Usage = D3D11_USAGE_DEFAULT;
 
 		D3D11_SUBRESOURCE_DATA subresource_data;
 		subresource_data.SysMemPitch = 0;
 		subresource_data.SysMemSlicePitch = 0;
-		subresource_data.pSysMem = vertices;
+		subresource_data.pSysMem = Core::scene_vertices;
 
-		DX_THROW_INFO(m_device->CreateBuffer(&buffer_desc, &subresource_data, &vertex_buffer));
+		{
+			PROFILE_ZONE("CreateBuffer");
+			DX_THROW_INFO(m_device->CreateBuffer(&buffer_desc, &subresource_data, &vertex_buffer));
+		}
 
-		const uint32_t strides = sizeof(Vertex);
+		const uint32_t strides = sizeof(Core::Vertex);
 		const uint32_t offset = 0;
 		m_device_context->IASetVertexBuffers(0, 1, vertex_buffer.GetAddressOf(), &strides, &offset);
 		m_device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-		ComPtr<ID3D11VertexShader> vertex_shader;
-		ComPtr<ID3D11PixelShader> pixel_shader;
-		ComPtr<ID3DBlob> blob;
-
-		DX_THROW_INFO(D3DReadFileToBlob(L"C:\\Users\\andra\\Projects\\directx-playground\\src\\shaders\\main.pix.cso", &blob));
-		DX_THROW_INFO(m_device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &pixel_shader));
-
-		m_device_context->PSSetShader(pixel_shader.Get(), nullptr, 0);
-
-		DX_THROW_INFO(D3DReadFileToBlob(L"C:\\Users\\andra\\Projects\\directx-playground\\src\\shaders\\main.vert.cso", &blob));
-		DX_THROW_INFO(m_device->CreateVertexShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &vertex_shader));
-
-		m_device_context->VSSetShader(vertex_shader.Get(), nullptr, 0);
-
-		ComPtr<ID3D11InputLayout> input_layout;
-		const D3D11_INPUT_ELEMENT_DESC input_element_desc[] =
-		{
-			{
-				"Color",
-				0,
-				DXGI_FORMAT_R32G32B32A32_FLOAT,
-				0,
-				0,
-				D3D11_INPUT_PER_VERTEX_DATA,
-				0
-			},
-			{
-				"Position",
-				0,
-				DXGI_FORMAT_R32G32_FLOAT,
-				0,
-				16,
-				D3D11_INPUT_PER_VERTEX_DATA,
-				0
-			}
-		};
-
-		DX_THROW_INFO(m_device->CreateInputLayout(input_element_desc, 2, blob->GetBufferPointer(), blob->GetBufferSize(), &input_layout));
-
-		m_device_context->IASetInputLayout(input_layout.Get());
+		m_device_context->VSSetShader(m_vertex_shader.Get(), nullptr, 0);
+		m_device_context->PSSetShader(m_pixel_shader.Get(), nullptr, 0);
+		m_device_context->IASetInputLayout(m_input_layout.Get());
 
 		m_device_context->OMSetRenderTargets(1, m_render_target_view.GetAddressOf(), nullptr);
 
@@ -151,8 +177,67 @@ namespace DX11
 		viewport.TopLeftX = 0.0f;
 		viewport.TopLeftY = 0.0f;
 		m_device_context->RSSetViewports(1, &viewport);
+	}
+
+	bool Renderer::reload_vertex_shader(const std::vector<unsigned char>& bytecode)
+	{
+		PROFILE_FUNCTION();
+
+		ComPtr<ID3D11VertexShader> vertex_shader;
+		if (FAILED(m_device->CreateVertexShader(bytecode.data(), bytecode.size(), nullptr, &vertex_shader)))
+		{
+			return false;
+		}
+
+		// The inputs have to stay what the vertex buffer holds
+		D3D11_INPUT_ELEMENT_DESC input_element_desc[max_input_element_count];
+		const uint32_t input_element_count = create_input_element_desc(*Shaders::main_vert_sm5.select<0>().reflection, input_element_desc);
+		ComPtr<ID3D11InputLayout> input_layout;
+		if (FAILED(m_device->CreateInputLayout(input_element_desc, input_element_count, bytecode.data(), bytecode.size(), &input_layout)))
+		{
+			return false;
+		}
+
+		m_vertex_shader = vertex_shader;
+		m_input_layout = input_layout;
+		return true;
+	}
 
-		DX_THROW_INFO_ONLY(m_device_context->Draw(3, 0));
+	bool Renderer::reload_pixel_shader(const std::vector<unsigned char>& bytecode)
+	{
+		PROFILE_FUNCTION();
+
+		ComPtr<ID3D11PixelShader> pixel_shader;
+		if (FAILED(m_device->CreatePixelShader(bytecode.data(), bytecode.size(), nullptr, &pixel_shader)))
+		{
+			return false;
+		}
+
+		m_pixel_shader = pixel_shader;
+		return true;
+	}
+
+	void Renderer::clear(const float color[4])
+	{
+		m_device_context->ClearRenderTargetView(m_render_target_view.Get(), color);
+	}
+
+	void Renderer::draw(uint32_t vertex_count, uint32_t first_vertex)
+	{
+		DX_THROW_INFO_ONLY(m_device_context->Draw(vertex_count, first_vertex));
+	}
+
+	void Renderer::end_frame()
+	{
+		PROFILE_FUNCTION();
+
+		m_gpu_profiler->end_region(m_gpu_frame_region);
+		m_gpu_profiler->end_frame();
+	}
+
+	void Renderer::present()
+	{
+		PROFILE_FUNCTION();
 
 		if (HRESULT result = m_swapchain->Present(1, 0); FAILED(result))
 		{
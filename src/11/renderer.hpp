@@ -5,26 +5,50 @@
 #include <dxgi.h>
 #include <wrl.h>
 
+#include <memory>
+#include <vector>
+
 #include "dxgi_info_manager.hpp"
+#include "gpu_timestamp_queries.hpp"
+#include "core/gpu_profiler.hpp"
+#include "core/render_backend.hpp"
 
 namespace DX11
 {
 
-	class Renderer
+	class Renderer : public Core::RenderBackend
 	{
 	public:
 		explicit Renderer(HWND h_wnd);
 		Renderer(const Renderer&) = delete;
 		Renderer& operator=(const Renderer&) = delete;
-		~Renderer() = default;
+		~Renderer() override = default;
+
+		const char* name() const override;
+		const Core::GpuProfiler* gpu_profiler() const override;
 
-		void render();
+		void begin_frame() override;
+		void clear(const float color[4]) override;
+		void draw(uint32_t vertex_count, uint32_t first_vertex) override;
+		void end_frame() override;
+		void present() override;
+
+		// For shader hot reload, call between frames. The current shader stays when the bytecode is rejected.
+		bool reload_vertex_shader(const std::vector<unsigned char>& bytecode);
+		bool reload_pixel_shader(const std::vector<unsigned char>& bytecode);
 	private:
 		Microsoft::WRL::ComPtr<ID3D11Device> m_device;
 		Microsoft::WRL::ComPtr<IDXGISwapChain> m_swapchain;
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_device_context;
 		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> m_render_target_view;
+		Microsoft::WRL::ComPtr<ID3D11VertexShader> m_vertex_shader;
+		Microsoft::WRL::ComPtr<ID3D11PixelShader> m_pixel_shader;
+		Microsoft::WRL::ComPtr<ID3D11InputLayout> m_input_layout;
 		DxgiInfoManager m_info_manager;
+
+		std::unique_ptr<GpuTimestampQueries> m_gpu_timestamp_queries;
+		std::unique_ptr<Core::GpuProfiler> m_gpu_profiler;
+		uint32_t m_gpu_frame_region = 0;
 	};
 
 }
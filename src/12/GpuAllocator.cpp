@@ -0,0 +1,251 @@
+#include "GpuAllocator.hpp"
+
+#include <directx/d3dx12.h>
+#include <Windows.h>
+
+#include <algorithm>
+#include <cassert>
+
+#include "core/profiler.hpp"
+
+// Unlike assert() the call also runs in release builds, only the check is compiled out
+#define CHECK_HR(call) do { [[maybe_unused]] const HRESULT check_result = (call); assert(SUCCEEDED(check_result)); } while (false)
+
+namespace DX12
+{
+
+	using Microsoft::WRL::ComPtr;
+
+	namespace
+	{
+		constexpr D3D12_HEAP_TYPE heap_types[] =
+		{
+			D3D12_HEAP_TYPE_DEFAULT,
+			D3D12_HEAP_TYPE_UPLOAD,
+			D3D12_HEAP_TYPE_READBACK,
+		};
+
+		constexpr uint32_t category_count = 4;
+	}
+
+	GpuAllocator::GpuAllocator(
+		ComPtr<ID3D12Device8> device,
+		Core::ResidencyManager& residency_manager,
+		uint64_t heap_size) :
+		m_device(device),
+		m_residency_manager(residency_manager),
+		m_heap_size(heap_size)
+	{
+		D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+		CHECK_HR(m_device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options)));
+		m_resource_heap_tier = options.ResourceHeapTier;
+
+		constexpr D3D12_HEAP_FLAGS category_heap_flags[category_count] =
+		{
+			D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+			D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES,
+			D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+			D3D12_HEAP_FLAG_ALLOW_ALL_BUFFERS_AND_TEXTURES,
+		};
+		// Multisampled render targets need 4MB, everything else gets by with 64KB
+		constexpr uint64_t category_alignments[category_count] =
+		{
+			D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
+			D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT,
+			D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
+			D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT,
+		};
+
+		for (uint32_t heap_type_idx = 0; heap_type_idx < _countof(heap_types); ++heap_type_idx)
+		{
+			for (uint32_t category_idx = 0; category_idx < category_count; ++category_idx)
+			{
+				Pool& pool = m_pools[heap_type_idx * category_count + category_idx];
+				pool.heap_type = heap_types[heap_type_idx];
+				pool.heap_flags = category_heap_flags[category_idx];
+				pool.alignment = category_alignments[category_idx];
+			}
+		}
+	}
+
+	GpuAllocation GpuAllocator::create_resource(
+		D3D12_HEAP_TYPE heap_type,
+		const D3D12_RESOURCE_DESC& desc,
+		D3D12_RESOURCE_STATES initial_state,
+		const D3D12_CLEAR_VALUE* optimized_clear_value)
+	{
+		PROFILE_FUNCTION();
+
+		const auto allocation_info = m_device->GetResourceAllocationInfo(0, 1, &desc);
+
+		GpuAllocation allocation;
+		allocation.pool_idx = pool_idx_of(heap_type, category_of(desc));
+		Pool& pool = m_pools[allocation.pool_idx];
+		assert(allocation_info.Alignment <= pool.alignment);
+
+		allocation.heap_idx = static_cast<uint32_t>(pool.heaps.size());
+		for (uint32_t heap_idx = 0; heap_idx < pool.heaps.size(); ++heap_idx)
+		{
+			if (!pool.heaps[heap_idx])
+			{
+				continue;
+			}
+
+			allocation.range = pool.heaps[heap_idx]->allocator.allocate(allocation_info.SizeInBytes, allocation_info.Alignment);
+			if (allocation.range.is_valid())
+			{
+				allocation.heap_idx = heap_idx;
+				break;
+			}
+		}
+
+		if (!allocation.range.is_valid())
+		{
+			const uint64_t heap_size = std::max(
+				m_heap_size,
+				(allocation_info.SizeInBytes + pool.alignment - 1) & ~(pool.alignment - 1));
+			allocation.heap_idx = create_heap(pool, heap_size);
+			allocation.range = pool.heaps[allocation.heap_idx]->allocator.allocate(allocation_info.SizeInBytes, allocation_info.Alignment);
+			assert(allocation.range.is_valid());
+		}
+
+		CHECK_HR(m_device->CreatePlacedResource(
+			pool.heaps[allocation.heap_idx]->heap.Get(),
+			allocation.range.offset,
+			&desc,
+			initial_state,
+			optimized_clear_value,
+			IID_PPV_ARGS(&allocation.resource)));
+		return allocation;
+	}
+
+	void GpuAllocator::release(GpuAllocation& allocation)
+	{
+		Pool& pool = m_pools[allocation.pool_idx];
+		Heap& heap = *pool.heaps[allocation.heap_idx];
+
+		allocation.resource.Reset();
+		heap.allocator.free(allocation.range);
+		allocation.range = Core::TlsfAllocation();
+
+		// Heaps of the regular size are kept for the next resources, unless there are others
+		if (heap.allocator.is_empty())
+		{
+			const bool is_dedicated = heap.allocator.size() != m_heap_size;
+			const auto heap_count = std::count_if(pool.heaps.begin(), pool.heaps.end(), [](const std::unique_ptr<Heap>& pool_heap)
+			{
+				return pool_heap != nullptr;
+			});
+			if (is_dedicated || heap_count > 1)
+			{
+				release_heap(pool, allocation.heap_idx);
+			}
+		}
+	}
+
+	void GpuAllocator::use(const GpuAllocation& allocation, uint64_t fence_value)
+	{
+		const Heap& heap = *m_pools[allocation.pool_idx].heaps[allocation.heap_idx];
+		if (heap.residency_id != Core::ResidencyManager::invalid_allocation)
+		{
+			m_residency_manager.use(heap.residency_id, fence_value);
+		}
+	}
+
+	void GpuAllocator::use(const GpuAllocation& allocation, uint64_t fence_value, uint64_t copy_fence_value)
+	{
+		const Heap& heap = *m_pools[allocation.pool_idx].heaps[allocation.heap_idx];
+		if (heap.residency_id != Core::ResidencyManager::invalid_allocation)
+		{
+			m_residency_manager.use(heap.residency_id, fence_value, copy_fence_value);
+		}
+	}
+
+	GpuAllocatorStats GpuAllocator::stats() const
+	{
+		GpuAllocatorStats stats;
+		for (const auto& pool : m_pools)
+		{
+			for (const auto& heap : pool.heaps)
+			{
+				if (!heap)
+				{
+					continue;
+				}
+
+				const auto heap_stats = heap->allocator.stats();
+				++stats.heap_count;
+				stats.heap_bytes += heap_stats.size;
+				stats.allocated_bytes += heap_stats.size - heap_stats.free_bytes;
+				stats.allocation_count += heap_stats.allocation_count;
+			}
+		}
+		return stats;
+	}
+
+	GpuAllocator::ResourceCategory GpuAllocator::category_of(const D3D12_RESOURCE_DESC& desc) const
+	{
+		if (m_resource_heap_tier >= D3D12_RESOURCE_HEAP_TIER_2)
+		{
+			return ResourceCategory::All;
+		}
+		if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+		{
+			return ResourceCategory::Buffer;
+		}
+		if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+		{
+			return ResourceCategory::RenderTargetTexture;
+		}
+		return ResourceCategory::Texture;
+	}
+
+	uint32_t GpuAllocator::pool_idx_of(D3D12_HEAP_TYPE heap_type, ResourceCategory category) const
+	{
+		const auto heap_type_idx = static_cast<uint32_t>(std::find(std::begin(heap_types), std::end(heap_types), heap_type) - std::begin(heap_types));
+		assert(heap_type_idx < _countof(heap_types));
+		return heap_type_idx * category_count + static_cast<uint32_t>(category);
+	}
+
+	uint32_t GpuAllocator::create_heap(Pool& pool, uint64_t size)
+	{
+		PROFILE_FUNCTION();
+
+		D3D12_HEAP_DESC heap_desc = {};
+		heap_desc.SizeInBytes = size;
+		heap_desc.Properties = CD3DX12_HEAP_PROPERTIES(pool.heap_type);
+		heap_desc.Alignment = pool.alignment;
+		heap_desc.Flags = pool.heap_flags;
+
+		ComPtr<ID3D12Heap> d3d12_heap;
+		CHECK_HR(m_device->CreateHeap(&heap_desc, IID_PPV_ARGS(&d3d12_heap)));
+
+		// The allocator's granularity is the smallest placement alignment
+		auto heap = std::make_unique<Heap>(d3d12_heap, size, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+		// Upload and readback heaps live in system memory, outside the budget the manager keeps
+		if (pool.heap_type == D3D12_HEAP_TYPE_DEFAULT)
+		{
+			ID3D12Pageable* pageable = d3d12_heap.Get();
+			heap->residency_id = m_residency_manager.track(pageable, size);
+		}
+
+		auto hole = std::find(pool.heaps.begin(), pool.heaps.end(), nullptr);
+		if (hole != pool.heaps.end())
+		{
+			*hole = std::move(heap);
+			return static_cast<uint32_t>(hole - pool.heaps.begin());
+		}
+		pool.heaps.push_back(std::move(heap));
+		return static_cast<uint32_t>(pool.heaps.size() - 1);
+	}
+
+	void GpuAllocator::release_heap(Pool& pool, uint32_t heap_idx)
+	{
+		if (pool.heaps[heap_idx]->residency_id != Core::ResidencyManager::invalid_allocation)
+		{
+			m_residency_manager.untrack(pool.heaps[heap_idx]->residency_id);
+		}
+		pool.heaps[heap_idx].reset();
+	}
+
+}
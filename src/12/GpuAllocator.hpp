@@ -0,0 +1,108 @@
+#ifndef _GPU_ALLOCATOR_HPP
+#define _GPU_ALLOCATOR_HPP
+
+#include <directx/d3d12.h>
+#include <wrl.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "core/residency.hpp"
+#include "core/tlsf_allocator.hpp"
+
+namespace DX12
+{
+	struct GpuAllocation
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+		uint32_t pool_idx = 0;
+		uint32_t heap_idx = 0;
+		Core::TlsfAllocation range;
+	};
+
+	struct GpuAllocatorStats
+	{
+		uint32_t heap_count = 0;
+		uint64_t heap_bytes = 0;
+		uint64_t allocated_bytes = 0;
+		uint32_t allocation_count = 0;
+	};
+
+	// Places resources in large ID3D12Heaps instead of creating a committed resource each,
+	// the ranges inside the heaps are handed out by Core::TlsfAllocator. With resource heap
+	// tier 1 buffers, render targets and other textures need heaps of their own. Resources
+	// larger than a heap get a heap to themselves. Heaps in video memory are tracked by the
+	// residency manager.
+	class GpuAllocator
+	{
+	public:
+		GpuAllocator(
+			Microsoft::WRL::ComPtr<ID3D12Device8> device,
+			Core::ResidencyManager& residency_manager,
+			uint64_t heap_size = 64 * 1024 * 1024);
+		GpuAllocator(const GpuAllocator&) = delete;
+		GpuAllocator& operator=(const GpuAllocator&) = delete;
+
+		GpuAllocation create_resource(
+			D3D12_HEAP_TYPE heap_type,
+			const D3D12_RESOURCE_DESC& desc,
+			D3D12_RESOURCE_STATES initial_state,
+			const D3D12_CLEAR_VALUE* optimized_clear_value = nullptr);
+		// The GPU must be done with the resource
+		void release(GpuAllocation& allocation);
+
+		// The submission signalling fence_value uses the resource
+		void use(const GpuAllocation& allocation, uint64_t fence_value);
+		// ...and so does a copy queue submission signalling copy_fence_value on its own fence
+		void use(const GpuAllocation& allocation, uint64_t fence_value, uint64_t copy_fence_value);
+
+		GpuAllocatorStats stats() const;
+	private:
+		enum class ResourceCategory : uint32_t
+		{
+			Buffer,
+			RenderTargetTexture,
+			Texture,
+			All,
+		};
+
+		struct Heap
+		{
+			Heap(Microsoft::WRL::ComPtr<ID3D12Heap> heap, uint64_t size, uint64_t alignment) :
+				heap(heap),
+				allocator(size, alignment)
+			{
+			}
+
+			Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+			Core::TlsfAllocator allocator;
+			uint32_t residency_id = Core::ResidencyManager::invalid_allocation;
+		};
+
+		struct Pool
+		{
+			D3D12_HEAP_TYPE heap_type;
+			D3D12_HEAP_FLAGS heap_flags;
+			uint64_t alignment;
+			// Released heaps leave a hole so the indices in the allocations stay valid
+			std::vector<std::unique_ptr<Heap>> heaps;
+		};
+
+		ResourceCategory category_of(const D3D12_RESOURCE_DESC& desc) const;
+		uint32_t pool_idx_of(D3D12_HEAP_TYPE heap_type, ResourceCategory category) const;
+		uint32_t create_heap(Pool& pool, uint64_t size);
+		void release_heap(Pool& pool, uint32_t heap_idx);
+
+		Microsoft::WRL::ComPtr<ID3D12Device8> m_device;
+		Core::ResidencyManager& m_residency_manager;
+		uint64_t m_heap_size;
+		D3D12_RESOURCE_HEAP_TIER m_resource_heap_tier;
+
+		// Default, upload and readback heaps times the resource categories
+		std::array<Pool, 12> m_pools;
+	};
+}
+
+#endif
@@ -0,0 +1,141 @@
+#include "GpuTimestampQueries.hpp"
+
+#include <directx/d3dx12.h>
+#include <Windows.h>
+
+#include <cassert>
+#include <cstring>
+
+// Unlike assert() the call also runs in release builds, only the check is compiled out
+#define CHECK_HR(call) do { [[maybe_unused]] const HRESULT check_result = (call); assert(SUCCEEDED(check_result)); } while (false)
+
+namespace DX12
+{
+
+	using Microsoft::WRL::ComPtr;
+
+	GpuTimestampQueries::GpuTimestampQueries(
+		ComPtr<ID3D12Device8> device,
+		ComPtr<ID3D12CommandQueue> command_queue,
+		ComPtr<ID3D12Fence> fence,
+		uint32_t frame_slot_count,
+		uint32_t max_timestamps_per_frame) :
+		m_command_queue(command_queue),
+		m_fence(fence),
+		m_frame_slots(frame_slot_count),
+		m_ticks(max_timestamps_per_frame),
+		m_max_timestamps_per_frame(max_timestamps_per_frame)
+	{
+		const uint32_t total_timestamps = frame_slot_count * max_timestamps_per_frame;
+
+		D3D12_QUERY_HEAP_DESC query_heap_desc;
+		query_heap_desc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+		query_heap_desc.Count = total_timestamps;
+		query_heap_desc.NodeMask = 0;
+		CHECK_HR(device->CreateQueryHeap(&query_heap_desc, IID_PPV_ARGS(&m_query_heap)));
+
+		auto heap_properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+		auto buffer_desc = CD3DX12_RESOURCE_DESC::Buffer(total_timestamps * sizeof(uint64_t));
+		CHECK_HR(device->CreateCommittedResource(
+			&heap_properties,
+			D3D12_HEAP_FLAG_NONE,
+			&buffer_desc,
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr,
+			IID_PPV_ARGS(&m_readback_buffer)));
+
+		CHECK_HR(m_command_queue->GetTimestampFrequency(&m_frequency));
+
+		LARGE_INTEGER qpc_frequency;
+		QueryPerformanceFrequency(&qpc_frequency);
+		m_qpc_frequency = qpc_frequency.QuadPart;
+	}
+
+	void GpuTimestampQueries::set_command_list(ID3D12GraphicsCommandList* command_list)
+	{
+		m_command_list = command_list;
+	}
+
+	void GpuTimestampQueries::set_submitted_fence_value(uint64_t fence_value)
+	{
+		m_frame_slots[m_last_ended_slot].fence_value = fence_value;
+	}
+
+	uint32_t GpuTimestampQueries::frame_slot_count() const
+	{
+		return static_cast<uint32_t>(m_frame_slots.size());
+	}
+
+	uint32_t GpuTimestampQueries::max_timestamps_per_frame() const
+	{
+		return m_max_timestamps_per_frame;
+	}
+
+	void GpuTimestampQueries::begin_frame(uint32_t frame_slot)
+	{
+		auto& slot = m_frame_slots[frame_slot];
+
+		uint64_t cpu_qpc;
+		CHECK_HR(m_command_queue->GetClockCalibration(&slot.calibration_gpu_tick, &cpu_qpc));
+
+		// Same conversion steady_clock uses, so the result lines up with Profiler::now()
+		slot.calibration_cpu_ns =
+			(cpu_qpc / m_qpc_frequency) * 1000000000ull +
+			(cpu_qpc % m_qpc_frequency) * 1000000000ull / m_qpc_frequency;
+	}
+
+	void GpuTimestampQueries::write_timestamp(uint32_t frame_slot, uint32_t timestamp_idx)
+	{
+		assert(m_command_list && "No command list to record the timestamp into");
+		m_command_list->EndQuery(
+			m_query_heap.Get(),
+			D3D12_QUERY_TYPE_TIMESTAMP,
+			frame_slot * m_max_timestamps_per_frame + timestamp_idx);
+	}
+
+	void GpuTimestampQueries::end_frame(uint32_t frame_slot, uint32_t timestamp_count)
+	{
+		m_last_ended_slot = frame_slot;
+		m_frame_slots[frame_slot].fence_value = UINT64_MAX;
+
+		if (timestamp_count == 0)
+		{
+			return;
+		}
+
+		const uint32_t first_timestamp = frame_slot * m_max_timestamps_per_frame;
+		m_command_list->ResolveQueryData(
+			m_query_heap.Get(),
+			D3D12_QUERY_TYPE_TIMESTAMP,
+			first_timestamp,
+			timestamp_count,
+			m_readback_buffer.Get(),
+			first_timestamp * sizeof(uint64_t));
+	}
+
+	bool GpuTimestampQueries::read_timestamps(uint32_t frame_slot, uint32_t timestamp_count, Core::GpuTimestamps& timestamps)
+	{
+		const auto& slot = m_frame_slots[frame_slot];
+		if (m_fence->GetCompletedValue() < slot.fence_value)
+		{
+			return false;
+		}
+
+		const size_t first_byte = frame_slot * m_max_timestamps_per_frame * sizeof(uint64_t);
+		const D3D12_RANGE read_range = { first_byte, first_byte + timestamp_count * sizeof(uint64_t) };
+		const D3D12_RANGE written_range = { 0, 0 };
+
+		void* data;
+		CHECK_HR(m_readback_buffer->Map(0, &read_range, &data));
+		std::memcpy(m_ticks.data(), static_cast<uint8_t*>(data) + first_byte, timestamp_count * sizeof(uint64_t));
+		m_readback_buffer->Unmap(0, &written_range);
+
+		timestamps.ticks = m_ticks.data();
+		timestamps.frequency = m_frequency;
+		timestamps.calibration_gpu_tick = slot.calibration_gpu_tick;
+		timestamps.calibration_cpu_ns = slot.calibration_cpu_ns;
+		timestamps.is_reliable = true;
+		return true;
+	}
+
+}
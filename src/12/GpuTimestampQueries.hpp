@@ -0,0 +1,63 @@
+#ifndef _GPU_TIMESTAMP_QUERIES_HPP
+#define _GPU_TIMESTAMP_QUERIES_HPP
+
+#include <directx/d3d12.h>
+#include <wrl.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "core/gpu_profiler.hpp"
+
+namespace DX12
+{
+	// Timestamp query heap plus a readback buffer the queries of a frame
+	// are resolved into at the end of that frame
+	class GpuTimestampQueries : public Core::GpuQuerySource
+	{
+	public:
+		GpuTimestampQueries(
+			Microsoft::WRL::ComPtr<ID3D12Device8> device,
+			Microsoft::WRL::ComPtr<ID3D12CommandQueue> command_queue,
+			Microsoft::WRL::ComPtr<ID3D12Fence> fence,
+			uint32_t frame_slot_count,
+			uint32_t max_timestamps_per_frame = 64);
+		GpuTimestampQueries(const GpuTimestampQueries&) = delete;
+		GpuTimestampQueries& operator=(const GpuTimestampQueries&) = delete;
+
+		// Queries are recorded into this command list until it is changed
+		void set_command_list(ID3D12GraphicsCommandList* command_list);
+		// Fence value signaled after the command list holding the last ended frame
+		void set_submitted_fence_value(uint64_t fence_value);
+
+		uint32_t frame_slot_count() const override;
+		uint32_t max_timestamps_per_frame() const override;
+
+		void begin_frame(uint32_t frame_slot) override;
+		void write_timestamp(uint32_t frame_slot, uint32_t timestamp_idx) override;
+		void end_frame(uint32_t frame_slot, uint32_t timestamp_count) override;
+		bool read_timestamps(uint32_t frame_slot, uint32_t timestamp_count, Core::GpuTimestamps& timestamps) override;
+	private:
+		struct FrameSlot
+		{
+			uint64_t fence_value = 0;
+			uint64_t calibration_gpu_tick = 0;
+			uint64_t calibration_cpu_ns = 0;
+		};
+
+		Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_command_queue;
+		Microsoft::WRL::ComPtr<ID3D12Fence> m_fence;
+		Microsoft::WRL::ComPtr<ID3D12QueryHeap> m_query_heap;
+		Microsoft::WRL::ComPtr<ID3D12Resource> m_readback_buffer;
+		ID3D12GraphicsCommandList* m_command_list = nullptr;
+
+		std::vector<FrameSlot> m_frame_slots;
+		std::vector<uint64_t> m_ticks;
+		uint32_t m_max_timestamps_per_frame;
+		uint32_t m_last_ended_slot = 0;
+		uint64_t m_frequency = 0;
+		uint64_t m_qpc_frequency = 0;
+	};
+}
+
+#endif
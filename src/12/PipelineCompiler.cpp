@@ -0,0 +1,76 @@
+#include "PipelineCompiler.hpp"
+
+#include <directx/d3dx12.h>
+#include <Windows.h>
+
+#include <cassert>
+#include <cstdint>
+
+namespace DX12
+{
+
+	using Microsoft::WRL::ComPtr;
+
+	PipelineCompiler::PipelineCompiler(
+		ComPtr<ID3D12Device8> device,
+		ComPtr<ID3D12RootSignature> root_signature,
+		DXGI_FORMAT render_target_format) :
+		m_device(device),
+		m_root_signature(root_signature),
+		m_render_target_format(render_target_format)
+	{
+	}
+
+	std::shared_ptr<void> PipelineCompiler::compile(const Core::PipelineDesc& desc)
+	{
+		D3D12_INPUT_ELEMENT_DESC input_element_desc[D3D12_IA_VERTEX_INPUT_STRUCTURE_ELEMENT_COUNT];
+		uint32_t input_element_count = 0;
+		if (desc.vertex_shader_reflection)
+		{
+			const Core::ShaderReflection& reflection = *desc.vertex_shader_reflection;
+			assert(reflection.input_count <= D3D12_IA_VERTEX_INPUT_STRUCTURE_ELEMENT_COUNT);
+			for (; input_element_count < reflection.input_count; ++input_element_count)
+			{
+				const Core::ShaderInputElement& input = reflection.inputs[input_element_count];
+				D3D12_INPUT_ELEMENT_DESC& element = input_element_desc[input_element_count];
+				element.SemanticName = input.semantic;
+				element.SemanticIndex = input.semantic_idx;
+				element.Format = static_cast<DXGI_FORMAT>(Core::input_element_dxgi_format(input));
+				element.InputSlot = input.input_slot;
+				element.AlignedByteOffset = input.offset;
+				element.InputSlotClass = input.is_per_instance
+					? D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA
+					: D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+				element.InstanceDataStepRate = input.is_per_instance ? 1 : 0;
+			}
+		}
+
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC pipeline_state_desc = {};
+		pipeline_state_desc.pRootSignature = m_root_signature.Get();
+		pipeline_state_desc.VS = { desc.vertex_shader.data(), desc.vertex_shader.size() };
+		pipeline_state_desc.PS = { desc.pixel_shader.data(), desc.pixel_shader.size() };
+		pipeline_state_desc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+		pipeline_state_desc.SampleMask = UINT_MAX;
+		pipeline_state_desc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+		pipeline_state_desc.DepthStencilState.DepthEnable = FALSE;
+		pipeline_state_desc.DepthStencilState.StencilEnable = FALSE;
+		pipeline_state_desc.InputLayout = { input_element_desc, input_element_count };
+		pipeline_state_desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+		pipeline_state_desc.NumRenderTargets = 1;
+		pipeline_state_desc.RTVFormats[0] = m_render_target_format;
+		pipeline_state_desc.SampleDesc.Count = 1;
+
+		// Invalid bytecode from a hot reload fails here, the cache keeps the previous pipeline
+		ID3D12PipelineState* pipeline_state = nullptr;
+		if (FAILED(m_device->CreateGraphicsPipelineState(&pipeline_state_desc, IID_PPV_ARGS(&pipeline_state))))
+		{
+			return nullptr;
+		}
+
+		return std::shared_ptr<void>(pipeline_state, [](void* object)
+		{
+			static_cast<ID3D12PipelineState*>(object)->Release();
+		});
+	}
+
+}
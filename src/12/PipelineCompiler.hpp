@@ -0,0 +1,33 @@
+#ifndef _PIPELINE_COMPILER_HPP
+#define _PIPELINE_COMPILER_HPP
+
+#include <directx/d3d12.h>
+#include <dxgi.h>
+#include <wrl.h>
+
+#include <memory>
+
+#include "core/pipeline_cache.hpp"
+
+namespace DX12
+{
+	// Creates graphics pipeline states for Core::PipelineCache on its worker threads,
+	// the input layout comes from the vertex shader's build time reflection
+	class PipelineCompiler : public Core::PipelineCompiler
+	{
+	public:
+		PipelineCompiler(
+			Microsoft::WRL::ComPtr<ID3D12Device8> device,
+			Microsoft::WRL::ComPtr<ID3D12RootSignature> root_signature,
+			DXGI_FORMAT render_target_format);
+
+		// Returns an ID3D12PipelineState*
+		std::shared_ptr<void> compile(const Core::PipelineDesc& desc) override;
+	private:
+		Microsoft::WRL::ComPtr<ID3D12Device8> m_device;
+		Microsoft::WRL::ComPtr<ID3D12RootSignature> m_root_signature;
+		DXGI_FORMAT m_render_target_format;
+	};
+}
+
+#endif
@@ -5,11 +5,19 @@
 #include <dxgi1_6.h>
 #include <Windows.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <vector>
 
 #include <CrossWindow/CrossWindow.h>
 
+#include "core/profiler.hpp"
+#include "core/scene.hpp"
+#include "shaders/main_pix_sm6.hpp"
+#include "shaders/main_vert_sm6.hpp"
+
 #define ASSERT(hr) assert(!FAILED(hr));
 
 namespace DX12
@@ -17,12 +25,19 @@ namespace DX12
 
 	using Microsoft::WRL::ComPtr;
 
-	Renderer::Renderer(xwin::Window& window)
+	Renderer::Renderer(xwin::Window& window, Core::JobSystem& job_system)
 	{
+		PROFILE_FUNCTION();
+
 		enable_debug_layer();
 
 		m_adapter = create_adapter();
 		m_device = create_device(m_adapter);
+		m_residency_backend = std::make_unique<ResidencyBackend>(m_device, m_adapter, DXGI_MEMORY_SEGMENT_GROUP_LOCAL);
+		m_residency_manager = std::make_unique<Core::ResidencyManager>(*m_residency_backend);
+		m_gpu_allocator = std::make_unique<GpuAllocator>(m_device, *m_residency_manager);
+		m_texture_streaming_backend = std::make_unique<TextureStreamingBackend>(m_device, *m_gpu_allocator, *m_residency_manager);
+		m_texture_streamer = std::make_unique<Core::TextureStreamer>(job_system, *m_texture_streaming_backend);
 		m_command_queue = create_command_queue(m_device, D3D12_COMMAND_LIST_TYPE_DIRECT);
 		{
 			m_swap_chain = create_swap_chain(
@@ -47,63 +62,243 @@ namespace DX12
 		}
 		m_command_list = create_command_list(m_device, m_command_allocators[m_current_back_buffer_idx], D3D12_COMMAND_LIST_TYPE_DIRECT);
 
+		m_root_signature = create_root_signature(
+			m_device,
+			*Shaders::main_vert_sm6.select<0>().reflection,
+			*Shaders::main_pix_sm6.select<0>().reflection);
+
+		m_vertex_buffer = create_upload_buffer(*m_gpu_allocator, Core::scene_vertices, sizeof(Core::scene_vertices));
+		m_vertex_buffer_view.BufferLocation = m_vertex_buffer.resource->GetGPUVirtualAddress();
+		m_vertex_buffer_view.SizeInBytes = sizeof(Core::scene_vertices);
+		m_vertex_buffer_view.StrideInBytes = sizeof(Core::Vertex);
+
+		// Draws are skipped until the pipeline finished compiling on a worker
+		constexpr Core::ShaderBytecode vertex_shader_bytecode = Shaders::main_vert_sm6.select<0>();
+		constexpr Core::ShaderBytecode pixel_shader_bytecode = Shaders::main_pix_sm6.select<0>();
+		m_vertex_shader.assign(vertex_shader_bytecode.data, vertex_shader_bytecode.data + vertex_shader_bytecode.size);
+		m_pixel_shader.assign(pixel_shader_bytecode.data, pixel_shader_bytecode.data + pixel_shader_bytecode.size);
+		m_pipeline_compiler = std::make_unique<PipelineCompiler>(m_device, m_root_signature, DXGI_FORMAT_R8G8B8A8_UNORM);
+		m_pipeline_cache = std::make_unique<Core::PipelineCache>(
+			job_system,
+			*m_pipeline_compiler,
+			static_cast<uint32_t>(m_back_buffers.size()));
+		m_pipeline_id = m_pipeline_cache->request(create_pipeline_desc());
+
 		m_fence = create_fence(m_device);
 		m_fence_event = create_event_handle();
 
+		m_gpu_timestamp_queries = std::make_unique<GpuTimestampQueries>(
+			m_device,
+			m_command_queue,
+			m_fence,
+			static_cast<uint32_t>(m_back_buffers.size()));
+		m_gpu_profiler = std::make_unique<Core::GpuProfiler>(*m_gpu_timestamp_queries);
+
 		// resize(window.getCurrentDisplaySize());
 	}
 
-	void Renderer::render()
+	Renderer::~Renderer()
+	{
+		// The pipeline cache releases pipeline states the GPU may still be using
+		flush(m_command_queue, m_fence, m_fence_value, m_fence_event);
+
+		m_gpu_allocator->release(m_vertex_buffer);
+	}
+
+	const char* Renderer::name() const
+	{
+		return "dx12";
+	}
+
+	void Renderer::begin_frame()
 	{
+		PROFILE_FUNCTION();
+
 		auto command_allocator = m_command_allocators[m_current_back_buffer_idx];
 		auto back_buffer = m_back_buffers[m_current_back_buffer_idx];
 
 		command_allocator->Reset();
 		m_command_list->Reset(command_allocator.Get(), nullptr);
 
+		m_pipeline_cache->begin_frame();
+
+		m_texture_streaming_backend->set_residency_fence_value(next_fence_value());
+		m_texture_streamer->update();
+
+		m_gpu_timestamp_queries->set_command_list(m_command_list.Get());
+		m_gpu_profiler->begin_frame();
+		m_gpu_frame_region = m_gpu_profiler->begin_region("Frame");
+
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
+			back_buffer.Get(),
+			D3D12_RESOURCE_STATE_PRESENT,
+			D3D12_RESOURCE_STATE_RENDER_TARGET);
+		m_command_list->ResourceBarrier(1, &barrier);
+
+		// State every draw of the frame shares, the pipeline is bound by set_pipeline()
+		const auto rtv = render_target_view();
+		const auto back_buffer_desc = back_buffer->GetDesc();
+		const CD3DX12_VIEWPORT viewport(
+			0.0f,
+			0.0f,
+			static_cast<float>(back_buffer_desc.Width),
+			static_cast<float>(back_buffer_desc.Height));
+		const CD3DX12_RECT scissor_rect(
+			0,
+			0,
+			static_cast<LONG>(back_buffer_desc.Width),
+			static_cast<LONG>(back_buffer_desc.Height));
+
+		m_command_list->OMSetRenderTargets(1, &rtv, FALSE, nullptr);
+		m_command_list->RSSetViewports(1, &viewport);
+		m_command_list->RSSetScissorRects(1, &scissor_rect);
+		m_command_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		m_command_list->IASetVertexBuffers(0, 1, &m_vertex_buffer_view);
+		m_gpu_allocator->use(m_vertex_buffer, next_fence_value());
+		m_is_pipeline_bound = false;
+	}
+
+	void Renderer::clear(const float color[4])
+	{
+		m_command_list->ClearRenderTargetView(render_target_view(), color, 0, nullptr);
+	}
+
+	void Renderer::set_pipeline(uint32_t /*pipeline_idx*/)
+	{
+		// There is a single pipeline, bound the first time the queue asks for any
+		if (m_is_pipeline_bound)
 		{
-			auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-				back_buffer.Get(),
-				D3D12_RESOURCE_STATE_PRESENT,
-				D3D12_RESOURCE_STATE_RENDER_TARGET);
-			m_command_list->ResourceBarrier(1, &barrier);
-
-			FLOAT clear_color[] = { 0.4f, 0.6f, 0.9f, 1.0f };
-
-			auto rtv_descriptor_size = m_device->GetDescriptorHandleIncrementSize(
-				D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-			CD3DX12_CPU_DESCRIPTOR_HANDLE rtv(
-				m_rtv_descriptor_heap->GetCPUDescriptorHandleForHeapStart(),
-				m_current_back_buffer_idx,
-				rtv_descriptor_size);
-
-			m_command_list->ClearRenderTargetView(rtv, clear_color, 0, nullptr);
+			return;
 		}
 
+		auto* pipeline_state = static_cast<ID3D12PipelineState*>(m_pipeline_cache->resolve(m_pipeline_id));
+		if (!pipeline_state)
 		{
-			auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-				back_buffer.Get(),
-				D3D12_RESOURCE_STATE_RENDER_TARGET,
-				D3D12_RESOURCE_STATE_PRESENT);
-			m_command_list->ResourceBarrier(1, &barrier);
+			return;
+		}
 
-			ASSERT(m_command_list->Close());
+		m_command_list->SetGraphicsRootSignature(m_root_signature.Get());
+		m_command_list->SetPipelineState(pipeline_state);
+		m_is_pipeline_bound = true;
+	}
 
-			ID3D12CommandList* const command_list[] = { m_command_list.Get() };
-			m_command_queue->ExecuteCommandLists(_countof(command_list), command_list);
+	void Renderer::draw(uint32_t vertex_count, uint32_t first_vertex)
+	{
+		if (!m_is_pipeline_bound)
+		{
+			return;
+		}
 
-			m_frame_fence_values[m_current_back_buffer_idx] = signal(m_command_queue, m_fence, m_fence_value);
+		m_command_list->DrawInstanced(vertex_count, 1, first_vertex, 0);
+	}
 
-			ASSERT(m_swap_chain->Present(1, 0));
+	void Renderer::end_frame()
+	{
+		PROFILE_FUNCTION();
 
-			m_current_back_buffer_idx = m_swap_chain->GetCurrentBackBufferIndex();
+		auto back_buffer = m_back_buffers[m_current_back_buffer_idx];
 
-			block_until_fence_value(m_fence, m_frame_fence_values[m_current_back_buffer_idx], m_fence_event);
-		}
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
+			back_buffer.Get(),
+			D3D12_RESOURCE_STATE_RENDER_TARGET,
+			D3D12_RESOURCE_STATE_PRESENT);
+		m_command_list->ResourceBarrier(1, &barrier);
+
+		m_gpu_profiler->end_region(m_gpu_frame_region);
+		m_gpu_profiler->end_frame();
+		ASSERT(m_command_list->Close());
+
+		// Allocations evicted while this frame was recorded but used by it
+		m_residency_manager->make_resident();
+
+		ID3D12CommandList* const command_list[] = { m_command_list.Get() };
+		m_command_queue->ExecuteCommandLists(_countof(command_list), command_list);
+
+		m_frame_fence_values[m_current_back_buffer_idx] = signal(m_command_queue, m_fence, m_fence_value);
+		m_gpu_timestamp_queries->set_submitted_fence_value(m_frame_fence_values[m_current_back_buffer_idx]);
+	}
+
+	void Renderer::present()
+	{
+		PROFILE_FUNCTION();
+
+		ASSERT(m_swap_chain->Present(1, 0));
+
+		m_current_back_buffer_idx = m_swap_chain->GetCurrentBackBufferIndex();
+
+		block_until_fence_value(m_fence, m_frame_fence_values[m_current_back_buffer_idx], m_fence_event);
+
+		m_residency_manager->update(m_fence->GetCompletedValue(), m_texture_streaming_backend->completed_fence_value());
+	}
+
+	const Core::GpuProfiler* Renderer::gpu_profiler() const
+	{
+		return m_gpu_profiler.get();
+	}
+
+	void Renderer::reload_vertex_shader(const std::vector<unsigned char>& bytecode)
+	{
+		m_vertex_shader = bytecode;
+		m_pipeline_cache->recompile(m_pipeline_id, create_pipeline_desc());
+	}
+
+	void Renderer::reload_pixel_shader(const std::vector<unsigned char>& bytecode)
+	{
+		m_pixel_shader = bytecode;
+		m_pipeline_cache->recompile(m_pipeline_id, create_pipeline_desc());
+	}
+
+	const Core::PipelineCache& Renderer::pipeline_cache() const
+	{
+		return *m_pipeline_cache;
+	}
+
+	Core::ResidencyManager& Renderer::residency_manager()
+	{
+		return *m_residency_manager;
+	}
+
+	GpuAllocator& Renderer::gpu_allocator()
+	{
+		return *m_gpu_allocator;
+	}
+
+	Core::TextureStreamer& Renderer::texture_streamer()
+	{
+		return *m_texture_streamer;
+	}
+
+	uint64_t Renderer::next_fence_value() const
+	{
+		return m_fence_value + 1;
+	}
+
+	Core::PipelineDesc Renderer::create_pipeline_desc() const
+	{
+		Core::PipelineDesc desc;
+		desc.name = "main";
+		desc.vertex_shader = m_vertex_shader;
+		desc.pixel_shader = m_pixel_shader;
+		// The inputs have to stay what the vertex buffer holds, also for reloaded shaders
+		desc.vertex_shader_reflection = Shaders::main_vert_sm6.select<0>().reflection;
+		desc.pixel_shader_reflection = Shaders::main_pix_sm6.select<0>().reflection;
+		return desc;
+	}
+
+	D3D12_CPU_DESCRIPTOR_HANDLE Renderer::render_target_view() const
+	{
+		auto rtv_descriptor_size = m_device->GetDescriptorHandleIncrementSize(
+			D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+		return CD3DX12_CPU_DESCRIPTOR_HANDLE(
+			m_rtv_descriptor_heap->GetCPUDescriptorHandleForHeapStart(),
+			m_current_back_buffer_idx,
+			rtv_descriptor_size);
 	}
 
 	void Renderer::resize(xwin::UVec2 size)
 	{
+		PROFILE_FUNCTION();
+
 		flush(m_command_queue, m_fence, m_fence_value, m_fence_event);
 
 		for (
@@ -140,6 +335,8 @@ namespace DX12
 
 	ComPtr<IDXGIAdapter4> Renderer::create_adapter() const
 	{
+		PROFILE_FUNCTION();
+
 		auto dxgi_factory = create_dxgi_factory();
 
 		ComPtr<IDXGIAdapter4> dxgi_adapter4;
@@ -186,6 +383,8 @@ namespace DX12
 
 	ComPtr<ID3D12Device8> Renderer::create_device(ComPtr<IDXGIAdapter4> adapter) const
 	{
+		PROFILE_FUNCTION();
+
 		ComPtr<ID3D12Device8> device;
 		ASSERT(D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_12_1, IID_PPV_ARGS(&device)));
 
@@ -234,6 +433,8 @@ namespace DX12
 		ComPtr<ID3D12Device8> device,
 		D3D12_COMMAND_LIST_TYPE type) const
 	{
+		PROFILE_FUNCTION();
+
 		D3D12_COMMAND_QUEUE_DESC desc;
 		desc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
 		desc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
@@ -252,6 +453,8 @@ namespace DX12
 		xwin::Window& window,
 		UINT buffer_count) const
 	{
+		PROFILE_FUNCTION();
+
 		auto window_size = window.getCurrentDisplaySize();
 
 		auto dxgi_factory = create_dxgi_factory();
@@ -285,6 +488,8 @@ namespace DX12
 
 	ComPtr<IDXGIFactory7> Renderer::create_dxgi_factory() const
 	{
+		PROFILE_FUNCTION();
+
 		ComPtr<IDXGIFactory7> dxgi_factory;
 		auto dxgi_factory_flag = 0;
 #if defined(_DEBUG)
@@ -300,6 +505,8 @@ namespace DX12
 		ComPtr<ID3D12Device8> device,
 		D3D12_COMMAND_LIST_TYPE type) const
 	{
+		PROFILE_FUNCTION();
+
 		ComPtr<ID3D12CommandAllocator> command_allocator;
 
 		ASSERT(device->CreateCommandAllocator(type, IID_PPV_ARGS(&command_allocator)));
@@ -312,6 +519,8 @@ namespace DX12
 		D3D12_DESCRIPTOR_HEAP_TYPE type,
 		UINT total_descriptors) const
 	{
+		PROFILE_FUNCTION();
+
 		ComPtr<ID3D12DescriptorHeap> descriptor_heap;
 
 		D3D12_DESCRIPTOR_HEAP_DESC desc;
@@ -327,6 +536,8 @@ namespace DX12
 
 	ComPtr<ID3D12Fence1> Renderer::create_fence(ComPtr<ID3D12Device8> device) const
 	{
+		PROFILE_FUNCTION();
+
 		ComPtr<ID3D12Fence1> fence;
 		ASSERT(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)));
 		return fence;
@@ -337,6 +548,8 @@ namespace DX12
 		ComPtr<ID3D12CommandAllocator> command_allocator,
 		D3D12_COMMAND_LIST_TYPE type) const
 	{
+		PROFILE_FUNCTION();
+
 		ComPtr<ID3D12GraphicsCommandList> command_list;
 		ASSERT(device->CreateCommandList(
 			0,
@@ -348,6 +561,125 @@ namespace DX12
 		return command_list;
 	}
 
+	ComPtr<ID3D12RootSignature> Renderer::create_root_signature(
+		ComPtr<ID3D12Device8> device,
+		const Core::ShaderReflection& vertex_shader,
+		const Core::ShaderReflection& pixel_shader) const
+	{
+		PROFILE_FUNCTION();
+
+		struct StageBinding
+		{
+			Core::ShaderResourceBinding binding;
+			D3D12_SHADER_VISIBILITY visibility;
+		};
+
+		// A register both stages read is bound once for all stages
+		std::vector<StageBinding> bindings;
+		auto add_bindings = [&bindings](const Core::ShaderReflection& reflection, D3D12_SHADER_VISIBILITY visibility)
+		{
+			for (uint32_t resource_idx = 0; resource_idx < reflection.resource_count; ++resource_idx)
+			{
+				const Core::ShaderResourceBinding& resource = reflection.resources[resource_idx];
+				auto shared = std::find_if(bindings.begin(), bindings.end(), [&resource](const StageBinding& stage_binding)
+				{
+					return stage_binding.binding.type == resource.type
+						&& stage_binding.binding.bind_point == resource.bind_point
+						&& stage_binding.binding.space == resource.space;
+				});
+				if (shared != bindings.end())
+				{
+					shared->visibility = D3D12_SHADER_VISIBILITY_ALL;
+				}
+				else
+				{
+					bindings.push_back({ resource, visibility });
+				}
+			}
+		};
+		add_bindings(vertex_shader, D3D12_SHADER_VISIBILITY_VERTEX);
+		add_bindings(pixel_shader, D3D12_SHADER_VISIBILITY_PIXEL);
+
+		// Single constant buffers become root descriptors, everything else a descriptor table of its own
+		std::vector<CD3DX12_DESCRIPTOR_RANGE> ranges;
+		ranges.reserve(bindings.size());
+		std::vector<CD3DX12_ROOT_PARAMETER> parameters(bindings.size());
+		for (size_t binding_idx = 0; binding_idx < bindings.size(); ++binding_idx)
+		{
+			const Core::ShaderResourceBinding& binding = bindings[binding_idx].binding;
+			const D3D12_SHADER_VISIBILITY visibility = bindings[binding_idx].visibility;
+
+			if (binding.type == Core::ShaderResourceType::ConstantBuffer && binding.count == 1)
+			{
+				parameters[binding_idx].InitAsConstantBufferView(binding.bind_point, binding.space, visibility);
+				continue;
+			}
+
+			D3D12_DESCRIPTOR_RANGE_TYPE range_type = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+			switch (binding.type)
+			{
+			case Core::ShaderResourceType::ConstantBuffer:
+				range_type = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
+				break;
+			case Core::ShaderResourceType::ShaderResource:
+				range_type = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+				break;
+			case Core::ShaderResourceType::UnorderedAccess:
+				range_type = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+				break;
+			case Core::ShaderResourceType::Sampler:
+				range_type = D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER;
+				break;
+			}
+
+			// UINT32_MAX is an unbounded array in both
+			ranges.emplace_back(range_type, binding.count, binding.bind_point, binding.space);
+			parameters[binding_idx].InitAsDescriptorTable(1, &ranges.back(), visibility);
+		}
+
+		D3D12_ROOT_SIGNATURE_FLAGS flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
+		if (vertex_shader.input_count > 0)
+		{
+			flags |= D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
+		}
+
+		CD3DX12_ROOT_SIGNATURE_DESC root_signature_desc;
+		root_signature_desc.Init(static_cast<UINT>(parameters.size()), parameters.data(), 0, nullptr, flags);
+
+		ComPtr<ID3DBlob> signature;
+		ComPtr<ID3DBlob> error;
+		ASSERT(D3D12SerializeRootSignature(&root_signature_desc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error));
+
+		ComPtr<ID3D12RootSignature> root_signature;
+		ASSERT(device->CreateRootSignature(
+			0,
+			signature->GetBufferPointer(),
+			signature->GetBufferSize(),
+			IID_PPV_ARGS(&root_signature)));
+		return root_signature;
+	}
+
+	GpuAllocation Renderer::create_upload_buffer(
+		GpuAllocator& gpu_allocator,
+		const void* data,
+		size_t size) const
+	{
+		PROFILE_FUNCTION();
+
+		auto buffer = gpu_allocator.create_resource(
+			D3D12_HEAP_TYPE_UPLOAD,
+			CD3DX12_RESOURCE_DESC::Buffer(size),
+			D3D12_RESOURCE_STATE_GENERIC_READ);
+
+		// The CPU never reads it back
+		const CD3DX12_RANGE read_range(0, 0);
+		void* mapped_data = nullptr;
+		ASSERT(buffer.resource->Map(0, &read_range, &mapped_data));
+		std::memcpy(mapped_data, data, size);
+		buffer.resource->Unmap(0, nullptr);
+		return buffer;
+	}
+
 	uint64_t Renderer::signal(
 		ComPtr<ID3D12CommandQueue> command_queue,
 		ComPtr<ID3D12Fence> fence,
@@ -364,6 +696,8 @@ namespace DX12
 		uint64_t& fence_value,
 		HANDLE fence_event)
 	{
+		PROFILE_FUNCTION();
+
 		uint64_t fence_value_for_signal = signal(command_queue, fence, fence_value);
 		block_until_fence_value(fence, fence_value_for_signal, fence_event);
 	}
@@ -374,6 +708,8 @@ namespace DX12
 		HANDLE fence_event,
 		std::chrono::milliseconds duration)
 	{
+		PROFILE_FUNCTION();
+
 		if (fence->GetCompletedValue() < fence_value)
 		{
 			ASSERT(fence->SetEventOnCompletion(fence_value, fence_event));
@@ -386,6 +722,8 @@ namespace DX12
 		ComPtr<ID3D12Device8> device,
 		ComPtr<ID3D12DescriptorHeap> descriptor_heap)
 	{
+		PROFILE_FUNCTION();
+
 		auto rtv_descriptor_size = device->GetDescriptorHandleIncrementSize(
 			D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
 
@@ -410,6 +748,8 @@ namespace DX12
 
 	HANDLE Renderer::create_event_handle()
 	{
+		PROFILE_FUNCTION();
+
 		const HANDLE fence_event_handle = CreateEvent(nullptr, false, false, nullptr);
 		assert(fence_event_handle && "Failed to create fence event handle");
 		return fence_event_handle;
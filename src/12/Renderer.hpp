@@ -15,15 +15,30 @@
 
 #include <cassert>
 #include <chrono>
+#include <memory>
+#include <vector>
 
 #include <CrossWindow/CrossWindow.h>
 
+#include "GpuAllocator.hpp"
+#include "GpuTimestampQueries.hpp"
+#include "PipelineCompiler.hpp"
+#include "ResidencyBackend.hpp"
+#include "TextureStreamingBackend.hpp"
+#include "core/gpu_profiler.hpp"
+#include "core/pipeline_cache.hpp"
+#include "core/render_backend.hpp"
+#include "core/residency.hpp"
+#include "core/texture_streamer.hpp"
+#include "core/shader_reflection.hpp"
+
 namespace DX12
 {
-	class Renderer
+	class Renderer : public Core::RenderBackend
 	{
 	public:
-		Renderer(xwin::Window& window);
+		Renderer(xwin::Window& window, Core::JobSystem& job_system);
+		~Renderer();
 
 		void enable_debug_layer() const;
 
@@ -51,6 +66,16 @@ namespace DX12
 			Microsoft::WRL::ComPtr<ID3D12Device8> device,
 			Microsoft::WRL::ComPtr<ID3D12CommandAllocator> command_allocator,
 			D3D12_COMMAND_LIST_TYPE type) const;
+		// Root parameters for every resource the stages bind, as reflected at build time
+		Microsoft::WRL::ComPtr<ID3D12RootSignature> create_root_signature(
+			Microsoft::WRL::ComPtr<ID3D12Device8> device,
+			const Core::ShaderReflection& vertex_shader,
+			const Core::ShaderReflection& pixel_shader) const;
+		// Upload heap buffer holding data, for small buffers that never change
+		GpuAllocation create_upload_buffer(
+			GpuAllocator& gpu_allocator,
+			const void* data,
+			size_t size) const;
 
 		HANDLE create_event_handle();
 
@@ -74,14 +99,42 @@ namespace DX12
 			Microsoft::WRL::ComPtr<ID3D12Device8> device,
 			Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> descriptor_heap);
 
-		void render();
+		const char* name() const override;
+		const Core::GpuProfiler* gpu_profiler() const override;
+
+		void begin_frame() override;
+		void clear(const float color[4]) override;
+		// Draws are skipped until the pipeline finished compiling
+		void set_pipeline(uint32_t pipeline_idx) override;
+		void draw(uint32_t vertex_count, uint32_t first_vertex) override;
+		void end_frame() override;
+		// Flips and waits until the next back buffer is free again
+		void present() override;
 		void resize(xwin::UVec2 size);
+
+		// For shader hot reload. The pipeline recompiles in the background and the
+		// current one stays in use until the new one is ready, or for good if it fails.
+		void reload_vertex_shader(const std::vector<unsigned char>& bytecode);
+		void reload_pixel_shader(const std::vector<unsigned char>& bytecode);
+
+		const Core::PipelineCache& pipeline_cache() const;
+		// Tracks allocations in video memory, they are used by the submission signalling next_fence_value()
+		Core::ResidencyManager& residency_manager();
+		GpuAllocator& gpu_allocator();
+		// Textures are StreamedTexture*
+		Core::TextureStreamer& texture_streamer();
+		uint64_t next_fence_value() const;
 	private:
+		Core::PipelineDesc create_pipeline_desc() const;
+		// Of the current back buffer
+		D3D12_CPU_DESCRIPTOR_HANDLE render_target_view() const;
+
 		Microsoft::WRL::ComPtr<ID3D12Device8> m_device;
 		Microsoft::WRL::ComPtr<IDXGIAdapter4> m_adapter;
 		Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_command_queue;
 		Microsoft::WRL::ComPtr<IDXGISwapChain4> m_swap_chain;
 		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_rtv_descriptor_heap;
+		Microsoft::WRL::ComPtr<ID3D12RootSignature> m_root_signature;
 
 		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> m_command_list;
 		std::array<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>, 3> m_command_allocators;
@@ -92,6 +145,27 @@ namespace DX12
 		uint64_t m_fence_value = 0;
 		HANDLE m_fence_event;
 
+		std::unique_ptr<GpuTimestampQueries> m_gpu_timestamp_queries;
+		std::unique_ptr<Core::GpuProfiler> m_gpu_profiler;
+		uint32_t m_gpu_frame_region = 0;
+
+		std::unique_ptr<PipelineCompiler> m_pipeline_compiler;
+		std::unique_ptr<Core::PipelineCache> m_pipeline_cache;
+		std::vector<unsigned char> m_vertex_shader;
+		std::vector<unsigned char> m_pixel_shader;
+		uint32_t m_pipeline_id = Core::PipelineCache::invalid_pipeline;
+		// Reset every frame, the command list starts without state
+		bool m_is_pipeline_bound = false;
+
+		std::unique_ptr<ResidencyBackend> m_residency_backend;
+		std::unique_ptr<Core::ResidencyManager> m_residency_manager;
+		std::unique_ptr<GpuAllocator> m_gpu_allocator;
+		std::unique_ptr<TextureStreamingBackend> m_texture_streaming_backend;
+		std::unique_ptr<Core::TextureStreamer> m_texture_streamer;
+
+		GpuAllocation m_vertex_buffer;
+		D3D12_VERTEX_BUFFER_VIEW m_vertex_buffer_view;
+
 		uint8_t m_current_back_buffer_idx = 0;
 
 		bool m_is_using_warp = false;
@@ -0,0 +1,63 @@
+#include "ResidencyBackend.hpp"
+
+#include <Windows.h>
+
+#include <cassert>
+
+#include "core/profiler.hpp"
+
+// Unlike assert() the call also runs in release builds, only the check is compiled out
+#define CHECK_HR(call) do { [[maybe_unused]] const HRESULT check_result = (call); assert(SUCCEEDED(check_result)); } while (false)
+
+namespace DX12
+{
+
+	using Microsoft::WRL::ComPtr;
+
+	ResidencyBackend::ResidencyBackend(
+		ComPtr<ID3D12Device8> device,
+		ComPtr<IDXGIAdapter4> adapter,
+		DXGI_MEMORY_SEGMENT_GROUP segment_group) :
+		m_device(device),
+		m_adapter(adapter),
+		m_segment_group(segment_group)
+	{
+	}
+
+	Core::MemoryBudget ResidencyBackend::query_budget()
+	{
+		DXGI_QUERY_VIDEO_MEMORY_INFO video_memory_info = {};
+		CHECK_HR(m_adapter->QueryVideoMemoryInfo(0, m_segment_group, &video_memory_info));
+
+		Core::MemoryBudget budget;
+		budget.budget_bytes = video_memory_info.Budget;
+		budget.usage_bytes = video_memory_info.CurrentUsage;
+		return budget;
+	}
+
+	void ResidencyBackend::evict(void* const* objects, uint32_t count)
+	{
+		PROFILE_FUNCTION();
+
+		CHECK_HR(m_device->Evict(count, to_pageables(objects, count)));
+	}
+
+	bool ResidencyBackend::make_resident(void* const* objects, uint32_t count)
+	{
+		PROFILE_FUNCTION();
+
+		// Pages the memory back in before returning, E_OUTOFMEMORY when it does not fit
+		return SUCCEEDED(m_device->MakeResident(count, to_pageables(objects, count)));
+	}
+
+	ID3D12Pageable* const* ResidencyBackend::to_pageables(void* const* objects, uint32_t count)
+	{
+		m_pageables.resize(count);
+		for (uint32_t object_idx = 0; object_idx < count; ++object_idx)
+		{
+			m_pageables[object_idx] = static_cast<ID3D12Pageable*>(objects[object_idx]);
+		}
+		return m_pageables.data();
+	}
+
+}
@@ -0,0 +1,37 @@
+#ifndef _RESIDENCY_BACKEND_HPP
+#define _RESIDENCY_BACKEND_HPP
+
+#include <directx/d3d12.h>
+#include <dxgi1_6.h>
+#include <wrl.h>
+
+#include <vector>
+
+#include "core/residency.hpp"
+
+namespace DX12
+{
+	// Core::ResidencyManager on top of ID3D12Device::Evict/MakeResident for one memory
+	// segment group. The tracked objects have to be ID3D12Pageable*.
+	class ResidencyBackend : public Core::ResidencyBackend
+	{
+	public:
+		ResidencyBackend(
+			Microsoft::WRL::ComPtr<ID3D12Device8> device,
+			Microsoft::WRL::ComPtr<IDXGIAdapter4> adapter,
+			DXGI_MEMORY_SEGMENT_GROUP segment_group);
+
+		Core::MemoryBudget query_budget() override;
+		void evict(void* const* objects, uint32_t count) override;
+		bool make_resident(void* const* objects, uint32_t count) override;
+	private:
+		ID3D12Pageable* const* to_pageables(void* const* objects, uint32_t count);
+
+		Microsoft::WRL::ComPtr<ID3D12Device8> m_device;
+		Microsoft::WRL::ComPtr<IDXGIAdapter4> m_adapter;
+		DXGI_MEMORY_SEGMENT_GROUP m_segment_group;
+		std::vector<ID3D12Pageable*> m_pageables;
+	};
+}
+
+#endif
@@ -0,0 +1,199 @@
+#include "TextureStreamingBackend.hpp"
+
+#include <directx/d3dx12.h>
+
+#include <cassert>
+
+#include "core/profiler.hpp"
+
+// Unlike assert() the call also runs in release builds, only the check is compiled out
+#define CHECK_HR(call) do { [[maybe_unused]] const HRESULT check_result = (call); assert(SUCCEEDED(check_result)); } while (false)
+
+namespace DX12
+{
+
+	using Microsoft::WRL::ComPtr;
+
+	TextureStreamingBackend::TextureStreamingBackend(
+		ComPtr<ID3D12Device8> device,
+		GpuAllocator& gpu_allocator,
+		Core::ResidencyManager& residency_manager,
+		uint64_t upload_capacity) :
+		m_device(device),
+		m_gpu_allocator(gpu_allocator),
+		m_residency_manager(residency_manager),
+		m_upload_capacity(upload_capacity)
+	{
+		PROFILE_FUNCTION();
+
+		D3D12_COMMAND_QUEUE_DESC queue_desc = {};
+		queue_desc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+		queue_desc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
+		queue_desc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+		CHECK_HR(m_device->CreateCommandQueue(&queue_desc, IID_PPV_ARGS(&m_copy_queue)));
+
+		for (auto& command_allocator : m_command_allocators)
+		{
+			CHECK_HR(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&command_allocator)));
+		}
+		// Created closed
+		CHECK_HR(m_device->CreateCommandList1(
+			0,
+			D3D12_COMMAND_LIST_TYPE_COPY,
+			D3D12_COMMAND_LIST_FLAG_NONE,
+			IID_PPV_ARGS(&m_command_list)));
+
+		CHECK_HR(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+		m_fence_event = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+		assert(m_fence_event && "Failed to create fence event.");
+
+		m_upload_buffer = m_gpu_allocator.create_resource(
+			D3D12_HEAP_TYPE_UPLOAD,
+			CD3DX12_RESOURCE_DESC::Buffer(upload_capacity),
+			D3D12_RESOURCE_STATE_GENERIC_READ);
+		// Stays mapped, the CPU never reads it
+		const CD3DX12_RANGE read_range(0, 0);
+		void* mapped_data = nullptr;
+		CHECK_HR(m_upload_buffer.resource->Map(0, &read_range, &mapped_data));
+		m_upload_memory = static_cast<uint8_t*>(mapped_data);
+	}
+
+	TextureStreamingBackend::~TextureStreamingBackend()
+	{
+		wait_for_fence_value(m_fence_value);
+		m_upload_buffer.resource->Unmap(0, nullptr);
+		m_gpu_allocator.release(m_upload_buffer);
+		::CloseHandle(m_fence_event);
+	}
+
+	void TextureStreamingBackend::set_residency_fence_value(uint64_t fence_value)
+	{
+		m_residency_fence_value = fence_value;
+	}
+
+	uint8_t* TextureStreamingBackend::upload_memory()
+	{
+		return m_upload_memory;
+	}
+
+	uint64_t TextureStreamingBackend::upload_capacity() const
+	{
+		return m_upload_capacity;
+	}
+
+	uint64_t TextureStreamingBackend::upload_alignment() const
+	{
+		return D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+	}
+
+	void* TextureStreamingBackend::create_texture(const Core::TextureDesc& desc)
+	{
+		PROFILE_FUNCTION();
+
+		auto* texture = new StreamedTexture();
+		texture->desc = CD3DX12_RESOURCE_DESC::Tex2D(
+			static_cast<DXGI_FORMAT>(Core::format_to_dxgi(desc.format)),
+			desc.width,
+			desc.height,
+			1,
+			static_cast<UINT16>(desc.mip_count));
+		texture->allocation = m_gpu_allocator.create_resource(
+			D3D12_HEAP_TYPE_DEFAULT,
+			texture->desc,
+			D3D12_RESOURCE_STATE_COMMON);
+		return texture;
+	}
+
+	void TextureStreamingBackend::destroy_texture(void* texture)
+	{
+		auto* streamed_texture = static_cast<StreamedTexture*>(texture);
+		m_gpu_allocator.release(streamed_texture->allocation);
+		delete streamed_texture;
+	}
+
+	Core::TextureFootprint TextureStreamingBackend::mip_footprint(void* texture, uint32_t mip_idx)
+	{
+		const auto* streamed_texture = static_cast<const StreamedTexture*>(texture);
+
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT layout;
+		UINT row_count;
+		UINT64 row_size;
+		UINT64 size;
+		m_device->GetCopyableFootprints(&streamed_texture->desc, mip_idx, 1, 0, &layout, &row_count, &row_size, &size);
+
+		Core::TextureFootprint footprint;
+		footprint.row_pitch = layout.Footprint.RowPitch;
+		footprint.row_count = row_count;
+		footprint.row_size = static_cast<uint32_t>(row_size);
+		footprint.size = size;
+		return footprint;
+	}
+
+	void TextureStreamingBackend::copy_mip(void* texture, uint32_t mip_idx, uint64_t upload_offset, const Core::TextureFootprint& footprint)
+	{
+		const auto* streamed_texture = static_cast<const StreamedTexture*>(texture);
+		if (!m_is_recording)
+		{
+			begin_recording();
+		}
+
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT layout;
+		m_device->GetCopyableFootprints(&streamed_texture->desc, mip_idx, 1, upload_offset, &layout, nullptr, nullptr, nullptr);
+		assert(layout.Footprint.RowPitch == footprint.row_pitch);
+
+		const CD3DX12_TEXTURE_COPY_LOCATION destination(streamed_texture->allocation.resource.Get(), mip_idx);
+		const CD3DX12_TEXTURE_COPY_LOCATION source(m_upload_buffer.resource.Get(), layout);
+		m_command_list->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+
+		// submit() signals the next value
+		m_gpu_allocator.use(streamed_texture->allocation, m_residency_fence_value, m_fence_value + 1);
+	}
+
+	uint64_t TextureStreamingBackend::submit()
+	{
+		PROFILE_FUNCTION();
+
+		if (m_is_recording)
+		{
+			CHECK_HR(m_command_list->Close());
+
+			// Heaps evicted since they were last used, the copies must not write to them before
+			m_residency_manager.make_resident();
+
+			ID3D12CommandList* const command_list[] = { m_command_list.Get() };
+			m_copy_queue->ExecuteCommandLists(_countof(command_list), command_list);
+			m_is_recording = false;
+		}
+
+		CHECK_HR(m_copy_queue->Signal(m_fence.Get(), ++m_fence_value));
+		m_command_allocator_fence_values[m_command_allocator_idx] = m_fence_value;
+		return m_fence_value;
+	}
+
+	uint64_t TextureStreamingBackend::completed_fence_value()
+	{
+		return m_fence->GetCompletedValue();
+	}
+
+	void TextureStreamingBackend::begin_recording()
+	{
+		m_command_allocator_idx = (m_command_allocator_idx + 1) % m_command_allocators.size();
+		// Only blocks when three submissions are still copying
+		wait_for_fence_value(m_command_allocator_fence_values[m_command_allocator_idx]);
+
+		auto& command_allocator = m_command_allocators[m_command_allocator_idx];
+		CHECK_HR(command_allocator->Reset());
+		CHECK_HR(m_command_list->Reset(command_allocator.Get(), nullptr));
+		m_is_recording = true;
+	}
+
+	void TextureStreamingBackend::wait_for_fence_value(uint64_t fence_value)
+	{
+		if (m_fence->GetCompletedValue() < fence_value)
+		{
+			CHECK_HR(m_fence->SetEventOnCompletion(fence_value, m_fence_event));
+			::WaitForSingleObject(m_fence_event, INFINITE);
+		}
+	}
+
+}
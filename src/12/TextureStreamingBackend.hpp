@@ -0,0 +1,82 @@
+#ifndef _TEXTURE_STREAMING_BACKEND_HPP
+#define _TEXTURE_STREAMING_BACKEND_HPP
+
+#include <directx/d3d12.h>
+#include <wrl.h>
+#include <Windows.h>
+
+#include <array>
+#include <cstdint>
+
+#include "GpuAllocator.hpp"
+#include "core/residency.hpp"
+#include "core/texture_streamer.hpp"
+
+namespace DX12
+{
+	struct StreamedTexture
+	{
+		GpuAllocation allocation;
+		D3D12_RESOURCE_DESC desc;
+	};
+
+	// Core::TextureStreamer on a COPY queue of its own. Mips are staged in a persistently
+	// mapped upload buffer and copied with the footprints GetCopyableFootprints reports.
+	// Textures are created in the common state, the copy queue promotes them to copy dest
+	// and they decay back, so the direct queue can sample finished mips without barriers.
+	// Copied textures count as used by both queues, so their heaps are made resident before
+	// the copies run and are not evicted before the copy fence passed them.
+	// The textures are StreamedTexture*.
+	class TextureStreamingBackend : public Core::TextureStreamingBackend
+	{
+	public:
+		TextureStreamingBackend(
+			Microsoft::WRL::ComPtr<ID3D12Device8> device,
+			GpuAllocator& gpu_allocator,
+			Core::ResidencyManager& residency_manager,
+			uint64_t upload_capacity = 64 * 1024 * 1024);
+		// Waits for the copies still running
+		~TextureStreamingBackend() override;
+
+		// The direct queue frame the copies count as used by as well, so textures keep their
+		// place in the LRU order of the residency manager
+		void set_residency_fence_value(uint64_t fence_value);
+
+		uint8_t* upload_memory() override;
+		uint64_t upload_capacity() const override;
+		uint64_t upload_alignment() const override;
+
+		void* create_texture(const Core::TextureDesc& desc) override;
+		void destroy_texture(void* texture) override;
+		Core::TextureFootprint mip_footprint(void* texture, uint32_t mip_idx) override;
+
+		void copy_mip(void* texture, uint32_t mip_idx, uint64_t upload_offset, const Core::TextureFootprint& footprint) override;
+		uint64_t submit() override;
+		uint64_t completed_fence_value() override;
+	private:
+		void begin_recording();
+		void wait_for_fence_value(uint64_t fence_value);
+
+		Microsoft::WRL::ComPtr<ID3D12Device8> m_device;
+		GpuAllocator& m_gpu_allocator;
+		Core::ResidencyManager& m_residency_manager;
+
+		Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_copy_queue;
+		std::array<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>, 3> m_command_allocators;
+		std::array<uint64_t, 3> m_command_allocator_fence_values = {};
+		uint32_t m_command_allocator_idx = 0;
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> m_command_list;
+		bool m_is_recording = false;
+
+		Microsoft::WRL::ComPtr<ID3D12Fence> m_fence;
+		uint64_t m_fence_value = 0;
+		HANDLE m_fence_event;
+		uint64_t m_residency_fence_value = 0;
+
+		GpuAllocation m_upload_buffer;
+		uint64_t m_upload_capacity;
+		uint8_t* m_upload_memory = nullptr;
+	};
+}
+
+#endif
@@ -3,6 +3,12 @@
 #include <algorithm>
 
 #include "Renderer.hpp"
+#include "core/benchmark.hpp"
+#include "core/job_system.hpp"
+#include "core/profiler.hpp"
+#include "core/render_queue.hpp"
+#include "core/scene.hpp"
+#include "core/shader_hot_reload.hpp"
 
 void xmain(int argc, const char** argv)
 {
@@ -17,11 +23,33 @@ void xmain(int argc, const char** argv)
 
 	assert(window.create(window_desc, event_queue));
 
-	DX12::Renderer renderer(window);
+	PROFILE_THREAD_NAME("Main");
+
+	Core::JobSystem job_system;
+
+	DX12::Renderer renderer(window, job_system);
+
+	const auto benchmark_config = Core::parse_benchmark_config(argc, argv);
+	Core::BenchmarkRecorder benchmark_recorder(benchmark_config);
+	Core::RenderQueue render_queue;
+
+#if defined(DIRECTX_PLAYGROUND_SHADER_HOT_RELOAD)
+	Core::ShaderHotReload shader_hot_reload(
+		DIRECTX_PLAYGROUND_SHADER_DIR,
+		[](const std::string& path, const Core::ShaderSource& source, std::vector<unsigned char>& bytecode, std::string& errors)
+		{
+			return Core::compile_shader_file(DIRECTX_PLAYGROUND_DXC, path, source, bytecode, errors);
+		});
+	const uint32_t vertex_shader_id = shader_hot_reload.add_shader({ "main.vert.hlsl", "vs_6_0", "main", { "INSTANCING=0" } });
+	const uint32_t pixel_shader_id = shader_hot_reload.add_shader({ "main.pix.hlsl", "ps_6_0" });
+#endif
 
 	bool is_running = true;
 	while (is_running)
 	{
+		PROFILE_ZONE("Frame");
+		benchmark_recorder.begin_frame();
+
 		event_queue.update();
 
 		while (!event_queue.empty())
@@ -48,6 +76,40 @@ void xmain(int argc, const char** argv)
 			event_queue.pop();
 		}
 
-		renderer.render();
+#if defined(DIRECTX_PLAYGROUND_SHADER_HOT_RELOAD)
+		// The pipeline is recompiled in the background, the current one is used until then
+		for (const auto& reload : shader_hot_reload.take_reloads())
+		{
+			if (!reload.is_compiled)
+			{
+				OutputDebugStringA(reload.errors.c_str());
+			}
+			else if (reload.shader_id == vertex_shader_id)
+			{
+				renderer.reload_vertex_shader(reload.bytecode);
+			}
+			else if (reload.shader_id == pixel_shader_id)
+			{
+				renderer.reload_pixel_shader(reload.bytecode);
+			}
+		}
+#endif
+
+		Core::render_scene(job_system, renderer, benchmark_config.scene, render_queue);
+		benchmark_recorder.end_cpu_work();
+		renderer.present();
+
+		benchmark_recorder.end_frame();
+		benchmark_recorder.add_gpu_samples(renderer.gpu_profiler());
+
+		if (benchmark_config.is_enabled && benchmark_recorder.is_finished())
+		{
+			benchmark_recorder.write_json(renderer.name());
+			is_running = false;
+		}
 	}
+
+#if defined(DIRECTX_PLAYGROUND_PROFILE)
+	Core::Profiler::write_chrome_trace("profile.json");
+#endif
 }
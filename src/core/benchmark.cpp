@@ -0,0 +1,319 @@
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include "gpu_profiler.hpp"
+#include "profiler.hpp"
+#include "render_queue.hpp"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace Core
+{
+
+	namespace
+	{
+		const char* match_option(const char* argument, const char* option)
+		{
+			const size_t length = std::strlen(option);
+			if (std::strncmp(argument, option, length) != 0 || argument[length] != '=')
+			{
+				return nullptr;
+			}
+			return argument + length + 1;
+		}
+
+		void write_percentiles(std::ostream& stream, const char* name, const std::vector<double>& samples)
+		{
+			const auto percentiles = compute_percentiles(samples);
+			stream << "\t\"" << name << "\": {"
+				<< "\"mean\": " << percentiles.mean
+				<< ", \"min\": " << percentiles.min
+				<< ", \"p50\": " << percentiles.p50
+				<< ", \"p95\": " << percentiles.p95
+				<< ", \"p99\": " << percentiles.p99
+				<< ", \"max\": " << percentiles.max
+				<< ", \"samples\": " << samples.size() << "}";
+		}
+
+		// Pipeline and material indices have to fit their fields of the render queue sort keys
+		uint32_t clamp_count(const char* value, uint32_t max_count)
+		{
+			return static_cast<uint32_t>(std::min<unsigned long>(std::strtoul(value, nullptr, 10), max_count));
+		}
+
+		double to_ms(uint64_t begin_ns, uint64_t end_ns)
+		{
+			return static_cast<double>(end_ns - begin_ns) / 1e6;
+		}
+	}
+
+	BenchmarkConfig parse_benchmark_config(int argc, const char** argv)
+	{
+		BenchmarkConfig config;
+
+		for (int argument_idx = 1; argument_idx < argc; ++argument_idx)
+		{
+			const char* argument = argv[argument_idx];
+			const char* value = nullptr;
+
+			if (std::strcmp(argument, "--benchmark") == 0)
+			{
+				config.is_enabled = true;
+			}
+			else if ((value = match_option(argument, "--frames")))
+			{
+				config.frame_count = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+				config.is_enabled = true;
+			}
+			else if ((value = match_option(argument, "--duration")))
+			{
+				config.duration_seconds = std::strtod(value, nullptr);
+				config.is_enabled = true;
+			}
+			else if ((value = match_option(argument, "--warmup")))
+			{
+				config.warmup_frame_count = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+				config.is_enabled = true;
+			}
+			else if ((value = match_option(argument, "--draws")))
+			{
+				config.scene.draw_count = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+				config.is_enabled = true;
+			}
+			else if ((value = match_option(argument, "--pipelines")))
+			{
+				config.scene.pipeline_count = clamp_count(value, 1U << sort_key_pipeline_bits);
+				config.is_enabled = true;
+			}
+			else if ((value = match_option(argument, "--materials")))
+			{
+				config.scene.material_count = clamp_count(value, 1U << sort_key_material_bits);
+				config.is_enabled = true;
+			}
+			else if ((value = match_option(argument, "--output")))
+			{
+				config.output_path = value;
+				config.is_enabled = true;
+			}
+		}
+
+		return config;
+	}
+
+	Percentiles compute_percentiles(std::vector<double> samples)
+	{
+		Percentiles percentiles;
+		if (samples.empty())
+		{
+			return percentiles;
+		}
+
+		std::sort(samples.begin(), samples.end());
+
+		// Nearest rank, so every reported value is an actual sample
+		const auto at_rank = [&samples](double percentile)
+		{
+			const auto rank = static_cast<size_t>(percentile * static_cast<double>(samples.size() - 1) + 0.5);
+			return samples[rank];
+		};
+
+		double sum = 0.0;
+		for (double sample : samples)
+		{
+			sum += sample;
+		}
+
+		percentiles.mean = sum / static_cast<double>(samples.size());
+		percentiles.min = samples.front();
+		percentiles.p50 = at_rank(0.50);
+		percentiles.p95 = at_rank(0.95);
+		percentiles.p99 = at_rank(0.99);
+		percentiles.max = samples.back();
+		return percentiles;
+	}
+
+	MemoryUsage query_memory_usage()
+	{
+		MemoryUsage usage;
+
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		{
+			usage.current_bytes = counters.WorkingSetSize;
+			usage.peak_bytes = counters.PeakWorkingSetSize;
+		}
+#else
+		long resident_pages = 0;
+		if (FILE* statm = std::fopen("/proc/self/statm", "r"))
+		{
+			long total_pages;
+			if (std::fscanf(statm, "%ld %ld", &total_pages, &resident_pages) != 2)
+			{
+				resident_pages = 0;
+			}
+			std::fclose(statm);
+		}
+		usage.current_bytes = static_cast<uint64_t>(resident_pages) * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+		rusage resource_usage;
+		if (getrusage(RUSAGE_SELF, &resource_usage) == 0)
+		{
+			// ru_maxrss is in kilobytes on Linux
+			usage.peak_bytes = static_cast<uint64_t>(resource_usage.ru_maxrss) * 1024;
+		}
+#endif
+
+		return usage;
+	}
+
+	BenchmarkRecorder::BenchmarkRecorder(const BenchmarkConfig& config) :
+		m_config(config)
+	{
+		m_frame_ms.reserve(config.frame_count);
+		m_cpu_ms.reserve(config.frame_count);
+		m_gpu_ms.reserve(config.frame_count);
+	}
+
+	void BenchmarkRecorder::begin_frame()
+	{
+		m_frame_begin_ns = Profiler::now();
+		m_cpu_end_ns = 0;
+
+		if (m_frame_idx == m_config.warmup_frame_count)
+		{
+			m_record_begin_ns = m_frame_begin_ns;
+		}
+	}
+
+	void BenchmarkRecorder::end_cpu_work()
+	{
+		m_cpu_end_ns = Profiler::now();
+	}
+
+	void BenchmarkRecorder::end_frame()
+	{
+		const uint64_t frame_end_ns = Profiler::now();
+
+		if (is_recording())
+		{
+			m_frame_ms.push_back(to_ms(m_frame_begin_ns, frame_end_ns));
+			m_cpu_ms.push_back(to_ms(m_frame_begin_ns, m_cpu_end_ns ? m_cpu_end_ns : frame_end_ns));
+			m_last_frame_end_ns = frame_end_ns;
+		}
+		++m_frame_idx;
+
+		if (is_finished())
+		{
+			m_memory_usage = query_memory_usage();
+		}
+	}
+
+	void BenchmarkRecorder::add_gpu_sample(double gpu_ms)
+	{
+		if (is_recording())
+		{
+			m_gpu_ms.push_back(gpu_ms);
+		}
+	}
+
+	void BenchmarkRecorder::add_gpu_samples(const GpuProfiler* gpu_profiler)
+	{
+		if (!gpu_profiler)
+		{
+			return;
+		}
+
+		const auto& regions = gpu_profiler->resolved_regions();
+		if (regions.empty() || gpu_profiler->resolved_frame_idx() == m_last_gpu_frame_idx)
+		{
+			return;
+		}
+		m_last_gpu_frame_idx = gpu_profiler->resolved_frame_idx();
+
+		uint64_t begin_ns = UINT64_MAX;
+		uint64_t end_ns = 0;
+		for (const auto& region : regions)
+		{
+			begin_ns = std::min(begin_ns, region.begin_ns);
+			end_ns = std::max(end_ns, region.end_ns);
+		}
+		add_gpu_sample(to_ms(begin_ns, end_ns));
+	}
+
+	bool BenchmarkRecorder::is_finished() const
+	{
+		if (m_frame_idx <= m_config.warmup_frame_count)
+		{
+			return false;
+		}
+
+		if (m_config.duration_seconds > 0.0)
+		{
+			return to_ms(m_record_begin_ns, m_last_frame_end_ns) >= m_config.duration_seconds * 1000.0;
+		}
+		return m_frame_idx - m_config.warmup_frame_count >= m_config.frame_count;
+	}
+
+	uint32_t BenchmarkRecorder::recorded_frame_count() const
+	{
+		return static_cast<uint32_t>(m_frame_ms.size());
+	}
+
+	double BenchmarkRecorder::recorded_seconds() const
+	{
+		return m_frame_ms.empty() ? 0.0 : to_ms(m_record_begin_ns, m_last_frame_end_ns) / 1000.0;
+	}
+
+	void BenchmarkRecorder::write_json(std::ostream& stream, const std::string& backend_name) const
+	{
+		const double duration_seconds = recorded_seconds();
+
+		stream << "{\n"
+			<< "\t\"backend\": \"" << backend_name << "\",\n"
+			<< "\t\"scene\": {\"draw_count\": " << m_config.scene.draw_count
+			<< ", \"pipeline_count\": " << m_config.scene.pipeline_count
+			<< ", \"material_count\": " << m_config.scene.material_count << "},\n"
+			<< "\t\"warmup_frames\": " << m_config.warmup_frame_count << ",\n"
+			<< "\t\"frames\": " << m_frame_ms.size() << ",\n"
+			<< "\t\"duration_seconds\": " << duration_seconds << ",\n";
+		write_percentiles(stream, "frame_ms", m_frame_ms);
+		stream << ",\n";
+		write_percentiles(stream, "cpu_ms", m_cpu_ms);
+		stream << ",\n";
+		write_percentiles(stream, "gpu_ms", m_gpu_ms);
+		stream << ",\n"
+			<< "\t\"memory\": {\"current_bytes\": " << m_memory_usage.current_bytes
+			<< ", \"peak_bytes\": " << m_memory_usage.peak_bytes << "}\n"
+			<< "}\n";
+	}
+
+	bool BenchmarkRecorder::write_json(const std::string& backend_name) const
+	{
+		std::ofstream stream(m_config.output_path);
+		if (!stream)
+		{
+			return false;
+		}
+		write_json(stream, backend_name);
+		return static_cast<bool>(stream);
+	}
+
+	bool BenchmarkRecorder::is_recording() const
+	{
+		return m_frame_idx >= m_config.warmup_frame_count;
+	}
+
+}
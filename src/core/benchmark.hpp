@@ -0,0 +1,95 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_BENCHMARK_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_BENCHMARK_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "scene.hpp"
+
+namespace Core
+{
+
+	class GpuProfiler;
+
+	struct BenchmarkConfig
+	{
+		bool is_enabled = false;
+		uint32_t frame_count = 1000;
+		// When non zero the run stops after this many seconds instead of frame_count frames
+		double duration_seconds = 0.0;
+		// Frames rendered before recording starts, so startup costs stay out of the results
+		uint32_t warmup_frame_count = 30;
+		SceneConfig scene;
+		std::string output_path = "benchmark.json";
+	};
+
+	// Recognises --benchmark, --frames=N, --duration=SECONDS, --warmup=N, --draws=N, --pipelines=N,
+	// --materials=N and --output=PATH, any of them turns benchmark mode on. Unknown arguments are ignored.
+	// The pipeline and material counts are clamped to what the render queue sort keys hold.
+	BenchmarkConfig parse_benchmark_config(int argc, const char** argv);
+
+	struct Percentiles
+	{
+		double mean = 0.0;
+		double min = 0.0;
+		double p50 = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+	};
+
+	Percentiles compute_percentiles(std::vector<double> samples);
+
+	struct MemoryUsage
+	{
+		uint64_t current_bytes = 0;
+		uint64_t peak_bytes = 0;
+	};
+
+	MemoryUsage query_memory_usage();
+
+	// Collects per frame timings of a fixed length run:
+	// begin_frame() -> CPU work -> end_cpu_work() -> present / GPU wait -> end_frame()
+	class BenchmarkRecorder
+	{
+	public:
+		explicit BenchmarkRecorder(const BenchmarkConfig& config);
+
+		void begin_frame();
+		void end_cpu_work();
+		void end_frame();
+
+		void add_gpu_sample(double gpu_ms);
+		// Adds the GPU time of the frame the profiler resolved last, if it was not added yet.
+		// Does nothing for backends without a GPU profiler.
+		void add_gpu_samples(const GpuProfiler* gpu_profiler);
+
+		bool is_finished() const;
+		uint32_t recorded_frame_count() const;
+		double recorded_seconds() const;
+
+		void write_json(std::ostream& stream, const std::string& backend_name) const;
+		bool write_json(const std::string& backend_name) const;
+	private:
+		bool is_recording() const;
+
+		BenchmarkConfig m_config;
+
+		uint32_t m_frame_idx = 0;
+		uint64_t m_frame_begin_ns = 0;
+		uint64_t m_cpu_end_ns = 0;
+		uint64_t m_record_begin_ns = 0;
+		uint64_t m_last_frame_end_ns = 0;
+		uint64_t m_last_gpu_frame_idx = UINT64_MAX;
+
+		std::vector<double> m_frame_ms;
+		std::vector<double> m_cpu_ms;
+		std::vector<double> m_gpu_ms;
+		MemoryUsage m_memory_usage;
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_BENCHMARK_HPP
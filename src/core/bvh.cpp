@@ -0,0 +1,576 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+
+#include "job_system.hpp"
+#include "occlusion_culling.hpp"
+#include "profiler.hpp"
+
+namespace Core
+{
+
+	namespace
+	{
+		constexpr uint32_t bin_count = 16;
+		// Nodes with more primitives are summarized and binned on the job system
+		constexpr uint32_t parallel_binning_size = 65536;
+		// Subtrees with more primitives are built by a job of their own
+		constexpr uint32_t parallel_subtree_size = 4096;
+		// Of a node relative to testing one primitive, for the SAH. Node and primitive tests
+		// cost about the same, but larger leaves mean fewer nodes to build, refit and walk.
+		constexpr float traversal_cost = 4.0f;
+
+		struct BuildPrimitive
+		{
+			Aabb bounds;
+			Float3 centroid;
+			uint32_t primitive_idx;
+		};
+
+		float get_component(const Float3& value, uint32_t axis)
+		{
+			return axis == 0 ? value.x : axis == 1 ? value.y : value.z;
+		}
+
+		Aabb empty_aabb()
+		{
+			return Aabb{ { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+		}
+
+		void grow(Aabb& aabb, const Float3& point)
+		{
+			aabb.min = { std::min(aabb.min.x, point.x), std::min(aabb.min.y, point.y), std::min(aabb.min.z, point.z) };
+			aabb.max = { std::max(aabb.max.x, point.x), std::max(aabb.max.y, point.y), std::max(aabb.max.z, point.z) };
+		}
+
+		void grow(Aabb& aabb, const Aabb& other)
+		{
+			aabb.min = { std::min(aabb.min.x, other.min.x), std::min(aabb.min.y, other.min.y), std::min(aabb.min.z, other.min.z) };
+			aabb.max = { std::max(aabb.max.x, other.max.x), std::max(aabb.max.y, other.max.y), std::max(aabb.max.z, other.max.z) };
+		}
+
+		float surface_area(const Aabb& aabb)
+		{
+			const float size_x = aabb.max.x - aabb.min.x;
+			const float size_y = aabb.max.y - aabb.min.y;
+			const float size_z = aabb.max.z - aabb.min.z;
+			return size_x < 0.0f ? 0.0f : 2.0f * (size_x * size_y + size_y * size_z + size_z * size_x);
+		}
+
+		// Of the primitives of a node
+		struct RangeSummary
+		{
+			Aabb bounds = empty_aabb();
+			Aabb centroid_bounds = empty_aabb();
+
+			void add(const RangeSummary& other)
+			{
+				grow(bounds, other.bounds);
+				grow(centroid_bounds, other.centroid_bounds);
+			}
+
+			void add_primitive(const BuildPrimitive& primitive)
+			{
+				grow(bounds, primitive.bounds);
+				grow(centroid_bounds, primitive.centroid);
+			}
+		};
+
+		// Equally sized slices of the centroid bounds along one axis
+		struct NodeBins
+		{
+			RangeSummary summaries[bin_count];
+			uint32_t counts[bin_count] = {};
+
+			void add(const NodeBins& other)
+			{
+				for (uint32_t bin_idx = 0; bin_idx < bin_count; ++bin_idx)
+				{
+					summaries[bin_idx].add(other.summaries[bin_idx]);
+					counts[bin_idx] += other.counts[bin_idx];
+				}
+			}
+		};
+
+		// Along the axis the centroids are furthest apart, binning all three axes finds
+		// slightly better splits for three times the work
+		struct BinMapping
+		{
+			uint32_t axis = 0;
+			float offset = 0.0f;
+			float scale = 0.0f;
+
+			explicit BinMapping(const Aabb& centroid_bounds)
+			{
+				float largest_extent = 0.0f;
+				for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+				{
+					const float extent = get_component(centroid_bounds.max, axis_idx) - get_component(centroid_bounds.min, axis_idx);
+					if (extent > largest_extent)
+					{
+						largest_extent = extent;
+						axis = axis_idx;
+					}
+				}
+				offset = get_component(centroid_bounds.min, axis);
+				scale = largest_extent > 0.0f ? static_cast<float>(bin_count) / largest_extent : 0.0f;
+			}
+
+			// False when every centroid is in the same spot
+			bool is_valid() const
+			{
+				return scale > 0.0f;
+			}
+
+			uint32_t bin_of(const Float3& centroid) const
+			{
+				const float bin = (get_component(centroid, axis) - offset) * scale;
+				return std::min(static_cast<uint32_t>(std::max(bin, 0.0f)), bin_count - 1);
+			}
+		};
+
+		// Calls function(range_begin, range_end, partial) for ranges of [begin, end) and adds
+		// up the partial results, on the job system when there are enough primitives
+		template<typename Result, typename Function>
+		Result reduce_range(JobSystem& job_system, uint32_t begin, uint32_t end, const Function& function)
+		{
+			const uint32_t count = end - begin;
+			if (count <= parallel_binning_size)
+			{
+				Result result;
+				function(begin, end, result);
+				return result;
+			}
+
+			std::vector<Result> partials((count + parallel_binning_size - 1) / parallel_binning_size);
+			job_system.parallel_for(count, parallel_binning_size, [&](uint32_t range_begin, uint32_t range_end)
+			{
+				function(begin + range_begin, begin + range_end, partials[range_begin / parallel_binning_size]);
+			});
+			for (size_t partial_idx = 1; partial_idx < partials.size(); ++partial_idx)
+			{
+				partials[0].add(partials[partial_idx]);
+			}
+			return partials[0];
+		}
+
+		void set_bounds(BvhNode& node, const Aabb& bounds)
+		{
+			node.min = bounds.min;
+			node.max = bounds.max;
+		}
+
+		Aabb get_bounds(const BvhNode& node)
+		{
+			return Aabb{ node.min, node.max };
+		}
+
+		// Signed distance of the center of the box to the plane and half the extent of the box
+		// projected on the normal
+		void plane_distance(const Float4& plane, const Float3& min, const Float3& max, float& distance, float& radius)
+		{
+			distance = plane.x * (min.x + max.x) * 0.5f + plane.y * (min.y + max.y) * 0.5f + plane.z * (min.z + max.z) * 0.5f + plane.w;
+			radius = std::fabs(plane.x) * (max.x - min.x) * 0.5f + std::fabs(plane.y) * (max.y - min.y) * 0.5f + std::fabs(plane.z) * (max.z - min.z) * 0.5f;
+		}
+
+		// Where the ray enters the box, FLT_MAX when it misses it before max_distance
+		float ray_entry(const Float3& origin, const Float3& inverse_direction, const Float3& min, const Float3& max, float max_distance)
+		{
+			const float x0 = (min.x - origin.x) * inverse_direction.x;
+			const float x1 = (max.x - origin.x) * inverse_direction.x;
+			const float y0 = (min.y - origin.y) * inverse_direction.y;
+			const float y1 = (max.y - origin.y) * inverse_direction.y;
+			const float z0 = (min.z - origin.z) * inverse_direction.z;
+			const float z1 = (max.z - origin.z) * inverse_direction.z;
+			const float entry = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.0f));
+			const float exit = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), max_distance));
+			return entry <= exit ? entry : FLT_MAX;
+		}
+	}
+
+	struct Bvh::BuildContext
+	{
+		explicit BuildContext(JobSystem& job_system) :
+			job_system(job_system)
+		{
+		}
+
+		JobSystem& job_system;
+		std::vector<BuildPrimitive> primitives;
+		std::atomic<uint32_t> node_count{ 0 };
+		JobCounter subtree_counter;
+	};
+
+	void Bvh::build(JobSystem& job_system, const Aabb* bounds, uint32_t count)
+	{
+		PROFILE_ZONE("Build BVH");
+
+		m_nodes.clear();
+		m_primitive_indices.clear();
+		m_primitive_bounds.clear();
+		if (count == 0)
+		{
+			return;
+		}
+
+		BuildContext context(job_system);
+		context.primitives.resize(count);
+		job_system.parallel_for(count, parallel_binning_size, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t primitive_idx = begin; primitive_idx < end; ++primitive_idx)
+			{
+				const Aabb& primitive_bounds = bounds[primitive_idx];
+				BuildPrimitive& primitive = context.primitives[primitive_idx];
+				primitive.bounds = primitive_bounds;
+				primitive.centroid = {
+					(primitive_bounds.min.x + primitive_bounds.max.x) * 0.5f,
+					(primitive_bounds.min.y + primitive_bounds.max.y) * 0.5f,
+					(primitive_bounds.min.z + primitive_bounds.max.z) * 0.5f,
+				};
+				primitive.primitive_idx = primitive_idx;
+			}
+		});
+
+		const BuildPrimitive* primitives = context.primitives.data();
+		const RangeSummary summary = reduce_range<RangeSummary>(job_system, 0, count, [primitives](uint32_t begin, uint32_t end, RangeSummary& result)
+		{
+			for (uint32_t primitive_idx = begin; primitive_idx < end; ++primitive_idx)
+			{
+				result.add_primitive(primitives[primitive_idx]);
+			}
+		});
+
+		// A binary tree with at least one primitive per leaf never needs more
+		m_nodes.resize(2 * static_cast<size_t>(count) - 1);
+		context.node_count = 1;
+		build_node(context, 0, 0, count, summary.bounds, summary.centroid_bounds);
+		job_system.wait(context.subtree_counter);
+		m_nodes.resize(context.node_count.load());
+
+		m_primitive_indices.resize(count);
+		m_primitive_bounds.resize(count);
+		for (uint32_t primitive_idx = 0; primitive_idx < count; ++primitive_idx)
+		{
+			m_primitive_indices[primitive_idx] = context.primitives[primitive_idx].primitive_idx;
+			m_primitive_bounds[primitive_idx] = context.primitives[primitive_idx].bounds;
+		}
+	}
+
+	void Bvh::refit(const Aabb* bounds)
+	{
+		PROFILE_ZONE("Refit BVH");
+
+		for (size_t primitive_idx = 0; primitive_idx < m_primitive_indices.size(); ++primitive_idx)
+		{
+			m_primitive_bounds[primitive_idx] = bounds[m_primitive_indices[primitive_idx]];
+		}
+
+		for (size_t node_idx = m_nodes.size(); node_idx-- > 0;)
+		{
+			BvhNode& node = m_nodes[node_idx];
+			Aabb node_bounds = empty_aabb();
+			if (node.count > 0)
+			{
+				for (uint32_t primitive_idx = node.first; primitive_idx < node.first + node.count; ++primitive_idx)
+				{
+					grow(node_bounds, m_primitive_bounds[primitive_idx]);
+				}
+			}
+			else
+			{
+				grow(node_bounds, get_bounds(m_nodes[node.first]));
+				grow(node_bounds, get_bounds(m_nodes[node.first + 1]));
+			}
+			set_bounds(node, node_bounds);
+		}
+	}
+
+	uint32_t Bvh::cull(const Frustum& frustum, uint32_t* visible_indices, const OcclusionBuffer* occlusion_buffer) const
+	{
+		PROFILE_ZONE("Cull BVH");
+
+		if (m_nodes.empty())
+		{
+			return 0;
+		}
+
+		// The planes a node still straddles, the ones it is entirely inside of are not
+		// tested again for its descendants
+		struct StackEntry
+		{
+			uint32_t node_idx;
+			uint32_t plane_mask;
+		};
+		std::vector<StackEntry> stack;
+		stack.reserve(64);
+		stack.push_back({ 0, 0x3F });
+
+		uint32_t visible_count = 0;
+		while (!stack.empty())
+		{
+			const StackEntry entry = stack.back();
+			stack.pop_back();
+			const BvhNode& node = m_nodes[entry.node_idx];
+
+			uint32_t plane_mask = entry.plane_mask;
+			bool is_outside = false;
+			for (uint32_t plane_idx = 0; plane_idx < 6 && !is_outside; ++plane_idx)
+			{
+				if (plane_mask & (1U << plane_idx))
+				{
+					float distance;
+					float radius;
+					plane_distance(frustum.planes[plane_idx], node.min, node.max, distance, radius);
+					is_outside = distance + radius < 0.0f;
+					if (distance - radius >= 0.0f)
+					{
+						plane_mask &= ~(1U << plane_idx);
+					}
+				}
+			}
+			if (is_outside || (occlusion_buffer && !occlusion_buffer->is_visible(get_bounds(node))))
+			{
+				continue;
+			}
+
+			if (node.count == 0)
+			{
+				stack.push_back({ node.first + 1, plane_mask });
+				stack.push_back({ node.first, plane_mask });
+				continue;
+			}
+
+			for (uint32_t primitive_idx = node.first; primitive_idx < node.first + node.count; ++primitive_idx)
+			{
+				const Aabb& primitive_bounds = m_primitive_bounds[primitive_idx];
+				bool is_visible = true;
+				for (uint32_t plane_idx = 0; plane_idx < 6 && is_visible; ++plane_idx)
+				{
+					if (plane_mask & (1U << plane_idx))
+					{
+						float distance;
+						float radius;
+						plane_distance(frustum.planes[plane_idx], primitive_bounds.min, primitive_bounds.max, distance, radius);
+						is_visible = distance + radius >= 0.0f;
+					}
+				}
+				if (is_visible && (!occlusion_buffer || occlusion_buffer->is_visible(primitive_bounds)))
+				{
+					visible_indices[visible_count++] = m_primitive_indices[primitive_idx];
+				}
+			}
+		}
+		return visible_count;
+	}
+
+	bool Bvh::raycast(const Float3& origin, const Float3& direction, float max_distance, BvhRayHit& hit) const
+	{
+		if (m_nodes.empty())
+		{
+			return false;
+		}
+
+		// Division by zero gives infinities, the slabs of that axis then never limit the ray
+		const Float3 inverse_direction = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+		float closest_distance = max_distance;
+		bool is_hit = false;
+
+		struct StackEntry
+		{
+			uint32_t node_idx;
+			float entry_distance;
+		};
+		std::vector<StackEntry> stack;
+		stack.reserve(64);
+		const float root_entry = ray_entry(origin, inverse_direction, m_nodes[0].min, m_nodes[0].max, closest_distance);
+		if (root_entry != FLT_MAX)
+		{
+			stack.push_back({ 0, root_entry });
+		}
+
+		while (!stack.empty())
+		{
+			const StackEntry entry = stack.back();
+			stack.pop_back();
+			if (entry.entry_distance > closest_distance)
+			{
+				continue;
+			}
+
+			const BvhNode& node = m_nodes[entry.node_idx];
+			if (node.count == 0)
+			{
+				// The nearer child goes on top, so closer hits shrink the ray early
+				const BvhNode& first_child = m_nodes[node.first];
+				const BvhNode& second_child = m_nodes[node.first + 1];
+				const float first_entry = ray_entry(origin, inverse_direction, first_child.min, first_child.max, closest_distance);
+				const float second_entry = ray_entry(origin, inverse_direction, second_child.min, second_child.max, closest_distance);
+				const StackEntry children[2] = { { node.first, first_entry }, { node.first + 1, second_entry } };
+				const bool is_first_nearer = first_entry <= second_entry;
+				for (const StackEntry& child : { children[is_first_nearer ? 1 : 0], children[is_first_nearer ? 0 : 1] })
+				{
+					if (child.entry_distance != FLT_MAX)
+					{
+						stack.push_back(child);
+					}
+				}
+				continue;
+			}
+
+			for (uint32_t primitive_idx = node.first; primitive_idx < node.first + node.count; ++primitive_idx)
+			{
+				const Aabb& primitive_bounds = m_primitive_bounds[primitive_idx];
+				const float distance = ray_entry(origin, inverse_direction, primitive_bounds.min, primitive_bounds.max, closest_distance);
+				if (distance != FLT_MAX && (!is_hit || distance < closest_distance))
+				{
+					closest_distance = distance;
+					hit.primitive_idx = m_primitive_indices[primitive_idx];
+					hit.distance = distance;
+					is_hit = true;
+				}
+			}
+		}
+		return is_hit;
+	}
+
+	const std::vector<BvhNode>& Bvh::nodes() const
+	{
+		return m_nodes;
+	}
+
+	const std::vector<uint32_t>& Bvh::primitive_indices() const
+	{
+		return m_primitive_indices;
+	}
+
+	const std::vector<Aabb>& Bvh::primitive_bounds() const
+	{
+		return m_primitive_bounds;
+	}
+
+	float Bvh::sah_cost() const
+	{
+		if (m_nodes.empty())
+		{
+			return 0.0f;
+		}
+
+		double cost = 0.0;
+		for (const BvhNode& node : m_nodes)
+		{
+			const double area = surface_area(get_bounds(node));
+			cost += node.count == 0 ? area * traversal_cost : area * node.count;
+		}
+		return static_cast<float>(cost / std::max(static_cast<double>(surface_area(get_bounds(m_nodes[0]))), 1e-30));
+	}
+
+	void Bvh::build_node(BuildContext& context, uint32_t node_idx, uint32_t begin, uint32_t end, const Aabb& bounds, const Aabb& centroid_bounds)
+	{
+		BvhNode& node = m_nodes[node_idx];
+		set_bounds(node, bounds);
+		const uint32_t count = end - begin;
+		const auto make_leaf = [&node, begin, count]()
+		{
+			node.first = begin;
+			node.count = count;
+		};
+
+		const BinMapping mapping(centroid_bounds);
+		if (count == 1 || (!mapping.is_valid() && count <= max_leaf_size))
+		{
+			make_leaf();
+			return;
+		}
+
+		BuildPrimitive* primitives = context.primitives.data();
+		uint32_t middle = begin + count / 2;
+		RangeSummary left_summary;
+		RangeSummary right_summary;
+		if (mapping.is_valid())
+		{
+			const NodeBins bins = reduce_range<NodeBins>(context.job_system, begin, end, [primitives, &mapping](uint32_t range_begin, uint32_t range_end, NodeBins& result)
+			{
+				for (uint32_t primitive_idx = range_begin; primitive_idx < range_end; ++primitive_idx)
+				{
+					const BuildPrimitive& primitive = primitives[primitive_idx];
+					const uint32_t bin_idx = mapping.bin_of(primitive.centroid);
+					result.summaries[bin_idx].add_primitive(primitive);
+					++result.counts[bin_idx];
+				}
+			});
+
+			// Costs are in units of the node's surface area, splitting after bin_idx puts the
+			// bins up to it on the left
+			float right_costs[bin_count];
+			Aabb right_bounds = empty_aabb();
+			uint32_t right_count = 0;
+			for (uint32_t bin_idx = bin_count - 1; bin_idx > 0; --bin_idx)
+			{
+				grow(right_bounds, bins.summaries[bin_idx].bounds);
+				right_count += bins.counts[bin_idx];
+				right_costs[bin_idx - 1] = surface_area(right_bounds) * static_cast<float>(right_count);
+			}
+
+			uint32_t best_bin_idx = 0;
+			float best_cost = FLT_MAX;
+			Aabb left_bounds = empty_aabb();
+			uint32_t left_count = 0;
+			for (uint32_t bin_idx = 0; bin_idx + 1 < bin_count; ++bin_idx)
+			{
+				grow(left_bounds, bins.summaries[bin_idx].bounds);
+				left_count += bins.counts[bin_idx];
+				const float cost = surface_area(left_bounds) * static_cast<float>(left_count) + right_costs[bin_idx];
+				if (left_count > 0 && left_count < count && cost < best_cost)
+				{
+					best_cost = cost;
+					best_bin_idx = bin_idx;
+				}
+			}
+
+			const float node_area = surface_area(bounds);
+			if (count <= max_leaf_size && node_area * static_cast<float>(count) <= node_area * traversal_cost + best_cost)
+			{
+				make_leaf();
+				return;
+			}
+
+			for (uint32_t bin_idx = 0; bin_idx < bin_count; ++bin_idx)
+			{
+				(bin_idx <= best_bin_idx ? left_summary : right_summary).add(bins.summaries[bin_idx]);
+			}
+			const BuildPrimitive* split = std::partition(primitives + begin, primitives + end, [&mapping, best_bin_idx](const BuildPrimitive& primitive)
+			{
+				return mapping.bin_of(primitive.centroid) <= best_bin_idx;
+			});
+			middle = static_cast<uint32_t>(split - primitives);
+		}
+		else
+		{
+			// Nothing separates primitives with their centroids in the same spot, halves it is
+			for (uint32_t primitive_idx = begin; primitive_idx < end; ++primitive_idx)
+			{
+				(primitive_idx < middle ? left_summary : right_summary).add_primitive(primitives[primitive_idx]);
+			}
+		}
+
+		const uint32_t child_idx = context.node_count.fetch_add(2);
+		node.first = child_idx;
+		node.count = 0;
+		if (end - middle > parallel_subtree_size)
+		{
+			context.job_system.submit([this, &context, child_idx, middle, end, right_summary]()
+			{
+				build_node(context, child_idx + 1, middle, end, right_summary.bounds, right_summary.centroid_bounds);
+			}, &context.subtree_counter);
+		}
+		else
+		{
+			build_node(context, child_idx + 1, middle, end, right_summary.bounds, right_summary.centroid_bounds);
+		}
+		build_node(context, child_idx, begin, middle, left_summary.bounds, left_summary.centroid_bounds);
+	}
+
+}
@@ -0,0 +1,81 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_BVH_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_BVH_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "frustum_culling.hpp"
+#include "simd_math.hpp"
+
+namespace Core
+{
+
+	class JobSystem;
+	class OcclusionBuffer;
+
+	struct Aabb
+	{
+		Float3 min;
+		Float3 max;
+	};
+
+	// Inner nodes have count 0 and their two children at first and first + 1, leaves
+	// have the primitives first to first + count of Bvh::primitive_indices()
+	struct BvhNode
+	{
+		Float3 min;
+		uint32_t first;
+		Float3 max;
+		uint32_t count;
+	};
+
+	struct BvhRayHit
+	{
+		uint32_t primitive_idx;
+		// Along the direction, 0 when the ray starts inside the bounds
+		float distance;
+	};
+
+	// Bounding volume hierarchy over the bounds of primitives, which can be anything.
+	// Children always come after their parent, which refit() relies on.
+	class Bvh
+	{
+	public:
+		static constexpr uint32_t max_leaf_size = 8;
+
+		// Binned SAH build, subtrees and the binning of large nodes run on the job system
+		void build(JobSystem& job_system, const Aabb* bounds, uint32_t count);
+		// Updates the bounds after primitives moved, keeping the tree. It gets slower to
+		// query the further the primitives move from where they were at build().
+		void refit(const Aabb* bounds);
+
+		// Writes the indices of the primitives whose bounds intersect the frustum, in no
+		// particular order, returns how many. Subtrees entirely inside are not tested further.
+		// With an occlusion buffer, nodes and primitives hidden behind its occluders are
+		// skipped as well.
+		uint32_t cull(const Frustum& frustum, uint32_t* visible_indices, const OcclusionBuffer* occlusion_buffer = nullptr) const;
+		// Closest primitive bounds the ray hits within max_distance, the direction does not
+		// have to be normalized and distances are in its units
+		bool raycast(const Float3& origin, const Float3& direction, float max_distance, BvhRayHit& hit) const;
+
+		const std::vector<BvhNode>& nodes() const;
+		const std::vector<uint32_t>& primitive_indices() const;
+		// In the order of primitive_indices()
+		const std::vector<Aabb>& primitive_bounds() const;
+		// Expected cost of a query relative to testing the root, from the surface areas
+		float sah_cost() const;
+	private:
+		struct BuildContext;
+
+		// The bounds of the primitives begin to end and of their centroids
+		void build_node(BuildContext& context, uint32_t node_idx, uint32_t begin, uint32_t end, const Aabb& bounds, const Aabb& centroid_bounds);
+
+		std::vector<BvhNode> m_nodes;
+		std::vector<uint32_t> m_primitive_indices;
+		// The bounds of m_primitive_indices, in the same order
+		std::vector<Aabb> m_primitive_bounds;
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_BVH_HPP
@@ -0,0 +1,141 @@
+#include "file_watcher.hpp"
+
+#include <algorithm>
+#include <system_error>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace Core
+{
+
+#if defined(__linux__)
+
+	FileWatcher::FileWatcher(const std::string& directory) :
+		m_directory(directory)
+	{
+		m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (m_inotify_fd < 0)
+		{
+			return;
+		}
+
+		// Editors either rewrite the file in place or write a new one and rename it over the old one
+		if (inotify_add_watch(m_inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+		{
+			close(m_inotify_fd);
+			m_inotify_fd = -1;
+		}
+	}
+
+	FileWatcher::~FileWatcher()
+	{
+		if (m_inotify_fd >= 0)
+		{
+			close(m_inotify_fd);
+		}
+	}
+
+	bool FileWatcher::is_valid() const
+	{
+		return m_inotify_fd >= 0;
+	}
+
+	std::vector<std::string> FileWatcher::poll()
+	{
+		std::vector<std::string> changed_files;
+		if (m_inotify_fd < 0)
+		{
+			return changed_files;
+		}
+
+		alignas(inotify_event) char buffer[4096];
+		while (true)
+		{
+			const ssize_t length = read(m_inotify_fd, buffer, sizeof(buffer));
+			if (length <= 0)
+			{
+				// EAGAIN, everything was read
+				break;
+			}
+
+			for (ssize_t offset = 0; offset < length;)
+			{
+				const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+				if (event->len > 0 && (event->mask & IN_ISDIR) == 0)
+				{
+					std::string name = event->name;
+					if (std::find(changed_files.begin(), changed_files.end(), name) == changed_files.end())
+					{
+						changed_files.push_back(std::move(name));
+					}
+				}
+				offset += sizeof(inotify_event) + event->len;
+			}
+		}
+		return changed_files;
+	}
+
+#else
+
+	FileWatcher::FileWatcher(const std::string& directory) :
+		m_directory(directory)
+	{
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+		{
+			if (entry.is_regular_file(error))
+			{
+				m_write_times[entry.path().filename().string()] = entry.last_write_time(error);
+			}
+		}
+		m_is_valid = !error;
+	}
+
+	FileWatcher::~FileWatcher() = default;
+
+	bool FileWatcher::is_valid() const
+	{
+		return m_is_valid;
+	}
+
+	std::vector<std::string> FileWatcher::poll()
+	{
+		std::vector<std::string> changed_files;
+
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(m_directory, error))
+		{
+			if (!entry.is_regular_file(error))
+			{
+				continue;
+			}
+
+			const auto write_time = entry.last_write_time(error);
+			if (error)
+			{
+				continue;
+			}
+
+			std::string name = entry.path().filename().string();
+			auto known = m_write_times.find(name);
+			if (known == m_write_times.end() || known->second != write_time)
+			{
+				m_write_times[name] = write_time;
+				changed_files.push_back(std::move(name));
+			}
+		}
+		return changed_files;
+	}
+
+#endif
+
+	const std::string& FileWatcher::directory() const
+	{
+		return m_directory;
+	}
+
+}
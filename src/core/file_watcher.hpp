@@ -0,0 +1,41 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_FILE_WATCHER_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_FILE_WATCHER_HPP
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Core
+{
+
+	// Reports the files of one directory (not its subdirectories) that were written,
+	// created or moved into it. Uses inotify on Linux, everywhere else the directory
+	// is scanned for changed modification times on every poll().
+	class FileWatcher
+	{
+	public:
+		explicit FileWatcher(const std::string& directory);
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+		~FileWatcher();
+
+		bool is_valid() const;
+		const std::string& directory() const;
+
+		// Does not block. File names are relative to the directory and reported once
+		// per call, no matter how many events the file got since the last one.
+		std::vector<std::string> poll();
+	private:
+		std::string m_directory;
+#if defined(__linux__)
+		int m_inotify_fd = -1;
+#else
+		std::unordered_map<std::string, std::filesystem::file_time_type> m_write_times;
+		bool m_is_valid = false;
+#endif
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_FILE_WATCHER_HPP
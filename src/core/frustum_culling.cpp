@@ -0,0 +1,317 @@
+#include "frustum_culling.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "job_system.hpp"
+#include "profiler.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_CULLING_SSE2
+#endif
+
+namespace Core
+{
+
+	namespace
+	{
+		// A multiple of every lane count, so only the last range has a scalar tail
+		constexpr uint32_t cull_grain_size = 32768;
+
+		// The remainder of a batch, and everything without SIMD
+		struct ScalarLanes
+		{
+			static constexpr uint32_t count = 1;
+			using Float = float;
+
+			static Float splat(float value) { return value; }
+			static Float load(const float* source) { return *source; }
+			static Float add(Float a, Float b) { return a + b; }
+			static Float mul(Float a, Float b) { return a * b; }
+			static Float mul_add(Float a, Float b, Float c) { return a * b + c; }
+			static Float min(Float a, Float b) { return std::min(a, b); }
+			static uint32_t non_negative_bits(Float value) { return value >= 0.0f ? 1 : 0; }
+
+			// Writes first_idx + lane for every set bit to destination, returns how many
+			static uint32_t compact(uint32_t mask_bits, uint32_t first_idx, uint32_t* destination)
+			{
+				*destination = first_idx;
+				return mask_bits;
+			}
+		};
+
+		// The tests are written once against these wrappers, one object per lane
+#if defined(__AVX2__)
+		// Lane numbers of the set bits of every 8 bit mask, one per byte, front to back
+		constexpr std::array<uint64_t, 256> make_compaction_table()
+		{
+			std::array<uint64_t, 256> table{};
+			for (uint32_t mask_bits = 0; mask_bits < 256; ++mask_bits)
+			{
+				uint32_t shift = 0;
+				for (uint32_t lane = 0; lane < 8; ++lane)
+				{
+					if (mask_bits & (1U << lane))
+					{
+						table[mask_bits] |= static_cast<uint64_t>(lane) << shift;
+						shift += 8;
+					}
+				}
+			}
+			return table;
+		}
+		constexpr std::array<uint64_t, 256> compaction_table = make_compaction_table();
+
+		struct Lanes
+		{
+			static constexpr uint32_t count = 8;
+			using Float = __m256;
+
+			static Float splat(float value) { return _mm256_set1_ps(value); }
+			static Float load(const float* source) { return _mm256_loadu_ps(source); }
+			static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+			static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+			static Float mul_add(Float a, Float b, Float c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+			static Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+			static uint32_t non_negative_bits(Float value)
+			{
+				return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(value, _mm256_setzero_ps(), _CMP_GE_OQ)));
+			}
+
+			// Always stores 8 indices, the caller makes sure they fit
+			static uint32_t compact(uint32_t mask_bits, uint32_t first_idx, uint32_t* destination)
+			{
+				const __m128i lanes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&compaction_table[mask_bits]));
+				const __m256i indices = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(first_idx)), _mm256_cvtepu8_epi32(lanes));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination), indices);
+				return static_cast<uint32_t>(std::bitset<8>(mask_bits).count());
+			}
+		};
+#elif defined(FRUSTUM_CULLING_SSE2)
+		struct Lanes
+		{
+			static constexpr uint32_t count = 4;
+			using Float = __m128;
+
+			static Float splat(float value) { return _mm_set1_ps(value); }
+			static Float load(const float* source) { return _mm_loadu_ps(source); }
+			static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+			static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+			static Float mul_add(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+			static Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+			static uint32_t non_negative_bits(Float value)
+			{
+				return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(value, _mm_setzero_ps())));
+			}
+
+			// Without a byte shuffle, every lane is written and only the visible ones advance
+			static uint32_t compact(uint32_t mask_bits, uint32_t first_idx, uint32_t* destination)
+			{
+				uint32_t visible_count = 0;
+				for (uint32_t lane = 0; lane < count; ++lane)
+				{
+					destination[visible_count] = first_idx + lane;
+					visible_count += (mask_bits >> lane) & 1;
+				}
+				return visible_count;
+			}
+		};
+#else
+		using Lanes = ScalarLanes;
+#endif
+
+		template<typename L>
+		struct PlaneLanes
+		{
+			typename L::Float x;
+			typename L::Float y;
+			typename L::Float z;
+			typename L::Float w;
+			typename L::Float abs_x;
+			typename L::Float abs_y;
+			typename L::Float abs_z;
+
+			explicit PlaneLanes(const Float4& plane) :
+				x(L::splat(plane.x)),
+				y(L::splat(plane.y)),
+				z(L::splat(plane.z)),
+				w(L::splat(plane.w)),
+				abs_x(L::splat(std::fabs(plane.x))),
+				abs_y(L::splat(std::fabs(plane.y))),
+				abs_z(L::splat(std::fabs(plane.z)))
+			{
+			}
+
+			typename L::Float distance(typename L::Float center_x, typename L::Float center_y, typename L::Float center_z, typename L::Float offset) const
+			{
+				return L::mul_add(center_x, x, L::mul_add(center_y, y, L::mul_add(center_z, z, L::add(w, offset))));
+			}
+		};
+
+		template<typename L>
+		struct SphereTest
+		{
+			using Bounds = SphereBounds;
+
+			std::array<PlaneLanes<L>, 6> planes;
+			const SphereBounds& spheres;
+
+			SphereTest(const Frustum& frustum, const SphereBounds& spheres) :
+				planes{ PlaneLanes<L>(frustum.planes[0]), PlaneLanes<L>(frustum.planes[1]), PlaneLanes<L>(frustum.planes[2]),
+					PlaneLanes<L>(frustum.planes[3]), PlaneLanes<L>(frustum.planes[4]), PlaneLanes<L>(frustum.planes[5]) },
+				spheres(spheres)
+			{
+			}
+
+			// Bit per lane, set when the sphere is not entirely behind any plane
+			uint32_t visible_bits(uint32_t first_idx) const
+			{
+				const typename L::Float center_x = L::load(spheres.center_x + first_idx);
+				const typename L::Float center_y = L::load(spheres.center_y + first_idx);
+				const typename L::Float center_z = L::load(spheres.center_z + first_idx);
+				const typename L::Float radius = L::load(spheres.radius + first_idx);
+				typename L::Float nearest = L::splat(FLT_MAX);
+				for (const PlaneLanes<L>& plane : planes)
+				{
+					nearest = L::min(nearest, plane.distance(center_x, center_y, center_z, radius));
+				}
+				return L::non_negative_bits(nearest);
+			}
+		};
+
+		template<typename L>
+		struct AabbTest
+		{
+			using Bounds = AabbBounds;
+
+			std::array<PlaneLanes<L>, 6> planes;
+			const AabbBounds& aabbs;
+
+			AabbTest(const Frustum& frustum, const AabbBounds& aabbs) :
+				planes{ PlaneLanes<L>(frustum.planes[0]), PlaneLanes<L>(frustum.planes[1]), PlaneLanes<L>(frustum.planes[2]),
+					PlaneLanes<L>(frustum.planes[3]), PlaneLanes<L>(frustum.planes[4]), PlaneLanes<L>(frustum.planes[5]) },
+				aabbs(aabbs)
+			{
+			}
+
+			// The corner furthest along the plane normal decides, which is the center
+			// plus the extents projected on the absolute normal
+			uint32_t visible_bits(uint32_t first_idx) const
+			{
+				const typename L::Float center_x = L::load(aabbs.center_x + first_idx);
+				const typename L::Float center_y = L::load(aabbs.center_y + first_idx);
+				const typename L::Float center_z = L::load(aabbs.center_z + first_idx);
+				const typename L::Float extent_x = L::load(aabbs.extent_x + first_idx);
+				const typename L::Float extent_y = L::load(aabbs.extent_y + first_idx);
+				const typename L::Float extent_z = L::load(aabbs.extent_z + first_idx);
+				typename L::Float nearest = L::splat(FLT_MAX);
+				for (const PlaneLanes<L>& plane : planes)
+				{
+					const typename L::Float radius = L::mul_add(extent_x, plane.abs_x, L::mul_add(extent_y, plane.abs_y, L::mul(extent_z, plane.abs_z)));
+					nearest = L::min(nearest, plane.distance(center_x, center_y, center_z, radius));
+				}
+				return L::non_negative_bits(nearest);
+			}
+		};
+
+		// visible_indices points at where index begin would go if everything was visible
+		template<template<typename> class Test>
+		uint32_t cull_range(const Frustum& frustum, const typename Test<ScalarLanes>::Bounds& bounds, uint32_t begin, uint32_t end, uint32_t* visible_indices)
+		{
+			const Test<Lanes> test(frustum, bounds);
+			uint32_t visible_count = 0;
+			uint32_t first_idx = begin;
+			for (; first_idx + Lanes::count <= end; first_idx += Lanes::count)
+			{
+				visible_count += Lanes::compact(test.visible_bits(first_idx), first_idx, visible_indices + visible_count);
+			}
+
+			const Test<ScalarLanes> tail_test(frustum, bounds);
+			for (; first_idx < end; ++first_idx)
+			{
+				visible_count += ScalarLanes::compact(tail_test.visible_bits(first_idx), first_idx, visible_indices + visible_count);
+			}
+			return visible_count;
+		}
+
+		template<template<typename> class Test>
+		uint32_t cull_parallel(JobSystem& job_system, const Frustum& frustum, const typename Test<ScalarLanes>::Bounds& bounds, uint32_t count, uint32_t* visible_indices)
+		{
+			const uint32_t range_count = (count + cull_grain_size - 1) / cull_grain_size;
+			std::vector<uint32_t> visible_counts(range_count);
+			job_system.parallel_for(count, cull_grain_size, [&](uint32_t begin, uint32_t end)
+			{
+				visible_counts[begin / cull_grain_size] = cull_range<Test>(frustum, bounds, begin, end, visible_indices + begin);
+			});
+
+			// Every range starts at or after where the previous one ends, so moving them
+			// front to back never overwrites one that has yet to move
+			uint32_t visible_count = visible_counts.empty() ? 0 : visible_counts[0];
+			for (uint32_t range_idx = 1; range_idx < range_count; ++range_idx)
+			{
+				const uint32_t* range_indices = visible_indices + range_idx * cull_grain_size;
+				std::copy(range_indices, range_indices + visible_counts[range_idx], visible_indices + visible_count);
+				visible_count += visible_counts[range_idx];
+			}
+			return visible_count;
+		}
+
+		Float4 normalize_plane(float x, float y, float z, float w)
+		{
+			const float inverse_length = 1.0f / std::sqrt(x * x + y * y + z * z);
+			return Float4{ x * inverse_length, y * inverse_length, z * inverse_length, w * inverse_length };
+		}
+	}
+
+	Frustum make_frustum(const Float4x4& view_projection)
+	{
+		// Rows multiply from the left, so clip space x, y, z and w are the dot products
+		// with the columns and -w <= x <= w, -w <= y <= w and 0 <= z <= w are the planes
+		const Float4* rows = view_projection.rows;
+		const Float4 column_x = { rows[0].x, rows[1].x, rows[2].x, rows[3].x };
+		const Float4 column_y = { rows[0].y, rows[1].y, rows[2].y, rows[3].y };
+		const Float4 column_z = { rows[0].z, rows[1].z, rows[2].z, rows[3].z };
+		const Float4 column_w = { rows[0].w, rows[1].w, rows[2].w, rows[3].w };
+
+		Frustum frustum;
+		frustum.planes[0] = normalize_plane(column_w.x + column_x.x, column_w.y + column_x.y, column_w.z + column_x.z, column_w.w + column_x.w);
+		frustum.planes[1] = normalize_plane(column_w.x - column_x.x, column_w.y - column_x.y, column_w.z - column_x.z, column_w.w - column_x.w);
+		frustum.planes[2] = normalize_plane(column_w.x + column_y.x, column_w.y + column_y.y, column_w.z + column_y.z, column_w.w + column_y.w);
+		frustum.planes[3] = normalize_plane(column_w.x - column_y.x, column_w.y - column_y.y, column_w.z - column_y.z, column_w.w - column_y.w);
+		frustum.planes[4] = normalize_plane(column_z.x, column_z.y, column_z.z, column_z.w);
+		frustum.planes[5] = normalize_plane(column_w.x - column_z.x, column_w.y - column_z.y, column_w.z - column_z.z, column_w.w - column_z.w);
+		return frustum;
+	}
+
+	uint32_t cull_spheres(const Frustum& frustum, const SphereBounds& spheres, uint32_t count, uint32_t* visible_indices)
+	{
+		PROFILE_ZONE("Cull spheres");
+		return cull_range<SphereTest>(frustum, spheres, 0, count, visible_indices);
+	}
+
+	uint32_t cull_aabbs(const Frustum& frustum, const AabbBounds& aabbs, uint32_t count, uint32_t* visible_indices)
+	{
+		PROFILE_ZONE("Cull AABBs");
+		return cull_range<AabbTest>(frustum, aabbs, 0, count, visible_indices);
+	}
+
+	uint32_t cull_spheres(JobSystem& job_system, const Frustum& frustum, const SphereBounds& spheres, uint32_t count, uint32_t* visible_indices)
+	{
+		PROFILE_ZONE("Cull spheres");
+		return cull_parallel<SphereTest>(job_system, frustum, spheres, count, visible_indices);
+	}
+
+	uint32_t cull_aabbs(JobSystem& job_system, const Frustum& frustum, const AabbBounds& aabbs, uint32_t count, uint32_t* visible_indices)
+	{
+		PROFILE_ZONE("Cull AABBs");
+		return cull_parallel<AabbTest>(job_system, frustum, aabbs, count, visible_indices);
+	}
+
+}
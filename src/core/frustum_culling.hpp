@@ -0,0 +1,57 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_FRUSTUM_CULLING_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_FRUSTUM_CULLING_HPP
+
+#include <cstdint>
+
+#include "simd_math.hpp"
+
+namespace Core
+{
+
+	class JobSystem;
+
+	// Normalized planes pointing inwards, a point is inside when
+	// dot(plane.xyz, point) + plane.w >= 0 for all six
+	struct Frustum
+	{
+		Float4 planes[6];
+	};
+
+	// For projections with depth from 0 to 1 like matrix_perspective_fov_lh(), the planes
+	// are in the space the matrix transforms from
+	Frustum make_frustum(const Float4x4& view_projection);
+
+	// One array per component, so 8 (AVX2) or 4 (SSE2) objects are tested at once
+	struct SphereBounds
+	{
+		const float* center_x;
+		const float* center_y;
+		const float* center_z;
+		const float* radius;
+	};
+
+	struct AabbBounds
+	{
+		const float* center_x;
+		const float* center_y;
+		const float* center_z;
+		// Half the size along each axis
+		const float* extent_x;
+		const float* extent_y;
+		const float* extent_z;
+	};
+
+	// Write the indices of the bounds intersecting the frustum to visible_indices, in
+	// increasing order, and return how many there are. visible_indices needs room for count
+	// indices, the ones after the visible ones are overwritten with garbage.
+	uint32_t cull_spheres(const Frustum& frustum, const SphereBounds& spheres, uint32_t count, uint32_t* visible_indices);
+	uint32_t cull_aabbs(const Frustum& frustum, const AabbBounds& aabbs, uint32_t count, uint32_t* visible_indices);
+
+	// The same spread over the job system, each range compacts its own part of
+	// visible_indices which are then moved together
+	uint32_t cull_spheres(JobSystem& job_system, const Frustum& frustum, const SphereBounds& spheres, uint32_t count, uint32_t* visible_indices);
+	uint32_t cull_aabbs(JobSystem& job_system, const Frustum& frustum, const AabbBounds& aabbs, uint32_t count, uint32_t* visible_indices);
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_FRUSTUM_CULLING_HPP
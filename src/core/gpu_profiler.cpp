@@ -0,0 +1,164 @@
+#include "gpu_profiler.hpp"
+
+#include <cassert>
+
+namespace Core
+{
+
+	namespace
+	{
+		constexpr uint32_t invalid_region = UINT32_MAX;
+	}
+
+	GpuProfiler::GpuProfiler(GpuQuerySource& source) :
+		m_source(source),
+		m_frames(source.frame_slot_count()),
+		m_track(Profiler::register_track("GPU"))
+	{
+		assert(source.frame_slot_count() > 0);
+	}
+
+	void GpuProfiler::begin_frame()
+	{
+		assert(!m_is_recording);
+
+		// Pick up every older frame that finished in the meantime, oldest first. The
+		// current slot holds the oldest one, frame_slot_count() frames ago.
+		const auto slot_count = static_cast<uint32_t>(m_frames.size());
+		for (uint32_t offset = 0; offset < slot_count; ++offset)
+		{
+			const uint32_t frame_slot = (m_current_slot + offset) % slot_count;
+			if (m_frames[frame_slot].is_pending)
+			{
+				try_resolve(m_frames[frame_slot], frame_slot);
+			}
+		}
+
+		auto& frame = m_frames[m_current_slot];
+		if (frame.is_pending)
+		{
+			// Still not finished after a full round of slots, reusing it beats stalling
+			frame.is_pending = false;
+			++m_dropped_frame_count;
+		}
+
+		frame.regions.clear();
+		frame.timestamp_count = 0;
+		frame.frame_idx = m_frame_idx;
+
+		m_source.begin_frame(m_current_slot);
+		m_is_recording = true;
+	}
+
+	void GpuProfiler::end_frame()
+	{
+		assert(m_is_recording);
+
+		auto& frame = m_frames[m_current_slot];
+		m_source.end_frame(m_current_slot, frame.timestamp_count);
+		frame.is_pending = frame.timestamp_count > 0;
+
+		m_is_recording = false;
+		m_current_slot = (m_current_slot + 1) % static_cast<uint32_t>(m_frames.size());
+		++m_frame_idx;
+	}
+
+	uint32_t GpuProfiler::begin_region(const char* name)
+	{
+		auto& frame = m_frames[m_current_slot];
+		if (!m_is_recording || frame.timestamp_count + 2 > m_source.max_timestamps_per_frame())
+		{
+			return invalid_region;
+		}
+
+		m_source.write_timestamp(m_current_slot, frame.timestamp_count);
+		frame.regions.push_back({ name, frame.timestamp_count, frame.timestamp_count });
+		++frame.timestamp_count;
+
+		// Keep room for the closing timestamp
+		++frame.timestamp_count;
+
+		return static_cast<uint32_t>(frame.regions.size() - 1);
+	}
+
+	void GpuProfiler::end_region(uint32_t region_idx)
+	{
+		if (region_idx == invalid_region || !m_is_recording)
+		{
+			return;
+		}
+
+		auto& region = m_frames[m_current_slot].regions[region_idx];
+		region.end_timestamp = region.begin_timestamp + 1;
+		m_source.write_timestamp(m_current_slot, region.end_timestamp);
+	}
+
+	const std::vector<GpuRegion>& GpuProfiler::resolved_regions() const
+	{
+		return m_resolved_regions;
+	}
+
+	uint64_t GpuProfiler::resolved_frame_idx() const
+	{
+		return m_resolved_frame_idx;
+	}
+
+	uint64_t GpuProfiler::dropped_frame_count() const
+	{
+		return m_dropped_frame_count;
+	}
+
+	bool GpuProfiler::try_resolve(Frame& frame, uint32_t frame_slot)
+	{
+		GpuTimestamps timestamps;
+		if (!m_source.read_timestamps(frame_slot, frame.timestamp_count, timestamps))
+		{
+			return false;
+		}
+		frame.is_pending = false;
+
+		if (!timestamps.is_reliable || timestamps.frequency == 0)
+		{
+			++m_dropped_frame_count;
+			return false;
+		}
+
+		const auto to_cpu_ns = [&timestamps](uint64_t tick)
+		{
+			const auto delta = static_cast<double>(static_cast<int64_t>(tick - timestamps.calibration_gpu_tick));
+			return timestamps.calibration_cpu_ns + static_cast<int64_t>(delta * 1e9 / static_cast<double>(timestamps.frequency));
+		};
+
+		// Frames finishing out of order still go to the trace, but never replace the
+		// regions of a newer frame
+		const bool is_newest = !m_has_resolved || frame.frame_idx > m_resolved_frame_idx;
+		if (is_newest)
+		{
+			m_resolved_regions.clear();
+			m_resolved_frame_idx = frame.frame_idx;
+			m_has_resolved = true;
+		}
+		for (const auto& region : frame.regions)
+		{
+			// A region that was never closed has no end timestamp
+			if (region.end_timestamp == region.begin_timestamp)
+			{
+				continue;
+			}
+
+			const GpuRegion resolved = {
+				region.name,
+				to_cpu_ns(timestamps.ticks[region.begin_timestamp]),
+				to_cpu_ns(timestamps.ticks[region.end_timestamp])
+			};
+			if (is_newest)
+			{
+				m_resolved_regions.push_back(resolved);
+			}
+			Profiler::record_on_track(m_track, resolved.name, resolved.begin_ns, resolved.end_ns);
+		}
+
+		return true;
+	}
+
+}
@@ -0,0 +1,130 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_GPU_PROFILER_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_GPU_PROFILER_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "profiler.hpp"
+
+#if defined(DIRECTX_PLAYGROUND_PROFILE)
+#define GPU_PROFILE_ZONE(gpu_profiler, name) Core::GpuProfileZone PROFILE_CONCAT(gpu_profile_zone_, __LINE__)(gpu_profiler, name)
+#else
+#define GPU_PROFILE_ZONE(gpu_profiler, name)
+#endif
+
+namespace Core
+{
+
+	struct GpuTimestamps
+	{
+		const uint64_t* ticks;
+		uint64_t frequency;
+		// A GPU tick and the Profiler::now() value observed at the same moment,
+		// used to place the GPU regions on the CPU timeline
+		uint64_t calibration_gpu_tick;
+		uint64_t calibration_cpu_ns;
+		// False when the GPU clock changed frequency during the frame (DX11 disjoint queries)
+		bool is_reliable;
+	};
+
+	// The API specific half of the GPU profiler: owns the timestamp queries of every
+	// frame slot. Slot N is reused every frame_slot_count() frames.
+	class GpuQuerySource
+	{
+	public:
+		virtual ~GpuQuerySource() = default;
+
+		virtual uint32_t frame_slot_count() const = 0;
+		virtual uint32_t max_timestamps_per_frame() const = 0;
+
+		virtual void begin_frame(uint32_t frame_slot) = 0;
+		virtual void write_timestamp(uint32_t frame_slot, uint32_t timestamp_idx) = 0;
+		virtual void end_frame(uint32_t frame_slot, uint32_t timestamp_count) = 0;
+
+		// Must not block: returns false while the GPU has not finished the frame yet
+		virtual bool read_timestamps(uint32_t frame_slot, uint32_t timestamp_count, GpuTimestamps& timestamps) = 0;
+	};
+
+	struct GpuRegion
+	{
+		const char* name;
+		uint64_t begin_ns;
+		uint64_t end_ns;
+	};
+
+	// Brackets GPU work with timestamps and reads them back once the GPU is done,
+	// at the latest when their slot comes around again frame_slot_count() frames
+	// later, so the CPU never waits on the GPU for profiling data.
+	// Resolved regions are pushed to a "GPU" track of the CPU profiler.
+	class GpuProfiler
+	{
+	public:
+		explicit GpuProfiler(GpuQuerySource& source);
+		GpuProfiler(const GpuProfiler&) = delete;
+		GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+		void begin_frame();
+		void end_frame();
+
+		uint32_t begin_region(const char* name);
+		void end_region(uint32_t region_idx);
+
+		// Regions of the most recently resolved frame
+		const std::vector<GpuRegion>& resolved_regions() const;
+		uint64_t resolved_frame_idx() const;
+		// Frames whose results were not ready when their slot had to be reused
+		uint64_t dropped_frame_count() const;
+	private:
+		struct Region
+		{
+			const char* name;
+			uint32_t begin_timestamp;
+			uint32_t end_timestamp;
+		};
+
+		struct Frame
+		{
+			std::vector<Region> regions;
+			uint32_t timestamp_count = 0;
+			uint64_t frame_idx = 0;
+			bool is_pending = false;
+		};
+
+		bool try_resolve(Frame& frame, uint32_t frame_slot);
+
+		GpuQuerySource& m_source;
+		std::vector<Frame> m_frames;
+		uint64_t m_frame_idx = 0;
+		uint32_t m_current_slot = 0;
+		bool m_is_recording = false;
+
+		std::vector<GpuRegion> m_resolved_regions;
+		uint64_t m_resolved_frame_idx = 0;
+		bool m_has_resolved = false;
+		uint64_t m_dropped_frame_count = 0;
+
+		uint32_t m_track;
+	};
+
+	class GpuProfileZone
+	{
+	public:
+		GpuProfileZone(GpuProfiler& profiler, const char* name) :
+			m_profiler(profiler),
+			m_region_idx(profiler.begin_region(name))
+		{}
+		GpuProfileZone(const GpuProfileZone&) = delete;
+		GpuProfileZone& operator=(const GpuProfileZone&) = delete;
+
+		~GpuProfileZone()
+		{
+			m_profiler.end_region(m_region_idx);
+		}
+	private:
+		GpuProfiler& m_profiler;
+		uint32_t m_region_idx;
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_GPU_PROFILER_HPP
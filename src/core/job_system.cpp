@@ -0,0 +1,264 @@
+#include "job_system.hpp"
+
+#include "profiler.hpp"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Core
+{
+
+	namespace
+	{
+		thread_local const JobSystem* t_owner = nullptr;
+		thread_local uint32_t t_queue_idx = 0;
+	}
+
+	bool JobCounter::is_done() const
+	{
+		return m_pending.load(std::memory_order_acquire) == 0;
+	}
+
+	JobSystem::JobSystem(const JobSystemDesc& desc) :
+		m_desc(desc)
+	{
+		uint32_t worker_count = desc.worker_count;
+		if (worker_count == JobSystemDesc::auto_worker_count)
+		{
+			const uint32_t hardware_threads = std::thread::hardware_concurrency();
+			worker_count = hardware_threads > 1 ? hardware_threads - 1 : 1;
+		}
+
+		for (uint32_t queue_idx = 0; queue_idx < worker_count + 1; ++queue_idx)
+		{
+			m_queues.push_back(std::make_unique<Queue>());
+		}
+
+		m_workers.reserve(worker_count);
+		for (uint32_t worker_idx = 0; worker_idx < worker_count; ++worker_idx)
+		{
+			m_workers.emplace_back(&JobSystem::worker_main, this, worker_idx + 1);
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleep_mutex);
+			m_is_running.store(false);
+		}
+		m_wake_condition.notify_all();
+
+		for (auto& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	void JobSystem::submit(Job job, JobCounter* counter)
+	{
+		if (counter)
+		{
+			counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// Count the job before it becomes visible so a thief can never
+		// take it out of the queue before it has been accounted for
+		m_queued_jobs.fetch_add(1, std::memory_order_seq_cst);
+
+		const uint32_t queue_idx = current_queue_idx();
+		{
+			std::lock_guard<std::mutex> lock(m_queues[queue_idx]->mutex);
+			m_queues[queue_idx]->entries.push_back({ std::move(job), counter });
+		}
+		wake_one();
+	}
+
+	void JobSystem::submit_background(Job job, JobCounter* counter)
+	{
+		if (m_workers.empty())
+		{
+			job();
+			return;
+		}
+
+		if (counter)
+		{
+			counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		m_queued_jobs.fetch_add(1, std::memory_order_seq_cst);
+
+		{
+			std::lock_guard<std::mutex> lock(m_background_queue.mutex);
+			m_background_queue.entries.push_back({ std::move(job), counter });
+		}
+		wake_one();
+	}
+
+	void JobSystem::wake_one()
+	{
+		// A worker counts itself as sleeping before it checks m_queued_jobs, both sequentially
+		// consistent, so either it sees the job or this sees it. Taking the mutex makes sure
+		// it is waiting by the time it gets notified.
+		if (m_sleeping_workers.load(std::memory_order_seq_cst) == 0)
+		{
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_sleep_mutex);
+		}
+		m_wake_condition.notify_one();
+	}
+
+	void JobSystem::wait(JobCounter& counter)
+	{
+		const uint32_t queue_idx = current_queue_idx();
+		while (!counter.is_done())
+		{
+			if (!run_one(queue_idx, false))
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	uint32_t JobSystem::worker_count() const
+	{
+		return static_cast<uint32_t>(m_workers.size());
+	}
+
+	void JobSystem::worker_main(uint32_t queue_idx)
+	{
+		t_owner = this;
+		t_queue_idx = queue_idx;
+		PROFILE_THREAD_NAME("Job Worker");
+
+		if (m_desc.pin_workers_to_cores)
+		{
+			pin_current_thread(m_desc.first_core + queue_idx - 1);
+		}
+
+		while (true)
+		{
+			if (run_one(queue_idx, true))
+			{
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(m_sleep_mutex);
+			m_sleeping_workers.fetch_add(1, std::memory_order_seq_cst);
+			m_wake_condition.wait(lock, [this]()
+				{
+					return m_queued_jobs.load(std::memory_order_seq_cst) > 0 || !m_is_running.load();
+				});
+			m_sleeping_workers.fetch_sub(1, std::memory_order_relaxed);
+
+			if (!m_is_running.load() && m_queued_jobs.load(std::memory_order_acquire) == 0)
+			{
+				return;
+			}
+		}
+	}
+
+	void JobSystem::pin_current_thread(uint32_t core) const
+	{
+		const uint32_t hardware_threads = std::thread::hardware_concurrency();
+		if (hardware_threads == 0)
+		{
+			return;
+		}
+		core %= hardware_threads;
+
+#if defined(_WIN32)
+		SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core);
+#else
+		cpu_set_t cpu_set;
+		CPU_ZERO(&cpu_set);
+		CPU_SET(core, &cpu_set);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#endif
+	}
+
+	uint32_t JobSystem::current_queue_idx() const
+	{
+		return t_owner == this ? t_queue_idx : 0;
+	}
+
+	bool JobSystem::pop(uint32_t queue_idx, Entry& entry)
+	{
+		auto& queue = *m_queues[queue_idx];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.entries.empty())
+		{
+			return false;
+		}
+
+		// The owner works depth-first on its most recent job, which keeps
+		// the data touched by the parent job in cache
+		entry = std::move(queue.entries.back());
+		queue.entries.pop_back();
+		return true;
+	}
+
+	bool JobSystem::steal(uint32_t queue_idx, Entry& entry)
+	{
+		const auto queue_count = static_cast<uint32_t>(m_queues.size());
+		for (uint32_t offset = 1; offset < queue_count; ++offset)
+		{
+			auto& queue = *m_queues[(queue_idx + offset) % queue_count];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.entries.empty())
+			{
+				continue;
+			}
+
+			// Thieves take the oldest job, which tends to be the biggest chunk of work
+			entry = std::move(queue.entries.front());
+			queue.entries.pop_front();
+			return true;
+		}
+		return false;
+	}
+
+	bool JobSystem::pop_background(Entry& entry)
+	{
+		std::lock_guard<std::mutex> lock(m_background_queue.mutex);
+		if (m_background_queue.entries.empty())
+		{
+			return false;
+		}
+
+		entry = std::move(m_background_queue.entries.front());
+		m_background_queue.entries.pop_front();
+		return true;
+	}
+
+	bool JobSystem::run_one(uint32_t queue_idx, bool is_background_allowed)
+	{
+		Entry entry;
+		if (!pop(queue_idx, entry)
+			&& !steal(queue_idx, entry)
+			&& !(is_background_allowed && pop_background(entry)))
+		{
+			return false;
+		}
+		m_queued_jobs.fetch_sub(1, std::memory_order_acq_rel);
+
+		{
+			PROFILE_ZONE("Job");
+			entry.job();
+		}
+
+		if (entry.counter)
+		{
+			entry.counter->m_pending.fetch_sub(1, std::memory_order_release);
+		}
+		return true;
+	}
+
+}
@@ -0,0 +1,135 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_JOB_SYSTEM_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_JOB_SYSTEM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Core
+{
+
+	using Job = std::function<void()>;
+
+	// Fork/join counter. Every job submitted with a counter increments it and
+	// decrements it once finished, JobSystem::wait() returns when it reaches zero.
+	class JobCounter
+	{
+	public:
+		JobCounter() = default;
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+		bool is_done() const;
+	private:
+		friend class JobSystem;
+
+		std::atomic<uint32_t> m_pending{ 0 };
+	};
+
+	struct JobSystemDesc
+	{
+		static constexpr uint32_t auto_worker_count = UINT32_MAX;
+
+		// auto_worker_count means one worker per hardware thread, minus the calling thread.
+		// With 0 every job runs on the threads calling wait().
+		uint32_t worker_count = auto_worker_count;
+		bool pin_workers_to_cores = false;
+		// Worker N is pinned to core (first_core + N) when pinning is enabled
+		uint32_t first_core = 1;
+	};
+
+	class JobSystem
+	{
+	public:
+		explicit JobSystem(const JobSystemDesc& desc = {});
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+		~JobSystem();
+
+		void submit(Job job, JobCounter* counter = nullptr);
+		// For long running work like pipeline compiles. Only workers run these, once
+		// every queue is empty, so wait() never picks one up on a frame critical thread.
+		// Without workers they run right away on the calling thread.
+		void submit_background(Job job, JobCounter* counter = nullptr);
+		// Runs pending jobs on the calling thread until the counter reaches zero
+		void wait(JobCounter& counter);
+
+		// Splits [0, count) into ranges of grain_size and calls function(begin, end)
+		// for each of them, returning once every range has finished.
+		// A grain_size of 0 picks one based on the worker count.
+		template<typename Function>
+		void parallel_for(uint32_t count, uint32_t grain_size, Function&& function);
+
+		uint32_t worker_count() const;
+	private:
+		struct Entry
+		{
+			Job job;
+			JobCounter* counter;
+		};
+
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<Entry> entries;
+		};
+
+		void worker_main(uint32_t queue_idx);
+		void pin_current_thread(uint32_t core) const;
+
+		uint32_t current_queue_idx() const;
+		bool pop(uint32_t queue_idx, Entry& entry);
+		bool steal(uint32_t queue_idx, Entry& entry);
+		bool pop_background(Entry& entry);
+		bool run_one(uint32_t queue_idx, bool is_background_allowed);
+		// Called after a job was queued, only locks when a worker is asleep
+		void wake_one();
+
+		// Queue 0 is shared by every thread that is not a worker,
+		// queue N (N > 0) is owned by worker N - 1
+		std::vector<std::unique_ptr<Queue>> m_queues;
+		Queue m_background_queue;
+		std::vector<std::thread> m_workers;
+
+		std::atomic<uint32_t> m_queued_jobs{ 0 };
+		// Workers waiting on m_wake_condition, only changed under m_sleep_mutex
+		std::atomic<uint32_t> m_sleeping_workers{ 0 };
+		std::atomic<bool> m_is_running{ true };
+		std::mutex m_sleep_mutex;
+		std::condition_variable m_wake_condition;
+
+		JobSystemDesc m_desc;
+	};
+
+	template<typename Function>
+	void JobSystem::parallel_for(uint32_t count, uint32_t grain_size, Function&& function)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		if (grain_size == 0)
+		{
+			const uint32_t total_ranges = (worker_count() + 1) * 4;
+			grain_size = (count + total_ranges - 1) / total_ranges;
+		}
+
+		JobCounter counter;
+		for (uint32_t begin = 0; begin < count; begin += grain_size)
+		{
+			const uint32_t end = count - begin > grain_size ? begin + grain_size : count;
+			submit([&function, begin, end]() { function(begin, end); }, &counter);
+		}
+		wait(counter);
+	}
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_JOB_SYSTEM_HPP
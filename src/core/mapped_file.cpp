@@ -0,0 +1,150 @@
+#include "mapped_file.hpp"
+
+#include <utility>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Core
+{
+
+	namespace
+	{
+		constexpr size_t page_size = 4096;
+	}
+
+#if defined(_WIN32)
+
+	MappedFile::MappedFile(const std::string& path)
+	{
+		HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+
+		LARGE_INTEGER file_size;
+		if (::GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+		{
+			// The mapping keeps the file open
+			m_mapping = ::CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (m_mapping)
+			{
+				m_data = static_cast<const uint8_t*>(::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+				m_size = m_data ? static_cast<size_t>(file_size.QuadPart) : 0;
+			}
+		}
+		::CloseHandle(file);
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data)
+		{
+			::UnmapViewOfFile(m_data);
+		}
+		if (m_mapping)
+		{
+			::CloseHandle(m_mapping);
+		}
+		m_data = nullptr;
+		m_size = 0;
+		m_mapping = nullptr;
+	}
+
+#else
+
+	MappedFile::MappedFile(const std::string& path)
+	{
+		const int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (file < 0)
+		{
+			return;
+		}
+
+		struct stat file_stat;
+		if (::fstat(file, &file_stat) == 0 && file_stat.st_size > 0)
+		{
+			void* data = ::mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			if (data != MAP_FAILED)
+			{
+				// Textures and meshes are read front to back, once
+				::madvise(data, static_cast<size_t>(file_stat.st_size), MADV_SEQUENTIAL);
+				m_data = static_cast<const uint8_t*>(data);
+				m_size = static_cast<size_t>(file_stat.st_size);
+			}
+		}
+		// The mapping keeps the file open
+		::close(file);
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data)
+		{
+			::munmap(const_cast<uint8_t*>(m_data), m_size);
+		}
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+#endif
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			close();
+			std::swap(m_data, other.m_data);
+			std::swap(m_size, other.m_size);
+#if defined(_WIN32)
+			std::swap(m_mapping, other.m_mapping);
+#endif
+		}
+		return *this;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	bool MappedFile::is_valid() const
+	{
+		return m_data != nullptr;
+	}
+
+	const uint8_t* MappedFile::data() const
+	{
+		return m_data;
+	}
+
+	size_t MappedFile::size() const
+	{
+		return m_size;
+	}
+
+	void MappedFile::prefetch() const
+	{
+		// Volatile so the reads are not optimised away
+		const volatile uint8_t* data = m_data;
+		uint8_t sum = 0;
+		for (size_t offset = 0; offset < m_size; offset += page_size)
+		{
+			sum += data[offset];
+		}
+		(void)sum;
+	}
+
+}
@@ -0,0 +1,44 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_MAPPED_FILE_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Core
+{
+
+	// Read only view of a whole file through the page cache, nothing is copied
+	// until the pages are touched
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		explicit MappedFile(const std::string& path);
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		// False when the file can not be opened or is empty
+		bool is_valid() const;
+		const uint8_t* data() const;
+		size_t size() const;
+
+		// Touches every page, so the disk reads happen on the calling thread
+		// instead of whichever thread reads the data first
+		void prefetch() const;
+	private:
+		void close();
+
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+#if defined(_WIN32)
+		void* m_mapping = nullptr;
+#endif
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_MAPPED_FILE_HPP
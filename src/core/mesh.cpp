@@ -0,0 +1,199 @@
+#include "mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Core
+{
+
+	namespace
+	{
+		// Offset and byte size of a section are inside the file and aligned
+		bool is_section_valid(uint64_t offset, uint64_t size, uint64_t file_size)
+		{
+			return offset % 16 == 0 && offset <= file_size && size <= file_size - offset;
+		}
+	}
+
+	bool load_mesh(const std::string& path, MeshData& mesh, std::string& error)
+	{
+		mesh.file = MappedFile(path);
+		if (!mesh.file.is_valid())
+		{
+			error = "Can not map " + path;
+			return false;
+		}
+
+		const uint8_t* data = mesh.file.data();
+		const size_t size = mesh.file.size();
+		if (size < sizeof(MeshHeader))
+		{
+			error = path + " is too small for a mesh";
+			return false;
+		}
+
+		MeshHeader& header = mesh.header;
+		std::memcpy(&header, data, sizeof(header));
+		if (header.magic != MeshHeader::magic_value)
+		{
+			error = path + " is not a mesh";
+			return false;
+		}
+		if (header.version != MeshHeader::current_version)
+		{
+			error = path + " has version " + std::to_string(header.version) + ", convert it again";
+			return false;
+		}
+		if (header.index_size != 2 && header.index_size != 4)
+		{
+			error = path + " has an invalid index size";
+			return false;
+		}
+
+		const bool is_valid = header.file_size == size
+			&& is_section_valid(header.vertex_offset, static_cast<uint64_t>(header.vertex_count) * sizeof(MeshVertex), size)
+			&& is_section_valid(header.index_offset, static_cast<uint64_t>(header.index_count) * header.index_size, size)
+			&& is_section_valid(header.submesh_offset, static_cast<uint64_t>(header.submesh_count) * sizeof(Submesh), size)
+			&& is_section_valid(header.meshlet_offset, static_cast<uint64_t>(header.meshlet_count) * sizeof(Meshlet), size)
+			&& is_section_valid(header.meshlet_vertex_offset, static_cast<uint64_t>(header.meshlet_vertex_count) * sizeof(uint32_t), size)
+			&& is_section_valid(header.meshlet_triangle_offset, header.meshlet_triangle_size, size)
+			// Read as uints, every meshlet's triangles are padded to four bytes
+			&& header.meshlet_triangle_size % 4 == 0;
+		if (!is_valid)
+		{
+			error = path + " is truncated";
+			return false;
+		}
+
+		// The mapping is page aligned and the sections 16 byte aligned within it
+		mesh.vertices = reinterpret_cast<const MeshVertex*>(data + header.vertex_offset);
+		mesh.indices = data + header.index_offset;
+		mesh.submeshes = reinterpret_cast<const Submesh*>(data + header.submesh_offset);
+		mesh.meshlets = reinterpret_cast<const Meshlet*>(data + header.meshlet_offset);
+		mesh.meshlet_vertices = reinterpret_cast<const uint32_t*>(data + header.meshlet_vertex_offset);
+		mesh.meshlet_triangles = data + header.meshlet_triangle_offset;
+		return true;
+	}
+
+	void encode_octahedral(const float (&normal)[3], int16_t (&encoded)[2])
+	{
+		const float length = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+		if (length == 0.0f)
+		{
+			encoded[0] = 0;
+			encoded[1] = 0;
+			return;
+		}
+
+		// Onto the octahedron, then the lower half folded over the diagonals
+		float x = normal[0] / length;
+		float y = normal[1] / length;
+		if (normal[2] < 0.0f)
+		{
+			const float folded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			const float folded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = folded_x;
+			y = folded_y;
+		}
+		encoded[0] = static_cast<int16_t>(std::lround(std::clamp(x, -1.0f, 1.0f) * 32767.0f));
+		encoded[1] = static_cast<int16_t>(std::lround(std::clamp(y, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	void decode_octahedral(const int16_t (&encoded)[2], float (&normal)[3])
+	{
+		float x = std::max(encoded[0] / 32767.0f, -1.0f);
+		float y = std::max(encoded[1] / 32767.0f, -1.0f);
+		const float z = 1.0f - std::abs(x) - std::abs(y);
+		if (z < 0.0f)
+		{
+			const float unfolded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			const float unfolded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = unfolded_x;
+			y = unfolded_y;
+		}
+
+		const float length = std::sqrt(x * x + y * y + z * z);
+		normal[0] = x / length;
+		normal[1] = y / length;
+		normal[2] = z / length;
+	}
+
+	uint16_t float_to_half(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+		const uint32_t exponent = (bits >> 23) & 0xff;
+		uint32_t mantissa = bits & 0x7fffff;
+
+		if (exponent == 0xff)
+		{
+			// Infinity stays infinity, NaN stays NaN
+			return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+		}
+
+		const int32_t half_exponent = static_cast<int32_t>(exponent) - 127 + 15;
+		if (half_exponent >= 31)
+		{
+			return static_cast<uint16_t>(sign | 0x7c00);
+		}
+		if (half_exponent <= 0)
+		{
+			if (half_exponent < -10)
+			{
+				return sign;
+			}
+
+			// Subnormal, rounded to nearest even
+			mantissa |= 0x800000;
+			const auto shift = static_cast<uint32_t>(14 - half_exponent);
+			uint32_t half_mantissa = mantissa >> shift;
+			const uint32_t remainder = mantissa & ((1U << shift) - 1);
+			const uint32_t halfway = 1U << (shift - 1);
+			if (remainder > halfway || (remainder == halfway && (half_mantissa & 1)))
+			{
+				++half_mantissa;
+			}
+			return static_cast<uint16_t>(sign | half_mantissa);
+		}
+
+		// Rounded to nearest even, a carry out of the mantissa correctly bumps the exponent
+		uint32_t half = sign | static_cast<uint32_t>(half_exponent) << 10 | mantissa >> 13;
+		const uint32_t remainder = mantissa & 0x1fff;
+		if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+		{
+			++half;
+		}
+		return static_cast<uint16_t>(half);
+	}
+
+	float half_to_float(uint16_t value)
+	{
+		const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+		const uint32_t exponent = (value >> 10) & 0x1f;
+		const uint32_t mantissa = value & 0x3ff;
+
+		if (exponent == 0)
+		{
+			const float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+			return sign ? -magnitude : magnitude;
+		}
+
+		const uint32_t bits = exponent == 31
+			? sign | 0x7f800000 | mantissa << 13
+			: sign | (exponent + 112) << 23 | mantissa << 13;
+		float result;
+		std::memcpy(&result, &bits, sizeof(result));
+		return result;
+	}
+
+	void decode_position(const MeshHeader& header, const MeshVertex& vertex, float (&position)[3])
+	{
+		for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+		{
+			position[axis_idx] = header.position_offset[axis_idx] + vertex.position[axis_idx] / 65535.0f * header.position_scale[axis_idx];
+		}
+	}
+
+}
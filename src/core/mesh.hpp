@@ -0,0 +1,124 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_MESH_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_MESH_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "mapped_file.hpp"
+
+namespace Core
+{
+
+	// 16 bytes, laid out for the input assembler as is
+	struct MeshVertex
+	{
+		// R16G16B16A16_UNORM within the mesh bounds, w is zero
+		uint16_t position[4];
+		// R16G16_SNORM, octahedral
+		int16_t normal[2];
+		// R16G16_FLOAT
+		uint16_t uv[2];
+	};
+	static_assert(sizeof(MeshVertex) == 16, "MeshVertex layout");
+
+	// A range of the index buffer drawn with one material, and the meshlets covering it
+	struct Submesh
+	{
+		uint32_t first_index = 0;
+		uint32_t index_count = 0;
+		// Materials are numbered in the order the source file first uses them
+		uint32_t material_idx = 0;
+		uint32_t first_meshlet = 0;
+		uint32_t meshlet_count = 0;
+		uint32_t reserved = 0;
+		float bounds_min[3] = {};
+		float bounds_max[3] = {};
+	};
+	static_assert(sizeof(Submesh) == 48, "Submesh layout");
+
+	// Up to max_vertices vertices and max_triangles triangles a mesh shader group draws, and
+	// what it is culled with. Laid out for a structured buffer as is.
+	struct Meshlet
+	{
+		static constexpr uint32_t max_vertices = 64;
+		static constexpr uint32_t max_triangles = 124;
+
+		// Into the meshlet vertices, which index the vertex section
+		uint32_t vertex_offset = 0;
+		// Byte offset into the meshlet triangles, three local vertex indices each. A multiple
+		// of four so that they can be read as uints.
+		uint32_t triangle_offset = 0;
+		uint32_t vertex_count = 0;
+		uint32_t triangle_count = 0;
+		float center[3] = {};
+		float radius = 0.0f;
+		// Every triangle faces away from a camera in the cone around -cone_axis from
+		// cone_apex, dot(normalize(cone_apex - camera), cone_axis) >= cone_cutoff.
+		// A cutoff of 1 means there is no such cone.
+		float cone_apex[3] = {};
+		float cone_cutoff = 1.0f;
+		float cone_axis[3] = {};
+		uint32_t reserved = 0;
+	};
+	static_assert(sizeof(Meshlet) == 64, "Meshlet layout");
+
+	// The start of a .mesh file. Sections are 16 byte aligned and follow in the order below,
+	// all little endian.
+	struct MeshHeader
+	{
+		static constexpr uint32_t magic_value = 0x4853454d; // "MESH"
+		static constexpr uint32_t current_version = 2;
+
+		uint32_t magic = magic_value;
+		uint32_t version = current_version;
+		uint32_t vertex_count = 0;
+		uint32_t index_count = 0;
+		uint32_t submesh_count = 0;
+		// 2 while every index fits, 4 otherwise
+		uint32_t index_size = 0;
+		// position = position_offset + unorm position * position_scale
+		float position_offset[3] = {};
+		float position_scale[3] = {};
+		uint64_t vertex_offset = 0;
+		uint64_t index_offset = 0;
+		uint64_t submesh_offset = 0;
+		uint64_t file_size = 0;
+		uint32_t meshlet_count = 0;
+		uint32_t meshlet_vertex_count = 0;
+		// Bytes, padded per meshlet
+		uint32_t meshlet_triangle_size = 0;
+		uint32_t reserved = 0;
+		uint64_t meshlet_offset = 0;
+		uint64_t meshlet_vertex_offset = 0;
+		uint64_t meshlet_triangle_offset = 0;
+	};
+	static_assert(sizeof(MeshHeader) == 120, "MeshHeader layout");
+
+	// A mapped .mesh file, the pointers point into it. Nothing is parsed or copied on load,
+	// the vertex and index sections can be copied into upload memory as they are.
+	struct MeshData
+	{
+		MeshHeader header;
+		const MeshVertex* vertices = nullptr;
+		// uint16_t or uint32_t, as header.index_size says
+		const void* indices = nullptr;
+		const Submesh* submeshes = nullptr;
+		const Meshlet* meshlets = nullptr;
+		const uint32_t* meshlet_vertices = nullptr;
+		const uint8_t* meshlet_triangles = nullptr;
+		MappedFile file;
+	};
+
+	// Checks the header and that the sections are inside the file, nothing else
+	bool load_mesh(const std::string& path, MeshData& mesh, std::string& error);
+
+	// Quantization helpers shared by the importer and CPU code reading meshes
+	void encode_octahedral(const float (&normal)[3], int16_t (&encoded)[2]);
+	void decode_octahedral(const int16_t (&encoded)[2], float (&normal)[3]);
+	uint16_t float_to_half(float value);
+	float half_to_float(uint16_t value);
+	void decode_position(const MeshHeader& header, const MeshVertex& vertex, float (&position)[3]);
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_MESH_HPP
@@ -0,0 +1,456 @@
+#include "mesh_import.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+
+#include "mapped_file.hpp"
+#include "profiler.hpp"
+
+namespace Core
+{
+
+	namespace
+	{
+		// Indices of one face corner into the v, vt and vn lists, -1 when missing
+		struct ObjCorner
+		{
+			int32_t position;
+			int32_t uv;
+			int32_t normal;
+
+			bool operator==(const ObjCorner& other) const
+			{
+				return position == other.position && uv == other.uv && normal == other.normal;
+			}
+		};
+
+		struct ObjCornerHash
+		{
+			size_t operator()(const ObjCorner& corner) const
+			{
+				uint64_t hash = static_cast<uint32_t>(corner.position);
+				hash = hash * 0x9e3779b97f4a7c15ULL ^ static_cast<uint32_t>(corner.uv);
+				hash = hash * 0x9e3779b97f4a7c15ULL ^ static_cast<uint32_t>(corner.normal);
+				return static_cast<size_t>(hash ^ hash >> 29);
+			}
+		};
+
+		class ObjReader
+		{
+		public:
+			ObjReader(const char* begin, const char* end) :
+				m_cursor(begin),
+				m_end(end)
+			{
+			}
+
+			bool is_at_end() const
+			{
+				return m_cursor == m_end;
+			}
+
+			void skip_spaces()
+			{
+				while (m_cursor != m_end && (*m_cursor == ' ' || *m_cursor == '\t' || *m_cursor == '\r'))
+				{
+					++m_cursor;
+				}
+			}
+
+			bool is_at_line_end()
+			{
+				skip_spaces();
+				return m_cursor == m_end || *m_cursor == '\n' || *m_cursor == '#';
+			}
+
+			void next_line()
+			{
+				const auto* line_end = static_cast<const char*>(std::memchr(m_cursor, '\n', m_end - m_cursor));
+				m_cursor = line_end ? line_end + 1 : m_end;
+			}
+
+			// Up to the next space
+			std::string_view word()
+			{
+				skip_spaces();
+				const char* begin = m_cursor;
+				while (m_cursor != m_end && *m_cursor != ' ' && *m_cursor != '\t' && *m_cursor != '\r' && *m_cursor != '\n')
+				{
+					++m_cursor;
+				}
+				return std::string_view(begin, m_cursor - begin);
+			}
+
+			bool read(float& value)
+			{
+				skip_spaces();
+				// from_chars does not take a leading plus
+				if (m_cursor != m_end && *m_cursor == '+')
+				{
+					++m_cursor;
+				}
+				const auto result = std::from_chars(m_cursor, m_end, value);
+				m_cursor = result.ptr;
+				return result.ec == std::errc();
+			}
+
+			bool read(int32_t& value)
+			{
+				const auto result = std::from_chars(m_cursor, m_end, value);
+				m_cursor = result.ptr;
+				return result.ec == std::errc();
+			}
+
+			bool skip(char character)
+			{
+				if (m_cursor != m_end && *m_cursor == character)
+				{
+					++m_cursor;
+					return true;
+				}
+				return false;
+			}
+		private:
+			const char* m_cursor;
+			const char* m_end;
+		};
+
+		// OBJ indices start at 1, negative ones count back from the last element
+		bool resolve_index(int32_t index, size_t count, int32_t& resolved)
+		{
+			resolved = index > 0 ? index - 1 : static_cast<int32_t>(count) + index;
+			return index != 0 && resolved >= 0 && static_cast<size_t>(resolved) < count;
+		}
+
+		size_t align_up(size_t value)
+		{
+			return (value + 15) & ~static_cast<size_t>(15);
+		}
+	}
+
+	bool parse_obj(const std::string& path, MeshImport& mesh, std::string& error)
+	{
+		PROFILE_FUNCTION();
+
+		const MappedFile file(path);
+		if (!file.is_valid())
+		{
+			error = "Can not map " + path;
+			return false;
+		}
+
+		std::vector<float> positions;
+		std::vector<float> uvs;
+		std::vector<float> normals;
+		std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> vertex_ids;
+		std::unordered_map<std::string, uint32_t> material_ids;
+		// Vertices that get their normal from their faces
+		std::vector<bool> is_normal_missing;
+		std::vector<uint32_t> face;
+
+		mesh.vertices.clear();
+		mesh.indices.clear();
+		mesh.submeshes.assign(1, Submesh());
+		mesh.meshlets.clear();
+		mesh.meshlet_vertices.clear();
+		mesh.meshlet_triangles.clear();
+
+		const auto fail = [&](uint32_t line_idx, const char* message)
+		{
+			error = path + ":" + std::to_string(line_idx) + ": " + message;
+			return false;
+		};
+
+		const auto* text = reinterpret_cast<const char*>(file.data());
+		ObjReader reader(text, text + file.size());
+		for (uint32_t line_idx = 1; !reader.is_at_end(); ++line_idx, reader.next_line())
+		{
+			if (reader.is_at_line_end())
+			{
+				continue;
+			}
+
+			const std::string_view keyword = reader.word();
+			if (keyword == "v" || keyword == "vn")
+			{
+				auto& values = keyword == "v" ? positions : normals;
+				float x;
+				float y;
+				float z;
+				if (!reader.read(x) || !reader.read(y) || !reader.read(z))
+				{
+					return fail(line_idx, "expected three numbers");
+				}
+				values.insert(values.end(), { x, y, z });
+			}
+			else if (keyword == "vt")
+			{
+				float u;
+				float v = 0.0f;
+				if (!reader.read(u) || (!reader.is_at_line_end() && !reader.read(v)))
+				{
+					return fail(line_idx, "expected a texture coordinate");
+				}
+				// OBJ puts v = 0 at the bottom, Direct3D at the top
+				uvs.insert(uvs.end(), { u, 1.0f - v });
+			}
+			else if (keyword == "f")
+			{
+				face.clear();
+				while (!reader.is_at_line_end())
+				{
+					int32_t position_index;
+					int32_t uv_index = 0;
+					int32_t normal_index = 0;
+					if (!reader.read(position_index))
+					{
+						return fail(line_idx, "expected a vertex index");
+					}
+					if (reader.skip('/'))
+					{
+						if (!reader.skip('/'))
+						{
+							reader.read(uv_index);
+							reader.skip('/');
+						}
+						reader.read(normal_index);
+					}
+
+					ObjCorner corner;
+					if (!resolve_index(position_index, positions.size() / 3, corner.position))
+					{
+						return fail(line_idx, "position index out of range");
+					}
+					corner.uv = -1;
+					if (uv_index != 0 && !resolve_index(uv_index, uvs.size() / 2, corner.uv))
+					{
+						return fail(line_idx, "texture coordinate index out of range");
+					}
+					corner.normal = -1;
+					if (normal_index != 0 && !resolve_index(normal_index, normals.size() / 3, corner.normal))
+					{
+						return fail(line_idx, "normal index out of range");
+					}
+
+					const auto [vertex_id, is_new] = vertex_ids.try_emplace(corner, static_cast<uint32_t>(mesh.vertices.size()));
+					if (is_new)
+					{
+						ImportedVertex vertex = {};
+						std::memcpy(vertex.position, &positions[corner.position * 3], sizeof(vertex.position));
+						if (corner.uv >= 0)
+						{
+							std::memcpy(vertex.uv, &uvs[corner.uv * 2], sizeof(vertex.uv));
+						}
+						if (corner.normal >= 0)
+						{
+							std::memcpy(vertex.normal, &normals[corner.normal * 3], sizeof(vertex.normal));
+						}
+						mesh.vertices.push_back(vertex);
+						is_normal_missing.push_back(corner.normal < 0);
+					}
+					face.push_back(vertex_id->second);
+				}
+
+				if (face.size() < 3)
+				{
+					return fail(line_idx, "a face needs three vertices");
+				}
+				for (size_t corner_idx = 1; corner_idx + 1 < face.size(); ++corner_idx)
+				{
+					mesh.indices.insert(mesh.indices.end(), { face[0], face[corner_idx], face[corner_idx + 1] });
+				}
+			}
+			else if (keyword == "usemtl")
+			{
+				const auto [material_id, is_new] = material_ids.try_emplace(std::string(reader.word()), static_cast<uint32_t>(material_ids.size()));
+				(void)is_new;
+
+				Submesh* submesh = &mesh.submeshes.back();
+				submesh->index_count = static_cast<uint32_t>(mesh.indices.size()) - submesh->first_index;
+				if (submesh->index_count > 0)
+				{
+					submesh = &mesh.submeshes.emplace_back();
+					submesh->first_index = static_cast<uint32_t>(mesh.indices.size());
+				}
+				submesh->material_idx = material_id->second;
+			}
+			// Groups, objects, smoothing groups, material libraries and anything else are skipped
+		}
+
+		Submesh& last_submesh = mesh.submeshes.back();
+		last_submesh.index_count = static_cast<uint32_t>(mesh.indices.size()) - last_submesh.first_index;
+		if (last_submesh.index_count == 0 && mesh.submeshes.size() > 1)
+		{
+			mesh.submeshes.pop_back();
+		}
+
+		const bool has_missing_normals = std::find(is_normal_missing.begin(), is_normal_missing.end(), true) != is_normal_missing.end();
+		if (has_missing_normals)
+		{
+			for (size_t index_idx = 0; index_idx + 2 < mesh.indices.size(); index_idx += 3)
+			{
+				const float* corners[3];
+				for (uint32_t corner_idx = 0; corner_idx < 3; ++corner_idx)
+				{
+					corners[corner_idx] = mesh.vertices[mesh.indices[index_idx + corner_idx]].position;
+				}
+				const float edges[2][3] = {
+					{ corners[1][0] - corners[0][0], corners[1][1] - corners[0][1], corners[1][2] - corners[0][2] },
+					{ corners[2][0] - corners[0][0], corners[2][1] - corners[0][1], corners[2][2] - corners[0][2] },
+				};
+				// Twice the area long
+				const float face_normal[3] = {
+					edges[0][1] * edges[1][2] - edges[0][2] * edges[1][1],
+					edges[0][2] * edges[1][0] - edges[0][0] * edges[1][2],
+					edges[0][0] * edges[1][1] - edges[0][1] * edges[1][0],
+				};
+				for (uint32_t corner_idx = 0; corner_idx < 3; ++corner_idx)
+				{
+					const uint32_t vertex_idx = mesh.indices[index_idx + corner_idx];
+					if (is_normal_missing[vertex_idx])
+					{
+						for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+						{
+							mesh.vertices[vertex_idx].normal[axis_idx] += face_normal[axis_idx];
+						}
+					}
+				}
+			}
+
+			for (size_t vertex_idx = 0; vertex_idx < mesh.vertices.size(); ++vertex_idx)
+			{
+				float (&normal)[3] = mesh.vertices[vertex_idx].normal;
+				const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+				if (is_normal_missing[vertex_idx] && length > 0.0f)
+				{
+					normal[0] /= length;
+					normal[1] /= length;
+					normal[2] /= length;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool write_mesh(const std::string& path, const MeshImport& mesh, std::string& error)
+	{
+		PROFILE_FUNCTION();
+
+		MeshHeader header;
+		header.vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+		header.index_count = static_cast<uint32_t>(mesh.indices.size());
+		header.submesh_count = static_cast<uint32_t>(mesh.submeshes.size());
+		header.index_size = mesh.vertices.size() <= 65536 ? 2 : 4;
+
+		float bounds_min[3] = { 0.0f, 0.0f, 0.0f };
+		float bounds_max[3] = { 0.0f, 0.0f, 0.0f };
+		if (!mesh.vertices.empty())
+		{
+			std::memcpy(bounds_min, mesh.vertices[0].position, sizeof(bounds_min));
+			std::memcpy(bounds_max, mesh.vertices[0].position, sizeof(bounds_max));
+		}
+		for (const auto& vertex : mesh.vertices)
+		{
+			for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+			{
+				bounds_min[axis_idx] = std::min(bounds_min[axis_idx], vertex.position[axis_idx]);
+				bounds_max[axis_idx] = std::max(bounds_max[axis_idx], vertex.position[axis_idx]);
+			}
+		}
+		for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+		{
+			header.position_offset[axis_idx] = bounds_min[axis_idx];
+			header.position_scale[axis_idx] = bounds_max[axis_idx] - bounds_min[axis_idx];
+		}
+
+		header.vertex_offset = align_up(sizeof(MeshHeader));
+		header.index_offset = align_up(header.vertex_offset + mesh.vertices.size() * sizeof(MeshVertex));
+		header.submesh_offset = align_up(header.index_offset + mesh.indices.size() * header.index_size);
+		header.meshlet_count = static_cast<uint32_t>(mesh.meshlets.size());
+		header.meshlet_vertex_count = static_cast<uint32_t>(mesh.meshlet_vertices.size());
+		header.meshlet_triangle_size = static_cast<uint32_t>(mesh.meshlet_triangles.size());
+		header.meshlet_offset = align_up(header.submesh_offset + mesh.submeshes.size() * sizeof(Submesh));
+		header.meshlet_vertex_offset = align_up(header.meshlet_offset + mesh.meshlets.size() * sizeof(Meshlet));
+		header.meshlet_triangle_offset = align_up(header.meshlet_vertex_offset + mesh.meshlet_vertices.size() * sizeof(uint32_t));
+		header.file_size = header.meshlet_triangle_offset + mesh.meshlet_triangles.size();
+
+		std::vector<uint8_t> data(header.file_size);
+		std::memcpy(data.data(), &header, sizeof(header));
+
+		auto* vertices = reinterpret_cast<MeshVertex*>(data.data() + header.vertex_offset);
+		for (size_t vertex_idx = 0; vertex_idx < mesh.vertices.size(); ++vertex_idx)
+		{
+			const ImportedVertex& source = mesh.vertices[vertex_idx];
+			MeshVertex& vertex = vertices[vertex_idx];
+			for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+			{
+				const float extent = header.position_scale[axis_idx];
+				const float unorm = extent > 0.0f ? (source.position[axis_idx] - bounds_min[axis_idx]) / extent : 0.0f;
+				vertex.position[axis_idx] = static_cast<uint16_t>(std::lround(std::clamp(unorm, 0.0f, 1.0f) * 65535.0f));
+			}
+			vertex.position[3] = 0;
+			encode_octahedral(source.normal, vertex.normal);
+			vertex.uv[0] = float_to_half(source.uv[0]);
+			vertex.uv[1] = float_to_half(source.uv[1]);
+		}
+
+		uint8_t* indices = data.data() + header.index_offset;
+		if (header.index_size == 2)
+		{
+			for (size_t index_idx = 0; index_idx < mesh.indices.size(); ++index_idx)
+			{
+				const auto index = static_cast<uint16_t>(mesh.indices[index_idx]);
+				std::memcpy(indices + index_idx * 2, &index, sizeof(index));
+			}
+		}
+		else
+		{
+			std::memcpy(indices, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+		}
+
+		auto* submeshes = reinterpret_cast<Submesh*>(data.data() + header.submesh_offset);
+		for (size_t submesh_idx = 0; submesh_idx < mesh.submeshes.size(); ++submesh_idx)
+		{
+			Submesh submesh = mesh.submeshes[submesh_idx];
+			for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+			{
+				submesh.bounds_min[axis_idx] = std::numeric_limits<float>::max();
+				submesh.bounds_max[axis_idx] = std::numeric_limits<float>::lowest();
+			}
+			for (uint32_t index_idx = submesh.first_index; index_idx < submesh.first_index + submesh.index_count; ++index_idx)
+			{
+				const float* position = mesh.vertices[mesh.indices[index_idx]].position;
+				for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+				{
+					submesh.bounds_min[axis_idx] = std::min(submesh.bounds_min[axis_idx], position[axis_idx]);
+					submesh.bounds_max[axis_idx] = std::max(submesh.bounds_max[axis_idx], position[axis_idx]);
+				}
+			}
+			if (submesh.index_count == 0)
+			{
+				std::fill(std::begin(submesh.bounds_min), std::end(submesh.bounds_min), 0.0f);
+				std::fill(std::begin(submesh.bounds_max), std::end(submesh.bounds_max), 0.0f);
+			}
+			submeshes[submesh_idx] = submesh;
+		}
+
+		std::copy(mesh.meshlets.begin(), mesh.meshlets.end(), reinterpret_cast<Meshlet*>(data.data() + header.meshlet_offset));
+		std::copy(mesh.meshlet_vertices.begin(), mesh.meshlet_vertices.end(), reinterpret_cast<uint32_t*>(data.data() + header.meshlet_vertex_offset));
+		std::copy(mesh.meshlet_triangles.begin(), mesh.meshlet_triangles.end(), data.data() + header.meshlet_triangle_offset);
+
+		std::ofstream file(path, std::ios::binary);
+		if (!file || !file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size())))
+		{
+			error = "Can not write " + path;
+			return false;
+		}
+		return true;
+	}
+
+}
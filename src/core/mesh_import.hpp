@@ -0,0 +1,43 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_MESH_IMPORT_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_MESH_IMPORT_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mesh.hpp"
+
+namespace Core
+{
+
+	struct ImportedVertex
+	{
+		float position[3];
+		float normal[3];
+		float uv[2];
+	};
+
+	// A triangle list as the importer produces it, before quantization
+	struct MeshImport
+	{
+		std::vector<ImportedVertex> vertices;
+		std::vector<uint32_t> indices;
+		// Only the index and meshlet ranges and materials, write_mesh() computes the bounds
+		std::vector<Submesh> submeshes;
+		// Empty until build_meshlets() fills them
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> meshlet_vertices;
+		std::vector<uint8_t> meshlet_triangles;
+	};
+
+	// v, vt, vn and f lines, polygons are fanned into triangles and negative indices count
+	// from the end. Every usemtl starts a submesh. Vertices without a normal in the file
+	// get the area weighted normal of their faces.
+	bool parse_obj(const std::string& path, MeshImport& mesh, std::string& error);
+
+	// Quantizes the vertices and writes a .mesh file, with 16 bit indices when they fit
+	bool write_mesh(const std::string& path, const MeshImport& mesh, std::string& error);
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_MESH_IMPORT_HPP
@@ -0,0 +1,435 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "profiler.hpp"
+
+namespace Core
+{
+
+	namespace
+	{
+		// Forsyth's simulated LRU cache and scoring constants
+		constexpr uint32_t scored_cache_size = 32;
+		constexpr uint32_t max_scored_valence = 32;
+		constexpr float cache_decay_power = 1.5f;
+		constexpr float last_triangle_score = 0.75f;
+		constexpr float valence_boost_scale = 2.0f;
+		constexpr float valence_boost_power = 0.5f;
+
+		constexpr uint32_t invalid_triangle = std::numeric_limits<uint32_t>::max();
+
+		struct VertexScoreTable
+		{
+			float cache[scored_cache_size];
+			float valence[max_scored_valence];
+
+			VertexScoreTable()
+			{
+				for (uint32_t position = 0; position < scored_cache_size; ++position)
+				{
+					// The three vertices of the last triangle score the same so that it is not
+					// favoured to reuse them in a particular order
+					cache[position] = position < 3
+						? last_triangle_score
+						: std::pow(1.0f - static_cast<float>(position - 3) / (scored_cache_size - 3), cache_decay_power);
+				}
+				valence[0] = 0.0f;
+				for (uint32_t count = 1; count < max_scored_valence; ++count)
+				{
+					valence[count] = valence_boost_scale * std::pow(static_cast<float>(count), -valence_boost_power);
+				}
+			}
+
+			// Vertices with few triangles left score high so that they are finished off first
+			float score(int32_t cache_position, uint32_t live_triangle_count) const
+			{
+				if (live_triangle_count == 0)
+				{
+					return -1.0f;
+				}
+				const float cache_score = cache_position >= 0 ? cache[cache_position] : 0.0f;
+				return cache_score + valence[std::min(live_triangle_count, max_scored_valence - 1)];
+			}
+		};
+
+		// Number of the triangle's vertices that miss the FIFO cache, the timestamps trick
+		// saves shifting the cache around
+		uint32_t update_fifo_cache(const uint32_t* triangle, uint32_t cache_size, std::vector<uint32_t>& timestamps, uint32_t& timestamp)
+		{
+			uint32_t miss_count = 0;
+			for (uint32_t corner_idx = 0; corner_idx < 3; ++corner_idx)
+			{
+				const uint32_t vertex_idx = triangle[corner_idx];
+				if (timestamp - timestamps[vertex_idx] > cache_size)
+				{
+					timestamps[vertex_idx] = timestamp++;
+					++miss_count;
+				}
+			}
+			return miss_count;
+		}
+
+		struct Cluster
+		{
+			uint32_t first_triangle;
+			uint32_t triangle_count;
+			float sort_key;
+		};
+	}
+
+	VertexCacheStats analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size)
+	{
+		VertexCacheStats stats;
+		const size_t triangle_count = index_count / 3;
+		if (triangle_count == 0)
+		{
+			return stats;
+		}
+
+		std::vector<uint32_t> timestamps(vertex_count, 0);
+		uint32_t timestamp = cache_size + 1;
+		for (size_t triangle_idx = 0; triangle_idx < triangle_count; ++triangle_idx)
+		{
+			stats.transformed_vertex_count += update_fifo_cache(indices + triangle_idx * 3, cache_size, timestamps, timestamp);
+		}
+
+		std::vector<bool> is_referenced(vertex_count, false);
+		size_t referenced_count = 0;
+		for (size_t index_idx = 0; index_idx < triangle_count * 3; ++index_idx)
+		{
+			if (!is_referenced[indices[index_idx]])
+			{
+				is_referenced[indices[index_idx]] = true;
+				++referenced_count;
+			}
+		}
+
+		stats.acmr = static_cast<float>(stats.transformed_vertex_count) / static_cast<float>(triangle_count);
+		stats.atvr = static_cast<float>(stats.transformed_vertex_count) / static_cast<float>(referenced_count);
+		return stats;
+	}
+
+	void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t vertex_count)
+	{
+		PROFILE_FUNCTION();
+
+		const size_t triangle_count = index_count / 3;
+		if (triangle_count == 0)
+		{
+			return;
+		}
+
+		static const VertexScoreTable table;
+
+		// The triangles of each vertex, the live ones are kept at the front of its range
+		std::vector<uint32_t> live_triangle_counts(vertex_count, 0);
+		for (size_t index_idx = 0; index_idx < triangle_count * 3; ++index_idx)
+		{
+			++live_triangle_counts[indices[index_idx]];
+		}
+		std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+		for (size_t vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx)
+		{
+			adjacency_offsets[vertex_idx + 1] = adjacency_offsets[vertex_idx] + live_triangle_counts[vertex_idx];
+		}
+		std::vector<uint32_t> adjacency(triangle_count * 3);
+		std::vector<uint32_t> fill_counts(vertex_count, 0);
+		for (size_t index_idx = 0; index_idx < triangle_count * 3; ++index_idx)
+		{
+			const uint32_t vertex_idx = indices[index_idx];
+			adjacency[adjacency_offsets[vertex_idx] + fill_counts[vertex_idx]++] = static_cast<uint32_t>(index_idx / 3);
+		}
+
+		std::vector<int32_t> cache_positions(vertex_count, -1);
+		std::vector<float> vertex_scores(vertex_count);
+		for (size_t vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx)
+		{
+			vertex_scores[vertex_idx] = table.score(-1, live_triangle_counts[vertex_idx]);
+		}
+		std::vector<float> triangle_scores(triangle_count);
+		uint32_t best_triangle = 0;
+		for (size_t triangle_idx = 0; triangle_idx < triangle_count; ++triangle_idx)
+		{
+			const uint32_t* triangle = indices + triangle_idx * 3;
+			triangle_scores[triangle_idx] = vertex_scores[triangle[0]] + vertex_scores[triangle[1]] + vertex_scores[triangle[2]];
+			if (triangle_scores[triangle_idx] > triangle_scores[best_triangle])
+			{
+				best_triangle = static_cast<uint32_t>(triangle_idx);
+			}
+		}
+
+		std::vector<bool> is_emitted(triangle_count, false);
+		std::vector<uint32_t> output(triangle_count * 3);
+		uint32_t cache[scored_cache_size + 3];
+		uint32_t cache_count = 0;
+		size_t input_cursor = 0;
+		for (size_t output_idx = 0; output_idx < triangle_count; ++output_idx)
+		{
+			if (best_triangle == invalid_triangle)
+			{
+				// Nothing left around the cache, continue with the next triangle of the input
+				while (is_emitted[input_cursor])
+				{
+					++input_cursor;
+				}
+				best_triangle = static_cast<uint32_t>(input_cursor);
+			}
+
+			const uint32_t* triangle = indices + static_cast<size_t>(best_triangle) * 3;
+			std::memcpy(&output[output_idx * 3], triangle, 3 * sizeof(uint32_t));
+			is_emitted[best_triangle] = true;
+
+			for (uint32_t corner_idx = 0; corner_idx < 3; ++corner_idx)
+			{
+				const uint32_t vertex_idx = triangle[corner_idx];
+				uint32_t* live_begin = &adjacency[adjacency_offsets[vertex_idx]];
+				uint32_t* live_end = live_begin + live_triangle_counts[vertex_idx];
+				std::iter_swap(std::find(live_begin, live_end, best_triangle), live_end - 1);
+				--live_triangle_counts[vertex_idx];
+			}
+
+			// The triangle's vertices move to the front, whatever falls off the end is evicted
+			uint32_t new_cache[scored_cache_size + 3];
+			uint32_t new_cache_count = 0;
+			for (uint32_t corner_idx = 0; corner_idx < 3; ++corner_idx)
+			{
+				if (std::find(new_cache, new_cache + new_cache_count, triangle[corner_idx]) == new_cache + new_cache_count)
+				{
+					new_cache[new_cache_count++] = triangle[corner_idx];
+				}
+			}
+			for (uint32_t cache_idx = 0; cache_idx < cache_count; ++cache_idx)
+			{
+				if (std::find(triangle, triangle + 3, cache[cache_idx]) == triangle + 3)
+				{
+					new_cache[new_cache_count++] = cache[cache_idx];
+				}
+			}
+
+			for (uint32_t cache_idx = 0; cache_idx < new_cache_count; ++cache_idx)
+			{
+				const uint32_t vertex_idx = new_cache[cache_idx];
+				cache_positions[vertex_idx] = cache_idx < scored_cache_size ? static_cast<int32_t>(cache_idx) : -1;
+				const float score = table.score(cache_positions[vertex_idx], live_triangle_counts[vertex_idx]);
+				const float score_change = score - vertex_scores[vertex_idx];
+				vertex_scores[vertex_idx] = score;
+
+				const uint32_t* live_triangles = &adjacency[adjacency_offsets[vertex_idx]];
+				for (uint32_t live_idx = 0; live_idx < live_triangle_counts[vertex_idx]; ++live_idx)
+				{
+					triangle_scores[live_triangles[live_idx]] += score_change;
+				}
+			}
+			cache_count = std::min(new_cache_count, scored_cache_size);
+			std::copy(new_cache, new_cache + cache_count, cache);
+
+			// Only the triangles around the cache changed score, the best one is among them
+			best_triangle = invalid_triangle;
+			float best_score = -std::numeric_limits<float>::max();
+			for (uint32_t cache_idx = 0; cache_idx < cache_count; ++cache_idx)
+			{
+				const uint32_t vertex_idx = cache[cache_idx];
+				const uint32_t* live_triangles = &adjacency[adjacency_offsets[vertex_idx]];
+				for (uint32_t live_idx = 0; live_idx < live_triangle_counts[vertex_idx]; ++live_idx)
+				{
+					if (triangle_scores[live_triangles[live_idx]] > best_score)
+					{
+						best_score = triangle_scores[live_triangles[live_idx]];
+						best_triangle = live_triangles[live_idx];
+					}
+				}
+			}
+		}
+
+		std::copy(output.begin(), output.end(), indices);
+	}
+
+	void optimize_overdraw(uint32_t* indices, size_t index_count, const std::vector<ImportedVertex>& vertices, float threshold)
+	{
+		PROFILE_FUNCTION();
+
+		const size_t triangle_count = index_count / 3;
+		if (triangle_count == 0)
+		{
+			return;
+		}
+
+		std::vector<uint32_t> timestamps(vertices.size(), 0);
+		uint32_t timestamp = post_transform_cache_size + 1;
+		const auto reset_cache = [&timestamp]()
+		{
+			timestamp += post_transform_cache_size + 1;
+		};
+
+		// A triangle missing on all three vertices usually starts a new patch of the mesh
+		std::vector<uint32_t> patch_starts;
+		for (size_t triangle_idx = 0; triangle_idx < triangle_count; ++triangle_idx)
+		{
+			const uint32_t miss_count = update_fifo_cache(indices + triangle_idx * 3, post_transform_cache_size, timestamps, timestamp);
+			if (triangle_idx == 0 || miss_count == 3)
+			{
+				patch_starts.push_back(static_cast<uint32_t>(triangle_idx));
+			}
+		}
+		patch_starts.push_back(static_cast<uint32_t>(triangle_count));
+
+		// Patches are cut into clusters as soon as the ACMR since the last cut, with a cold
+		// cache, gets within the threshold of the patch's
+		std::vector<uint32_t> cluster_starts;
+		for (size_t patch_idx = 0; patch_idx + 1 < patch_starts.size(); ++patch_idx)
+		{
+			const uint32_t patch_begin = patch_starts[patch_idx];
+			const uint32_t patch_end = patch_starts[patch_idx + 1];
+
+			reset_cache();
+			uint32_t patch_miss_count = 0;
+			for (uint32_t triangle_idx = patch_begin; triangle_idx < patch_end; ++triangle_idx)
+			{
+				patch_miss_count += update_fifo_cache(indices + static_cast<size_t>(triangle_idx) * 3, post_transform_cache_size, timestamps, timestamp);
+			}
+			const float target_acmr = threshold * static_cast<float>(patch_miss_count) / static_cast<float>(patch_end - patch_begin);
+
+			reset_cache();
+			cluster_starts.push_back(patch_begin);
+			uint32_t miss_count = 0;
+			uint32_t cluster_triangle_count = 0;
+			for (uint32_t triangle_idx = patch_begin; triangle_idx < patch_end; ++triangle_idx)
+			{
+				miss_count += update_fifo_cache(indices + static_cast<size_t>(triangle_idx) * 3, post_transform_cache_size, timestamps, timestamp);
+				++cluster_triangle_count;
+				if (static_cast<float>(miss_count) <= target_acmr * static_cast<float>(cluster_triangle_count) && triangle_idx + 1 < patch_end)
+				{
+					cluster_starts.push_back(triangle_idx + 1);
+					reset_cache();
+					miss_count = 0;
+					cluster_triangle_count = 0;
+				}
+			}
+
+			// A last cluster that never got there is merged into the one before
+			const bool is_last_cluster_bad = static_cast<float>(miss_count) > target_acmr * static_cast<float>(cluster_triangle_count);
+			if (is_last_cluster_bad && cluster_starts.back() != patch_begin)
+			{
+				cluster_starts.pop_back();
+			}
+		}
+		cluster_starts.push_back(static_cast<uint32_t>(triangle_count));
+
+		// Area weighted centroids and normals of the clusters and of the whole list
+		std::vector<Cluster> clusters(cluster_starts.size() - 1);
+		std::vector<float> cluster_data(clusters.size() * 6, 0.0f);
+		float mesh_centroid[3] = { 0.0f, 0.0f, 0.0f };
+		float mesh_area = 0.0f;
+		for (size_t cluster_idx = 0; cluster_idx < clusters.size(); ++cluster_idx)
+		{
+			Cluster& cluster = clusters[cluster_idx];
+			cluster.first_triangle = cluster_starts[cluster_idx];
+			cluster.triangle_count = cluster_starts[cluster_idx + 1] - cluster.first_triangle;
+
+			float* centroid = &cluster_data[cluster_idx * 6];
+			float* normal = centroid + 3;
+			float cluster_area = 0.0f;
+			for (uint32_t triangle_idx = cluster.first_triangle; triangle_idx < cluster.first_triangle + cluster.triangle_count; ++triangle_idx)
+			{
+				const uint32_t* triangle = indices + static_cast<size_t>(triangle_idx) * 3;
+				const float* corners[3] = {
+					vertices[triangle[0]].position,
+					vertices[triangle[1]].position,
+					vertices[triangle[2]].position,
+				};
+				const float edges[2][3] = {
+					{ corners[1][0] - corners[0][0], corners[1][1] - corners[0][1], corners[1][2] - corners[0][2] },
+					{ corners[2][0] - corners[0][0], corners[2][1] - corners[0][1], corners[2][2] - corners[0][2] },
+				};
+				// Twice the area long
+				const float face_normal[3] = {
+					edges[0][1] * edges[1][2] - edges[0][2] * edges[1][1],
+					edges[0][2] * edges[1][0] - edges[0][0] * edges[1][2],
+					edges[0][0] * edges[1][1] - edges[0][1] * edges[1][0],
+				};
+				const float area = std::sqrt(face_normal[0] * face_normal[0] + face_normal[1] * face_normal[1] + face_normal[2] * face_normal[2]);
+				for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+				{
+					centroid[axis_idx] += (corners[0][axis_idx] + corners[1][axis_idx] + corners[2][axis_idx]) / 3.0f * area;
+					normal[axis_idx] += face_normal[axis_idx];
+				}
+				cluster_area += area;
+			}
+
+			for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+			{
+				mesh_centroid[axis_idx] += centroid[axis_idx];
+				centroid[axis_idx] = cluster_area > 0.0f ? centroid[axis_idx] / cluster_area : 0.0f;
+			}
+			mesh_area += cluster_area;
+		}
+		for (float& coordinate : mesh_centroid)
+		{
+			coordinate = mesh_area > 0.0f ? coordinate / mesh_area : 0.0f;
+		}
+
+		// Clusters far out along their normal occlude the rest from most directions
+		for (size_t cluster_idx = 0; cluster_idx < clusters.size(); ++cluster_idx)
+		{
+			const float* centroid = &cluster_data[cluster_idx * 6];
+			const float* normal = centroid + 3;
+			const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			float distance = 0.0f;
+			for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+			{
+				distance += (centroid[axis_idx] - mesh_centroid[axis_idx]) * normal[axis_idx];
+			}
+			clusters[cluster_idx].sort_key = length > 0.0f ? distance / length : 0.0f;
+		}
+		std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& left, const Cluster& right)
+		{
+			return left.sort_key > right.sort_key;
+		});
+
+		std::vector<uint32_t> output;
+		output.reserve(triangle_count * 3);
+		for (const Cluster& cluster : clusters)
+		{
+			const uint32_t* begin = indices + static_cast<size_t>(cluster.first_triangle) * 3;
+			output.insert(output.end(), begin, begin + static_cast<size_t>(cluster.triangle_count) * 3);
+		}
+		std::copy(output.begin(), output.end(), indices);
+	}
+
+	void optimize_vertex_fetch(MeshImport& mesh)
+	{
+		PROFILE_FUNCTION();
+
+		std::vector<uint32_t> remap(mesh.vertices.size(), std::numeric_limits<uint32_t>::max());
+		std::vector<ImportedVertex> vertices;
+		vertices.reserve(mesh.vertices.size());
+		for (uint32_t& index : mesh.indices)
+		{
+			if (remap[index] == std::numeric_limits<uint32_t>::max())
+			{
+				remap[index] = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(mesh.vertices[index]);
+			}
+			index = remap[index];
+		}
+		mesh.vertices.swap(vertices);
+	}
+
+	void optimize_mesh(MeshImport& mesh, float overdraw_threshold)
+	{
+		PROFILE_FUNCTION();
+
+		for (const Submesh& submesh : mesh.submeshes)
+		{
+			uint32_t* indices = mesh.indices.data() + submesh.first_index;
+			optimize_vertex_cache(indices, submesh.index_count, mesh.vertices.size());
+			optimize_overdraw(indices, submesh.index_count, mesh.vertices, overdraw_threshold);
+		}
+		optimize_vertex_fetch(mesh);
+	}
+
+}
@@ -0,0 +1,45 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_MESH_OPTIMIZER_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_MESH_OPTIMIZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh_import.hpp"
+
+namespace Core
+{
+
+	// The FIFO post-transform cache the statistics and the overdraw clusters are measured with
+	constexpr uint32_t post_transform_cache_size = 16;
+
+	struct VertexCacheStats
+	{
+		uint32_t transformed_vertex_count = 0;
+		// Vertices transformed per triangle, 0.5 at best for a regular grid and 3 at worst
+		float acmr = 0.0f;
+		// Vertices transformed per vertex referenced, 1 at best
+		float atvr = 0.0f;
+	};
+
+	VertexCacheStats analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size = post_transform_cache_size);
+
+	// Reorders the triangles of a triangle list for the post-transform cache, Tom Forsyth's
+	// linear-speed vertex cache optimisation
+	void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t vertex_count);
+
+	// Reorders clusters of an optimize_vertex_cache() ordered list so that outward facing ones
+	// come first, after Sander et al., "Fast Triangle Reordering for Vertex Locality and
+	// Reduced Overdraw". Clusters are split as long as the ACMR stays within threshold times
+	// the one of the input.
+	void optimize_overdraw(uint32_t* indices, size_t index_count, const std::vector<ImportedVertex>& vertices, float threshold);
+
+	// Renumbers the vertices in the order the indices first use them and drops unused ones
+	void optimize_vertex_fetch(MeshImport& mesh);
+
+	// All of the above, the cache and overdraw passes run on each submesh on its own
+	void optimize_mesh(MeshImport& mesh, float overdraw_threshold = 1.05f);
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_MESH_OPTIMIZER_HPP
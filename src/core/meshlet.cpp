@@ -0,0 +1,554 @@
+#include "meshlet.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "profiler.hpp"
+
+namespace Core
+{
+
+	namespace
+	{
+		constexpr uint8_t unused_local_vertex = 0xff;
+		constexpr uint32_t invalid_triangle = std::numeric_limits<uint32_t>::max();
+		// How much a triangle turned away from the meshlet's normal counts against it, next to
+		// its distance from the meshlet
+		constexpr float cone_weight = 0.5f;
+		// Below this the triangles face too many ways for a cone to ever cull the meshlet
+		constexpr float min_cone_dot = 0.1f;
+
+		float dot(const float* left, const float* right)
+		{
+			return left[0] * right[0] + left[1] * right[1] + left[2] * right[2];
+		}
+
+		void cross(const float* left, const float* right, float* result)
+		{
+			result[0] = left[1] * right[2] - left[2] * right[1];
+			result[1] = left[2] * right[0] - left[0] * right[2];
+			result[2] = left[0] * right[1] - left[1] * right[0];
+		}
+
+		// Zero stays zero
+		void normalize(float* vector)
+		{
+			const float length = std::sqrt(dot(vector, vector));
+			if (length > 0.0f)
+			{
+				vector[0] /= length;
+				vector[1] /= length;
+				vector[2] /= length;
+			}
+		}
+
+		float squared_distance(const float* left, const float* right)
+		{
+			const float offset[3] = { left[0] - right[0], left[1] - right[1], left[2] - right[2] };
+			return dot(offset, offset);
+		}
+
+		float distance(const float* left, const float* right)
+		{
+			return std::sqrt(squared_distance(left, right));
+		}
+
+		// Unit normal, zero for degenerate triangles
+		void triangle_normal(const float* corner0, const float* corner1, const float* corner2, float* normal)
+		{
+			const float edge0[3] = { corner1[0] - corner0[0], corner1[1] - corner0[1], corner1[2] - corner0[2] };
+			const float edge1[3] = { corner2[0] - corner0[0], corner2[1] - corner0[1], corner2[2] - corner0[2] };
+			cross(edge0, edge1, normal);
+			normalize(normal);
+		}
+
+		// Ritter's sphere: the two furthest apart of the extreme points along the axes, grown
+		// over the rest
+		void compute_bounding_sphere(const MeshImport& mesh, const uint32_t* vertices, uint32_t vertex_count, Meshlet& meshlet)
+		{
+			uint32_t extremes[3][2] = {};
+			for (uint32_t vertex_idx = 1; vertex_idx < vertex_count; ++vertex_idx)
+			{
+				const float* position = mesh.vertices[vertices[vertex_idx]].position;
+				for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+				{
+					if (position[axis_idx] < mesh.vertices[vertices[extremes[axis_idx][0]]].position[axis_idx])
+					{
+						extremes[axis_idx][0] = vertex_idx;
+					}
+					if (position[axis_idx] > mesh.vertices[vertices[extremes[axis_idx][1]]].position[axis_idx])
+					{
+						extremes[axis_idx][1] = vertex_idx;
+					}
+				}
+			}
+
+			uint32_t widest_axis = 0;
+			float widest_span = -1.0f;
+			for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+			{
+				const float span = distance(mesh.vertices[vertices[extremes[axis_idx][0]]].position, mesh.vertices[vertices[extremes[axis_idx][1]]].position);
+				if (span > widest_span)
+				{
+					widest_axis = axis_idx;
+					widest_span = span;
+				}
+			}
+
+			const float* first = mesh.vertices[vertices[extremes[widest_axis][0]]].position;
+			const float* second = mesh.vertices[vertices[extremes[widest_axis][1]]].position;
+			float center[3] = { (first[0] + second[0]) * 0.5f, (first[1] + second[1]) * 0.5f, (first[2] + second[2]) * 0.5f };
+			float radius = widest_span * 0.5f;
+			for (uint32_t vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx)
+			{
+				const float* position = mesh.vertices[vertices[vertex_idx]].position;
+				const float point_distance = distance(position, center);
+				if (point_distance > radius)
+				{
+					const float grown_radius = (radius + point_distance) * 0.5f;
+					const float shift = (grown_radius - radius) / point_distance;
+					for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+					{
+						center[axis_idx] += (position[axis_idx] - center[axis_idx]) * shift;
+					}
+					radius = grown_radius;
+				}
+			}
+
+			std::copy(center, center + 3, meshlet.center);
+			meshlet.radius = radius;
+		}
+
+		// The cone axis is the average normal, its apex sits behind every triangle plane so
+		// that a camera in the cone sees the back of all of them
+		void compute_normal_cone(const MeshImport& mesh, const uint32_t* vertices, const uint8_t* triangles, uint32_t triangle_count, Meshlet& meshlet)
+		{
+			float normals[Meshlet::max_triangles * 3];
+			float axis[3] = { 0.0f, 0.0f, 0.0f };
+			for (uint32_t triangle_idx = 0; triangle_idx < triangle_count; ++triangle_idx)
+			{
+				const uint8_t* triangle = triangles + triangle_idx * 3;
+				float* normal = &normals[triangle_idx * 3];
+				triangle_normal(
+					mesh.vertices[vertices[triangle[0]]].position,
+					mesh.vertices[vertices[triangle[1]]].position,
+					mesh.vertices[vertices[triangle[2]]].position,
+					normal);
+				axis[0] += normal[0];
+				axis[1] += normal[1];
+				axis[2] += normal[2];
+			}
+			normalize(axis);
+
+			// Degenerate triangles have no normal and never show up, they are left out
+			const auto is_degenerate = [&normals](uint32_t triangle_idx)
+			{
+				return dot(&normals[triangle_idx * 3], &normals[triangle_idx * 3]) == 0.0f;
+			};
+			float min_dot = 1.0f;
+			for (uint32_t triangle_idx = 0; triangle_idx < triangle_count; ++triangle_idx)
+			{
+				if (!is_degenerate(triangle_idx))
+				{
+					min_dot = std::min(min_dot, dot(&normals[triangle_idx * 3], axis));
+				}
+			}
+
+			std::copy(axis, axis + 3, meshlet.cone_axis);
+			if (min_dot <= min_cone_dot)
+			{
+				std::copy(meshlet.center, meshlet.center + 3, meshlet.cone_apex);
+				meshlet.cone_cutoff = 1.0f;
+				return;
+			}
+
+			float apex_distance = 0.0f;
+			for (uint32_t triangle_idx = 0; triangle_idx < triangle_count; ++triangle_idx)
+			{
+				if (is_degenerate(triangle_idx))
+				{
+					continue;
+				}
+				const float* normal = &normals[triangle_idx * 3];
+				const float* corner = mesh.vertices[vertices[triangles[triangle_idx * 3]]].position;
+				const float to_center[3] = { meshlet.center[0] - corner[0], meshlet.center[1] - corner[1], meshlet.center[2] - corner[2] };
+				apex_distance = std::max(apex_distance, dot(to_center, normal) / dot(axis, normal));
+			}
+			for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+			{
+				meshlet.cone_apex[axis_idx] = meshlet.center[axis_idx] - axis[axis_idx] * apex_distance;
+			}
+			// The sine of the widest angle between a normal and the axis
+			meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+		}
+
+		// Greedily grows a meshlet from a seed triangle with the neighbouring triangle that
+		// adds the fewest vertices, the closest and most aligned one among equals. A meshlet
+		// is done when it is full or nothing connected fits anymore.
+		class MeshletBuilder
+		{
+		public:
+			explicit MeshletBuilder(MeshImport& mesh) :
+				m_mesh(mesh),
+				m_local_vertices(mesh.vertices.size(), unused_local_vertex),
+				m_live_triangle_counts(mesh.vertices.size()),
+				m_adjacency_offsets(mesh.vertices.size() + 1)
+			{
+			}
+
+			void build(uint32_t first_index, uint32_t index_count)
+			{
+				m_indices = m_mesh.indices.data() + first_index;
+				const uint32_t triangle_count = index_count / 3;
+
+				std::fill(m_live_triangle_counts.begin(), m_live_triangle_counts.end(), 0);
+				for (uint32_t index_idx = 0; index_idx < triangle_count * 3; ++index_idx)
+				{
+					++m_live_triangle_counts[m_indices[index_idx]];
+				}
+				for (size_t vertex_idx = 0; vertex_idx < m_mesh.vertices.size(); ++vertex_idx)
+				{
+					m_adjacency_offsets[vertex_idx + 1] = m_adjacency_offsets[vertex_idx] + m_live_triangle_counts[vertex_idx];
+				}
+				m_adjacency.resize(triangle_count * 3);
+				std::vector<uint32_t> fill_counts(m_mesh.vertices.size(), 0);
+				for (uint32_t index_idx = 0; index_idx < triangle_count * 3; ++index_idx)
+				{
+					const uint32_t vertex_idx = m_indices[index_idx];
+					m_adjacency[m_adjacency_offsets[vertex_idx] + fill_counts[vertex_idx]++] = index_idx / 3;
+				}
+
+				m_triangle_data.resize(triangle_count * 6);
+				for (uint32_t triangle_idx = 0; triangle_idx < triangle_count; ++triangle_idx)
+				{
+					const float* corners[3] = {
+						m_mesh.vertices[m_indices[triangle_idx * 3]].position,
+						m_mesh.vertices[m_indices[triangle_idx * 3 + 1]].position,
+						m_mesh.vertices[m_indices[triangle_idx * 3 + 2]].position,
+					};
+					float* centroid = &m_triangle_data[triangle_idx * 6];
+					for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+					{
+						centroid[axis_idx] = (corners[0][axis_idx] + corners[1][axis_idx] + corners[2][axis_idx]) / 3.0f;
+					}
+					triangle_normal(corners[0], corners[1], corners[2], centroid + 3);
+				}
+				m_is_emitted.assign(triangle_count, false);
+				m_last_vertices.clear();
+
+				uint32_t input_cursor = 0;
+				uint32_t emitted_count = 0;
+				while (emitted_count < triangle_count)
+				{
+					uint32_t triangle_idx = find_next_triangle();
+					if (triangle_idx == invalid_triangle)
+					{
+						if (!m_vertices.empty())
+						{
+							flush();
+							continue;
+						}
+						triangle_idx = find_seed_triangle();
+					}
+					if (triangle_idx == invalid_triangle)
+					{
+						// Nothing left next to the last meshlet, go on where the (cache optimized) input does
+						while (m_is_emitted[input_cursor])
+						{
+							++input_cursor;
+						}
+						triangle_idx = input_cursor;
+					}
+
+					add_triangle(triangle_idx);
+					++emitted_count;
+					if (m_triangles.size() / 3 == Meshlet::max_triangles)
+					{
+						flush();
+					}
+				}
+				flush();
+			}
+		private:
+			uint32_t count_new_vertices(const uint32_t* triangle) const
+			{
+				uint32_t new_count = 0;
+				for (uint32_t corner_idx = 0; corner_idx < 3; ++corner_idx)
+				{
+					const bool is_repeated = (corner_idx > 0 && triangle[corner_idx] == triangle[0]) || (corner_idx > 1 && triangle[corner_idx] == triangle[1]);
+					if (m_local_vertices[triangle[corner_idx]] == unused_local_vertex && !is_repeated)
+					{
+						++new_count;
+					}
+				}
+				return new_count;
+			}
+
+			uint32_t find_next_triangle() const
+			{
+				float center[3] = { 0.0f, 0.0f, 0.0f };
+				float normal[3] = { m_normal_sum[0], m_normal_sum[1], m_normal_sum[2] };
+				const auto meshlet_triangle_count = static_cast<float>(m_triangles.size() / 3);
+				for (uint32_t axis_idx = 0; axis_idx < 3 && meshlet_triangle_count > 0.0f; ++axis_idx)
+				{
+					center[axis_idx] = m_centroid_sum[axis_idx] / meshlet_triangle_count;
+				}
+				normalize(normal);
+
+				uint32_t best_triangle = invalid_triangle;
+				uint32_t best_priority = 4;
+				float best_score = std::numeric_limits<float>::max();
+				for (const uint32_t vertex_idx : m_vertices)
+				{
+					const uint32_t* live_triangles = &m_adjacency[m_adjacency_offsets[vertex_idx]];
+					for (uint32_t live_idx = 0; live_idx < m_live_triangle_counts[vertex_idx]; ++live_idx)
+					{
+						const uint32_t triangle_idx = live_triangles[live_idx];
+						const uint32_t* triangle = m_indices + static_cast<size_t>(triangle_idx) * 3;
+						const uint32_t new_count = count_new_vertices(triangle);
+						if (m_vertices.size() + new_count > Meshlet::max_vertices)
+						{
+							continue;
+						}
+						// Leaving the last triangle of a vertex behind would strand it
+						const bool is_finishing = m_live_triangle_counts[triangle[0]] == 1 || m_live_triangle_counts[triangle[1]] == 1 || m_live_triangle_counts[triangle[2]] == 1;
+						const uint32_t priority = is_finishing ? 0 : new_count;
+						if (priority > best_priority)
+						{
+							continue;
+						}
+
+						const float* triangle_data = &m_triangle_data[static_cast<size_t>(triangle_idx) * 6];
+						const float spread = 1.0f - dot(triangle_data + 3, normal);
+						// Squared, which orders the same without the square root
+						const float weight = 1.0f + cone_weight * spread;
+						const float score = squared_distance(triangle_data, center) * weight * weight;
+						if (priority < best_priority || score < best_score)
+						{
+							best_triangle = triangle_idx;
+							best_priority = priority;
+							best_score = score;
+						}
+					}
+				}
+				return best_triangle;
+			}
+
+			// Of the triangles around the last meshlet the one with the fewest live neighbours,
+			// so that meshlets are started from corners instead of leaving islands behind
+			uint32_t find_seed_triangle() const
+			{
+				uint32_t best_triangle = invalid_triangle;
+				uint32_t best_live_count = std::numeric_limits<uint32_t>::max();
+				for (const uint32_t vertex_idx : m_last_vertices)
+				{
+					const uint32_t* live_triangles = &m_adjacency[m_adjacency_offsets[vertex_idx]];
+					for (uint32_t live_idx = 0; live_idx < m_live_triangle_counts[vertex_idx]; ++live_idx)
+					{
+						const uint32_t* triangle = m_indices + static_cast<size_t>(live_triangles[live_idx]) * 3;
+						const uint32_t live_count = m_live_triangle_counts[triangle[0]] + m_live_triangle_counts[triangle[1]] + m_live_triangle_counts[triangle[2]];
+						if (live_count < best_live_count)
+						{
+							best_triangle = live_triangles[live_idx];
+							best_live_count = live_count;
+						}
+					}
+				}
+				return best_triangle;
+			}
+
+			void add_triangle(uint32_t triangle_idx)
+			{
+				const uint32_t* triangle = m_indices + static_cast<size_t>(triangle_idx) * 3;
+				for (uint32_t corner_idx = 0; corner_idx < 3; ++corner_idx)
+				{
+					const uint32_t vertex_idx = triangle[corner_idx];
+					if (m_local_vertices[vertex_idx] == unused_local_vertex)
+					{
+						m_local_vertices[vertex_idx] = static_cast<uint8_t>(m_vertices.size());
+						m_vertices.push_back(vertex_idx);
+					}
+					m_triangles.push_back(m_local_vertices[vertex_idx]);
+
+					uint32_t* live_begin = &m_adjacency[m_adjacency_offsets[vertex_idx]];
+					uint32_t* live_end = live_begin + m_live_triangle_counts[vertex_idx];
+					std::iter_swap(std::find(live_begin, live_end, triangle_idx), live_end - 1);
+					--m_live_triangle_counts[vertex_idx];
+				}
+				m_is_emitted[triangle_idx] = true;
+
+				const float* triangle_data = &m_triangle_data[static_cast<size_t>(triangle_idx) * 6];
+				for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+				{
+					m_centroid_sum[axis_idx] += triangle_data[axis_idx];
+					m_normal_sum[axis_idx] += triangle_data[3 + axis_idx];
+				}
+			}
+
+			void flush()
+			{
+				if (m_triangles.empty())
+				{
+					return;
+				}
+
+				Meshlet meshlet;
+				meshlet.vertex_offset = static_cast<uint32_t>(m_mesh.meshlet_vertices.size());
+				meshlet.triangle_offset = static_cast<uint32_t>(m_mesh.meshlet_triangles.size());
+				meshlet.vertex_count = static_cast<uint32_t>(m_vertices.size());
+				meshlet.triangle_count = static_cast<uint32_t>(m_triangles.size() / 3);
+				m_mesh.meshlet_vertices.insert(m_mesh.meshlet_vertices.end(), m_vertices.begin(), m_vertices.end());
+				m_mesh.meshlet_triangles.insert(m_mesh.meshlet_triangles.end(), m_triangles.begin(), m_triangles.end());
+				m_mesh.meshlet_triangles.resize((m_mesh.meshlet_triangles.size() + 3) & ~static_cast<size_t>(3), 0);
+
+				compute_bounding_sphere(m_mesh, m_vertices.data(), meshlet.vertex_count, meshlet);
+				compute_normal_cone(m_mesh, m_vertices.data(), m_triangles.data(), meshlet.triangle_count, meshlet);
+				m_mesh.meshlets.push_back(meshlet);
+
+				for (const uint32_t vertex_idx : m_vertices)
+				{
+					m_local_vertices[vertex_idx] = unused_local_vertex;
+				}
+				m_last_vertices.swap(m_vertices);
+				m_vertices.clear();
+				m_triangles.clear();
+				std::fill(std::begin(m_centroid_sum), std::end(m_centroid_sum), 0.0f);
+				std::fill(std::begin(m_normal_sum), std::end(m_normal_sum), 0.0f);
+			}
+
+			MeshImport& m_mesh;
+			const uint32_t* m_indices = nullptr;
+			// Index into the meshlet being built, unused_local_vertex when not in it
+			std::vector<uint8_t> m_local_vertices;
+			// Triangles of each vertex that are not in a meshlet yet are at the front of its range
+			std::vector<uint32_t> m_live_triangle_counts;
+			std::vector<uint32_t> m_adjacency_offsets;
+			std::vector<uint32_t> m_adjacency;
+			// Centroid and unit normal of each triangle
+			std::vector<float> m_triangle_data;
+			std::vector<bool> m_is_emitted;
+
+			std::vector<uint32_t> m_vertices;
+			std::vector<uint8_t> m_triangles;
+			// Of the meshlet flushed last, where the next one is seeded
+			std::vector<uint32_t> m_last_vertices;
+			float m_centroid_sum[3] = {};
+			float m_normal_sum[3] = {};
+		};
+
+		bool is_outside_frustum(const Meshlet& meshlet, const MeshletCullView& view)
+		{
+			for (const auto& plane : view.planes)
+			{
+				if (dot(plane, meshlet.center) + plane[3] < -meshlet.radius)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool is_facing_away(const Meshlet& meshlet, const MeshletCullView& view)
+		{
+			if (meshlet.cone_cutoff >= 1.0f)
+			{
+				return false;
+			}
+			const float to_apex[3] = {
+				meshlet.cone_apex[0] - view.camera_position[0],
+				meshlet.cone_apex[1] - view.camera_position[1],
+				meshlet.cone_apex[2] - view.camera_position[2],
+			};
+			return dot(to_apex, meshlet.cone_axis) >= meshlet.cone_cutoff * std::sqrt(dot(to_apex, to_apex));
+		}
+	}
+
+	void build_meshlets(MeshImport& mesh)
+	{
+		PROFILE_FUNCTION();
+
+		mesh.meshlets.clear();
+		mesh.meshlet_vertices.clear();
+		mesh.meshlet_triangles.clear();
+
+		MeshletBuilder builder(mesh);
+		for (Submesh& submesh : mesh.submeshes)
+		{
+			submesh.first_meshlet = static_cast<uint32_t>(mesh.meshlets.size());
+			builder.build(submesh.first_index, submesh.index_count);
+			submesh.meshlet_count = static_cast<uint32_t>(mesh.meshlets.size()) - submesh.first_meshlet;
+		}
+	}
+
+	MeshletCullView make_meshlet_cull_view(
+		const float (&position)[3],
+		const float (&forward)[3],
+		const float (&up)[3],
+		float vertical_fov,
+		float aspect_ratio,
+		float near_z,
+		float far_z)
+	{
+		float unit_forward[3] = { forward[0], forward[1], forward[2] };
+		normalize(unit_forward);
+		float right[3];
+		cross(unit_forward, up, right);
+		normalize(right);
+		float unit_up[3];
+		cross(right, unit_forward, unit_up);
+
+		const float tan_vertical = std::tan(vertical_fov * 0.5f);
+		const float tan_horizontal = tan_vertical * aspect_ratio;
+		// Inward normals in the order near, far, left, right, bottom, top. The side planes
+		// contain the camera position and the frustum edges at distance 1.
+		MeshletCullView view = {};
+		for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+		{
+			view.planes[0][axis_idx] = unit_forward[axis_idx];
+			view.planes[1][axis_idx] = -unit_forward[axis_idx];
+			view.planes[2][axis_idx] = unit_forward[axis_idx] * tan_horizontal + right[axis_idx];
+			view.planes[3][axis_idx] = unit_forward[axis_idx] * tan_horizontal - right[axis_idx];
+			view.planes[4][axis_idx] = unit_forward[axis_idx] * tan_vertical + unit_up[axis_idx];
+			view.planes[5][axis_idx] = unit_forward[axis_idx] * tan_vertical - unit_up[axis_idx];
+			view.camera_position[axis_idx] = position[axis_idx];
+		}
+		view.planes[0][3] = -dot(unit_forward, position) - near_z;
+		view.planes[1][3] = dot(unit_forward, position) + far_z;
+		for (uint32_t side_idx = 0; side_idx < 4; ++side_idx)
+		{
+			float* plane = view.planes[2 + side_idx];
+			normalize(plane);
+			plane[3] = -dot(plane, position);
+		}
+		return view;
+	}
+
+	bool is_meshlet_visible(const Meshlet& meshlet, const MeshletCullView& view)
+	{
+		return !is_outside_frustum(meshlet, view) && !is_facing_away(meshlet, view);
+	}
+
+	MeshletCullStats cull_meshlets(const Meshlet* meshlets, uint32_t meshlet_count, const MeshletCullView& view, uint32_t* visible_meshlets)
+	{
+		MeshletCullStats stats;
+		for (uint32_t meshlet_idx = 0; meshlet_idx < meshlet_count; ++meshlet_idx)
+		{
+			if (is_outside_frustum(meshlets[meshlet_idx], view))
+			{
+				++stats.frustum_culled_count;
+			}
+			else if (is_facing_away(meshlets[meshlet_idx], view))
+			{
+				++stats.cone_culled_count;
+			}
+			else
+			{
+				visible_meshlets[stats.visible_count++] = meshlet_idx;
+			}
+		}
+		return stats;
+	}
+
+}
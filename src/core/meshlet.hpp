@@ -0,0 +1,49 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_MESHLET_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_MESHLET_HPP
+
+#include <cstdint>
+
+#include "mesh.hpp"
+#include "mesh_import.hpp"
+
+namespace Core
+{
+
+	// Splits every submesh into meshlets of neighbouring triangles and computes their bounding
+	// spheres and normal cones. Runs after optimize_mesh(), which renumbers the vertices.
+	void build_meshlets(MeshImport& mesh);
+
+	// What meshlets are culled against, in the space of the mesh. A point is inside when
+	// dot(plane.xyz, point) + plane.w >= 0 for all six planes.
+	struct MeshletCullView
+	{
+		float planes[6][4];
+		float camera_position[3];
+	};
+
+	// A perspective camera, the field of view is vertical and in radians
+	MeshletCullView make_meshlet_cull_view(
+		const float (&position)[3],
+		const float (&forward)[3],
+		const float (&up)[3],
+		float vertical_fov,
+		float aspect_ratio,
+		float near_z,
+		float far_z);
+
+	struct MeshletCullStats
+	{
+		uint32_t visible_count = 0;
+		uint32_t frustum_culled_count = 0;
+		// Facing away from the camera as a whole, out of the ones inside the frustum
+		uint32_t cone_culled_count = 0;
+	};
+
+	// The CPU reference of what an amplification shader does with the meshlets, the indices
+	// of the visible ones are written to visible_meshlets
+	bool is_meshlet_visible(const Meshlet& meshlet, const MeshletCullView& view);
+	MeshletCullStats cull_meshlets(const Meshlet* meshlets, uint32_t meshlet_count, const MeshletCullView& view, uint32_t* visible_meshlets);
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_MESHLET_HPP
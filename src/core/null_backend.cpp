@@ -0,0 +1,176 @@
+#include "null_backend.hpp"
+
+#include <algorithm>
+
+namespace Core
+{
+
+	const char* NullBackend::name() const
+	{
+		return "null";
+	}
+
+	const GpuProfiler* NullBackend::gpu_profiler() const
+	{
+		return nullptr;
+	}
+
+	void NullBackend::begin_frame()
+	{
+		// Keeps the capacity, so a steady state frame does not allocate
+		m_command_stream.clear();
+		write_command(CommandType::BeginFrame);
+	}
+
+	void NullBackend::clear(const float color[4])
+	{
+		write_command(CommandType::Clear);
+		for (uint32_t channel = 0; channel < 4; ++channel)
+		{
+			write(color[channel]);
+		}
+		++m_counters.clears;
+	}
+
+	void NullBackend::set_pipeline(uint32_t pipeline_idx)
+	{
+		write_command(CommandType::SetPipeline);
+		write(pipeline_idx);
+		++m_counters.pipeline_changes;
+	}
+
+	void NullBackend::set_material(uint32_t material_idx)
+	{
+		write_command(CommandType::SetMaterial);
+		write(material_idx);
+		++m_counters.material_changes;
+	}
+
+	void NullBackend::draw(uint32_t vertex_count, uint32_t first_vertex)
+	{
+		write_command(CommandType::Draw);
+		write(vertex_count);
+		write(first_vertex);
+		++m_counters.draws;
+		m_counters.vertices += vertex_count;
+	}
+
+	void NullBackend::end_frame()
+	{
+		write_command(CommandType::EndFrame);
+		++m_counters.frames;
+	}
+
+	void NullBackend::present()
+	{
+	}
+
+	const std::vector<uint8_t>& NullBackend::command_stream() const
+	{
+		return m_command_stream;
+	}
+
+	const CommandCounters& NullBackend::counters() const
+	{
+		return m_counters;
+	}
+
+	size_t NullBackend::argument_size(CommandType type)
+	{
+		switch (type)
+		{
+		case CommandType::Clear:
+			return 4 * sizeof(float);
+		case CommandType::SetPipeline:
+		case CommandType::SetMaterial:
+			return sizeof(uint32_t);
+		case CommandType::Draw:
+			return 2 * sizeof(uint32_t);
+		default:
+			return 0;
+		}
+	}
+
+	void NullBackend::write_command(CommandType type)
+	{
+		write(type);
+		++m_counters.commands;
+		m_counters.command_bytes += 1 + argument_size(type);
+	}
+
+	NullTextureStreamingBackend::NullTextureStreamingBackend(uint64_t upload_capacity) :
+		m_upload_memory(upload_capacity)
+	{
+	}
+
+	NullTextureStreamingBackend::~NullTextureStreamingBackend() = default;
+
+	uint8_t* NullTextureStreamingBackend::upload_memory()
+	{
+		return m_upload_memory.data();
+	}
+
+	uint64_t NullTextureStreamingBackend::upload_capacity() const
+	{
+		return m_upload_memory.size();
+	}
+
+	uint64_t NullTextureStreamingBackend::upload_alignment() const
+	{
+		// D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT
+		return 512;
+	}
+
+	void* NullTextureStreamingBackend::create_texture(const TextureDesc& desc)
+	{
+		++m_counters.textures;
+		return new TextureDesc(desc);
+	}
+
+	void NullTextureStreamingBackend::destroy_texture(void* texture)
+	{
+		delete static_cast<TextureDesc*>(texture);
+	}
+
+	TextureFootprint NullTextureStreamingBackend::mip_footprint(void* texture, uint32_t mip_idx)
+	{
+		// D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+		constexpr uint32_t pitch_alignment = 256;
+
+		const auto& desc = *static_cast<const TextureDesc*>(texture);
+		TextureFootprint footprint;
+		compute_mip_pitch(
+			desc.format,
+			std::max(1U, desc.width >> mip_idx),
+			std::max(1U, desc.height >> mip_idx),
+			footprint.row_size,
+			footprint.row_count);
+		footprint.row_pitch = (footprint.row_size + pitch_alignment - 1) & ~(pitch_alignment - 1);
+		// Like GetCopyableFootprints, the last row is not padded
+		footprint.size = static_cast<uint64_t>(footprint.row_pitch) * (footprint.row_count - 1) + footprint.row_size;
+		return footprint;
+	}
+
+	void NullTextureStreamingBackend::copy_mip(void* /*texture*/, uint32_t /*mip_idx*/, uint64_t /*upload_offset*/, const TextureFootprint& footprint)
+	{
+		++m_counters.copies;
+		m_counters.copied_bytes += footprint.size;
+	}
+
+	uint64_t NullTextureStreamingBackend::submit()
+	{
+		++m_counters.submits;
+		return ++m_fence_value;
+	}
+
+	uint64_t NullTextureStreamingBackend::completed_fence_value()
+	{
+		return m_fence_value;
+	}
+
+	const CopyCounters& NullTextureStreamingBackend::counters() const
+	{
+		return m_counters;
+	}
+
+}
@@ -0,0 +1,131 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_NULL_BACKEND_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_NULL_BACKEND_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "render_backend.hpp"
+#include "texture_streamer.hpp"
+
+namespace Core
+{
+
+	enum class CommandType : uint8_t
+	{
+		BeginFrame,
+		Clear,
+		SetPipeline,
+		SetMaterial,
+		Draw,
+		EndFrame,
+	};
+
+	struct CommandCounters
+	{
+		uint64_t frames = 0;
+		uint64_t clears = 0;
+		uint64_t pipeline_changes = 0;
+		uint64_t material_changes = 0;
+		uint64_t draws = 0;
+		uint64_t vertices = 0;
+		uint64_t commands = 0;
+		uint64_t command_bytes = 0;
+	};
+
+	// Backend without a device: every call is appended to a byte stream
+	// (a one byte CommandType followed by the packed arguments) and counted.
+	// The stream holds the commands of the current frame only.
+	class NullBackend : public RenderBackend
+	{
+	public:
+		NullBackend() = default;
+		NullBackend(const NullBackend&) = delete;
+		NullBackend& operator=(const NullBackend&) = delete;
+
+		const char* name() const override;
+		const GpuProfiler* gpu_profiler() const override;
+
+		void begin_frame() override;
+		void clear(const float color[4]) override;
+		void set_pipeline(uint32_t pipeline_idx) override;
+		void set_material(uint32_t material_idx) override;
+		void draw(uint32_t vertex_count, uint32_t first_vertex) override;
+		void end_frame() override;
+		void present() override;
+
+		const std::vector<uint8_t>& command_stream() const;
+		const CommandCounters& counters() const;
+
+		// Calls visitor(CommandType, const uint8_t* arguments) for every recorded command
+		template<typename Visitor>
+		void for_each_command(Visitor&& visitor) const;
+
+		static size_t argument_size(CommandType type);
+	private:
+		template<typename T>
+		void write(const T& value);
+		void write_command(CommandType type);
+
+		std::vector<uint8_t> m_command_stream;
+		CommandCounters m_counters;
+	};
+
+	struct CopyCounters
+	{
+		uint64_t textures = 0;
+		uint64_t copies = 0;
+		uint64_t copied_bytes = 0;
+		uint64_t submits = 0;
+	};
+
+	// Texture streaming without a GPU: footprints follow the Direct3D 12 pitch and placement
+	// rules, copies are counted and finish as soon as they are submitted
+	class NullTextureStreamingBackend : public TextureStreamingBackend
+	{
+	public:
+		explicit NullTextureStreamingBackend(uint64_t upload_capacity = 64 * 1024 * 1024);
+		~NullTextureStreamingBackend() override;
+
+		uint8_t* upload_memory() override;
+		uint64_t upload_capacity() const override;
+		uint64_t upload_alignment() const override;
+
+		void* create_texture(const TextureDesc& desc) override;
+		void destroy_texture(void* texture) override;
+		TextureFootprint mip_footprint(void* texture, uint32_t mip_idx) override;
+
+		void copy_mip(void* texture, uint32_t mip_idx, uint64_t upload_offset, const TextureFootprint& footprint) override;
+		uint64_t submit() override;
+		uint64_t completed_fence_value() override;
+
+		const CopyCounters& counters() const;
+	private:
+		std::vector<uint8_t> m_upload_memory;
+		uint64_t m_fence_value = 0;
+		CopyCounters m_counters;
+	};
+
+	template<typename Visitor>
+	void NullBackend::for_each_command(Visitor&& visitor) const
+	{
+		size_t offset = 0;
+		while (offset < m_command_stream.size())
+		{
+			const auto type = static_cast<CommandType>(m_command_stream[offset]);
+			visitor(type, m_command_stream.data() + offset + 1);
+			offset += 1 + argument_size(type);
+		}
+	}
+
+	template<typename T>
+	void NullBackend::write(const T& value)
+	{
+		const size_t offset = m_command_stream.size();
+		m_command_stream.resize(offset + sizeof(T));
+		std::memcpy(m_command_stream.data() + offset, &value, sizeof(T));
+	}
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_NULL_BACKEND_HPP
@@ -0,0 +1,370 @@
+#include "occlusion_culling.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#include "profiler.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_CULLING_SSE2
+#endif
+
+namespace Core
+{
+
+	namespace
+	{
+		// Filling and testing are written once against these wrappers, one pixel per lane
+#if defined(__AVX2__)
+		struct Lanes
+		{
+			static constexpr uint32_t count = 8;
+			using Float = __m256;
+			using Mask = __m256;
+
+			static Float splat(float value) { return _mm256_set1_ps(value); }
+			// value + lane for every lane
+			static Float ramp(float value) { return _mm256_add_ps(_mm256_set1_ps(value), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f)); }
+			static Float load(const float* source) { return _mm256_loadu_ps(source); }
+			static void store(float* destination, Float value) { _mm256_storeu_ps(destination, value); }
+			static Float mul_add(Float a, Float b, Float c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+			static Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+			static Mask greater_equal(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+			static Mask less(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+			static Mask mask_and(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+			static Float select(Mask mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+			static bool any(Mask mask) { return _mm256_movemask_ps(mask) != 0; }
+		};
+#elif defined(OCCLUSION_CULLING_SSE2)
+		struct Lanes
+		{
+			static constexpr uint32_t count = 4;
+			using Float = __m128;
+			using Mask = __m128;
+
+			static Float splat(float value) { return _mm_set1_ps(value); }
+			static Float ramp(float value) { return _mm_add_ps(_mm_set1_ps(value), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f)); }
+			static Float load(const float* source) { return _mm_loadu_ps(source); }
+			static void store(float* destination, Float value) { _mm_storeu_ps(destination, value); }
+			static Float mul_add(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+			static Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+			static Mask greater_equal(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+			static Mask less(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+			static Mask mask_and(Mask a, Mask b) { return _mm_and_ps(a, b); }
+			static Float select(Mask mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+			static bool any(Mask mask) { return _mm_movemask_ps(mask) != 0; }
+		};
+#else
+		struct Lanes
+		{
+			static constexpr uint32_t count = 1;
+			using Float = float;
+			using Mask = bool;
+
+			static Float splat(float value) { return value; }
+			static Float ramp(float value) { return value; }
+			static Float load(const float* source) { return *source; }
+			static void store(float* destination, Float value) { *destination = value; }
+			static Float mul_add(Float a, Float b, Float c) { return a * b + c; }
+			static Float min(Float a, Float b) { return std::min(a, b); }
+			static Mask greater_equal(Float a, Float b) { return a >= b; }
+			static Mask less(Float a, Float b) { return a < b; }
+			static Mask mask_and(Mask a, Mask b) { return a && b; }
+			static Float select(Mask mask, Float a, Float b) { return mask ? a : b; }
+			static bool any(Mask mask) { return mask; }
+		};
+#endif
+
+		// Rows are whole registers, so the loops never need a tail
+		constexpr uint32_t row_alignment = 8;
+		static_assert(row_alignment % Lanes::count == 0, "Rows have to be whole registers");
+
+		// The pixels min to max touches, clamped to the buffer. Floats first, the corners of
+		// clipped triangles can be far outside.
+		void pixel_range(float min, float max, uint32_t size, uint32_t& begin, uint32_t& end)
+		{
+			const float float_size = static_cast<float>(size);
+			begin = static_cast<uint32_t>(std::clamp(std::floor(min), 0.0f, float_size));
+			end = static_cast<uint32_t>(std::clamp(std::floor(max) + 1.0f, 0.0f, float_size));
+		}
+
+		Float4 lerp(const Float4& a, const Float4& b, float t)
+		{
+			return {
+				a.x + (b.x - a.x) * t,
+				a.y + (b.y - a.y) * t,
+				a.z + (b.z - a.z) * t,
+				a.w + (b.w - a.w) * t,
+			};
+		}
+	}
+
+	OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height) :
+		m_width((std::max(width, 1U) + row_alignment - 1) / row_alignment * row_alignment),
+		m_height(std::max(height, 1U)),
+		m_depth(static_cast<size_t>(m_width) * m_height, 1.0f),
+		m_view_projection{}
+	{
+	}
+
+	void OcclusionBuffer::begin(const Float4x4& view_projection)
+	{
+		PROFILE_ZONE("Clear occlusion buffer");
+
+		const uint64_t begin_ns = Profiler::now();
+		m_stats = {};
+		m_view_projection = view_projection;
+		std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+		m_stats.clear_ns = Profiler::now() - begin_ns;
+	}
+
+	void OcclusionBuffer::add_occluder(const Float4x4& world, const Float3* positions, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count)
+	{
+		PROFILE_ZONE("Rasterize occluder");
+
+		const uint64_t transform_begin_ns = Profiler::now();
+		const Matrix world_view_projection = matrix_multiply(load(world), load(m_view_projection));
+		m_clip_positions.resize(vertex_count);
+		for (uint32_t vertex_idx = 0; vertex_idx < vertex_count; ++vertex_idx)
+		{
+			store(m_clip_positions[vertex_idx], vector_transform(load(positions[vertex_idx], 1.0f), world_view_projection));
+		}
+
+		const uint64_t rasterize_begin_ns = Profiler::now();
+		const uint32_t triangle_count = index_count / 3;
+		for (uint32_t triangle_idx = 0; triangle_idx < triangle_count; ++triangle_idx)
+		{
+			const uint32_t* triangle = indices + triangle_idx * 3;
+			assert(triangle[0] < vertex_count && triangle[1] < vertex_count && triangle[2] < vertex_count);
+			rasterize_triangle(m_clip_positions[triangle[0]], m_clip_positions[triangle[1]], m_clip_positions[triangle[2]]);
+		}
+		const uint64_t end_ns = Profiler::now();
+
+		m_stats.transform_ns += rasterize_begin_ns - transform_begin_ns;
+		m_stats.rasterize_ns += end_ns - rasterize_begin_ns;
+		m_stats.occluder_triangle_count += triangle_count;
+	}
+
+	void OcclusionBuffer::rasterize_triangle(const Float4& a, const Float4& b, const Float4& c)
+	{
+		// Entirely outside one of the side planes or beyond the far plane
+		if ((a.x > a.w && b.x > b.w && c.x > c.w) || (a.x < -a.w && b.x < -b.w && c.x < -c.w) ||
+			(a.y > a.w && b.y > b.w && c.y > c.w) || (a.y < -a.w && b.y < -b.w && c.y < -c.w) ||
+			(a.z > a.w && b.z > b.w && c.z > c.w))
+		{
+			return;
+		}
+
+		// Clipped against the near plane z = 0, which also keeps w positive
+		const Float4 corners[3] = { a, b, c };
+		Float4 clipped[4];
+		uint32_t clipped_count = 0;
+		for (uint32_t corner_idx = 0; corner_idx < 3; ++corner_idx)
+		{
+			const Float4& corner = corners[corner_idx];
+			const Float4& next = corners[(corner_idx + 1) % 3];
+			if (corner.z >= 0.0f)
+			{
+				clipped[clipped_count++] = corner;
+			}
+			if ((corner.z >= 0.0f) != (next.z >= 0.0f))
+			{
+				clipped[clipped_count++] = lerp(corner, next, corner.z / (corner.z - next.z));
+			}
+		}
+		if (clipped_count < 3)
+		{
+			return;
+		}
+
+		const float half_width = static_cast<float>(m_width) * 0.5f;
+		const float half_height = static_cast<float>(m_height) * 0.5f;
+		Float4 screen[4];
+		for (uint32_t corner_idx = 0; corner_idx < clipped_count; ++corner_idx)
+		{
+			const Float4& corner = clipped[corner_idx];
+			const float inverse_w = 1.0f / corner.w;
+			screen[corner_idx] = {
+				(corner.x * inverse_w + 1.0f) * half_width,
+				(1.0f - corner.y * inverse_w) * half_height,
+				corner.z * inverse_w,
+				1.0f,
+			};
+		}
+
+		fill_triangle(screen[0], screen[1], screen[2]);
+		if (clipped_count == 4)
+		{
+			fill_triangle(screen[0], screen[2], screen[3]);
+		}
+	}
+
+	void OcclusionBuffer::fill_triangle(const Float4& a, const Float4& b, const Float4& c)
+	{
+		// Positive for clockwise on screen, with y pointing down
+		const float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+		if (!(area > 0.0f))
+		{
+			return;
+		}
+
+		uint32_t x_begin;
+		uint32_t x_end;
+		uint32_t y_begin;
+		uint32_t y_end;
+		pixel_range(std::min({ a.x, b.x, c.x }), std::max({ a.x, b.x, c.x }), m_width, x_begin, x_end);
+		pixel_range(std::min({ a.y, b.y, c.y }), std::max({ a.y, b.y, c.y }), m_height, y_begin, y_end);
+		if (x_begin >= x_end || y_begin >= y_end)
+		{
+			return;
+		}
+		++m_stats.rasterized_triangle_count;
+
+		// Edge functions a * x + b * y + c, positive inside, for the edges opposite each corner
+		const Float4* corners[3] = { &a, &b, &c };
+		float edge_a[3];
+		float edge_b[3];
+		float edge_c[3];
+		for (uint32_t edge_idx = 0; edge_idx < 3; ++edge_idx)
+		{
+			const Float4& from = *corners[(edge_idx + 1) % 3];
+			const Float4& to = *corners[(edge_idx + 2) % 3];
+			edge_a[edge_idx] = from.y - to.y;
+			edge_b[edge_idx] = to.x - from.x;
+			edge_c[edge_idx] = -edge_a[edge_idx] * from.x - edge_b[edge_idx] * from.y;
+		}
+
+		// Depth as a plane over the screen
+		const float depth_dx = ((b.z - a.z) * (c.y - a.y) - (b.y - a.y) * (c.z - a.z)) / area;
+		const float depth_dy = ((b.x - a.x) * (c.z - a.z) - (b.z - a.z) * (c.x - a.x)) / area;
+
+		const Lanes::Float zero = Lanes::splat(0.0f);
+		const Lanes::Float step_0 = Lanes::splat(edge_a[0]);
+		const Lanes::Float step_1 = Lanes::splat(edge_a[1]);
+		const Lanes::Float step_2 = Lanes::splat(edge_a[2]);
+		const Lanes::Float depth_step = Lanes::splat(depth_dx);
+		x_begin -= x_begin % Lanes::count;
+		for (uint32_t y = y_begin; y < y_end; ++y)
+		{
+			// At pixel centers
+			const float pixel_y = static_cast<float>(y) + 0.5f;
+			const Lanes::Float row_0 = Lanes::splat(edge_b[0] * pixel_y + edge_c[0]);
+			const Lanes::Float row_1 = Lanes::splat(edge_b[1] * pixel_y + edge_c[1]);
+			const Lanes::Float row_2 = Lanes::splat(edge_b[2] * pixel_y + edge_c[2]);
+			const Lanes::Float row_depth = Lanes::splat(a.z + depth_dy * (pixel_y - a.y) - depth_dx * a.x);
+			float* row = m_depth.data() + static_cast<size_t>(y) * m_width;
+			for (uint32_t x = x_begin; x < x_end; x += Lanes::count)
+			{
+				const Lanes::Float pixel_x = Lanes::ramp(static_cast<float>(x) + 0.5f);
+				const Lanes::Float edge_0 = Lanes::mul_add(step_0, pixel_x, row_0);
+				const Lanes::Float edge_1 = Lanes::mul_add(step_1, pixel_x, row_1);
+				const Lanes::Float edge_2 = Lanes::mul_add(step_2, pixel_x, row_2);
+				const Lanes::Mask is_inside = Lanes::greater_equal(Lanes::min(edge_0, Lanes::min(edge_1, edge_2)), zero);
+				const Lanes::Float depth = Lanes::mul_add(depth_step, pixel_x, row_depth);
+				const Lanes::Float old_depth = Lanes::load(row + x);
+				Lanes::store(row + x, Lanes::select(is_inside, Lanes::min(old_depth, depth), old_depth));
+			}
+		}
+	}
+
+	bool OcclusionBuffer::is_visible(const Aabb& bounds) const
+	{
+		const Matrix view_projection = load(m_view_projection);
+		float min_x = FLT_MAX;
+		float min_y = FLT_MAX;
+		float min_depth = FLT_MAX;
+		float max_x = -FLT_MAX;
+		float max_y = -FLT_MAX;
+		for (uint32_t corner_idx = 0; corner_idx < 8; ++corner_idx)
+		{
+			const Vector corner = vector_set(
+				(corner_idx & 1) ? bounds.max.x : bounds.min.x,
+				(corner_idx & 2) ? bounds.max.y : bounds.min.y,
+				(corner_idx & 4) ? bounds.max.z : bounds.min.z,
+				1.0f);
+			Float4 clip;
+			store(clip, vector_transform(corner, view_projection));
+			// Nothing in front of the near plane is rasterized, so nothing can hide it
+			if (clip.z < 0.0f)
+			{
+				return true;
+			}
+			const float inverse_w = 1.0f / clip.w;
+			min_x = std::min(min_x, clip.x * inverse_w);
+			max_x = std::max(max_x, clip.x * inverse_w);
+			min_y = std::min(min_y, clip.y * inverse_w);
+			max_y = std::max(max_y, clip.y * inverse_w);
+			min_depth = std::min(min_depth, clip.z * inverse_w);
+		}
+
+		const float half_width = static_cast<float>(m_width) * 0.5f;
+		const float half_height = static_cast<float>(m_height) * 0.5f;
+		uint32_t x_begin;
+		uint32_t x_end;
+		uint32_t y_begin;
+		uint32_t y_end;
+		pixel_range((min_x + 1.0f) * half_width, (max_x + 1.0f) * half_width, m_width, x_begin, x_end);
+		pixel_range((1.0f - max_y) * half_height, (1.0f - min_y) * half_height, m_height, y_begin, y_end);
+
+		// Visible as soon as one pixel of the rectangle is no closer than the bounds
+		const Lanes::Float bounds_depth = Lanes::splat(min_depth);
+		const Lanes::Float first_x = Lanes::splat(static_cast<float>(x_begin));
+		const Lanes::Float last_x = Lanes::splat(static_cast<float>(x_end));
+		const uint32_t aligned_x_begin = x_begin - x_begin % Lanes::count;
+		for (uint32_t y = y_begin; y < y_end; ++y)
+		{
+			const float* row = m_depth.data() + static_cast<size_t>(y) * m_width;
+			for (uint32_t x = aligned_x_begin; x < x_end; x += Lanes::count)
+			{
+				const Lanes::Float pixel_x = Lanes::ramp(static_cast<float>(x));
+				const Lanes::Mask is_in_range = Lanes::mask_and(Lanes::greater_equal(pixel_x, first_x), Lanes::less(pixel_x, last_x));
+				if (Lanes::any(Lanes::mask_and(is_in_range, Lanes::greater_equal(Lanes::load(row + x), bounds_depth))))
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	uint32_t OcclusionBuffer::cull(const Aabb* bounds, uint32_t count, uint32_t* visible_indices) const
+	{
+		PROFILE_ZONE("Occlusion cull");
+
+		uint32_t visible_count = 0;
+		for (uint32_t bounds_idx = 0; bounds_idx < count; ++bounds_idx)
+		{
+			if (is_visible(bounds[bounds_idx]))
+			{
+				visible_indices[visible_count++] = bounds_idx;
+			}
+		}
+		return visible_count;
+	}
+
+	const OcclusionStats& OcclusionBuffer::stats() const
+	{
+		return m_stats;
+	}
+
+	uint32_t OcclusionBuffer::width() const
+	{
+		return m_width;
+	}
+
+	uint32_t OcclusionBuffer::height() const
+	{
+		return m_height;
+	}
+
+	const float* OcclusionBuffer::depth() const
+	{
+		return m_depth.data();
+	}
+
+}
@@ -0,0 +1,74 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_OCCLUSION_CULLING_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_OCCLUSION_CULLING_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "bvh.hpp"
+#include "simd_math.hpp"
+
+namespace Core
+{
+
+	struct OcclusionStats
+	{
+		uint64_t clear_ns = 0;
+		// Of the occluder vertices to clip space
+		uint64_t transform_ns = 0;
+		// Near plane clipping, triangle setup and filling
+		uint64_t rasterize_ns = 0;
+		uint32_t occluder_triangle_count = 0;
+		// The ones left after back faces, triangles behind the camera and off screen
+		uint32_t rasterized_triangle_count = 0;
+	};
+
+	// Small depth buffer the closest depth of a few large occluders is rasterized into on
+	// the CPU, to test the bounds of objects against before drawing them. Depth goes from
+	// 0 at the near plane to 1 at the far plane, as with matrix_perspective_fov_lh().
+	// Occluders only cover the pixels whose centers they cover, so objects peeking out
+	// by less than a pixel may be culled.
+	class OcclusionBuffer
+	{
+	public:
+		static constexpr uint32_t default_width = 256;
+		static constexpr uint32_t default_height = 128;
+
+		// The width is rounded up to a multiple of 8 so rows are whole SIMD registers
+		explicit OcclusionBuffer(uint32_t width = default_width, uint32_t height = default_height);
+
+		// Clears the depth to the far plane and sets the camera of the calls below
+		void begin(const Float4x4& view_projection);
+		// Triangles are clockwise seen from the front, the back faces are skipped
+		void add_occluder(const Float4x4& world, const Float3* positions, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count);
+
+		// False when the bounds are entirely behind the occluders or off screen, true when
+		// they reach past the near plane
+		bool is_visible(const Aabb& bounds) const;
+		// Writes the indices of the visible bounds to visible_indices, in increasing order,
+		// and returns how many there are
+		uint32_t cull(const Aabb* bounds, uint32_t count, uint32_t* visible_indices) const;
+
+		// Since the last begin()
+		const OcclusionStats& stats() const;
+		uint32_t width() const;
+		uint32_t height() const;
+		// Row after row from the top
+		const float* depth() const;
+	private:
+		// Clip space corners, clipped against the near plane here
+		void rasterize_triangle(const Float4& a, const Float4& b, const Float4& c);
+		// Screen space corners in pixels with their depth in z, w unused
+		void fill_triangle(const Float4& a, const Float4& b, const Float4& c);
+
+		uint32_t m_width;
+		uint32_t m_height;
+		std::vector<float> m_depth;
+		Float4x4 m_view_projection;
+		// Clip space of the current occluder
+		std::vector<Float4> m_clip_positions;
+		OcclusionStats m_stats;
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_OCCLUSION_CULLING_HPP
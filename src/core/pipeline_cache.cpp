@@ -0,0 +1,194 @@
+#include "pipeline_cache.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "profiler.hpp"
+
+namespace Core
+{
+
+	PipelineCache::PipelineCache(JobSystem& job_system, PipelineCompiler& compiler, uint32_t frames_in_flight) :
+		m_job_system(job_system),
+		m_compiler(compiler),
+		m_frames_in_flight(frames_in_flight)
+	{
+	}
+
+	PipelineCache::~PipelineCache()
+	{
+		m_job_system.wait(m_compiles);
+	}
+
+	uint32_t PipelineCache::request(PipelineDesc desc, uint32_t fallback_pipeline_id)
+	{
+		const auto pipeline_id = static_cast<uint32_t>(m_pipelines.size());
+		assert(fallback_pipeline_id == invalid_pipeline || fallback_pipeline_id < pipeline_id);
+
+		Pipeline& pipeline = m_pipelines.emplace_back();
+		pipeline.fallback_pipeline_id = fallback_pipeline_id;
+		pipeline.stats.name = desc.name;
+
+		submit_compile(pipeline_id, std::move(desc));
+		return pipeline_id;
+	}
+
+	void PipelineCache::recompile(uint32_t pipeline_id, PipelineDesc desc)
+	{
+		submit_compile(pipeline_id, std::move(desc));
+	}
+
+	void PipelineCache::begin_frame()
+	{
+		PROFILE_FUNCTION();
+
+		++m_frame_idx;
+
+		std::vector<CompileResult> results;
+		{
+			std::unique_lock<std::mutex> lock(m_results_mutex, std::try_to_lock);
+			if (lock.owns_lock())
+			{
+				results.swap(m_results);
+			}
+		}
+		for (auto& result : results)
+		{
+			apply(result);
+		}
+
+		m_retired_pipelines.erase(
+			std::remove_if(m_retired_pipelines.begin(), m_retired_pipelines.end(), [this](const RetiredPipeline& retired)
+			{
+				return m_frame_idx - retired.frame_idx > m_frames_in_flight;
+			}),
+			m_retired_pipelines.end());
+	}
+
+	void* PipelineCache::resolve(uint32_t pipeline_id)
+	{
+		uint32_t resolved_id = pipeline_id;
+		// The depth limit guards against fallback cycles
+		for (size_t depth = 0; resolved_id != invalid_pipeline && depth < m_pipelines.size(); ++depth)
+		{
+			const Pipeline& pipeline = m_pipelines[resolved_id];
+			if (pipeline.object)
+			{
+				if (depth == 0)
+				{
+					++m_counters.ready_resolves;
+				}
+				else
+				{
+					++m_counters.fallback_resolves;
+				}
+				return pipeline.object.get();
+			}
+			resolved_id = pipeline.fallback_pipeline_id;
+		}
+
+		++m_counters.skipped_resolves;
+		return nullptr;
+	}
+
+	bool PipelineCache::is_ready(uint32_t pipeline_id) const
+	{
+		return m_pipelines[pipeline_id].object != nullptr;
+	}
+
+	bool PipelineCache::is_failed(uint32_t pipeline_id) const
+	{
+		return m_pipelines[pipeline_id].is_failed;
+	}
+
+	uint32_t PipelineCache::pending_compile_count() const
+	{
+		return m_pending_compile_count;
+	}
+
+	const PipelineStats& PipelineCache::stats(uint32_t pipeline_id) const
+	{
+		return m_pipelines[pipeline_id].stats;
+	}
+
+	uint32_t PipelineCache::pipeline_count() const
+	{
+		return static_cast<uint32_t>(m_pipelines.size());
+	}
+
+	const PipelineCacheCounters& PipelineCache::counters() const
+	{
+		return m_counters;
+	}
+
+	void PipelineCache::wait_idle()
+	{
+		PROFILE_FUNCTION();
+
+		m_job_system.wait(m_compiles);
+
+		std::vector<CompileResult> results;
+		{
+			std::lock_guard<std::mutex> lock(m_results_mutex);
+			results.swap(m_results);
+		}
+		for (auto& result : results)
+		{
+			apply(result);
+		}
+	}
+
+	void PipelineCache::submit_compile(uint32_t pipeline_id, PipelineDesc desc)
+	{
+		Pipeline& pipeline = m_pipelines[pipeline_id];
+		const uint32_t generation = ++pipeline.generation;
+		pipeline.is_compiling = true;
+		++m_pending_compile_count;
+
+		m_job_system.submit_background([this, pipeline_id, generation, desc = std::move(desc)]()
+		{
+			PROFILE_ZONE("Compile pipeline");
+
+			const uint64_t begin_ns = Profiler::now();
+			std::shared_ptr<void> object = m_compiler.compile(desc);
+			const double compile_ms = static_cast<double>(Profiler::now() - begin_ns) / 1e6;
+
+			std::lock_guard<std::mutex> lock(m_results_mutex);
+			m_results.push_back({ pipeline_id, generation, std::move(object), compile_ms });
+		}, &m_compiles);
+	}
+
+	void PipelineCache::apply(CompileResult& result)
+	{
+		--m_pending_compile_count;
+
+		Pipeline& pipeline = m_pipelines[result.pipeline_id];
+		PipelineStats& stats = pipeline.stats;
+		++stats.compile_count;
+		stats.last_compile_ms = result.compile_ms;
+		stats.max_compile_ms = std::max(stats.max_compile_ms, result.compile_ms);
+
+		if (result.generation != pipeline.generation)
+		{
+			// A newer compile was requested meanwhile, its result is the one to use
+			return;
+		}
+		pipeline.is_compiling = false;
+
+		if (!result.object)
+		{
+			// The previous version, if any, stays in use
+			++stats.failed_compile_count;
+			pipeline.is_failed = true;
+			return;
+		}
+		pipeline.is_failed = false;
+
+		if (pipeline.object)
+		{
+			m_retired_pipelines.push_back({ std::move(pipeline.object), m_frame_idx });
+		}
+		pipeline.object = std::move(result.object);
+	}
+
+}
@@ -0,0 +1,139 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_PIPELINE_CACHE_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_PIPELINE_CACHE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "job_system.hpp"
+#include "shader_reflection.hpp"
+
+namespace Core
+{
+
+	struct PipelineDesc
+	{
+		std::string name;
+		std::vector<unsigned char> vertex_shader;
+		std::vector<unsigned char> pixel_shader;
+		// Generated at build time, see add_hlsl
+		const ShaderReflection* vertex_shader_reflection = nullptr;
+		const ShaderReflection* pixel_shader_reflection = nullptr;
+	};
+
+	// Creates the pipeline objects of one backend. compile() runs on job system workers,
+	// concurrently with the render thread and with other compiles.
+	class PipelineCompiler
+	{
+	public:
+		virtual ~PipelineCompiler() = default;
+
+		// Null when the pipeline can not be created. The deleter of the returned
+		// pointer releases the backend object.
+		virtual std::shared_ptr<void> compile(const PipelineDesc& desc) = 0;
+	};
+
+	struct PipelineStats
+	{
+		std::string name;
+		uint32_t compile_count = 0;
+		uint32_t failed_compile_count = 0;
+		double last_compile_ms = 0.0;
+		double max_compile_ms = 0.0;
+	};
+
+	struct PipelineCacheCounters
+	{
+		// resolve() calls answered with the requested pipeline, a fallback or nothing
+		uint64_t ready_resolves = 0;
+		uint64_t fallback_resolves = 0;
+		uint64_t skipped_resolves = 0;
+	};
+
+	// Compiles pipelines in the background so the render thread never waits for one.
+	// Until a pipeline is ready resolve() hands out its fallback, or null to tell the
+	// caller to skip the draw. Recompiling keeps the current pipeline in use until the
+	// new one is ready. Everything but the compiles runs on the render thread.
+	class PipelineCache
+	{
+	public:
+		static constexpr uint32_t invalid_pipeline = UINT32_MAX;
+
+		// Retired pipelines are released frames_in_flight frames after they were replaced,
+		// when the GPU can no longer be using them
+		PipelineCache(JobSystem& job_system, PipelineCompiler& compiler, uint32_t frames_in_flight);
+		PipelineCache(const PipelineCache&) = delete;
+		PipelineCache& operator=(const PipelineCache&) = delete;
+		// Waits for the compiles still running
+		~PipelineCache();
+
+		// Starts compiling a new pipeline and returns its id
+		uint32_t request(PipelineDesc desc, uint32_t fallback_pipeline_id = invalid_pipeline);
+		// Compiles a new version of the pipeline, used once it is ready
+		void recompile(uint32_t pipeline_id, PipelineDesc desc);
+
+		// Picks up finished compiles and releases retired pipelines, call once per frame.
+		// Does not block, results published while it runs are taken next frame.
+		void begin_frame();
+
+		// The pipeline, or the closest ready fallback, or null
+		void* resolve(uint32_t pipeline_id);
+		bool is_ready(uint32_t pipeline_id) const;
+		bool is_failed(uint32_t pipeline_id) const;
+		uint32_t pending_compile_count() const;
+
+		const PipelineStats& stats(uint32_t pipeline_id) const;
+		uint32_t pipeline_count() const;
+		const PipelineCacheCounters& counters() const;
+
+		// Blocks until every compile finished and was picked up, for startup and tests
+		void wait_idle();
+	private:
+		struct Pipeline
+		{
+			uint32_t fallback_pipeline_id = invalid_pipeline;
+			// Results of older compiles are dropped when they finish after a newer request
+			uint32_t generation = 0;
+			bool is_compiling = false;
+			bool is_failed = false;
+			std::shared_ptr<void> object;
+			PipelineStats stats;
+		};
+
+		struct CompileResult
+		{
+			uint32_t pipeline_id;
+			uint32_t generation;
+			std::shared_ptr<void> object;
+			double compile_ms;
+		};
+
+		struct RetiredPipeline
+		{
+			std::shared_ptr<void> object;
+			uint64_t frame_idx;
+		};
+
+		void submit_compile(uint32_t pipeline_id, PipelineDesc desc);
+		void apply(CompileResult& result);
+
+		JobSystem& m_job_system;
+		PipelineCompiler& m_compiler;
+		uint32_t m_frames_in_flight;
+		uint64_t m_frame_idx = 0;
+
+		std::vector<Pipeline> m_pipelines;
+		std::vector<RetiredPipeline> m_retired_pipelines;
+		uint32_t m_pending_compile_count = 0;
+		PipelineCacheCounters m_counters;
+
+		std::mutex m_results_mutex;
+		std::vector<CompileResult> m_results;
+		JobCounter m_compiles;
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_PIPELINE_CACHE_HPP
@@ -0,0 +1,254 @@
+#include "profiler.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace Core
+{
+
+	namespace
+	{
+		struct Track
+		{
+			std::string name;
+			// Null once the thread exited, its events were copied to finished_events
+			std::unique_ptr<ProfileEvent[]> events;
+			std::atomic<uint64_t> written{ 0 };
+			std::vector<ProfileEvent> finished_events;
+		};
+
+		struct Registry
+		{
+			std::mutex mutex;
+			std::vector<std::unique_ptr<Track>> tracks;
+			// Ring buffers of exited threads, handed to the next new track
+			std::vector<std::unique_ptr<ProfileEvent[]>> free_buffers;
+		};
+
+		Registry& registry()
+		{
+			static Registry instance;
+			return instance;
+		}
+
+		uint32_t add_track(std::string name)
+		{
+			auto track = std::make_unique<Track>();
+			track->name = std::move(name);
+
+			auto& instance = registry();
+			std::lock_guard<std::mutex> lock(instance.mutex);
+			if (instance.free_buffers.empty())
+			{
+				track->events = std::make_unique<ProfileEvent[]>(Profiler::ring_buffer_capacity);
+			}
+			else
+			{
+				track->events = std::move(instance.free_buffers.back());
+				instance.free_buffers.pop_back();
+			}
+			instance.tracks.push_back(std::move(track));
+			return static_cast<uint32_t>(instance.tracks.size() - 1);
+		}
+
+		Track& track_at(uint32_t idx)
+		{
+			auto& instance = registry();
+			std::lock_guard<std::mutex> lock(instance.mutex);
+			return *instance.tracks[idx];
+		}
+
+		void push(Track& track, uint32_t track_idx, const char* name, uint64_t begin_ns, uint64_t end_ns)
+		{
+			const uint64_t written = track.written.load(std::memory_order_relaxed);
+			track.events[written % Profiler::ring_buffer_capacity] = { name, begin_ns, end_ns, track_idx };
+			track.written.store(written + 1, std::memory_order_release);
+		}
+
+		// The live events, oldest first
+		void copy_events(const Track& track, std::vector<ProfileEvent>& events)
+		{
+			if (!track.events)
+			{
+				events.insert(events.end(), track.finished_events.begin(), track.finished_events.end());
+				return;
+			}
+
+			const uint64_t written = track.written.load(std::memory_order_acquire);
+			const uint64_t first = written > Profiler::ring_buffer_capacity ? written - Profiler::ring_buffer_capacity : 0;
+			for (uint64_t event_idx = first; event_idx < written; ++event_idx)
+			{
+				events.push_back(track.events[event_idx % Profiler::ring_buffer_capacity]);
+			}
+		}
+
+		struct ThreadTrack
+		{
+			uint32_t idx = 0;
+			Track* track = nullptr;
+
+			// Keeps only the events the thread recorded and recycles its ring buffer
+			~ThreadTrack()
+			{
+				if (!track)
+				{
+					return;
+				}
+
+				auto& instance = registry();
+				std::lock_guard<std::mutex> lock(instance.mutex);
+				copy_events(*track, track->finished_events);
+				instance.free_buffers.push_back(std::move(track->events));
+			}
+		};
+
+		// Tracks are never destroyed, so events of finished threads stay available for export
+		ThreadTrack& thread_track()
+		{
+			thread_local ThreadTrack current;
+			if (!current.track)
+			{
+				current.idx = add_track("Thread");
+				current.track = &track_at(current.idx);
+			}
+			return current;
+		}
+
+		void write_escaped(std::ostream& stream, const std::string& text)
+		{
+			static constexpr char hex_digits[] = "0123456789abcdef";
+			for (char c : text)
+			{
+				const auto code = static_cast<unsigned char>(c);
+				if (c == '"' || c == '\\')
+				{
+					stream << '\\' << c;
+				}
+				else if (code < 0x20)
+				{
+					// JSON strings can not hold control characters as they are
+					stream << "\\u00" << hex_digits[code >> 4] << hex_digits[code & 0xF];
+				}
+				else
+				{
+					stream << c;
+				}
+			}
+		}
+	}
+
+	uint64_t Profiler::now()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	void Profiler::record(const char* name, uint64_t begin_ns, uint64_t end_ns)
+	{
+		auto& current = thread_track();
+		push(*current.track, current.idx, name, begin_ns, end_ns);
+	}
+
+	void Profiler::record_on_track(uint32_t track, const char* name, uint64_t begin_ns, uint64_t end_ns)
+	{
+		// Non thread tracks may be fed from any thread, unlike the per thread ring buffers
+		auto& instance = registry();
+		std::lock_guard<std::mutex> lock(instance.mutex);
+		push(*instance.tracks[track], track, name, begin_ns, end_ns);
+	}
+
+	void Profiler::set_thread_name(const char* name)
+	{
+		auto& current = thread_track();
+		std::lock_guard<std::mutex> lock(registry().mutex);
+		current.track->name = name;
+	}
+
+	uint32_t Profiler::register_track(const char* name)
+	{
+		return add_track(name);
+	}
+
+	std::vector<ProfileEvent> Profiler::collect()
+	{
+		std::vector<ProfileEvent> events;
+
+		auto& instance = registry();
+		std::lock_guard<std::mutex> lock(instance.mutex);
+		for (const auto& track : instance.tracks)
+		{
+			copy_events(*track, events);
+		}
+
+		return events;
+	}
+
+	void Profiler::clear()
+	{
+		auto& instance = registry();
+		std::lock_guard<std::mutex> lock(instance.mutex);
+		for (auto& track : instance.tracks)
+		{
+			track->written.store(0, std::memory_order_release);
+			track->finished_events = {};
+		}
+	}
+
+	void Profiler::write_chrome_trace(std::ostream& stream)
+	{
+		const auto events = collect();
+
+		uint64_t origin_ns = UINT64_MAX;
+		for (const auto& event : events)
+		{
+			origin_ns = event.begin_ns < origin_ns ? event.begin_ns : origin_ns;
+		}
+
+		stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+		bool is_first = true;
+		{
+			auto& instance = registry();
+			std::lock_guard<std::mutex> lock(instance.mutex);
+			for (size_t track_idx = 0; track_idx < instance.tracks.size(); ++track_idx)
+			{
+				stream << (is_first ? "" : ",")
+					<< "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << track_idx
+					<< ",\"args\":{\"name\":\"";
+				write_escaped(stream, instance.tracks[track_idx]->name);
+				stream << "\"}}";
+				is_first = false;
+			}
+		}
+
+		// Chrome trace timestamps are in microseconds, keep the nanoseconds as fractions
+		stream.setf(std::ios::fixed);
+		stream.precision(3);
+		for (const auto& event : events)
+		{
+			stream << (is_first ? "" : ",") << "\n{\"name\":\"";
+			write_escaped(stream, event.name);
+			stream << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.track
+				<< ",\"ts\":" << (event.begin_ns - origin_ns) / 1000.0
+				<< ",\"dur\":" << (event.end_ns - event.begin_ns) / 1000.0 << "}";
+			is_first = false;
+		}
+
+		stream << "\n]}\n";
+	}
+
+	bool Profiler::write_chrome_trace(const std::string& path)
+	{
+		std::ofstream stream(path);
+		if (!stream)
+		{
+			return false;
+		}
+		write_chrome_trace(stream);
+		return static_cast<bool>(stream);
+	}
+
+}
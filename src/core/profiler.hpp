@@ -0,0 +1,84 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_PROFILER_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_PROFILER_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+// Zones compile to nothing unless DIRECTX_PLAYGROUND_PROFILE is defined.
+// Names must be string literals (or otherwise outlive the profiler), only the pointer is stored.
+#if defined(DIRECTX_PLAYGROUND_PROFILE)
+#define PROFILE_ZONE(name) Core::ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+#define PROFILE_THREAD_NAME(name) Core::Profiler::set_thread_name(name)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD_NAME(name)
+#endif
+
+namespace Core
+{
+
+	struct ProfileEvent
+	{
+		const char* name;
+		uint64_t begin_ns;
+		uint64_t end_ns;
+		// Index of the recording thread, or a track registered with Profiler::register_track()
+		uint32_t track;
+	};
+
+	// Every thread records into its own ring buffer, so a zone costs two clock
+	// reads and a store without any locking, playground_headless --profiler-overhead=COUNT
+	// measures it. Once a ring buffer is full the oldest events are overwritten.
+	// When a thread exits its events are copied out and its ring buffer goes to the next new thread.
+	class Profiler
+	{
+	public:
+		static constexpr uint32_t ring_buffer_capacity = 1 << 16;
+
+		static uint64_t now();
+
+		static void record(const char* name, uint64_t begin_ns, uint64_t end_ns);
+		// Records an event on a track that is not backed by a CPU thread, e.g. a GPU queue
+		static void record_on_track(uint32_t track, const char* name, uint64_t begin_ns, uint64_t end_ns);
+
+		static void set_thread_name(const char* name);
+		static uint32_t register_track(const char* name);
+
+		// Snapshot of every buffered event. Threads that keep recording while
+		// this runs may overwrite events that are being copied.
+		static std::vector<ProfileEvent> collect();
+		static void clear();
+
+		static void write_chrome_trace(std::ostream& stream);
+		static bool write_chrome_trace(const std::string& path);
+	};
+
+	class ProfileZone
+	{
+	public:
+		explicit ProfileZone(const char* name) :
+			m_name(name),
+			m_begin_ns(Profiler::now())
+		{}
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone& operator=(const ProfileZone&) = delete;
+
+		~ProfileZone()
+		{
+			Profiler::record(m_name, m_begin_ns, Profiler::now());
+		}
+	private:
+		const char* m_name;
+		uint64_t m_begin_ns;
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_PROFILER_HPP
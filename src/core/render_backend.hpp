@@ -0,0 +1,35 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_RENDER_BACKEND_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_RENDER_BACKEND_HPP
+
+#include <cstdint>
+
+namespace Core
+{
+
+	class GpuProfiler;
+
+	// What the frame loop sees of a renderer. A frame is
+	// begin_frame() -> clear()/set_pipeline()/set_material()/draw()... -> end_frame() (submit) -> present().
+	class RenderBackend
+	{
+	public:
+		virtual ~RenderBackend() = default;
+
+		virtual const char* name() const = 0;
+		// Null for backends that can not time GPU work
+		virtual const GpuProfiler* gpu_profiler() const = 0;
+
+		virtual void begin_frame() = 0;
+		virtual void clear(const float color[4]) = 0;
+		// Indices chosen by the caller, RenderQueue only sets them when they change.
+		// Backends with a single pipeline and no materials ignore them.
+		virtual void set_pipeline(uint32_t /*pipeline_idx*/) {}
+		virtual void set_material(uint32_t /*material_idx*/) {}
+		virtual void draw(uint32_t vertex_count, uint32_t first_vertex) = 0;
+		virtual void end_frame() = 0;
+		virtual void present() = 0;
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_RENDER_BACKEND_HPP
@@ -0,0 +1,251 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+#include "job_system.hpp"
+#include "profiler.hpp"
+#include "render_backend.hpp"
+
+namespace Core
+{
+
+	namespace
+	{
+		constexpr uint32_t digit_bits = 8;
+		constexpr uint32_t digit_value_count = 1U << digit_bits;
+		// Below this fanning out costs more than one thread sorting everything
+		constexpr uint32_t parallel_sort_threshold = 65536;
+
+		constexpr uint32_t material_shift = sort_key_depth_bits;
+		constexpr uint32_t pipeline_shift = material_shift + sort_key_material_bits;
+		constexpr uint32_t pass_shift = pipeline_shift + sort_key_pipeline_bits;
+		constexpr uint32_t layer_shift = pass_shift + sort_key_pass_bits;
+		static_assert(layer_shift + sort_key_layer_bits == 64, "The fields have to fill the key");
+
+		constexpr uint64_t max_depth = (1ULL << sort_key_depth_bits) - 1;
+
+		uint64_t quantize_depth(float depth)
+		{
+			// NaN ends up in front
+			const double clamped = depth > 0.0f ? std::min(static_cast<double>(depth), 1.0) : 0.0;
+			return static_cast<uint64_t>(clamped * static_cast<double>(max_depth) + 0.5);
+		}
+
+		// Asserts the value fits, and masks it in release builds so it can not spill into the
+		// field above
+		uint64_t key_field([[maybe_unused]] uint32_t value, uint32_t bits, uint32_t shift)
+		{
+			assert(value < (1U << bits));
+			return (static_cast<uint64_t>(value) & ((1ULL << bits) - 1)) << shift;
+		}
+
+		// Runs the blocks one after the other on the calling thread
+		struct RunBlocksInline
+		{
+			template<typename Function>
+			void operator()(uint32_t block_count, const Function& function) const
+			{
+				for (uint32_t block_idx = 0; block_idx < block_count; ++block_idx)
+				{
+					function(block_idx);
+				}
+			}
+		};
+	}
+
+	uint64_t make_sort_key(uint32_t layer, uint32_t pass, uint32_t pipeline, uint32_t material, float depth)
+	{
+		return key_field(layer, sort_key_layer_bits, layer_shift) |
+			key_field(pass, sort_key_pass_bits, pass_shift) |
+			key_field(pipeline, sort_key_pipeline_bits, pipeline_shift) |
+			key_field(material, sort_key_material_bits, material_shift) |
+			quantize_depth(depth);
+	}
+
+	uint64_t make_blended_sort_key(uint32_t layer, uint32_t pass, uint32_t pipeline, uint32_t material, float depth)
+	{
+		return key_field(layer, sort_key_layer_bits, layer_shift) |
+			key_field(pass, sort_key_pass_bits, pass_shift) |
+			((max_depth - quantize_depth(depth)) << (sort_key_pipeline_bits + sort_key_material_bits)) |
+			key_field(pipeline, sort_key_pipeline_bits, sort_key_material_bits) |
+			key_field(material, sort_key_material_bits, 0);
+	}
+
+	void RenderQueue::clear()
+	{
+		m_keys.clear();
+		m_items.clear();
+		m_differing_bits = 0;
+	}
+
+	void RenderQueue::add(uint64_t sort_key, const DrawItem& item)
+	{
+		// Any key works as the reference, they are all in the queue
+		if (!m_keys.empty())
+		{
+			m_differing_bits |= sort_key ^ m_keys.front();
+		}
+		m_keys.push_back(sort_key);
+		m_items.push_back(item);
+	}
+
+	void RenderQueue::sort()
+	{
+		PROFILE_ZONE("Sort render queue");
+
+		sort(1, RunBlocksInline());
+	}
+
+	void RenderQueue::sort(JobSystem& job_system)
+	{
+		PROFILE_ZONE("Sort render queue");
+
+		if (size() < parallel_sort_threshold)
+		{
+			sort(1, RunBlocksInline());
+			return;
+		}
+
+		sort(job_system.worker_count() + 1, [&job_system](uint32_t block_count, const auto& function)
+		{
+			job_system.parallel_for(block_count, 1, [&function](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t block_idx = begin; block_idx < end; ++block_idx)
+				{
+					function(block_idx);
+				}
+			});
+		});
+	}
+
+	template<typename RunBlocks>
+	void RenderQueue::sort(uint32_t block_count, RunBlocks&& run_blocks)
+	{
+		uint32_t shifts[64 / digit_bits];
+		uint32_t pass_count = 0;
+		for (uint32_t shift = 0; shift < 64; shift += digit_bits)
+		{
+			if (((m_differing_bits >> shift) & (digit_value_count - 1)) != 0)
+			{
+				shifts[pass_count++] = shift;
+			}
+		}
+		if (pass_count == 0)
+		{
+			return;
+		}
+
+		const uint32_t count = size();
+		const uint32_t block_size = (count + block_count - 1) / block_count;
+		m_scratch_keys.resize(count);
+		m_block_histograms.resize(static_cast<size_t>(block_count) * digit_value_count);
+		// The passes before the last one only move indices, the last one moves the items
+		// into sorted order so submit() reads them front to back
+		m_item_indices.resize(count);
+		m_scratch_item_indices.resize(count);
+		m_scratch_items.resize(count);
+		std::iota(m_item_indices.begin(), m_item_indices.end(), 0);
+
+		for (uint32_t pass_idx = 0; pass_idx < pass_count; ++pass_idx)
+		{
+			const uint32_t shift = shifts[pass_idx];
+			const bool is_last_pass = pass_idx + 1 == pass_count;
+
+			run_blocks(block_count, [&](uint32_t block_idx)
+			{
+				uint32_t* histogram = m_block_histograms.data() + static_cast<size_t>(block_idx) * digit_value_count;
+				std::fill(histogram, histogram + digit_value_count, 0);
+				const uint32_t end = std::min(count, (block_idx + 1) * block_size);
+				for (uint32_t key_idx = std::min(count, block_idx * block_size); key_idx < end; ++key_idx)
+				{
+					++histogram[(m_keys[key_idx] >> shift) & (digit_value_count - 1)];
+				}
+			});
+
+			// Digit value major and block minor, so equal digits stay in block order
+			uint32_t offset = 0;
+			for (uint32_t digit_value = 0; digit_value < digit_value_count; ++digit_value)
+			{
+				for (uint32_t block_idx = 0; block_idx < block_count; ++block_idx)
+				{
+					uint32_t& entry = m_block_histograms[static_cast<size_t>(block_idx) * digit_value_count + digit_value];
+					const uint32_t digit_count = entry;
+					entry = offset;
+					offset += digit_count;
+				}
+			}
+
+			run_blocks(block_count, [&](uint32_t block_idx)
+			{
+				uint32_t* offsets = m_block_histograms.data() + static_cast<size_t>(block_idx) * digit_value_count;
+				const uint32_t end = std::min(count, (block_idx + 1) * block_size);
+				for (uint32_t key_idx = std::min(count, block_idx * block_size); key_idx < end; ++key_idx)
+				{
+					const uint64_t key = m_keys[key_idx];
+					const uint32_t destination = offsets[(key >> shift) & (digit_value_count - 1)]++;
+					m_scratch_keys[destination] = key;
+					if (is_last_pass)
+					{
+						m_scratch_items[destination] = m_items[m_item_indices[key_idx]];
+					}
+					else
+					{
+						m_scratch_item_indices[destination] = m_item_indices[key_idx];
+					}
+				}
+			});
+
+			m_keys.swap(m_scratch_keys);
+			if (!is_last_pass)
+			{
+				m_item_indices.swap(m_scratch_item_indices);
+			}
+		}
+		m_items.swap(m_scratch_items);
+	}
+
+	RenderQueueStats RenderQueue::submit(RenderBackend& backend) const
+	{
+		PROFILE_ZONE("Submit render queue");
+
+		RenderQueueStats stats;
+		uint32_t pipeline = 0;
+		uint32_t material = 0;
+		for (const DrawItem& item : m_items)
+		{
+			if (stats.draw_count == 0 || item.pipeline != pipeline)
+			{
+				backend.set_pipeline(item.pipeline);
+				pipeline = item.pipeline;
+				++stats.pipeline_change_count;
+			}
+			if (stats.draw_count == 0 || item.material != material)
+			{
+				backend.set_material(item.material);
+				material = item.material;
+				++stats.material_change_count;
+			}
+			backend.draw(item.vertex_count, item.first_vertex);
+			++stats.draw_count;
+		}
+		return stats;
+	}
+
+	uint32_t RenderQueue::size() const
+	{
+		return static_cast<uint32_t>(m_keys.size());
+	}
+
+	uint64_t RenderQueue::sort_key(uint32_t position) const
+	{
+		return m_keys[position];
+	}
+
+	const DrawItem& RenderQueue::item(uint32_t position) const
+	{
+		return m_items[position];
+	}
+
+}
@@ -0,0 +1,85 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_RENDER_QUEUE_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_RENDER_QUEUE_HPP
+
+#include <cstdint>
+#include <vector>
+
+namespace Core
+{
+
+	class JobSystem;
+	class RenderBackend;
+
+	// Bits of a sort key from the top, so draws are ordered by layer, then pass
+	constexpr uint32_t sort_key_layer_bits = 4;
+	constexpr uint32_t sort_key_pass_bits = 4;
+	constexpr uint32_t sort_key_pipeline_bits = 12;
+	constexpr uint32_t sort_key_material_bits = 20;
+	constexpr uint32_t sort_key_depth_bits = 24;
+
+	// Layer, pass, pipeline, material, depth: within a pass draws sharing a pipeline and
+	// then a material are together, front to back. Depth from 0 to 1, clamped.
+	uint64_t make_sort_key(uint32_t layer, uint32_t pass, uint32_t pipeline, uint32_t material, float depth);
+	// Layer, pass, depth back to front, pipeline, material, for passes that blend
+	uint64_t make_blended_sort_key(uint32_t layer, uint32_t pass, uint32_t pipeline, uint32_t material, float depth);
+
+	// The payload of a sort key
+	struct DrawItem
+	{
+		uint32_t pipeline;
+		uint32_t material;
+		uint32_t vertex_count;
+		uint32_t first_vertex;
+	};
+
+	struct RenderQueueStats
+	{
+		uint32_t draw_count = 0;
+		uint32_t pipeline_change_count = 0;
+		uint32_t material_change_count = 0;
+	};
+
+	// Draws of a frame with their sort keys, sorted with an LSD radix sort over 8 bit
+	// digits. Digits every key shares are skipped, so unused key bits cost nothing.
+	// Keeps its memory across clear(), so a steady state frame does not allocate.
+	class RenderQueue
+	{
+	public:
+		void clear();
+		void add(uint64_t sort_key, const DrawItem& item);
+
+		// Stable, draws with the same key keep the order they were added in
+		void sort();
+		// The same with the histograms and scattering of large queues on the job system
+		void sort(JobSystem& job_system);
+
+		// Draws in sorted order, or the order they were added in before sort(), and only
+		// sets the pipeline and material when they change
+		RenderQueueStats submit(RenderBackend& backend) const;
+
+		uint32_t size() const;
+		// Indexed by position in the sorted order
+		uint64_t sort_key(uint32_t position) const;
+		const DrawItem& item(uint32_t position) const;
+	private:
+		// Calls run_blocks(block_count, function) to run function(block_idx) for every block
+		template<typename RunBlocks>
+		void sort(uint32_t block_count, RunBlocks&& run_blocks);
+
+		// In sorted order after sort(), in the order added before
+		std::vector<uint64_t> m_keys;
+		std::vector<DrawItem> m_items;
+		std::vector<uint64_t> m_scratch_keys;
+		std::vector<DrawItem> m_scratch_items;
+		// Into m_items, moved along with m_keys by all but the last pass of sort()
+		std::vector<uint32_t> m_item_indices;
+		std::vector<uint32_t> m_scratch_item_indices;
+		// Counts and then offsets of every digit value in every block
+		std::vector<uint32_t> m_block_histograms;
+		// Bits that differ between any of the keys and the first one
+		uint64_t m_differing_bits = 0;
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_RENDER_QUEUE_HPP
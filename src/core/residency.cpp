@@ -0,0 +1,268 @@
+#include "residency.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "profiler.hpp"
+
+namespace Core
+{
+
+	ResidencyManager::ResidencyManager(ResidencyBackend& backend, const ResidencyDesc& desc) :
+		m_backend(backend),
+		m_desc(desc)
+	{
+		assert(desc.evict_target <= desc.evict_threshold);
+	}
+
+	uint32_t ResidencyManager::track(void* object, uint64_t size)
+	{
+		uint32_t allocation_id = m_free_allocation;
+		if (allocation_id != invalid_allocation)
+		{
+			m_free_allocation = m_allocations[allocation_id].next;
+		}
+		else
+		{
+			allocation_id = static_cast<uint32_t>(m_allocations.size());
+			m_allocations.emplace_back();
+		}
+
+		Allocation& allocation = m_allocations[allocation_id];
+		allocation = Allocation();
+		allocation.object = object;
+		allocation.size = size;
+		allocation.is_tracked = true;
+		allocation.is_resident = true;
+		link(allocation_id);
+
+		m_resident_bytes += size;
+		++m_allocation_count;
+		return allocation_id;
+	}
+
+	void ResidencyManager::untrack(uint32_t allocation_id)
+	{
+		Allocation& allocation = m_allocations[allocation_id];
+		assert(allocation.is_tracked);
+
+		if (allocation.is_resident)
+		{
+			unlink(allocation_id);
+			m_resident_bytes -= allocation.size;
+		}
+		if (allocation.is_pending)
+		{
+			// Rare enough for a linear search
+			for (auto& pending_allocation_id : m_pending_allocations)
+			{
+				if (pending_allocation_id == allocation_id)
+				{
+					pending_allocation_id = m_pending_allocations.back();
+					m_pending_allocations.pop_back();
+					break;
+				}
+			}
+		}
+
+		allocation = Allocation();
+		allocation.next = m_free_allocation;
+		m_free_allocation = allocation_id;
+		--m_allocation_count;
+	}
+
+	void ResidencyManager::use(uint32_t allocation_id, uint64_t fence_value)
+	{
+		Allocation& allocation = m_allocations[allocation_id];
+		assert(allocation.is_tracked);
+		assert(fence_value >= allocation.last_used_fence_value);
+		allocation.last_used_fence_value = fence_value;
+
+		if (allocation.is_resident)
+		{
+			// Moving it to the tail keeps the list sorted by fence value
+			if (m_lru_tail != allocation_id)
+			{
+				unlink(allocation_id);
+				link(allocation_id);
+			}
+		}
+		else if (!allocation.is_pending)
+		{
+			allocation.is_pending = true;
+			m_pending_allocations.push_back(allocation_id);
+		}
+	}
+
+	void ResidencyManager::use(uint32_t allocation_id, uint64_t fence_value, uint64_t copy_fence_value)
+	{
+		use(allocation_id, fence_value);
+
+		Allocation& allocation = m_allocations[allocation_id];
+		assert(copy_fence_value >= allocation.last_used_copy_fence_value);
+		allocation.last_used_copy_fence_value = copy_fence_value;
+	}
+
+	bool ResidencyManager::make_resident()
+	{
+		if (m_pending_allocations.empty())
+		{
+			return true;
+		}
+
+		PROFILE_FUNCTION();
+
+		m_objects.clear();
+		uint64_t size = 0;
+		for (const uint32_t allocation_id : m_pending_allocations)
+		{
+			const Allocation& allocation = m_allocations[allocation_id];
+			m_objects.push_back(allocation.object);
+			size += allocation.size;
+		}
+
+		if (!m_backend.make_resident(m_objects.data(), static_cast<uint32_t>(m_objects.size())))
+		{
+			// They stay pending, the next update() may free enough memory
+			++m_counters.failed_make_residents;
+			return false;
+		}
+
+		for (const uint32_t allocation_id : m_pending_allocations)
+		{
+			Allocation& allocation = m_allocations[allocation_id];
+			allocation.is_pending = false;
+			allocation.is_resident = true;
+			link(allocation_id);
+		}
+		m_counters.make_residents += m_pending_allocations.size();
+		m_counters.made_resident_bytes += size;
+		m_resident_bytes += size;
+		m_pending_allocations.clear();
+		return true;
+	}
+
+	void ResidencyManager::update(uint64_t completed_fence_value, uint64_t completed_copy_fence_value)
+	{
+		PROFILE_FUNCTION();
+
+		m_budget = m_backend.query_budget();
+
+		const auto threshold_bytes = static_cast<uint64_t>(static_cast<double>(m_budget.budget_bytes) * m_desc.evict_threshold);
+		if (m_budget.usage_bytes <= threshold_bytes)
+		{
+			return;
+		}
+		++m_counters.over_budget_updates;
+
+		const auto target_bytes = static_cast<uint64_t>(static_cast<double>(m_budget.budget_bytes) * m_desc.evict_target);
+		const uint64_t excess_bytes = m_budget.usage_bytes - target_bytes;
+
+		m_objects.clear();
+		uint64_t evicted_bytes = 0;
+		uint32_t allocation_id = m_lru_head;
+		while (evicted_bytes < excess_bytes && allocation_id != invalid_allocation)
+		{
+			Allocation& allocation = m_allocations[allocation_id];
+			// Everything after it was used even later
+			if (allocation.last_used_fence_value > completed_fence_value)
+			{
+				break;
+			}
+			const uint32_t next_allocation_id = allocation.next;
+			// Copies do not follow the order of the other queue, the ones after it may be done
+			if (allocation.last_used_copy_fence_value > completed_copy_fence_value)
+			{
+				allocation_id = next_allocation_id;
+				continue;
+			}
+
+			unlink(allocation_id);
+			allocation.is_resident = false;
+			m_objects.push_back(allocation.object);
+			evicted_bytes += allocation.size;
+			allocation_id = next_allocation_id;
+		}
+
+		if (evicted_bytes < excess_bytes)
+		{
+			++m_counters.stalled_evictions;
+		}
+		if (m_objects.empty())
+		{
+			return;
+		}
+
+		m_backend.evict(m_objects.data(), static_cast<uint32_t>(m_objects.size()));
+		m_counters.evictions += m_objects.size();
+		m_counters.evicted_bytes += evicted_bytes;
+		m_resident_bytes -= evicted_bytes;
+		// Until the next query reflects the eviction
+		m_budget.usage_bytes -= std::min(evicted_bytes, m_budget.usage_bytes);
+	}
+
+	bool ResidencyManager::is_resident(uint32_t allocation_id) const
+	{
+		return m_allocations[allocation_id].is_resident;
+	}
+
+	uint32_t ResidencyManager::allocation_count() const
+	{
+		return m_allocation_count;
+	}
+
+	uint64_t ResidencyManager::resident_bytes() const
+	{
+		return m_resident_bytes;
+	}
+
+	const MemoryBudget& ResidencyManager::budget() const
+	{
+		return m_budget;
+	}
+
+	const ResidencyCounters& ResidencyManager::counters() const
+	{
+		return m_counters;
+	}
+
+	void ResidencyManager::link(uint32_t allocation_id)
+	{
+		Allocation& allocation = m_allocations[allocation_id];
+		allocation.previous = m_lru_tail;
+		allocation.next = invalid_allocation;
+		if (m_lru_tail != invalid_allocation)
+		{
+			m_allocations[m_lru_tail].next = allocation_id;
+		}
+		else
+		{
+			m_lru_head = allocation_id;
+		}
+		m_lru_tail = allocation_id;
+	}
+
+	void ResidencyManager::unlink(uint32_t allocation_id)
+	{
+		Allocation& allocation = m_allocations[allocation_id];
+		if (allocation.previous != invalid_allocation)
+		{
+			m_allocations[allocation.previous].next = allocation.next;
+		}
+		else
+		{
+			m_lru_head = allocation.next;
+		}
+		if (allocation.next != invalid_allocation)
+		{
+			m_allocations[allocation.next].previous = allocation.previous;
+		}
+		else
+		{
+			m_lru_tail = allocation.previous;
+		}
+		allocation.previous = invalid_allocation;
+		allocation.next = invalid_allocation;
+	}
+
+}
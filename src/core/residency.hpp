@@ -0,0 +1,126 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_RESIDENCY_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_RESIDENCY_HPP
+
+#include <cstdint>
+#include <vector>
+
+namespace Core
+{
+
+	struct MemoryBudget
+	{
+		// What the OS grants the process right now, it changes with other applications
+		uint64_t budget_bytes = 0;
+		uint64_t usage_bytes = 0;
+	};
+
+	// Moves the memory of one backend in and out of the GPU's memory segment.
+	// The objects are the ones passed to ResidencyManager::track().
+	class ResidencyBackend
+	{
+	public:
+		virtual ~ResidencyBackend() = default;
+
+		virtual MemoryBudget query_budget() = 0;
+		virtual void evict(void* const* objects, uint32_t count) = 0;
+		// Blocks until the objects are usable again, false when they do not fit
+		virtual bool make_resident(void* const* objects, uint32_t count) = 0;
+	};
+
+	struct ResidencyDesc
+	{
+		// Eviction starts above evict_threshold of the budget and goes down to evict_target,
+		// so a usage hovering around the budget does not evict a little every frame
+		double evict_threshold = 0.95;
+		double evict_target = 0.85;
+	};
+
+	struct ResidencyCounters
+	{
+		uint64_t evictions = 0;
+		uint64_t evicted_bytes = 0;
+		uint64_t make_residents = 0;
+		uint64_t made_resident_bytes = 0;
+		uint64_t failed_make_residents = 0;
+		// update() calls that found the usage above the threshold
+		uint64_t over_budget_updates = 0;
+		// ...and could not get below the target because the GPU still used everything else
+		uint64_t stalled_evictions = 0;
+	};
+
+	// Keeps the tracked allocations (heaps, committed resources) under the memory budget.
+	// Allocations are ordered by the fence value of the last submission using them and
+	// the least recently used ones the GPU finished with are evicted first. Evicted
+	// allocations become resident again before the next submission that uses them.
+	// Only for the render thread.
+	class ResidencyManager
+	{
+	public:
+		static constexpr uint32_t invalid_allocation = UINT32_MAX;
+
+		explicit ResidencyManager(ResidencyBackend& backend, const ResidencyDesc& desc = {});
+		ResidencyManager(const ResidencyManager&) = delete;
+		ResidencyManager& operator=(const ResidencyManager&) = delete;
+
+		// New allocations are resident. Returns the id the other calls take.
+		uint32_t track(void* object, uint64_t size);
+		// Call once the GPU no longer uses the allocation, before it is released
+		void untrack(uint32_t allocation_id);
+
+		// The submission signalling fence_value uses the allocation. Fence values never decrease.
+		void use(uint32_t allocation_id, uint64_t fence_value);
+		// Work on a second queue with a fence of its own (copies) uses it as well, the
+		// allocation is not evicted before that fence passed copy_fence_value either
+		void use(uint32_t allocation_id, uint64_t fence_value, uint64_t copy_fence_value);
+		// Makes the evicted allocations used since the last call resident again,
+		// call right before submitting the work using them
+		bool make_resident();
+
+		// Queries the budget and evicts when over it, call once per frame. Without a copy
+		// queue every copy counts as completed.
+		void update(uint64_t completed_fence_value, uint64_t completed_copy_fence_value = UINT64_MAX);
+
+		bool is_resident(uint32_t allocation_id) const;
+		uint32_t allocation_count() const;
+		uint64_t resident_bytes() const;
+		const MemoryBudget& budget() const;
+		const ResidencyCounters& counters() const;
+	private:
+		struct Allocation
+		{
+			void* object = nullptr;
+			uint64_t size = 0;
+			uint64_t last_used_fence_value = 0;
+			uint64_t last_used_copy_fence_value = 0;
+			// Neighbours in the LRU list of resident allocations, or the free list
+			uint32_t previous = invalid_allocation;
+			uint32_t next = invalid_allocation;
+			bool is_tracked = false;
+			bool is_resident = false;
+			bool is_pending = false;
+		};
+
+		void link(uint32_t allocation_id);
+		void unlink(uint32_t allocation_id);
+
+		ResidencyBackend& m_backend;
+		ResidencyDesc m_desc;
+
+		std::vector<Allocation> m_allocations;
+		uint32_t m_free_allocation = invalid_allocation;
+		uint32_t m_allocation_count = 0;
+		// Oldest first
+		uint32_t m_lru_head = invalid_allocation;
+		uint32_t m_lru_tail = invalid_allocation;
+		uint64_t m_resident_bytes = 0;
+
+		std::vector<uint32_t> m_pending_allocations;
+		std::vector<void*> m_objects;
+
+		MemoryBudget m_budget;
+		ResidencyCounters m_counters;
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_RESIDENCY_HPP
@@ -0,0 +1,70 @@
+#include "scene.hpp"
+
+#include <algorithm>
+
+#include "profiler.hpp"
+#include "render_backend.hpp"
+#include "render_queue.hpp"
+
+namespace Core
+{
+
+	const Vertex scene_vertices[3] = {
+		{
+			{ 1.0f, 0.0f, 0.0f, 1.0f },
+			{ 0.0f, 0.5f }
+		},
+		{
+			{ 0.0f, 1.0f, 0.0f, 1.0f },
+			{ 1.0f, -0.5f }
+		},
+		{
+			{ 0.0f, 0.0f, 1.0f, 1.0f },
+			{ -0.5f, -0.5f }
+		},
+	};
+
+	namespace
+	{
+		void add_draws(const SceneConfig& scene_config, RenderQueue& render_queue)
+		{
+			const uint32_t pipeline_count = std::clamp(scene_config.pipeline_count, 1U, 1U << sort_key_pipeline_bits);
+			const uint32_t material_count = std::clamp(scene_config.material_count, 1U, 1U << sort_key_material_bits);
+			render_queue.clear();
+			for (uint32_t draw_idx = 0; draw_idx < scene_config.draw_count; ++draw_idx)
+			{
+				const uint32_t pipeline = draw_idx % pipeline_count;
+				const uint32_t material = draw_idx % material_count;
+				const float depth = static_cast<float>(draw_idx) / static_cast<float>(scene_config.draw_count);
+				render_queue.add(make_sort_key(0, 0, pipeline, material, depth), { pipeline, material, 3, 0 });
+			}
+		}
+
+		void submit_frame(RenderBackend& backend, const SceneConfig& scene_config, const RenderQueue& render_queue)
+		{
+			backend.begin_frame();
+			backend.clear(scene_config.clear_color);
+			render_queue.submit(backend);
+			backend.end_frame();
+		}
+	}
+
+	void render_scene(RenderBackend& backend, const SceneConfig& scene_config, RenderQueue& render_queue)
+	{
+		PROFILE_FUNCTION();
+
+		add_draws(scene_config, render_queue);
+		render_queue.sort();
+		submit_frame(backend, scene_config, render_queue);
+	}
+
+	void render_scene(JobSystem& job_system, RenderBackend& backend, const SceneConfig& scene_config, RenderQueue& render_queue)
+	{
+		PROFILE_FUNCTION();
+
+		add_draws(scene_config, render_queue);
+		render_queue.sort(job_system);
+		submit_frame(backend, scene_config, render_queue);
+	}
+
+}
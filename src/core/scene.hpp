@@ -0,0 +1,42 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_SCENE_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_SCENE_HPP
+
+#include <cstdint>
+
+#include "simd_math.hpp"
+
+namespace Core
+{
+
+	class JobSystem;
+	class RenderBackend;
+	class RenderQueue;
+
+	struct Vertex
+	{
+		Float4 color;
+		Float2 pos;
+	};
+
+	// The vertex buffer every backend draws from, positions are in clip space
+	extern const Vertex scene_vertices[3];
+
+	struct SceneConfig
+	{
+		float clear_color[4] = { 0.4f, 0.6f, 0.9f, 1.0f };
+		// Number of times scene_vertices is drawn every frame
+		uint32_t draw_count = 1;
+		// The draws take turns using these, so in the order they are made every draw
+		// changes both
+		uint32_t pipeline_count = 1;
+		uint32_t material_count = 1;
+	};
+
+	// Records one frame of the scene through the render queue, without presenting it
+	void render_scene(RenderBackend& backend, const SceneConfig& scene_config, RenderQueue& render_queue);
+	// The same with large queues sorted on the job system
+	void render_scene(JobSystem& job_system, RenderBackend& backend, const SceneConfig& scene_config, RenderQueue& render_queue);
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_SCENE_HPP
@@ -0,0 +1,238 @@
+#include "shader_hot_reload.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include "file_watcher.hpp"
+#include "profiler.hpp"
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace Core
+{
+
+	namespace
+	{
+		constexpr std::chrono::milliseconds poll_interval(100);
+		// Saves often arrive as several events, the editor gets this long to finish writing
+		constexpr std::chrono::milliseconds settle_time(50);
+
+		std::string quote(const std::string& argument)
+		{
+			return "\"" + argument + "\"";
+		}
+
+		bool ends_with(const std::string& text, const char* suffix)
+		{
+			const size_t length = std::char_traits<char>::length(suffix);
+			return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+		}
+
+		std::string read_file(const std::filesystem::path& path)
+		{
+			std::ifstream file(path, std::ios::binary);
+			return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+	}
+
+	bool compile_shader_file(
+		const std::string& compiler_path,
+		const std::string& path,
+		const ShaderSource& source,
+		std::vector<unsigned char>& bytecode,
+		std::string& errors)
+	{
+		static std::atomic<uint32_t> s_compile_idx{ 0 };
+
+#if defined(_WIN32)
+		const int process_id = _getpid();
+#else
+		const int process_id = static_cast<int>(getpid());
+#endif
+		const auto temp_directory = std::filesystem::temp_directory_path();
+		const std::string file_stem = "playground_shader_" + std::to_string(process_id) + "_" + std::to_string(s_compile_idx++);
+		const auto output_path = temp_directory / (file_stem + ".cso");
+		const auto log_path = temp_directory / (file_stem + ".log");
+
+		// Both fxc and dxc accept - as well as / in front of their options
+		std::ostringstream command;
+		command << quote(compiler_path) << " -nologo -T " << quote(source.profile) << " -E " << quote(source.entry);
+		for (const auto& define : source.defines)
+		{
+			command << " -D " << quote(define);
+		}
+		command << " -Fo " << quote(output_path.string()) << " " << quote(path)
+			<< " > " << quote(log_path.string()) << " 2>&1";
+
+#if defined(_WIN32)
+		// cmd.exe strips the outermost quotes of the command line
+		const std::string command_line = quote(command.str());
+#else
+		const std::string command_line = command.str();
+#endif
+
+		const int result = std::system(command_line.c_str());
+
+		errors = read_file(log_path);
+		const std::string output = result == 0 ? read_file(output_path) : std::string();
+		bytecode.assign(output.begin(), output.end());
+
+		std::error_code error;
+		std::filesystem::remove(output_path, error);
+		std::filesystem::remove(log_path, error);
+
+		return result == 0 && !bytecode.empty();
+	}
+
+	ShaderHotReload::ShaderHotReload(const std::string& directory, ShaderCompileFn compile) :
+		m_directory(directory),
+		m_compile(std::move(compile))
+	{
+		m_compile_thread = std::thread(&ShaderHotReload::compile_thread_main, this);
+	}
+
+	ShaderHotReload::~ShaderHotReload()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_stop_mutex);
+			m_is_running = false;
+		}
+		m_stop_condition.notify_all();
+		m_compile_thread.join();
+	}
+
+	bool ShaderHotReload::is_watching() const
+	{
+		return m_is_watching.load();
+	}
+
+	uint32_t ShaderHotReload::add_shader(const ShaderSource& source)
+	{
+		std::lock_guard<std::mutex> lock(m_shaders_mutex);
+		m_shaders.push_back(source);
+		return static_cast<uint32_t>(m_shaders.size() - 1);
+	}
+
+	std::vector<ShaderReload> ShaderHotReload::take_reloads()
+	{
+		std::vector<ShaderReload> reloads;
+
+		std::unique_lock<std::mutex> lock(m_reloads_mutex, std::try_to_lock);
+		if (lock.owns_lock())
+		{
+			reloads.swap(m_reloads);
+		}
+		return reloads;
+	}
+
+	uint64_t ShaderHotReload::compile_count() const
+	{
+		return m_compile_count.load();
+	}
+
+	uint64_t ShaderHotReload::failed_compile_count() const
+	{
+		return m_failed_compile_count.load();
+	}
+
+	void ShaderHotReload::compile_thread_main()
+	{
+		PROFILE_THREAD_NAME("Shader Hot Reload");
+
+		FileWatcher watcher(m_directory);
+		m_is_watching.store(watcher.is_valid());
+
+		std::unique_lock<std::mutex> stop_lock(m_stop_mutex);
+		while (!m_stop_condition.wait_for(stop_lock, poll_interval, [this] { return !m_is_running; }))
+		{
+			stop_lock.unlock();
+
+			auto changed_files = watcher.poll();
+			if (!changed_files.empty())
+			{
+				std::this_thread::sleep_for(settle_time);
+				for (auto& file_name : watcher.poll())
+				{
+					if (std::find(changed_files.begin(), changed_files.end(), file_name) == changed_files.end())
+					{
+						changed_files.push_back(std::move(file_name));
+					}
+				}
+
+				const bool is_include_changed = std::any_of(changed_files.begin(), changed_files.end(), [](const std::string& file_name)
+				{
+					return ends_with(file_name, ".hlsli");
+				});
+
+				std::vector<ShaderSource> shaders;
+				{
+					std::lock_guard<std::mutex> lock(m_shaders_mutex);
+					shaders = m_shaders;
+				}
+
+				for (uint32_t shader_idx = 0; shader_idx < shaders.size(); ++shader_idx)
+				{
+					const ShaderSource& source = shaders[shader_idx];
+					const bool is_changed = is_include_changed
+						|| std::find(changed_files.begin(), changed_files.end(), source.file_name) != changed_files.end();
+					if (!is_changed)
+					{
+						continue;
+					}
+
+					ShaderReload reload;
+					reload.shader_id = shader_idx;
+					{
+						PROFILE_ZONE("Compile shader");
+						reload.is_compiled = m_compile(m_directory + "/" + source.file_name, source, reload.bytecode, reload.errors);
+					}
+
+					const bool is_compiled = reload.is_compiled;
+					{
+						std::lock_guard<std::mutex> lock(m_reloads_mutex);
+						// A newer result replaces one of the same kind the render thread did not pick up
+						// yet. A failure keeps a pending success, a success makes a pending failure stale.
+						if (is_compiled)
+						{
+							m_reloads.erase(std::remove_if(m_reloads.begin(), m_reloads.end(), [shader_idx](const ShaderReload& pending_reload)
+							{
+								return pending_reload.shader_id == shader_idx && !pending_reload.is_compiled;
+							}), m_reloads.end());
+						}
+						auto pending = std::find_if(m_reloads.begin(), m_reloads.end(), [shader_idx, is_compiled](const ShaderReload& pending_reload)
+						{
+							return pending_reload.shader_id == shader_idx && pending_reload.is_compiled == is_compiled;
+						});
+						if (pending != m_reloads.end())
+						{
+							*pending = std::move(reload);
+						}
+						else
+						{
+							m_reloads.push_back(std::move(reload));
+						}
+					}
+
+					// Counted once published, a counted compile is always in take_reloads()
+					m_compile_count.fetch_add(1);
+					if (!is_compiled)
+					{
+						m_failed_compile_count.fetch_add(1);
+					}
+				}
+			}
+
+			stop_lock.lock();
+		}
+	}
+
+}
@@ -0,0 +1,95 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_SHADER_HOT_RELOAD_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_SHADER_HOT_RELOAD_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Core
+{
+
+	struct ShaderSource
+	{
+		// Relative to the watched directory
+		std::string file_name;
+		std::string profile;
+		std::string entry = "main";
+		// NAME=VALUE
+		std::vector<std::string> defines;
+	};
+
+	// Fills bytecode, or errors when the source does not compile
+	using ShaderCompileFn = std::function<bool(const std::string& path, const ShaderSource& source, std::vector<unsigned char>& bytecode, std::string& errors)>;
+
+	// Runs the command line compiler (dxc, or fxc for shader model 5) in a child process,
+	// with the same arguments add_hlsl uses.
+	bool compile_shader_file(
+		const std::string& compiler_path,
+		const std::string& path,
+		const ShaderSource& source,
+		std::vector<unsigned char>& bytecode,
+		std::string& errors);
+
+	struct ShaderReload
+	{
+		uint32_t shader_id = 0;
+		bool is_compiled = false;
+		std::vector<unsigned char> bytecode;
+		std::string errors;
+	};
+
+	// Watches the shader directory and recompiles every added shader whose source
+	// changed on a background thread. Any changed .hlsli recompiles all of them.
+	// The render thread picks up the results between frames with take_reloads(),
+	// shaders that fail to compile keep their previous bytecode. Per shader it holds
+	// the latest success and the latest failure after it, so a broken save right
+	// after a good one still reports the error without losing the good bytecode.
+	class ShaderHotReload
+	{
+	public:
+		ShaderHotReload(const std::string& directory, ShaderCompileFn compile);
+		ShaderHotReload(const ShaderHotReload&) = delete;
+		ShaderHotReload& operator=(const ShaderHotReload&) = delete;
+		~ShaderHotReload();
+
+		bool is_watching() const;
+
+		// Returns the id the shader's reloads are reported with
+		uint32_t add_shader(const ShaderSource& source);
+
+		// Never blocks: while the compile thread publishes results it returns nothing,
+		// they are handed out on the next call.
+		std::vector<ShaderReload> take_reloads();
+
+		uint64_t compile_count() const;
+		uint64_t failed_compile_count() const;
+	private:
+		void compile_thread_main();
+
+		std::string m_directory;
+		ShaderCompileFn m_compile;
+
+		std::mutex m_shaders_mutex;
+		std::vector<ShaderSource> m_shaders;
+
+		std::mutex m_reloads_mutex;
+		std::vector<ShaderReload> m_reloads;
+
+		std::atomic<uint64_t> m_compile_count{ 0 };
+		std::atomic<uint64_t> m_failed_compile_count{ 0 };
+		std::atomic<bool> m_is_watching{ false };
+
+		std::mutex m_stop_mutex;
+		std::condition_variable m_stop_condition;
+		bool m_is_running = true;
+		std::thread m_compile_thread;
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_SHADER_HOT_RELOAD_HPP
@@ -0,0 +1,53 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_SHADER_PERMUTATION_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_SHADER_PERMUTATION_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "shader_reflection.hpp"
+
+namespace Core
+{
+
+	struct ShaderBytecode
+	{
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+		const ShaderReflection* reflection = nullptr;
+	};
+
+	// Bitmask of enabled features, bit i is the i-th feature the shader declares
+	using ShaderKey = uint32_t;
+
+	// Every permutation of one shader stage, indexed by its key.
+	// Generated by add_hlsl_permutations, permutations that were not built stay empty.
+	template<size_t Count>
+	struct ShaderPermutations
+	{
+		static_assert(Count > 0 && (Count & (Count - 1)) == 0, "One permutation per combination of feature bits");
+
+		ShaderBytecode variants[Count];
+
+		constexpr const ShaderBytecode& operator[](ShaderKey key) const
+		{
+			assert(key < Count && variants[key].data != nullptr);
+			return variants[key];
+		}
+
+		template<ShaderKey Key>
+		constexpr const ShaderBytecode& select() const
+		{
+			static_assert(Key < Count, "Key uses a feature bit the shader does not declare");
+			return (*this)[Key];
+		}
+
+		constexpr bool contains(ShaderKey key) const
+		{
+			return key < Count && variants[key].data != nullptr;
+		}
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_SHADER_PERMUTATION_HPP
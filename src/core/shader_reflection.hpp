@@ -0,0 +1,75 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_SHADER_REFLECTION_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_SHADER_REFLECTION_HPP
+
+#include <cassert>
+#include <cstdint>
+
+namespace Core
+{
+
+	enum class ShaderComponentType : uint8_t
+	{
+		Float,
+		Int,
+		Uint,
+	};
+
+	// One vertex shader input as the input assembler has to feed it. Inputs whose
+	// semantic starts with "Instance" are read per instance from slot 1, all others
+	// per vertex from slot 0. Offsets assume tightly packed 32 bit components.
+	struct ShaderInputElement
+	{
+		const char* semantic;
+		uint32_t semantic_idx;
+		ShaderComponentType component_type;
+		uint32_t component_count;
+		uint32_t input_slot;
+		bool is_per_instance;
+		uint32_t offset;
+	};
+
+	// The DXGI_FORMAT of the 32 bit components, as a number so this builds without the Windows headers
+	inline uint32_t input_element_dxgi_format(const ShaderInputElement& input)
+	{
+		// R32, R32G32, R32G32B32 and R32G32B32A32 of each component type
+		constexpr uint32_t formats[3][4] =
+		{
+			{ 41, 16, 6, 2 },
+			{ 43, 18, 8, 4 },
+			{ 42, 17, 7, 3 },
+		};
+		assert(input.component_count >= 1 && input.component_count <= 4);
+		return formats[static_cast<uint32_t>(input.component_type)][input.component_count - 1];
+	}
+
+	enum class ShaderResourceType : uint8_t
+	{
+		ConstantBuffer,
+		ShaderResource,
+		UnorderedAccess,
+		Sampler,
+	};
+
+	struct ShaderResourceBinding
+	{
+		const char* name;
+		ShaderResourceType type;
+		uint32_t bind_point;
+		uint32_t space;
+		// UINT32_MAX for unbounded arrays
+		uint32_t count;
+	};
+
+	// What the build extracted from the compiler listing of a shader,
+	// the renderers never reflect bytecode at runtime.
+	struct ShaderReflection
+	{
+		const ShaderInputElement* inputs;
+		uint32_t input_count;
+		const ShaderResourceBinding* resources;
+		uint32_t resource_count;
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_SHADER_REFLECTION_HPP
@@ -0,0 +1,226 @@
+#include "simd_math.hpp"
+
+#include <algorithm>
+
+#if defined(DIRECTX_PLAYGROUND_MATH_SCALAR)
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_MATH_AVX2
+#endif
+
+namespace Core
+{
+
+	namespace
+	{
+		// The batch kernels are written once against these wrappers, one vector per lane
+#if defined(SIMD_MATH_AVX2)
+		struct Lanes
+		{
+			static constexpr size_t count = 8;
+			using Float = __m256;
+
+			static Float splat(float value) { return _mm256_set1_ps(value); }
+			static Float load(const float* source) { return _mm256_loadu_ps(source); }
+			static void store(float* destination, Float value) { _mm256_storeu_ps(destination, value); }
+			static Float mul_add(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+		};
+#elif defined(DIRECTX_PLAYGROUND_MATH_SSE2)
+		struct Lanes
+		{
+			static constexpr size_t count = 4;
+			using Float = __m128;
+
+			static Float splat(float value) { return _mm_set1_ps(value); }
+			static Float load(const float* source) { return _mm_loadu_ps(source); }
+			static void store(float* destination, Float value) { _mm_storeu_ps(destination, value); }
+			static Float mul_add(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		};
+#elif defined(DIRECTX_PLAYGROUND_MATH_NEON)
+		struct Lanes
+		{
+			static constexpr size_t count = 4;
+			using Float = float32x4_t;
+
+			static Float splat(float value) { return vdupq_n_f32(value); }
+			static Float load(const float* source) { return vld1q_f32(source); }
+			static void store(float* destination, Float value) { vst1q_f32(destination, value); }
+			static Float mul_add(Float a, Float b, Float c) { return vmlaq_f32(c, a, b); }
+		};
+#endif
+
+		// The remainder of a batch, and everything without SIMD
+		struct ScalarLanes
+		{
+			static constexpr size_t count = 1;
+			using Float = float;
+
+			static Float splat(float value) { return value; }
+			static Float load(const float* source) { return *source; }
+			static void store(float* destination, Float value) { *destination = value; }
+			static Float mul_add(Float a, Float b, Float c) { return a * b + c; }
+		};
+
+		float get_component(const Float4& value, uint32_t component_idx)
+		{
+			const float components[4] = { value.x, value.y, value.z, value.w };
+			return components[component_idx];
+		}
+
+		// Column column_idx of the matrix, with the translation when Translated
+		template<typename L, bool Translated>
+		struct MatrixColumn
+		{
+			typename L::Float m0;
+			typename L::Float m1;
+			typename L::Float m2;
+			typename L::Float m3;
+
+			MatrixColumn(const Float4x4& matrix, uint32_t column_idx) :
+				m0(L::splat(get_component(matrix.rows[0], column_idx))),
+				m1(L::splat(get_component(matrix.rows[1], column_idx))),
+				m2(L::splat(get_component(matrix.rows[2], column_idx))),
+				m3(L::splat(Translated ? get_component(matrix.rows[3], column_idx) : 0.0f))
+			{
+			}
+
+			typename L::Float apply(typename L::Float x, typename L::Float y, typename L::Float z) const
+			{
+				return L::mul_add(x, m0, L::mul_add(y, m1, L::mul_add(z, m2, m3)));
+			}
+		};
+
+		template<typename L>
+		size_t transform_points(const Float4x4& matrix, const Float3Batch& points, size_t begin, size_t count, const Float4BatchOutput& result)
+		{
+			const MatrixColumn<L, true> columns[4] = { { matrix, 0 }, { matrix, 1 }, { matrix, 2 }, { matrix, 3 } };
+			size_t vector_idx = begin;
+			for (; vector_idx + L::count <= count; vector_idx += L::count)
+			{
+				const typename L::Float x = L::load(points.x + vector_idx);
+				const typename L::Float y = L::load(points.y + vector_idx);
+				const typename L::Float z = L::load(points.z + vector_idx);
+				L::store(result.x + vector_idx, columns[0].apply(x, y, z));
+				L::store(result.y + vector_idx, columns[1].apply(x, y, z));
+				L::store(result.z + vector_idx, columns[2].apply(x, y, z));
+				L::store(result.w + vector_idx, columns[3].apply(x, y, z));
+			}
+			return vector_idx;
+		}
+
+		template<typename L>
+		size_t transform_directions(const Float4x4& matrix, const Float3Batch& directions, size_t begin, size_t count, const Float3BatchOutput& result)
+		{
+			const MatrixColumn<L, false> columns[3] = { { matrix, 0 }, { matrix, 1 }, { matrix, 2 } };
+			size_t vector_idx = begin;
+			for (; vector_idx + L::count <= count; vector_idx += L::count)
+			{
+				const typename L::Float x = L::load(directions.x + vector_idx);
+				const typename L::Float y = L::load(directions.y + vector_idx);
+				const typename L::Float z = L::load(directions.z + vector_idx);
+				L::store(result.x + vector_idx, columns[0].apply(x, y, z));
+				L::store(result.y + vector_idx, columns[1].apply(x, y, z));
+				L::store(result.z + vector_idx, columns[2].apply(x, y, z));
+			}
+			return vector_idx;
+		}
+	}
+
+	Matrix matrix_inverse(const Matrix& matrix)
+	{
+		// Cofactors over 2x2 sub-determinants of the top and bottom row pairs
+		Float4x4 stored;
+		store(stored, matrix);
+		float m[16];
+		for (uint32_t element_idx = 0; element_idx < 16; ++element_idx)
+		{
+			m[element_idx] = get_component(stored.rows[element_idx / 4], element_idx % 4);
+		}
+
+		const float top[6] = {
+			m[0] * m[5] - m[1] * m[4],
+			m[0] * m[6] - m[2] * m[4],
+			m[0] * m[7] - m[3] * m[4],
+			m[1] * m[6] - m[2] * m[5],
+			m[1] * m[7] - m[3] * m[5],
+			m[2] * m[7] - m[3] * m[6],
+		};
+		const float bottom[6] = {
+			m[8] * m[13] - m[9] * m[12],
+			m[8] * m[14] - m[10] * m[12],
+			m[8] * m[15] - m[11] * m[12],
+			m[9] * m[14] - m[10] * m[13],
+			m[9] * m[15] - m[11] * m[13],
+			m[10] * m[15] - m[11] * m[14],
+		};
+
+		const float determinant =
+			top[0] * bottom[5] - top[1] * bottom[4] + top[2] * bottom[3]
+			+ top[3] * bottom[2] - top[4] * bottom[1] + top[5] * bottom[0];
+		const float scale = 1.0f / determinant;
+
+		return Matrix{ {
+			vector_scale(vector_set(
+				m[5] * bottom[5] - m[6] * bottom[4] + m[7] * bottom[3],
+				-m[1] * bottom[5] + m[2] * bottom[4] - m[3] * bottom[3],
+				m[13] * top[5] - m[14] * top[4] + m[15] * top[3],
+				-m[9] * top[5] + m[10] * top[4] - m[11] * top[3]), scale),
+			vector_scale(vector_set(
+				-m[4] * bottom[5] + m[6] * bottom[2] - m[7] * bottom[1],
+				m[0] * bottom[5] - m[2] * bottom[2] + m[3] * bottom[1],
+				-m[12] * top[5] + m[14] * top[2] - m[15] * top[1],
+				m[8] * top[5] - m[10] * top[2] + m[11] * top[1]), scale),
+			vector_scale(vector_set(
+				m[4] * bottom[4] - m[5] * bottom[2] + m[7] * bottom[0],
+				-m[0] * bottom[4] + m[1] * bottom[2] - m[3] * bottom[0],
+				m[12] * top[4] - m[13] * top[2] + m[15] * top[0],
+				-m[8] * top[4] + m[9] * top[2] - m[11] * top[0]), scale),
+			vector_scale(vector_set(
+				-m[4] * bottom[3] + m[5] * bottom[1] - m[6] * bottom[0],
+				m[0] * bottom[3] - m[1] * bottom[1] + m[2] * bottom[0],
+				-m[12] * top[3] + m[13] * top[1] - m[14] * top[0],
+				m[8] * top[3] - m[9] * top[1] + m[10] * top[0]), scale),
+		} };
+	}
+
+	Vector quaternion_slerp(Vector a, Vector b, float t)
+	{
+		float cos_angle = dot4(a, b);
+		if (cos_angle < 0.0f)
+		{
+			b = vector_negate(b);
+			cos_angle = -cos_angle;
+		}
+
+		// Nearly the same rotation, where the sine below loses all precision
+		if (cos_angle > 0.9995f)
+		{
+			return normalize4(vector_lerp(a, b, t));
+		}
+
+		const float angle = std::acos(std::min(cos_angle, 1.0f));
+		const float inverse_sin = 1.0f / std::sin(angle);
+		return vector_add(
+			vector_scale(a, std::sin((1.0f - t) * angle) * inverse_sin),
+			vector_scale(b, std::sin(t * angle) * inverse_sin));
+	}
+
+	void transform_points(const Float4x4& matrix, const Float3Batch& points, size_t count, const Float4BatchOutput& result)
+	{
+		size_t vector_idx = 0;
+#if defined(SIMD_MATH_AVX2) || defined(DIRECTX_PLAYGROUND_MATH_SSE2) || defined(DIRECTX_PLAYGROUND_MATH_NEON)
+		vector_idx = transform_points<Lanes>(matrix, points, vector_idx, count, result);
+#endif
+		transform_points<ScalarLanes>(matrix, points, vector_idx, count, result);
+	}
+
+	void transform_directions(const Float4x4& matrix, const Float3Batch& directions, size_t count, const Float3BatchOutput& result)
+	{
+		size_t vector_idx = 0;
+#if defined(SIMD_MATH_AVX2) || defined(DIRECTX_PLAYGROUND_MATH_SSE2) || defined(DIRECTX_PLAYGROUND_MATH_NEON)
+		vector_idx = transform_directions<Lanes>(matrix, directions, vector_idx, count, result);
+#endif
+		transform_directions<ScalarLanes>(matrix, directions, vector_idx, count, result);
+	}
+
+}
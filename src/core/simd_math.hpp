@@ -0,0 +1,506 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_SIMD_MATH_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_SIMD_MATH_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// The inline functions below only use what every translation unit of a build has, so that
+// they are the same everywhere no matter which files get AVX2. The batch kernels in
+// simd_math.cpp go wider. DIRECTX_PLAYGROUND_MATH_SCALAR forces the plain C++ fallback.
+#if defined(DIRECTX_PLAYGROUND_MATH_SCALAR)
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DIRECTX_PLAYGROUND_MATH_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define DIRECTX_PLAYGROUND_MATH_NEON
+#endif
+
+namespace Core
+{
+
+	// Storage types, for vertex and constant buffers, files and anything else kept in memory
+	struct Float2
+	{
+		float x;
+		float y;
+	};
+
+	struct Float3
+	{
+		float x;
+		float y;
+		float z;
+	};
+
+	struct Float4
+	{
+		float x;
+		float y;
+		float z;
+		float w;
+	};
+
+	// Row major, vectors are rows multiplied from the left as in HLSL's mul(v, m), so
+	// a * b applies a first
+	struct Float4x4
+	{
+		Float4 rows[4];
+	};
+
+	// Register types, loaded from the storage types, computed with and stored back.
+	// Quaternions are vectors (x, y, z, w) with w the real part.
+#if defined(DIRECTX_PLAYGROUND_MATH_SSE2)
+	using Vector = __m128;
+#elif defined(DIRECTX_PLAYGROUND_MATH_NEON)
+	using Vector = float32x4_t;
+#else
+	struct Vector
+	{
+		float lanes[4];
+	};
+#endif
+
+	struct Matrix
+	{
+		Vector rows[4];
+	};
+
+	// Everything else is written once against these
+
+	inline Vector vector_set(float x, float y, float z, float w)
+	{
+#if defined(DIRECTX_PLAYGROUND_MATH_SSE2)
+		return _mm_setr_ps(x, y, z, w);
+#elif defined(DIRECTX_PLAYGROUND_MATH_NEON)
+		const float values[4] = { x, y, z, w };
+		return vld1q_f32(values);
+#else
+		return Vector{ { x, y, z, w } };
+#endif
+	}
+
+	inline Vector vector_splat(float value)
+	{
+#if defined(DIRECTX_PLAYGROUND_MATH_SSE2)
+		return _mm_set1_ps(value);
+#elif defined(DIRECTX_PLAYGROUND_MATH_NEON)
+		return vdupq_n_f32(value);
+#else
+		return Vector{ { value, value, value, value } };
+#endif
+	}
+
+	inline Vector vector_zero()
+	{
+		return vector_splat(0.0f);
+	}
+
+	inline Vector load(const Float4& value)
+	{
+#if defined(DIRECTX_PLAYGROUND_MATH_SSE2)
+		return _mm_loadu_ps(&value.x);
+#elif defined(DIRECTX_PLAYGROUND_MATH_NEON)
+		return vld1q_f32(&value.x);
+#else
+		return Vector{ { value.x, value.y, value.z, value.w } };
+#endif
+	}
+
+	// w is 1 for points and 0 for directions
+	inline Vector load(const Float3& value, float w)
+	{
+		return vector_set(value.x, value.y, value.z, w);
+	}
+
+	inline Vector load(const Float2& value, float z, float w)
+	{
+		return vector_set(value.x, value.y, z, w);
+	}
+
+	inline void store(Float4& destination, Vector value)
+	{
+#if defined(DIRECTX_PLAYGROUND_MATH_SSE2)
+		_mm_storeu_ps(&destination.x, value);
+#elif defined(DIRECTX_PLAYGROUND_MATH_NEON)
+		vst1q_f32(&destination.x, value);
+#else
+		destination = Float4{ value.lanes[0], value.lanes[1], value.lanes[2], value.lanes[3] };
+#endif
+	}
+
+	inline void store(Float3& destination, Vector value)
+	{
+		Float4 stored;
+		store(stored, value);
+		destination = Float3{ stored.x, stored.y, stored.z };
+	}
+
+	template<uint32_t Lane>
+	float get_lane(Vector value)
+	{
+		static_assert(Lane < 4, "A vector has four lanes");
+#if defined(DIRECTX_PLAYGROUND_MATH_SSE2)
+		return _mm_cvtss_f32(_mm_shuffle_ps(value, value, _MM_SHUFFLE(Lane, Lane, Lane, Lane)));
+#elif defined(DIRECTX_PLAYGROUND_MATH_NEON)
+		return vgetq_lane_f32(value, Lane);
+#else
+		return value.lanes[Lane];
+#endif
+	}
+
+	// Lane i of the result is lane I of the input, with I the i-th template argument
+	template<uint32_t X, uint32_t Y, uint32_t Z, uint32_t W>
+	Vector swizzle(Vector value)
+	{
+		static_assert(X < 4 && Y < 4 && Z < 4 && W < 4, "A vector has four lanes");
+#if defined(DIRECTX_PLAYGROUND_MATH_SSE2)
+		return _mm_shuffle_ps(value, value, _MM_SHUFFLE(W, Z, Y, X));
+#elif defined(DIRECTX_PLAYGROUND_MATH_NEON)
+		return vector_set(vgetq_lane_f32(value, X), vgetq_lane_f32(value, Y), vgetq_lane_f32(value, Z), vgetq_lane_f32(value, W));
+#else
+		return Vector{ { value.lanes[X], value.lanes[Y], value.lanes[Z], value.lanes[W] } };
+#endif
+	}
+
+	template<uint32_t Lane>
+	Vector splat_lane(Vector value)
+	{
+		return swizzle<Lane, Lane, Lane, Lane>(value);
+	}
+
+	inline Vector vector_add(Vector a, Vector b)
+	{
+#if defined(DIRECTX_PLAYGROUND_MATH_SSE2)
+		return _mm_add_ps(a, b);
+#elif defined(DIRECTX_PLAYGROUND_MATH_NEON)
+		return vaddq_f32(a, b);
+#else
+		return Vector{ { a.lanes[0] + b.lanes[0], a.lanes[1] + b.lanes[1], a.lanes[2] + b.lanes[2], a.lanes[3] + b.lanes[3] } };
+#endif
+	}
+
+	inline Vector vector_subtract(Vector a, Vector b)
+	{
+#if defined(DIRECTX_PLAYGROUND_MATH_SSE2)
+		return _mm_sub_ps(a, b);
+#elif defined(DIRECTX_PLAYGROUND_MATH_NEON)
+		return vsubq_f32(a, b);
+#else
+		return Vector{ { a.lanes[0] - b.lanes[0], a.lanes[1] - b.lanes[1], a.lanes[2] - b.lanes[2], a.lanes[3] - b.lanes[3] } };
+#endif
+	}
+
+	inline Vector vector_multiply(Vector a, Vector b)
+	{
+#if defined(DIRECTX_PLAYGROUND_MATH_SSE2)
+		return _mm_mul_ps(a, b);
+#elif defined(DIRECTX_PLAYGROUND_MATH_NEON)
+		return vmulq_f32(a, b);
+#else
+		return Vector{ { a.lanes[0] * b.lanes[0], a.lanes[1] * b.lanes[1], a.lanes[2] * b.lanes[2], a.lanes[3] * b.lanes[3] } };
+#endif
+	}
+
+	inline Vector vector_divide(Vector a, Vector b)
+	{
+#if defined(DIRECTX_PLAYGROUND_MATH_SSE2)
+		return _mm_div_ps(a, b);
+#elif defined(DIRECTX_PLAYGROUND_MATH_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+		return vdivq_f32(a, b);
+#else
+		Float4 dividend;
+		Float4 divisor;
+		store(dividend, a);
+		store(divisor, b);
+		return vector_set(dividend.x / divisor.x, dividend.y / divisor.y, dividend.z / divisor.z, dividend.w / divisor.w);
+#endif
+	}
+
+	// a * b + c, not fused so that every build rounds the same
+	inline Vector vector_multiply_add(Vector a, Vector b, Vector c)
+	{
+		return vector_add(vector_multiply(a, b), c);
+	}
+
+	inline Vector vector_negate(Vector value)
+	{
+		return vector_subtract(vector_zero(), value);
+	}
+
+	inline Vector vector_min(Vector a, Vector b)
+	{
+#if defined(DIRECTX_PLAYGROUND_MATH_SSE2)
+		return _mm_min_ps(a, b);
+#elif defined(DIRECTX_PLAYGROUND_MATH_NEON)
+		return vminq_f32(a, b);
+#else
+		return Vector{ { std::fmin(a.lanes[0], b.lanes[0]), std::fmin(a.lanes[1], b.lanes[1]), std::fmin(a.lanes[2], b.lanes[2]), std::fmin(a.lanes[3], b.lanes[3]) } };
+#endif
+	}
+
+	inline Vector vector_max(Vector a, Vector b)
+	{
+#if defined(DIRECTX_PLAYGROUND_MATH_SSE2)
+		return _mm_max_ps(a, b);
+#elif defined(DIRECTX_PLAYGROUND_MATH_NEON)
+		return vmaxq_f32(a, b);
+#else
+		return Vector{ { std::fmax(a.lanes[0], b.lanes[0]), std::fmax(a.lanes[1], b.lanes[1]), std::fmax(a.lanes[2], b.lanes[2]), std::fmax(a.lanes[3], b.lanes[3]) } };
+#endif
+	}
+
+	inline Vector vector_scale(Vector value, float scale)
+	{
+		return vector_multiply(value, vector_splat(scale));
+	}
+
+	inline Vector vector_lerp(Vector a, Vector b, float t)
+	{
+		return vector_multiply_add(vector_subtract(b, a), vector_splat(t), a);
+	}
+
+	inline float dot3(Vector a, Vector b)
+	{
+		const Vector product = vector_multiply(a, b);
+		return get_lane<0>(vector_add(vector_add(product, splat_lane<1>(product)), splat_lane<2>(product)));
+	}
+
+	inline float dot4(Vector a, Vector b)
+	{
+		const Vector product = vector_multiply(a, b);
+		const Vector pairs = vector_add(product, swizzle<2, 3, 0, 1>(product));
+		return get_lane<0>(vector_add(pairs, splat_lane<1>(pairs)));
+	}
+
+	// w of the result is 0
+	inline Vector cross3(Vector a, Vector b)
+	{
+		return vector_subtract(
+			vector_multiply(swizzle<1, 2, 0, 3>(a), swizzle<2, 0, 1, 3>(b)),
+			vector_multiply(swizzle<2, 0, 1, 3>(a), swizzle<1, 2, 0, 3>(b)));
+	}
+
+	inline float length3(Vector value)
+	{
+		return std::sqrt(dot3(value, value));
+	}
+
+	// Zero stays zero
+	inline Vector normalize3(Vector value)
+	{
+		const float length = length3(value);
+		return length > 0.0f ? vector_scale(value, 1.0f / length) : value;
+	}
+
+	inline Vector normalize4(Vector value)
+	{
+		const float length = std::sqrt(dot4(value, value));
+		return length > 0.0f ? vector_scale(value, 1.0f / length) : value;
+	}
+
+	inline Matrix load(const Float4x4& value)
+	{
+		return Matrix{ { load(value.rows[0]), load(value.rows[1]), load(value.rows[2]), load(value.rows[3]) } };
+	}
+
+	inline void store(Float4x4& destination, const Matrix& value)
+	{
+		for (uint32_t row_idx = 0; row_idx < 4; ++row_idx)
+		{
+			store(destination.rows[row_idx], value.rows[row_idx]);
+		}
+	}
+
+	inline Matrix matrix_identity()
+	{
+		return Matrix{ {
+			vector_set(1.0f, 0.0f, 0.0f, 0.0f),
+			vector_set(0.0f, 1.0f, 0.0f, 0.0f),
+			vector_set(0.0f, 0.0f, 1.0f, 0.0f),
+			vector_set(0.0f, 0.0f, 0.0f, 1.0f),
+		} };
+	}
+
+	// The row vector times the matrix
+	inline Vector vector_transform(Vector value, const Matrix& matrix)
+	{
+		Vector result = vector_multiply(splat_lane<0>(value), matrix.rows[0]);
+		result = vector_multiply_add(splat_lane<1>(value), matrix.rows[1], result);
+		result = vector_multiply_add(splat_lane<2>(value), matrix.rows[2], result);
+		return vector_multiply_add(splat_lane<3>(value), matrix.rows[3], result);
+	}
+
+	// a first, then b
+	inline Matrix matrix_multiply(const Matrix& a, const Matrix& b)
+	{
+		return Matrix{ {
+			vector_transform(a.rows[0], b),
+			vector_transform(a.rows[1], b),
+			vector_transform(a.rows[2], b),
+			vector_transform(a.rows[3], b),
+		} };
+	}
+
+	inline Matrix matrix_transpose(const Matrix& matrix)
+	{
+		Float4x4 stored;
+		store(stored, matrix);
+		const Float4* rows = stored.rows;
+		return Matrix{ {
+			vector_set(rows[0].x, rows[1].x, rows[2].x, rows[3].x),
+			vector_set(rows[0].y, rows[1].y, rows[2].y, rows[3].y),
+			vector_set(rows[0].z, rows[1].z, rows[2].z, rows[3].z),
+			vector_set(rows[0].w, rows[1].w, rows[2].w, rows[3].w),
+		} };
+	}
+
+	inline Matrix matrix_translation(float x, float y, float z)
+	{
+		Matrix result = matrix_identity();
+		result.rows[3] = vector_set(x, y, z, 1.0f);
+		return result;
+	}
+
+	inline Matrix matrix_scaling(float x, float y, float z)
+	{
+		return Matrix{ {
+			vector_set(x, 0.0f, 0.0f, 0.0f),
+			vector_set(0.0f, y, 0.0f, 0.0f),
+			vector_set(0.0f, 0.0f, z, 0.0f),
+			vector_set(0.0f, 0.0f, 0.0f, 1.0f),
+		} };
+	}
+
+	inline Vector quaternion_identity()
+	{
+		return vector_set(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	// The axis has to be normalized, the angle is in radians
+	inline Vector quaternion_rotation_axis(Vector axis, float angle)
+	{
+		const float half_angle = angle * 0.5f;
+		const Vector rotation = vector_scale(axis, std::sin(half_angle));
+		return vector_set(get_lane<0>(rotation), get_lane<1>(rotation), get_lane<2>(rotation), std::cos(half_angle));
+	}
+
+	// Rotation a first, then b, the way matrix_multiply() orders them
+	inline Vector quaternion_multiply(Vector a, Vector b)
+	{
+		// The Hamilton product b a
+		const float real = get_lane<3>(b) * get_lane<3>(a) - dot3(b, a);
+		const Vector imaginary = vector_add(
+			vector_add(vector_scale(a, get_lane<3>(b)), vector_scale(b, get_lane<3>(a))),
+			cross3(b, a));
+		return vector_set(get_lane<0>(imaginary), get_lane<1>(imaginary), get_lane<2>(imaginary), real);
+	}
+
+	inline Vector quaternion_conjugate(Vector rotation)
+	{
+		return vector_multiply(rotation, vector_set(-1.0f, -1.0f, -1.0f, 1.0f));
+	}
+
+	// Rotates the xyz of a vector by a unit quaternion, w passes through
+	inline Vector quaternion_rotate(Vector value, Vector rotation)
+	{
+		// v + 2 w (u x v) + 2 u x (u x v), with u the imaginary part
+		const Vector twice_cross = vector_scale(cross3(rotation, value), 2.0f);
+		return vector_add(
+			vector_add(value, vector_scale(twice_cross, get_lane<3>(rotation))),
+			cross3(rotation, twice_cross));
+	}
+
+	inline Matrix matrix_rotation_quaternion(Vector rotation)
+	{
+		const float x = get_lane<0>(rotation);
+		const float y = get_lane<1>(rotation);
+		const float z = get_lane<2>(rotation);
+		const float w = get_lane<3>(rotation);
+		return Matrix{ {
+			vector_set(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w), 0.0f),
+			vector_set(2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w), 0.0f),
+			vector_set(2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y), 0.0f),
+			vector_set(0.0f, 0.0f, 0.0f, 1.0f),
+		} };
+	}
+
+	// Scale first, then the rotation, then the translation
+	inline Matrix matrix_affine(Vector scale, Vector rotation, Vector translation)
+	{
+		Matrix result = matrix_rotation_quaternion(rotation);
+		result.rows[0] = vector_scale(result.rows[0], get_lane<0>(scale));
+		result.rows[1] = vector_scale(result.rows[1], get_lane<1>(scale));
+		result.rows[2] = vector_scale(result.rows[2], get_lane<2>(scale));
+		result.rows[3] = vector_set(get_lane<0>(translation), get_lane<1>(translation), get_lane<2>(translation), 1.0f);
+		return result;
+	}
+
+	// Left handed with z from 0 at near_z to 1 at far_z, as Direct3D clips. The field of
+	// view is vertical and in radians.
+	inline Matrix matrix_perspective_fov_lh(float vertical_fov, float aspect_ratio, float near_z, float far_z)
+	{
+		const float height = 1.0f / std::tan(vertical_fov * 0.5f);
+		const float range = far_z / (far_z - near_z);
+		return Matrix{ {
+			vector_set(height / aspect_ratio, 0.0f, 0.0f, 0.0f),
+			vector_set(0.0f, height, 0.0f, 0.0f),
+			vector_set(0.0f, 0.0f, range, 1.0f),
+			vector_set(0.0f, 0.0f, -range * near_z, 0.0f),
+		} };
+	}
+
+	// Left handed view matrix looking along direction from position
+	inline Matrix matrix_look_to_lh(Vector position, Vector direction, Vector up)
+	{
+		const Vector z_axis = normalize3(direction);
+		const Vector x_axis = normalize3(cross3(up, z_axis));
+		const Vector y_axis = cross3(z_axis, x_axis);
+		return matrix_transpose(Matrix{ {
+			vector_set(get_lane<0>(x_axis), get_lane<1>(x_axis), get_lane<2>(x_axis), -dot3(x_axis, position)),
+			vector_set(get_lane<0>(y_axis), get_lane<1>(y_axis), get_lane<2>(y_axis), -dot3(y_axis, position)),
+			vector_set(get_lane<0>(z_axis), get_lane<1>(z_axis), get_lane<2>(z_axis), -dot3(z_axis, position)),
+			vector_set(0.0f, 0.0f, 0.0f, 1.0f),
+		} });
+	}
+
+	// The general inverse, meaningless for singular matrices
+	Matrix matrix_inverse(const Matrix& matrix);
+
+	// Interpolates along the shorter arc
+	Vector quaternion_slerp(Vector a, Vector b, float t);
+
+	// count vectors as structure of arrays, each component in an array of its own. The
+	// batch kernels take 8 (AVX2) or 4 (SSE2, NEON) at a time and any count.
+	struct Float3Batch
+	{
+		const float* x;
+		const float* y;
+		const float* z;
+	};
+
+	struct Float3BatchOutput
+	{
+		float* x;
+		float* y;
+		float* z;
+	};
+
+	struct Float4BatchOutput
+	{
+		float* x;
+		float* y;
+		float* z;
+		float* w;
+	};
+
+	// Points with w = 1 times the matrix, all four components of the result
+	void transform_points(const Float4x4& matrix, const Float3Batch& points, size_t count, const Float4BatchOutput& result);
+
+	// Directions with w = 0 times the matrix, the translation does not apply
+	void transform_directions(const Float4x4& matrix, const Float3Batch& directions, size_t count, const Float3BatchOutput& result);
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_SIMD_MATH_HPP
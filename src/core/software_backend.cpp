@@ -0,0 +1,479 @@
+#include "software_backend.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+
+#include "job_system.hpp"
+#include "profiler.hpp"
+#include "scene.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTWARE_BACKEND_SSE2
+#endif
+
+namespace Core
+{
+
+	namespace
+	{
+		constexpr int32_t subpixel_bits = 4;
+		constexpr int32_t subpixel_scale = 1 << subpixel_bits;
+		constexpr int32_t subpixel_half = subpixel_scale / 2;
+		constexpr float guard_band = 1.5f;
+
+		// The rasterizer inner loop is written once against these wrappers,
+		// one pixel per lane
+#if defined(__AVX2__)
+		struct Lanes
+		{
+			static constexpr uint32_t count = 8;
+			using Int = __m256i;
+			using Float = __m256;
+
+			static Int splat(int32_t value) { return _mm256_set1_epi32(value); }
+			static Int ramp(int32_t step) { return _mm256_setr_epi32(0, step, 2 * step, 3 * step, 4 * step, 5 * step, 6 * step, 7 * step); }
+			static Int add(Int a, Int b) { return _mm256_add_epi32(a, b); }
+			static Int bitwise_and(Int a, Int b) { return _mm256_and_si256(a, b); }
+			static Int greater(Int a, Int b) { return _mm256_cmpgt_epi32(a, b); }
+			static Int non_negative(Int a, Int b, Int c) { return _mm256_cmpgt_epi32(_mm256_or_si256(_mm256_or_si256(a, b), c), _mm256_set1_epi32(-1)); }
+			static uint32_t mask_bits(Int mask) { return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(mask))); }
+
+			static Float splat(float value) { return _mm256_set1_ps(value); }
+			static Float to_float(Int value) { return _mm256_cvtepi32_ps(value); }
+			static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+			static Float mul_add(Float a, Float b, Float c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+
+			static Int to_unorm8(Float value, int32_t shift)
+			{
+				value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+				const Int unorm = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+				return _mm256_sllv_epi32(unorm, _mm256_set1_epi32(shift));
+			}
+			static Int bitwise_or(Int a, Int b) { return _mm256_or_si256(a, b); }
+
+			static void store(uint32_t* destination, Int value, Int mask)
+			{
+				_mm256_maskstore_epi32(reinterpret_cast<int*>(destination), mask, value);
+			}
+		};
+#elif defined(SOFTWARE_BACKEND_SSE2)
+		struct Lanes
+		{
+			static constexpr uint32_t count = 4;
+			using Int = __m128i;
+			using Float = __m128;
+
+			static Int splat(int32_t value) { return _mm_set1_epi32(value); }
+			static Int ramp(int32_t step) { return _mm_setr_epi32(0, step, 2 * step, 3 * step); }
+			static Int add(Int a, Int b) { return _mm_add_epi32(a, b); }
+			static Int bitwise_and(Int a, Int b) { return _mm_and_si128(a, b); }
+			static Int greater(Int a, Int b) { return _mm_cmpgt_epi32(a, b); }
+			static Int non_negative(Int a, Int b, Int c) { return _mm_cmpgt_epi32(_mm_or_si128(_mm_or_si128(a, b), c), _mm_set1_epi32(-1)); }
+			static uint32_t mask_bits(Int mask) { return static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(mask))); }
+
+			static Float splat(float value) { return _mm_set1_ps(value); }
+			static Float to_float(Int value) { return _mm_cvtepi32_ps(value); }
+			static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+			static Float mul_add(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+			static Int to_unorm8(Float value, int32_t shift)
+			{
+				value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+				const Int unorm = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+				return _mm_sll_epi32(unorm, _mm_cvtsi32_si128(shift));
+			}
+			static Int bitwise_or(Int a, Int b) { return _mm_or_si128(a, b); }
+
+			static void store(uint32_t* destination, Int value, Int mask)
+			{
+				auto* address = reinterpret_cast<__m128i*>(destination);
+				const Int previous = _mm_loadu_si128(address);
+				_mm_storeu_si128(address, _mm_or_si128(_mm_and_si128(mask, value), _mm_andnot_si128(mask, previous)));
+			}
+		};
+#else
+		struct Lanes
+		{
+			static constexpr uint32_t count = 1;
+			using Int = int32_t;
+			using Float = float;
+
+			static Int splat(int32_t value) { return value; }
+			static Int ramp(int32_t) { return 0; }
+			static Int add(Int a, Int b) { return a + b; }
+			static Int bitwise_and(Int a, Int b) { return a & b; }
+			static Int greater(Int a, Int b) { return a > b ? -1 : 0; }
+			static Int non_negative(Int a, Int b, Int c) { return (a | b | c) >= 0 ? -1 : 0; }
+			static uint32_t mask_bits(Int mask) { return mask ? 1 : 0; }
+
+			static Float splat(float value) { return value; }
+			static Float to_float(Int value) { return static_cast<float>(value); }
+			static Float mul(Float a, Float b) { return a * b; }
+			static Float mul_add(Float a, Float b, Float c) { return a * b + c; }
+
+			static Int to_unorm8(Float value, int32_t shift)
+			{
+				value = std::min(std::max(value, 0.0f), 1.0f);
+				return static_cast<Int>(static_cast<uint32_t>(value * 255.0f + 0.5f) << shift);
+			}
+			static Int bitwise_or(Int a, Int b) { return a | b; }
+
+			static void store(uint32_t* destination, Int value, Int mask)
+			{
+				if (mask)
+				{
+					*destination = static_cast<uint32_t>(value);
+				}
+			}
+		};
+#endif
+
+		int32_t to_subpixel(float coordinate)
+		{
+			return static_cast<int32_t>(std::lround(coordinate * subpixel_scale));
+		}
+
+		uint32_t pack_unorm8(const float color[4])
+		{
+			uint32_t packed = 0;
+			for (uint32_t channel = 0; channel < 4; ++channel)
+			{
+				const float value = std::min(std::max(color[channel], 0.0f), 1.0f);
+				packed |= static_cast<uint32_t>(value * 255.0f + 0.5f) << (channel * 8);
+			}
+			return packed;
+		}
+
+		uint32_t popcount(uint32_t bits)
+		{
+			uint32_t count = 0;
+			for (; bits; bits &= bits - 1)
+			{
+				++count;
+			}
+			return count;
+		}
+	}
+
+	SoftwareBackend::SoftwareBackend(JobSystem& job_system, uint32_t width, uint32_t height) :
+		m_job_system(job_system),
+		m_width(width),
+		m_height(height),
+		m_tile_columns((width + tile_size - 1) / tile_size),
+		m_tile_rows((height + tile_size - 1) / tile_size)
+	{
+		// Edge functions are evaluated in 32 bit, which bounds the resolution together
+		// with the guard band and the subpixel precision
+		assert(static_cast<uint64_t>(width) * height * 2 *
+			static_cast<uint64_t>(guard_band * subpixel_scale) * static_cast<uint64_t>(guard_band * subpixel_scale) <= INT32_MAX &&
+			"Render target too large for 32 bit edge functions");
+
+		// Rows are padded to whole tiles, so a group of lanes never straddles two tiles
+		m_pixels.resize(static_cast<size_t>(m_tile_columns) * tile_size * height);
+		m_tile_bins.resize(static_cast<size_t>(m_tile_columns) * m_tile_rows);
+	}
+
+	const char* SoftwareBackend::name() const
+	{
+		return "software";
+	}
+
+	const GpuProfiler* SoftwareBackend::gpu_profiler() const
+	{
+		return nullptr;
+	}
+
+	void SoftwareBackend::begin_frame()
+	{
+		m_triangles.clear();
+		for (auto& bin : m_tile_bins)
+		{
+			bin.clear();
+		}
+		m_frame_pixels_shaded.store(0, std::memory_order_relaxed);
+	}
+
+	void SoftwareBackend::clear(const float color[4])
+	{
+		m_clear_value = pack_unorm8(color);
+
+		// Clearing happens per tile in end_frame(), right before the tile is rasterized,
+		// but draws recorded before the clear must not survive it
+		m_triangles.clear();
+		for (auto& bin : m_tile_bins)
+		{
+			bin.clear();
+		}
+	}
+
+	void SoftwareBackend::draw(uint32_t vertex_count, uint32_t first_vertex)
+	{
+		PROFILE_FUNCTION();
+
+		assert(first_vertex + vertex_count <= sizeof(scene_vertices) / sizeof(scene_vertices[0]));
+
+		for (uint32_t vertex_idx = first_vertex; vertex_idx + 3 <= first_vertex + vertex_count; vertex_idx += 3)
+		{
+			++m_counters.triangles_submitted;
+
+			// Vertex shader and viewport transform
+			int32_t x[3];
+			int32_t y[3];
+			bool is_in_guard_band = true;
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				const auto& vertex = scene_vertices[vertex_idx + corner];
+				is_in_guard_band &= std::fabs(vertex.pos.x) <= guard_band && std::fabs(vertex.pos.y) <= guard_band;
+				x[corner] = to_subpixel((vertex.pos.x * 0.5f + 0.5f) * static_cast<float>(m_width));
+				y[corner] = to_subpixel((0.5f - vertex.pos.y * 0.5f) * static_cast<float>(m_height));
+			}
+			if (!is_in_guard_band)
+			{
+				continue;
+			}
+
+			// Positive area is clockwise on screen, the D3D default front face
+			const int64_t area =
+				static_cast<int64_t>(x[1] - x[0]) * (y[2] - y[0]) -
+				static_cast<int64_t>(y[1] - y[0]) * (x[2] - x[0]);
+			if (area <= 0)
+			{
+				continue;
+			}
+
+			Triangle triangle;
+			triangle.inverse_area = 1.0f / static_cast<float>(area);
+
+			// Edge i is opposite vertex i, so it evaluates to that vertex's barycentric weight times the area
+			for (uint32_t edge = 0; edge < 3; ++edge)
+			{
+				const uint32_t from = (edge + 1) % 3;
+				const uint32_t to = (edge + 2) % 3;
+				const int32_t a = -(y[to] - y[from]);
+				const int32_t b = x[to] - x[from];
+
+				// Top-left rule: samples exactly on an edge only belong to the triangle on left and top edges
+				const bool is_top_left = a > 0 || (a == 0 && b > 0);
+
+				triangle.a[edge] = a;
+				triangle.b[edge] = b;
+				triangle.c[edge] = -static_cast<int64_t>(a) * x[from] - static_cast<int64_t>(b) * y[from] - (is_top_left ? 0 : 1);
+
+				const Float4& color = scene_vertices[vertex_idx + edge].color;
+				triangle.colors[edge][0] = color.x;
+				triangle.colors[edge][1] = color.y;
+				triangle.colors[edge][2] = color.z;
+				triangle.colors[edge][3] = color.w;
+			}
+
+			// Pixels whose center lies inside the bounding box of the snapped vertices
+			const int32_t min_x = (*std::min_element(x, x + 3) - subpixel_half + subpixel_scale - 1) >> subpixel_bits;
+			const int32_t min_y = (*std::min_element(y, y + 3) - subpixel_half + subpixel_scale - 1) >> subpixel_bits;
+			const int32_t max_x = (*std::max_element(x, x + 3) - subpixel_half) >> subpixel_bits;
+			const int32_t max_y = (*std::max_element(y, y + 3) - subpixel_half) >> subpixel_bits;
+
+			triangle.min_x = static_cast<uint32_t>(std::max(min_x, 0));
+			triangle.min_y = static_cast<uint32_t>(std::max(min_y, 0));
+			triangle.max_x = static_cast<uint32_t>(std::min(max_x, static_cast<int32_t>(m_width) - 1));
+			triangle.max_y = static_cast<uint32_t>(std::min(max_y, static_cast<int32_t>(m_height) - 1));
+			if (max_x < 0 || max_y < 0 || triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y)
+			{
+				continue;
+			}
+
+			const auto triangle_idx = static_cast<uint32_t>(m_triangles.size());
+			m_triangles.push_back(triangle);
+
+			for (uint32_t tile_y = triangle.min_y / tile_size; tile_y <= triangle.max_y / tile_size; ++tile_y)
+			{
+				for (uint32_t tile_x = triangle.min_x / tile_size; tile_x <= triangle.max_x / tile_size; ++tile_x)
+				{
+					m_tile_bins[tile_y * m_tile_columns + tile_x].push_back(triangle_idx);
+				}
+			}
+		}
+	}
+
+	void SoftwareBackend::end_frame()
+	{
+		PROFILE_FUNCTION();
+
+		m_job_system.parallel_for(m_tile_columns * m_tile_rows, 1, [this](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t tile_idx = begin; tile_idx < end; ++tile_idx)
+				{
+					rasterize_tile(tile_idx);
+				}
+			});
+
+		m_counters.triangles_rasterized += m_triangles.size();
+		m_counters.pixels_shaded += m_frame_pixels_shaded.load(std::memory_order_relaxed);
+	}
+
+	void SoftwareBackend::present()
+	{
+	}
+
+	uint32_t SoftwareBackend::width() const
+	{
+		return m_width;
+	}
+
+	uint32_t SoftwareBackend::height() const
+	{
+		return m_height;
+	}
+
+	const std::vector<uint32_t>& SoftwareBackend::pixels() const
+	{
+		return m_pixels;
+	}
+
+	const SoftwareCounters& SoftwareBackend::counters() const
+	{
+		return m_counters;
+	}
+
+	bool SoftwareBackend::write_image(const std::string& path) const
+	{
+		std::ofstream stream(path, std::ios::binary);
+		if (!stream)
+		{
+			return false;
+		}
+
+		stream << "P6\n" << m_width << " " << m_height << "\n255\n";
+
+		const size_t row_pitch = static_cast<size_t>(m_tile_columns) * tile_size;
+		std::vector<uint8_t> row(m_width * 3);
+		for (uint32_t y = 0; y < m_height; ++y)
+		{
+			for (uint32_t x = 0; x < m_width; ++x)
+			{
+				const uint32_t pixel = m_pixels[y * row_pitch + x];
+				row[x * 3 + 0] = static_cast<uint8_t>(pixel);
+				row[x * 3 + 1] = static_cast<uint8_t>(pixel >> 8);
+				row[x * 3 + 2] = static_cast<uint8_t>(pixel >> 16);
+			}
+			stream.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+		}
+
+		return static_cast<bool>(stream);
+	}
+
+	void SoftwareBackend::rasterize_tile(uint32_t tile_idx)
+	{
+		const uint32_t min_x = (tile_idx % m_tile_columns) * tile_size;
+		const uint32_t min_y = (tile_idx / m_tile_columns) * tile_size;
+		const uint32_t max_x = std::min(min_x + tile_size, m_width) - 1;
+		const uint32_t max_y = std::min(min_y + tile_size, m_height) - 1;
+
+		const size_t row_pitch = static_cast<size_t>(m_tile_columns) * tile_size;
+		for (uint32_t y = min_y; y <= max_y; ++y)
+		{
+			std::fill_n(m_pixels.data() + y * row_pitch + min_x, tile_size, m_clear_value);
+		}
+
+		uint64_t pixels_shaded = 0;
+		for (uint32_t triangle_idx : m_tile_bins[tile_idx])
+		{
+			const auto& triangle = m_triangles[triangle_idx];
+			pixels_shaded += rasterize_triangle(
+				triangle,
+				std::max(min_x, triangle.min_x),
+				std::max(min_y, triangle.min_y),
+				std::min(max_x, triangle.max_x),
+				std::min(max_y, triangle.max_y));
+		}
+		m_frame_pixels_shaded.fetch_add(pixels_shaded, std::memory_order_relaxed);
+	}
+
+	uint64_t SoftwareBackend::rasterize_triangle(const Triangle& triangle, uint32_t min_x, uint32_t min_y, uint32_t max_x, uint32_t max_y)
+	{
+		const size_t row_pitch = static_cast<size_t>(m_tile_columns) * tile_size;
+
+		// Lane groups start aligned, lanes left of min_x or right of max_x are masked off
+		const uint32_t first_x = min_x & ~(Lanes::count - 1);
+		const auto first_sample_x = static_cast<int64_t>(first_x) * subpixel_scale + subpixel_half;
+
+		Lanes::Int lane_offsets[3];
+		Lanes::Int group_steps[3];
+		for (uint32_t edge = 0; edge < 3; ++edge)
+		{
+			lane_offsets[edge] = Lanes::ramp(triangle.a[edge] * subpixel_scale);
+			group_steps[edge] = Lanes::splat(triangle.a[edge] * subpixel_scale * static_cast<int32_t>(Lanes::count));
+		}
+
+		const Lanes::Int lane_x = Lanes::ramp(1);
+		const Lanes::Int before_min_x = Lanes::splat(static_cast<int32_t>(min_x) - 1);
+		const Lanes::Int after_max_x = Lanes::splat(static_cast<int32_t>(max_x) + 1);
+
+		const Lanes::Float inverse_area = Lanes::splat(triangle.inverse_area);
+		Lanes::Float colors[3][4];
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			for (uint32_t channel = 0; channel < 4; ++channel)
+			{
+				colors[corner][channel] = Lanes::splat(triangle.colors[corner][channel]);
+			}
+		}
+
+		uint64_t pixels_shaded = 0;
+		for (uint32_t y = min_y; y <= max_y; ++y)
+		{
+			const int64_t sample_y = static_cast<int64_t>(y) * subpixel_scale + subpixel_half;
+
+			Lanes::Int edges[3];
+			for (uint32_t edge = 0; edge < 3; ++edge)
+			{
+				const int64_t row_value = triangle.a[edge] * first_sample_x + triangle.b[edge] * sample_y + triangle.c[edge];
+				edges[edge] = Lanes::add(Lanes::splat(static_cast<int32_t>(row_value)), lane_offsets[edge]);
+			}
+
+			uint32_t* row = m_pixels.data() + y * row_pitch;
+			for (uint32_t x = first_x; x <= max_x; x += Lanes::count)
+			{
+				const Lanes::Int xs = Lanes::add(Lanes::splat(static_cast<int32_t>(x)), lane_x);
+				const Lanes::Int mask = Lanes::bitwise_and(
+					Lanes::non_negative(edges[0], edges[1], edges[2]),
+					Lanes::bitwise_and(Lanes::greater(xs, before_min_x), Lanes::greater(after_max_x, xs)));
+
+				const uint32_t mask_bits = Lanes::mask_bits(mask);
+				if (mask_bits)
+				{
+					const Lanes::Float weights[3] = {
+						Lanes::mul(Lanes::to_float(edges[0]), inverse_area),
+						Lanes::mul(Lanes::to_float(edges[1]), inverse_area),
+						Lanes::mul(Lanes::to_float(edges[2]), inverse_area),
+					};
+
+					// Pixel shader: the interpolated vertex color
+					Lanes::Int packed = Lanes::splat(0);
+					for (uint32_t channel = 0; channel < 4; ++channel)
+					{
+						const Lanes::Float value = Lanes::mul_add(weights[0], colors[0][channel],
+							Lanes::mul_add(weights[1], colors[1][channel],
+								Lanes::mul(weights[2], colors[2][channel])));
+						packed = Lanes::bitwise_or(packed, Lanes::to_unorm8(value, static_cast<int32_t>(channel * 8)));
+					}
+
+					Lanes::store(row + x, packed, mask);
+					pixels_shaded += popcount(mask_bits);
+				}
+
+				for (uint32_t edge = 0; edge < 3; ++edge)
+				{
+					edges[edge] = Lanes::add(edges[edge], group_steps[edge]);
+				}
+			}
+		}
+
+		return pixels_shaded;
+	}
+
+}
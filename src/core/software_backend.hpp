@@ -0,0 +1,96 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_SOFTWARE_BACKEND_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_SOFTWARE_BACKEND_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "render_backend.hpp"
+
+namespace Core
+{
+
+	class JobSystem;
+
+	struct SoftwareCounters
+	{
+		uint64_t triangles_submitted = 0;
+		uint64_t triangles_rasterized = 0;
+		uint64_t pixels_shaded = 0;
+	};
+
+	// Reference rasterizer running main.vert.hlsl / main.pix.hlsl on the CPU:
+	// clip space positions pass through, vertex colors are interpolated
+	// across the triangle. Draws are binned into tiles at draw() time and
+	// all tiles are rasterized in parallel at end_frame().
+	//
+	// Follows the D3D rules that matter for this pipeline: pixel centers at .5,
+	// top-left fill rule, clockwise front faces with back face culling and
+	// round to nearest UNORM conversion. Positions are snapped to 1/16 of a pixel
+	// instead of D3D's 1/256, and there is no clipping, so triangles have to stay
+	// inside the guard band of [-1.5, 1.5] in clip space (others are skipped).
+	class SoftwareBackend : public RenderBackend
+	{
+	public:
+		static constexpr uint32_t tile_size = 64;
+
+		SoftwareBackend(JobSystem& job_system, uint32_t width = 1280, uint32_t height = 720);
+		SoftwareBackend(const SoftwareBackend&) = delete;
+		SoftwareBackend& operator=(const SoftwareBackend&) = delete;
+
+		const char* name() const override;
+		const GpuProfiler* gpu_profiler() const override;
+
+		void begin_frame() override;
+		void clear(const float color[4]) override;
+		void draw(uint32_t vertex_count, uint32_t first_vertex) override;
+		void end_frame() override;
+		void present() override;
+
+		uint32_t width() const;
+		uint32_t height() const;
+		// RGBA8, R in the lowest byte, rows are tightly packed
+		const std::vector<uint32_t>& pixels() const;
+		const SoftwareCounters& counters() const;
+
+		// Binary PPM, alpha is dropped
+		bool write_image(const std::string& path) const;
+	private:
+		struct Triangle
+		{
+			// Edge function i is a[i] * x + b[i] * y + c[i] in 1/16 pixel units,
+			// already biased for the fill rule so a sample is inside when all three are >= 0
+			int32_t a[3];
+			int32_t b[3];
+			int64_t c[3];
+			float inverse_area;
+			float colors[3][4];
+			uint32_t min_x;
+			uint32_t min_y;
+			uint32_t max_x;
+			uint32_t max_y;
+		};
+
+		void rasterize_tile(uint32_t tile_idx);
+		uint64_t rasterize_triangle(const Triangle& triangle, uint32_t min_x, uint32_t min_y, uint32_t max_x, uint32_t max_y);
+
+		JobSystem& m_job_system;
+		uint32_t m_width;
+		uint32_t m_height;
+		uint32_t m_tile_columns;
+		uint32_t m_tile_rows;
+
+		std::vector<uint32_t> m_pixels;
+		uint32_t m_clear_value = 0;
+
+		std::vector<Triangle> m_triangles;
+		std::vector<std::vector<uint32_t>> m_tile_bins;
+
+		SoftwareCounters m_counters;
+		std::atomic<uint64_t> m_frame_pixels_shaded{ 0 };
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_SOFTWARE_BACKEND_HPP
@@ -0,0 +1,524 @@
+#include "texture.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace Core
+{
+
+	namespace
+	{
+		constexpr uint32_t four_cc(char a, char b, char c, char d)
+		{
+			return static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8 | static_cast<uint32_t>(c) << 16 | static_cast<uint32_t>(d) << 24;
+		}
+
+		constexpr uint32_t dds_magic = four_cc('D', 'D', 'S', ' ');
+
+		struct DdsPixelFormat
+		{
+			uint32_t size;
+			uint32_t flags;
+			uint32_t four_cc;
+			uint32_t rgb_bit_count;
+			uint32_t r_mask;
+			uint32_t g_mask;
+			uint32_t b_mask;
+			uint32_t a_mask;
+		};
+
+		struct DdsHeader
+		{
+			uint32_t size;
+			uint32_t flags;
+			uint32_t height;
+			uint32_t width;
+			uint32_t pitch_or_linear_size;
+			uint32_t depth;
+			uint32_t mip_map_count;
+			uint32_t reserved1[11];
+			DdsPixelFormat pixel_format;
+			uint32_t caps;
+			uint32_t caps2;
+			uint32_t caps3;
+			uint32_t caps4;
+			uint32_t reserved2;
+		};
+		static_assert(sizeof(DdsHeader) == 124, "DDS_HEADER layout");
+
+		struct DdsHeaderDx10
+		{
+			uint32_t dxgi_format;
+			uint32_t resource_dimension;
+			uint32_t misc_flag;
+			uint32_t array_size;
+			uint32_t misc_flags2;
+		};
+		static_assert(sizeof(DdsHeaderDx10) == 20, "DDS_HEADER_DXT10 layout");
+
+		// DDSD_*, DDPF_*, DDSCAPS_* and DDSCAPS2_* from the DDS documentation
+		constexpr uint32_t dds_flags_caps = 0x1;
+		constexpr uint32_t dds_flags_height = 0x2;
+		constexpr uint32_t dds_flags_width = 0x4;
+		constexpr uint32_t dds_flags_pitch = 0x8;
+		constexpr uint32_t dds_flags_pixel_format = 0x1000;
+		constexpr uint32_t dds_flags_mip_map_count = 0x20000;
+		constexpr uint32_t dds_flags_linear_size = 0x80000;
+		constexpr uint32_t dds_flags_depth = 0x800000;
+		constexpr uint32_t dds_pixel_format_four_cc = 0x4;
+		constexpr uint32_t dds_pixel_format_rgb = 0x40;
+		constexpr uint32_t dds_caps_complex = 0x8;
+		constexpr uint32_t dds_caps_texture = 0x1000;
+		constexpr uint32_t dds_caps_mip_map = 0x400000;
+		constexpr uint32_t dds_caps2_cube_map = 0x200;
+		constexpr uint32_t dds_caps2_volume = 0x200000;
+		// D3D10_RESOURCE_DIMENSION_TEXTURE2D
+		constexpr uint32_t dds_dimension_texture_2d = 3;
+
+		TextureFormat format_from_pixel_format(const DdsPixelFormat& pixel_format)
+		{
+			if (pixel_format.flags & dds_pixel_format_four_cc)
+			{
+				switch (pixel_format.four_cc)
+				{
+				case four_cc('D', 'X', 'T', '1'):
+					return TextureFormat::BC1Unorm;
+				case four_cc('D', 'X', 'T', '5'):
+					return TextureFormat::BC3Unorm;
+				case four_cc('A', 'T', 'I', '2'):
+				case four_cc('B', 'C', '5', 'U'):
+					return TextureFormat::BC5Unorm;
+				default:
+					return TextureFormat::Unknown;
+				}
+			}
+
+			const bool is_rgba8 = (pixel_format.flags & dds_pixel_format_rgb)
+				&& pixel_format.rgb_bit_count == 32
+				&& pixel_format.r_mask == 0x000000ff
+				&& pixel_format.g_mask == 0x0000ff00
+				&& pixel_format.b_mask == 0x00ff0000;
+			return is_rgba8 ? TextureFormat::RGBA8Unorm : TextureFormat::Unknown;
+		}
+
+		// The KTX2 file identifier
+		constexpr uint8_t ktx2_identifier[12] = { 0xab, 0x4b, 0x54, 0x58, 0x20, 0x32, 0x30, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a };
+
+		struct Ktx2Header
+		{
+			uint8_t identifier[12];
+			uint32_t vk_format;
+			uint32_t type_size;
+			uint32_t pixel_width;
+			uint32_t pixel_height;
+			uint32_t pixel_depth;
+			uint32_t layer_count;
+			uint32_t face_count;
+			uint32_t level_count;
+			uint32_t supercompression_scheme;
+			uint32_t dfd_byte_offset;
+			uint32_t dfd_byte_length;
+			uint32_t kvd_byte_offset;
+			uint32_t kvd_byte_length;
+			uint64_t sgd_byte_offset;
+			uint64_t sgd_byte_length;
+		};
+		static_assert(sizeof(Ktx2Header) == 80, "KTX2 header layout");
+
+		// Follows the header, one per level, most detailed first
+		struct Ktx2Level
+		{
+			uint64_t byte_offset;
+			uint64_t byte_length;
+			uint64_t uncompressed_byte_length;
+		};
+		static_assert(sizeof(Ktx2Level) == 24, "KTX2 level index layout");
+
+		TextureFormat format_from_vulkan(uint32_t vk_format)
+		{
+			// VkFormat values
+			switch (vk_format)
+			{
+			case 37:
+				return TextureFormat::RGBA8Unorm;
+			case 43:
+				return TextureFormat::RGBA8UnormSrgb;
+			case 131:
+			case 133:
+				return TextureFormat::BC1Unorm;
+			case 132:
+			case 134:
+				return TextureFormat::BC1UnormSrgb;
+			case 137:
+				return TextureFormat::BC3Unorm;
+			case 138:
+				return TextureFormat::BC3UnormSrgb;
+			case 141:
+				return TextureFormat::BC5Unorm;
+			case 145:
+				return TextureFormat::BC7Unorm;
+			case 146:
+				return TextureFormat::BC7UnormSrgb;
+			default:
+				return TextureFormat::Unknown;
+			}
+		}
+
+		// D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION, it also keeps row pitches well inside 32 bits
+		constexpr uint32_t max_texture_dimension = 16384;
+
+		// Shifting by the mip index stays defined and every mip is at least 1x1
+		bool is_desc_valid(const TextureDesc& desc, const std::string& path, std::string& error)
+		{
+			if (desc.width == 0 || desc.height == 0)
+			{
+				error = path + " has no texels";
+				return false;
+			}
+			if (desc.width > max_texture_dimension || desc.height > max_texture_dimension)
+			{
+				error = path + " is larger than " + std::to_string(max_texture_dimension) + " texels";
+				return false;
+			}
+
+			uint32_t full_mip_count = 1;
+			while ((std::max(desc.width, desc.height) >> full_mip_count) != 0)
+			{
+				++full_mip_count;
+			}
+			if (desc.mip_count > full_mip_count)
+			{
+				error = path + " has more mips than its size allows";
+				return false;
+			}
+			return true;
+		}
+
+		bool parse_dds(const uint8_t* data, size_t size, const std::string& path, TextureData& texture, std::string& error)
+		{
+			uint32_t magic = 0;
+			DdsHeader header = {};
+			if (size < sizeof(magic) + sizeof(header))
+			{
+				error = path + " is too small for a DDS file";
+				return false;
+			}
+			std::memcpy(&magic, data, sizeof(magic));
+			std::memcpy(&header, data + sizeof(magic), sizeof(header));
+			if (magic != dds_magic || header.size != sizeof(header))
+			{
+				error = path + " is not a DDS file";
+				return false;
+			}
+
+			size_t offset = sizeof(magic) + sizeof(header);
+			TextureDesc& desc = texture.desc;
+			if ((header.pixel_format.flags & dds_pixel_format_four_cc) && header.pixel_format.four_cc == four_cc('D', 'X', '1', '0'))
+			{
+				DdsHeaderDx10 header_dx10 = {};
+				if (size < offset + sizeof(header_dx10))
+				{
+					error = path + " is truncated";
+					return false;
+				}
+				std::memcpy(&header_dx10, data + offset, sizeof(header_dx10));
+				offset += sizeof(header_dx10);
+
+				if (header_dx10.resource_dimension != dds_dimension_texture_2d || header_dx10.array_size > 1)
+				{
+					error = path + " is not a 2D texture";
+					return false;
+				}
+				desc.format = format_from_dxgi(header_dx10.dxgi_format);
+			}
+			else
+			{
+				desc.format = format_from_pixel_format(header.pixel_format);
+			}
+
+			if (desc.format == TextureFormat::Unknown)
+			{
+				error = path + " has an unsupported format";
+				return false;
+			}
+			if ((header.flags & dds_flags_depth) || (header.caps2 & (dds_caps2_cube_map | dds_caps2_volume)))
+			{
+				error = path + " is not a 2D texture";
+				return false;
+			}
+
+			desc.width = header.width;
+			desc.height = header.height;
+			desc.mip_count = std::max(1U, header.mip_map_count);
+			if (!is_desc_valid(desc, path, error))
+			{
+				return false;
+			}
+
+			texture.mips.clear();
+			for (uint32_t mip_idx = 0; mip_idx < desc.mip_count; ++mip_idx)
+			{
+				TextureMip mip;
+				mip.width = std::max(1U, desc.width >> mip_idx);
+				mip.height = std::max(1U, desc.height >> mip_idx);
+				compute_mip_pitch(desc.format, mip.width, mip.height, mip.row_pitch, mip.row_count);
+				mip.size = static_cast<uint64_t>(mip.row_pitch) * mip.row_count;
+				// offset never passes size, subtracting cannot wrap around
+				if (mip.size > size - offset)
+				{
+					error = path + " is truncated";
+					return false;
+				}
+				mip.data = data + offset;
+				offset += mip.size;
+				texture.mips.push_back(mip);
+			}
+			return true;
+		}
+
+		bool parse_ktx2(const uint8_t* data, size_t size, const std::string& path, TextureData& texture, std::string& error)
+		{
+			Ktx2Header header = {};
+			if (size < sizeof(header))
+			{
+				error = path + " is too small for a KTX2 file";
+				return false;
+			}
+			std::memcpy(&header, data, sizeof(header));
+			if (header.supercompression_scheme != 0)
+			{
+				error = path + " is supercompressed";
+				return false;
+			}
+			if (header.pixel_height == 0 || header.pixel_depth > 1 || header.layer_count > 1 || header.face_count != 1)
+			{
+				error = path + " is not a 2D texture";
+				return false;
+			}
+
+			TextureDesc& desc = texture.desc;
+			desc.format = format_from_vulkan(header.vk_format);
+			if (desc.format == TextureFormat::Unknown)
+			{
+				error = path + " has an unsupported format";
+				return false;
+			}
+			desc.width = header.pixel_width;
+			desc.height = header.pixel_height;
+			// 0 asks the loader to generate mips, the streamer uploads what is there
+			desc.mip_count = std::max(1U, header.level_count);
+			if (!is_desc_valid(desc, path, error))
+			{
+				return false;
+			}
+			if (size < sizeof(header) + sizeof(Ktx2Level) * static_cast<uint64_t>(desc.mip_count))
+			{
+				error = path + " is truncated";
+				return false;
+			}
+
+			texture.mips.clear();
+			for (uint32_t mip_idx = 0; mip_idx < desc.mip_count; ++mip_idx)
+			{
+				Ktx2Level level;
+				std::memcpy(&level, data + sizeof(header) + sizeof(Ktx2Level) * mip_idx, sizeof(level));
+
+				// Rows are tightly packed, unlike in KTX1
+				TextureMip mip;
+				mip.width = std::max(1U, desc.width >> mip_idx);
+				mip.height = std::max(1U, desc.height >> mip_idx);
+				compute_mip_pitch(desc.format, mip.width, mip.height, mip.row_pitch, mip.row_count);
+				mip.size = static_cast<uint64_t>(mip.row_pitch) * mip.row_count;
+				if (level.byte_length < mip.size || level.byte_offset > size || size - level.byte_offset < level.byte_length)
+				{
+					error = path + " is truncated";
+					return false;
+				}
+				mip.data = data + level.byte_offset;
+				texture.mips.push_back(mip);
+			}
+			return true;
+		}
+	}
+
+	bool is_block_compressed(TextureFormat format)
+	{
+		return format != TextureFormat::Unknown
+			&& format != TextureFormat::RGBA8Unorm
+			&& format != TextureFormat::RGBA8UnormSrgb;
+	}
+
+	uint32_t format_block_bytes(TextureFormat format)
+	{
+		switch (format)
+		{
+		case TextureFormat::RGBA8Unorm:
+		case TextureFormat::RGBA8UnormSrgb:
+			return 4;
+		case TextureFormat::BC1Unorm:
+		case TextureFormat::BC1UnormSrgb:
+			return 8;
+		case TextureFormat::BC3Unorm:
+		case TextureFormat::BC3UnormSrgb:
+		case TextureFormat::BC5Unorm:
+		case TextureFormat::BC7Unorm:
+		case TextureFormat::BC7UnormSrgb:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+
+	TextureFormat format_from_dxgi(uint32_t dxgi_format)
+	{
+		// DXGI_FORMAT values, dxgiformat.h is Windows only
+		switch (dxgi_format)
+		{
+		case 28:
+			return TextureFormat::RGBA8Unorm;
+		case 29:
+			return TextureFormat::RGBA8UnormSrgb;
+		case 71:
+			return TextureFormat::BC1Unorm;
+		case 72:
+			return TextureFormat::BC1UnormSrgb;
+		case 77:
+			return TextureFormat::BC3Unorm;
+		case 78:
+			return TextureFormat::BC3UnormSrgb;
+		case 83:
+			return TextureFormat::BC5Unorm;
+		case 98:
+			return TextureFormat::BC7Unorm;
+		case 99:
+			return TextureFormat::BC7UnormSrgb;
+		default:
+			return TextureFormat::Unknown;
+		}
+	}
+
+	uint32_t format_to_dxgi(TextureFormat format)
+	{
+		switch (format)
+		{
+		case TextureFormat::RGBA8Unorm:
+			return 28;
+		case TextureFormat::RGBA8UnormSrgb:
+			return 29;
+		case TextureFormat::BC1Unorm:
+			return 71;
+		case TextureFormat::BC1UnormSrgb:
+			return 72;
+		case TextureFormat::BC3Unorm:
+			return 77;
+		case TextureFormat::BC3UnormSrgb:
+			return 78;
+		case TextureFormat::BC5Unorm:
+			return 83;
+		case TextureFormat::BC7Unorm:
+			return 98;
+		case TextureFormat::BC7UnormSrgb:
+			return 99;
+		default:
+			return 0;
+		}
+	}
+
+	void compute_mip_pitch(TextureFormat format, uint32_t width, uint32_t height, uint32_t& row_pitch, uint32_t& row_count)
+	{
+		if (is_block_compressed(format))
+		{
+			row_pitch = std::max(1U, (width + 3) / 4) * format_block_bytes(format);
+			row_count = std::max(1U, (height + 3) / 4);
+		}
+		else
+		{
+			row_pitch = width * format_block_bytes(format);
+			row_count = height;
+		}
+	}
+
+	bool load_texture(const std::string& path, TextureData& texture, std::string& error, TextureReadMode mode)
+	{
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+		if (mode == TextureReadMode::Mapped)
+		{
+			texture.file = MappedFile(path);
+			if (!texture.file.is_valid())
+			{
+				error = "Can not map " + path;
+				return false;
+			}
+			data = texture.file.data();
+			size = texture.file.size();
+		}
+		else
+		{
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			if (!file)
+			{
+				error = "Can not open " + path;
+				return false;
+			}
+			texture.storage.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			if (!file.read(reinterpret_cast<char*>(texture.storage.data()), static_cast<std::streamsize>(texture.storage.size())))
+			{
+				error = "Can not read " + path;
+				return false;
+			}
+			data = texture.storage.data();
+			size = texture.storage.size();
+		}
+		texture.file_size = size;
+
+		if (size >= sizeof(ktx2_identifier) && std::memcmp(data, ktx2_identifier, sizeof(ktx2_identifier)) == 0)
+		{
+			return parse_ktx2(data, size, path, texture, error);
+		}
+		return parse_dds(data, size, path, texture, error);
+	}
+
+	bool write_dds(const std::string& path, const TextureDesc& desc, const std::vector<TextureMip>& mips)
+	{
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+
+		uint32_t row_pitch;
+		uint32_t row_count;
+		compute_mip_pitch(desc.format, desc.width, desc.height, row_pitch, row_count);
+
+		DdsHeader header = {};
+		header.size = sizeof(header);
+		header.flags = dds_flags_caps | dds_flags_height | dds_flags_width | dds_flags_pixel_format | dds_flags_mip_map_count
+			| (is_block_compressed(desc.format) ? dds_flags_linear_size : dds_flags_pitch);
+		header.height = desc.height;
+		header.width = desc.width;
+		header.pitch_or_linear_size = is_block_compressed(desc.format) ? row_pitch * row_count : row_pitch;
+		header.mip_map_count = desc.mip_count;
+		header.pixel_format.size = sizeof(header.pixel_format);
+		header.pixel_format.flags = dds_pixel_format_four_cc;
+		header.pixel_format.four_cc = four_cc('D', 'X', '1', '0');
+		header.caps = dds_caps_texture | (desc.mip_count > 1 ? dds_caps_complex | dds_caps_mip_map : 0);
+
+		DdsHeaderDx10 header_dx10 = {};
+		header_dx10.dxgi_format = format_to_dxgi(desc.format);
+		header_dx10.resource_dimension = dds_dimension_texture_2d;
+		header_dx10.array_size = 1;
+
+		file.write(reinterpret_cast<const char*>(&dds_magic), sizeof(dds_magic));
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(&header_dx10), sizeof(header_dx10));
+		for (uint32_t mip_idx = 0; mip_idx < desc.mip_count; ++mip_idx)
+		{
+			file.write(reinterpret_cast<const char*>(mips[mip_idx].data), static_cast<std::streamsize>(mips[mip_idx].size));
+		}
+		return static_cast<bool>(file);
+	}
+
+}
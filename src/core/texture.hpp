@@ -0,0 +1,82 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_TEXTURE_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_TEXTURE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+namespace Core
+{
+
+	enum class TextureFormat : uint32_t
+	{
+		Unknown,
+		RGBA8Unorm,
+		RGBA8UnormSrgb,
+		BC1Unorm,
+		BC1UnormSrgb,
+		BC3Unorm,
+		BC3UnormSrgb,
+		BC5Unorm,
+		BC7Unorm,
+		BC7UnormSrgb,
+	};
+
+	bool is_block_compressed(TextureFormat format);
+	// Of a 4x4 block for block compressed formats, of a texel otherwise
+	uint32_t format_block_bytes(TextureFormat format);
+	TextureFormat format_from_dxgi(uint32_t dxgi_format);
+	uint32_t format_to_dxgi(TextureFormat format);
+
+	struct TextureDesc
+	{
+		TextureFormat format = TextureFormat::Unknown;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mip_count = 0;
+	};
+
+	// One mip level as it is stored in the file, rows of texels or 4x4 blocks
+	struct TextureMip
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t row_pitch = 0;
+		uint32_t row_count = 0;
+		const uint8_t* data = nullptr;
+		uint64_t size = 0;
+	};
+
+	// Bytes per row and rows of a tightly packed mip
+	void compute_mip_pitch(TextureFormat format, uint32_t width, uint32_t height, uint32_t& row_pitch, uint32_t& row_count);
+
+	enum class TextureReadMode : uint32_t
+	{
+		// The mips point straight into the page cache, nothing is copied before upload
+		Mapped,
+		// The whole file is read into a buffer first
+		Buffered,
+	};
+
+	struct TextureData
+	{
+		TextureDesc desc;
+		// Most detailed first, pointing into file or storage, whichever holds the file
+		std::vector<TextureMip> mips;
+		MappedFile file;
+		std::vector<uint8_t> storage;
+		uint64_t file_size = 0;
+	};
+
+	// 2D textures with mips in the formats above, picked by the file's magic:
+	// DDS with or without the DX10 header, or KTX2 without supercompression.
+	// Headers are parsed in place, the mips are not touched.
+	bool load_texture(const std::string& path, TextureData& texture, std::string& error, TextureReadMode mode = TextureReadMode::Mapped);
+	// Always writes the DX10 header. mips holds desc.mip_count tightly packed levels.
+	bool write_dds(const std::string& path, const TextureDesc& desc, const std::vector<TextureMip>& mips);
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_TEXTURE_HPP
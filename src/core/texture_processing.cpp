@@ -0,0 +1,1030 @@
+#include "texture_processing.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "job_system.hpp"
+#include "profiler.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TEXTURE_PROCESSING_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTURE_PROCESSING_SSE2
+#endif
+
+namespace Core
+{
+
+	namespace
+	{
+		constexpr uint32_t max_tap_count = 8;
+		// Entries of the linear to sRGB table, fine enough that dark texels round correctly
+		constexpr uint32_t from_linear_size = 1 << 14;
+
+		struct Filter
+		{
+			// Of the first tap relative to twice the destination texel
+			int32_t offset;
+			uint32_t tap_count;
+			float weights[max_tap_count];
+		};
+
+		double bessel_i0(double x)
+		{
+			double sum = 1.0;
+			double term = 1.0;
+			for (uint32_t k = 1; k < 32; ++k)
+			{
+				const double factor = x / (2.0 * k);
+				term *= factor * factor;
+				sum += term;
+			}
+			return sum;
+		}
+
+		Filter make_filter(MipFilter mip_filter)
+		{
+			if (mip_filter == MipFilter::Box)
+			{
+				return { 0, 2, { 0.5f, 0.5f } };
+			}
+
+			// Sinc at half the source frequency under a Kaiser window two destination texels wide
+			constexpr double pi = 3.14159265358979323846;
+			constexpr double width = 2.0;
+			constexpr double beta = 4.0;
+			Filter filter = { -3, max_tap_count, {} };
+			double sum = 0.0;
+			double weights[max_tap_count];
+			for (uint32_t tap_idx = 0; tap_idx < max_tap_count; ++tap_idx)
+			{
+				// From the destination texel's center, in destination texels
+				const double distance = (static_cast<double>(tap_idx) - 3.5) / 2.0;
+				const double sinc = std::sin(pi * distance) / (pi * distance);
+				const double window_position = distance / width;
+				const double window = bessel_i0(beta * std::sqrt(1.0 - window_position * window_position)) / bessel_i0(beta);
+				weights[tap_idx] = sinc * window;
+				sum += weights[tap_idx];
+			}
+			for (uint32_t tap_idx = 0; tap_idx < max_tap_count; ++tap_idx)
+			{
+				filter.weights[tap_idx] = static_cast<float>(weights[tap_idx] / sum);
+			}
+			return filter;
+		}
+
+		struct SrgbTables
+		{
+			float to_linear[256];
+			// Plain unorm, for alpha and images that are not sRGB
+			float to_float[256];
+			uint8_t from_linear[from_linear_size];
+
+			SrgbTables()
+			{
+				for (uint32_t value = 0; value < 256; ++value)
+				{
+					const double srgb = value / 255.0;
+					to_linear[value] = static_cast<float>(srgb <= 0.04045 ? srgb / 12.92 : std::pow((srgb + 0.055) / 1.055, 2.4));
+					to_float[value] = static_cast<float>(srgb);
+				}
+				for (uint32_t entry_idx = 0; entry_idx < from_linear_size; ++entry_idx)
+				{
+					const double linear = static_cast<double>(entry_idx) / (from_linear_size - 1);
+					const double srgb = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+					from_linear[entry_idx] = static_cast<uint8_t>(std::lround(std::clamp(srgb, 0.0, 1.0) * 255.0));
+				}
+			}
+		};
+
+		const SrgbTables& srgb_tables()
+		{
+			static const SrgbTables tables;
+			return tables;
+		}
+
+		void decode_row(const uint8_t* texels, uint32_t width, bool is_srgb, float* destination)
+		{
+			const SrgbTables& tables = srgb_tables();
+			const float* color_table = is_srgb ? tables.to_linear : tables.to_float;
+			for (uint32_t x = 0; x < width; ++x, texels += 4, destination += 4)
+			{
+				destination[0] = color_table[texels[0]];
+				destination[1] = color_table[texels[1]];
+				destination[2] = color_table[texels[2]];
+				destination[3] = tables.to_float[texels[3]];
+			}
+		}
+
+		// Texels are already clamped to [0, 1]
+		void encode_row(const float* texels, uint32_t width, bool is_srgb, uint8_t* destination)
+		{
+			const SrgbTables& tables = srgb_tables();
+			for (uint32_t x = 0; x < width; ++x, texels += 4, destination += 4)
+			{
+				for (uint32_t channel_idx = 0; channel_idx < 3; ++channel_idx)
+				{
+					destination[channel_idx] = is_srgb
+						? tables.from_linear[static_cast<uint32_t>(texels[channel_idx] * (from_linear_size - 1) + 0.5f)]
+						: static_cast<uint8_t>(texels[channel_idx] * 255.0f + 0.5f);
+				}
+				destination[3] = static_cast<uint8_t>(texels[3] * 255.0f + 0.5f);
+			}
+		}
+
+		// Weighted sum of whole rows, channel by channel
+		void filter_vertical(const float* const* rows, const Filter& filter, uint32_t float_count, float* destination)
+		{
+			uint32_t float_idx = 0;
+#if defined(__AVX2__)
+			for (; float_idx + 8 <= float_count; float_idx += 8)
+			{
+				__m256 sum = _mm256_setzero_ps();
+				for (uint32_t tap_idx = 0; tap_idx < filter.tap_count; ++tap_idx)
+				{
+					sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(filter.weights[tap_idx]), _mm256_loadu_ps(rows[tap_idx] + float_idx)));
+				}
+				_mm256_storeu_ps(destination + float_idx, sum);
+			}
+#endif
+#if defined(TEXTURE_PROCESSING_SSE2)
+			for (; float_idx + 4 <= float_count; float_idx += 4)
+			{
+				__m128 sum = _mm_setzero_ps();
+				for (uint32_t tap_idx = 0; tap_idx < filter.tap_count; ++tap_idx)
+				{
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(filter.weights[tap_idx]), _mm_loadu_ps(rows[tap_idx] + float_idx)));
+				}
+				_mm_storeu_ps(destination + float_idx, sum);
+			}
+#endif
+			for (; float_idx < float_count; ++float_idx)
+			{
+				float sum = 0.0f;
+				for (uint32_t tap_idx = 0; tap_idx < filter.tap_count; ++tap_idx)
+				{
+					sum += filter.weights[tap_idx] * rows[tap_idx][float_idx];
+				}
+				destination[float_idx] = sum;
+			}
+		}
+
+		// Halves a row, one RGBA texel per 128 bits. row points at the first tap of
+		// destination texel 0 and is padded so no tap needs clamping.
+		void filter_horizontal(const float* row, const Filter& filter, uint32_t destination_width, float* destination)
+		{
+			uint32_t x = 0;
+#if defined(__AVX2__)
+			// Two destination texels at once, their taps are two source texels apart
+			for (; x + 2 <= destination_width; x += 2)
+			{
+				__m256 sum = _mm256_setzero_ps();
+				for (uint32_t tap_idx = 0; tap_idx < filter.tap_count; ++tap_idx)
+				{
+					const float* tap = row + (2 * x + tap_idx) * 4;
+					const __m256 texels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(tap)), _mm_loadu_ps(tap + 8), 1);
+					sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(filter.weights[tap_idx]), texels));
+				}
+				sum = _mm256_min_ps(_mm256_max_ps(sum, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+				_mm256_storeu_ps(destination + x * 4, sum);
+			}
+#endif
+#if defined(TEXTURE_PROCESSING_SSE2)
+			for (; x < destination_width; ++x)
+			{
+				__m128 sum = _mm_setzero_ps();
+				for (uint32_t tap_idx = 0; tap_idx < filter.tap_count; ++tap_idx)
+				{
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(filter.weights[tap_idx]), _mm_loadu_ps(row + (2 * x + tap_idx) * 4)));
+				}
+				sum = _mm_min_ps(_mm_max_ps(sum, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+				_mm_storeu_ps(destination + x * 4, sum);
+			}
+#else
+			for (; x < destination_width; ++x)
+			{
+				for (uint32_t channel_idx = 0; channel_idx < 4; ++channel_idx)
+				{
+					float sum = 0.0f;
+					for (uint32_t tap_idx = 0; tap_idx < filter.tap_count; ++tap_idx)
+					{
+						sum += filter.weights[tap_idx] * row[(2 * x + tap_idx) * 4 + channel_idx];
+					}
+					destination[x * 4 + channel_idx] = std::min(std::max(sum, 0.0f), 1.0f);
+				}
+			}
+#endif
+		}
+
+		// Mean and direction of largest variance of a block's texels, the axis is zero
+		// when all texels are the same
+		template<uint32_t N>
+		void fit_line(const float (&texels)[16][N], float (&mean)[N], float (&axis)[N])
+		{
+			for (uint32_t channel_idx = 0; channel_idx < N; ++channel_idx)
+			{
+				mean[channel_idx] = 0.0f;
+				for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+				{
+					mean[channel_idx] += texels[texel_idx][channel_idx];
+				}
+				mean[channel_idx] /= 16.0f;
+			}
+
+			float covariance[N][N] = {};
+			for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+			{
+				for (uint32_t row = 0; row < N; ++row)
+				{
+					for (uint32_t column = 0; column < N; ++column)
+					{
+						covariance[row][column] += (texels[texel_idx][row] - mean[row]) * (texels[texel_idx][column] - mean[column]);
+					}
+				}
+			}
+
+			// Power iteration, starting from the covariance row of the channel varying most,
+			// which is never orthogonal to the principal axis unless the block is uniform
+			uint32_t widest_idx = 0;
+			for (uint32_t channel_idx = 1; channel_idx < N; ++channel_idx)
+			{
+				if (covariance[channel_idx][channel_idx] > covariance[widest_idx][widest_idx])
+				{
+					widest_idx = channel_idx;
+				}
+			}
+			for (uint32_t channel_idx = 0; channel_idx < N; ++channel_idx)
+			{
+				axis[channel_idx] = covariance[widest_idx][channel_idx];
+			}
+			for (uint32_t iteration = 0; iteration < 8; ++iteration)
+			{
+				float next[N] = {};
+				float length = 0.0f;
+				for (uint32_t row = 0; row < N; ++row)
+				{
+					for (uint32_t column = 0; column < N; ++column)
+					{
+						next[row] += covariance[row][column] * axis[column];
+					}
+					length = std::max(length, std::abs(next[row]));
+				}
+				if (length == 0.0f)
+				{
+					break;
+				}
+				for (uint32_t channel_idx = 0; channel_idx < N; ++channel_idx)
+				{
+					axis[channel_idx] = next[channel_idx] / length;
+				}
+			}
+
+			float length = 0.0f;
+			for (uint32_t channel_idx = 0; channel_idx < N; ++channel_idx)
+			{
+				length += axis[channel_idx] * axis[channel_idx];
+			}
+			length = std::sqrt(length);
+			for (uint32_t channel_idx = 0; channel_idx < N; ++channel_idx)
+			{
+				axis[channel_idx] = length > 0.0f ? axis[channel_idx] / length : 0.0f;
+			}
+		}
+
+		// The texels at both ends of the line through them
+		template<uint32_t N>
+		void find_endpoints(const float (&texels)[16][N], float (&first)[N], float (&second)[N])
+		{
+			float mean[N];
+			float axis[N];
+			fit_line(texels, mean, axis);
+
+			float min_projection = 0.0f;
+			float max_projection = 0.0f;
+			for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+			{
+				float projection = 0.0f;
+				for (uint32_t channel_idx = 0; channel_idx < N; ++channel_idx)
+				{
+					projection += (texels[texel_idx][channel_idx] - mean[channel_idx]) * axis[channel_idx];
+				}
+				min_projection = std::min(min_projection, projection);
+				max_projection = std::max(max_projection, projection);
+			}
+			for (uint32_t channel_idx = 0; channel_idx < N; ++channel_idx)
+			{
+				first[channel_idx] = std::clamp(mean[channel_idx] + axis[channel_idx] * max_projection, 0.0f, 255.0f);
+				second[channel_idx] = std::clamp(mean[channel_idx] + axis[channel_idx] * min_projection, 0.0f, 255.0f);
+			}
+		}
+
+		// Endpoints minimising the squared error for fixed indices, false when the indices
+		// do not pin them down. weights[i] is how much of the first endpoint texel i gets.
+		template<uint32_t N>
+		bool solve_endpoints(const float (&texels)[16][N], const float (&weights)[16], float (&first)[N], float (&second)[N])
+		{
+			float first_first = 0.0f;
+			float first_second = 0.0f;
+			float second_second = 0.0f;
+			float first_texels[N] = {};
+			float second_texels[N] = {};
+			for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+			{
+				const float weight = weights[texel_idx];
+				first_first += weight * weight;
+				first_second += weight * (1.0f - weight);
+				second_second += (1.0f - weight) * (1.0f - weight);
+				for (uint32_t channel_idx = 0; channel_idx < N; ++channel_idx)
+				{
+					first_texels[channel_idx] += weight * texels[texel_idx][channel_idx];
+					second_texels[channel_idx] += (1.0f - weight) * texels[texel_idx][channel_idx];
+				}
+			}
+
+			const float determinant = first_first * second_second - first_second * first_second;
+			if (std::abs(determinant) < 1e-6f)
+			{
+				return false;
+			}
+			for (uint32_t channel_idx = 0; channel_idx < N; ++channel_idx)
+			{
+				first[channel_idx] = std::clamp((second_second * first_texels[channel_idx] - first_second * second_texels[channel_idx]) / determinant, 0.0f, 255.0f);
+				second[channel_idx] = std::clamp((first_first * second_texels[channel_idx] - first_second * first_texels[channel_idx]) / determinant, 0.0f, 255.0f);
+			}
+			return true;
+		}
+
+		uint16_t quantize_565(const float (&color)[3])
+		{
+			const auto r = static_cast<uint32_t>(color[0] * 31.0f / 255.0f + 0.5f);
+			const auto g = static_cast<uint32_t>(color[1] * 63.0f / 255.0f + 0.5f);
+			const auto b = static_cast<uint32_t>(color[2] * 31.0f / 255.0f + 0.5f);
+			return static_cast<uint16_t>(r << 11 | g << 5 | b);
+		}
+
+		void expand_565(uint16_t color, int32_t (&rgb)[3])
+		{
+			const int32_t r = color >> 11;
+			const int32_t g = (color >> 5) & 63;
+			const int32_t b = color & 31;
+			rgb[0] = r << 3 | r >> 2;
+			rgb[1] = g << 2 | g >> 4;
+			rgb[2] = b << 3 | b >> 2;
+		}
+
+		// The four colors of a BC1 block, three and transparent black when first <= second
+		void color_palette(uint16_t first, uint16_t second, bool is_four_color, int32_t (&palette)[4][4])
+		{
+			int32_t first_rgb[3];
+			int32_t second_rgb[3];
+			expand_565(first, first_rgb);
+			expand_565(second, second_rgb);
+			for (uint32_t channel_idx = 0; channel_idx < 3; ++channel_idx)
+			{
+				palette[0][channel_idx] = first_rgb[channel_idx];
+				palette[1][channel_idx] = second_rgb[channel_idx];
+				if (is_four_color)
+				{
+					palette[2][channel_idx] = (2 * first_rgb[channel_idx] + second_rgb[channel_idx] + 1) / 3;
+					palette[3][channel_idx] = (first_rgb[channel_idx] + 2 * second_rgb[channel_idx] + 1) / 3;
+				}
+				else
+				{
+					palette[2][channel_idx] = (first_rgb[channel_idx] + second_rgb[channel_idx]) / 2;
+					palette[3][channel_idx] = 0;
+				}
+			}
+			palette[0][3] = 255;
+			palette[1][3] = 255;
+			palette[2][3] = 255;
+			palette[3][3] = is_four_color ? 255 : 0;
+		}
+
+		// Orders the endpoints for the four color mode and picks the nearest color per texel
+		float fit_color_indices(const float (&texels)[16][3], uint16_t& first, uint16_t& second, uint32_t& indices)
+		{
+			if (first < second)
+			{
+				std::swap(first, second);
+			}
+
+			int32_t palette[4][4];
+			color_palette(first, second, true, palette);
+			// Equal endpoints decode in three color mode, where only the first one is safe
+			const uint32_t palette_size = first == second ? 1 : 4;
+
+			float error = 0.0f;
+			indices = 0;
+			for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+			{
+				float best_error = std::numeric_limits<float>::max();
+				uint32_t best_idx = 0;
+				for (uint32_t palette_idx = 0; palette_idx < palette_size; ++palette_idx)
+				{
+					float texel_error = 0.0f;
+					for (uint32_t channel_idx = 0; channel_idx < 3; ++channel_idx)
+					{
+						const float difference = texels[texel_idx][channel_idx] - palette[palette_idx][channel_idx];
+						texel_error += difference * difference;
+					}
+					if (texel_error < best_error)
+					{
+						best_error = texel_error;
+						best_idx = palette_idx;
+					}
+				}
+				error += best_error;
+				indices |= best_idx << (2 * texel_idx);
+			}
+			return error;
+		}
+
+		void write_color_block(uint16_t first, uint16_t second, uint32_t indices, uint8_t* output)
+		{
+			std::memcpy(output, &first, sizeof(first));
+			std::memcpy(output + 2, &second, sizeof(second));
+			std::memcpy(output + 4, &indices, sizeof(indices));
+		}
+
+		// BC1 in four color mode, also the color half of BC3
+		void encode_color_block(const uint8_t (&block)[16][4], uint8_t* output)
+		{
+			float texels[16][3];
+			for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+			{
+				for (uint32_t channel_idx = 0; channel_idx < 3; ++channel_idx)
+				{
+					texels[texel_idx][channel_idx] = block[texel_idx][channel_idx];
+				}
+			}
+
+			float first_color[3];
+			float second_color[3];
+			find_endpoints(texels, first_color, second_color);
+			uint16_t first = quantize_565(first_color);
+			uint16_t second = quantize_565(second_color);
+			uint32_t indices;
+			const float error = fit_color_indices(texels, first, second, indices);
+			if (first == second)
+			{
+				write_color_block(first, second, indices, output);
+				return;
+			}
+
+			// One least squares pass over the chosen indices, kept if it decodes better
+			constexpr float first_weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+			float weights[16];
+			for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+			{
+				weights[texel_idx] = first_weights[(indices >> (2 * texel_idx)) & 3];
+			}
+			if (solve_endpoints(texels, weights, first_color, second_color))
+			{
+				uint16_t refined_first = quantize_565(first_color);
+				uint16_t refined_second = quantize_565(second_color);
+				uint32_t refined_indices;
+				if (fit_color_indices(texels, refined_first, refined_second, refined_indices) < error)
+				{
+					first = refined_first;
+					second = refined_second;
+					indices = refined_indices;
+				}
+			}
+			write_color_block(first, second, indices, output);
+		}
+
+		// Eight values between the endpoints, or six and 0 and 255 when first <= second
+		void channel_palette(uint8_t first, uint8_t second, int32_t (&palette)[8])
+		{
+			palette[0] = first;
+			palette[1] = second;
+			if (first > second)
+			{
+				for (int32_t palette_idx = 2; palette_idx < 8; ++palette_idx)
+				{
+					palette[palette_idx] = ((8 - palette_idx) * first + (palette_idx - 1) * second + 3) / 7;
+				}
+			}
+			else
+			{
+				for (int32_t palette_idx = 2; palette_idx < 6; ++palette_idx)
+				{
+					palette[palette_idx] = ((6 - palette_idx) * first + (palette_idx - 1) * second + 2) / 5;
+				}
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+		}
+
+		// BC4, the alpha half of BC3 and both halves of BC5
+		void encode_channel_block(const uint8_t (&block)[16][4], uint32_t channel_idx, uint8_t* output)
+		{
+			uint8_t first = 0;
+			uint8_t second = 255;
+			for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+			{
+				first = std::max(first, block[texel_idx][channel_idx]);
+				second = std::min(second, block[texel_idx][channel_idx]);
+			}
+
+			int32_t palette[8];
+			channel_palette(first, second, palette);
+			const uint32_t palette_size = first == second ? 1 : 8;
+
+			uint64_t indices = 0;
+			for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+			{
+				int32_t best_error = INT32_MAX;
+				uint64_t best_idx = 0;
+				for (uint32_t palette_idx = 0; palette_idx < palette_size; ++palette_idx)
+				{
+					const int32_t error = std::abs(block[texel_idx][channel_idx] - palette[palette_idx]);
+					if (error < best_error)
+					{
+						best_error = error;
+						best_idx = palette_idx;
+					}
+				}
+				indices |= best_idx << (3 * texel_idx);
+			}
+
+			output[0] = first;
+			output[1] = second;
+			for (uint32_t byte_idx = 0; byte_idx < 6; ++byte_idx)
+			{
+				output[2 + byte_idx] = static_cast<uint8_t>(indices >> (8 * byte_idx));
+			}
+		}
+
+		// BC7 mode 6: one subset, RGBA endpoints of 7 bits plus a shared lowest bit each
+		// and 4 bit indices
+		constexpr uint32_t bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		// Picks the lowest bit that brings all channels of the endpoint closest
+		void quantize_bc7_endpoint(const float (&endpoint)[4], uint8_t (&values)[4], uint8_t& p_bit)
+		{
+			float best_error = std::numeric_limits<float>::max();
+			for (uint8_t candidate_p_bit = 0; candidate_p_bit < 2; ++candidate_p_bit)
+			{
+				uint8_t candidate_values[4];
+				float error = 0.0f;
+				for (uint32_t channel_idx = 0; channel_idx < 4; ++channel_idx)
+				{
+					const float value = std::clamp(std::round((endpoint[channel_idx] - candidate_p_bit) / 2.0f), 0.0f, 127.0f);
+					candidate_values[channel_idx] = static_cast<uint8_t>(value);
+					const float difference = endpoint[channel_idx] - (candidate_values[channel_idx] << 1 | candidate_p_bit);
+					error += difference * difference;
+				}
+				if (error < best_error)
+				{
+					best_error = error;
+					std::memcpy(values, candidate_values, sizeof(values));
+					p_bit = candidate_p_bit;
+				}
+			}
+		}
+
+		void bc7_palette(const uint8_t (&first)[4], uint8_t first_p_bit, const uint8_t (&second)[4], uint8_t second_p_bit, int32_t (&palette)[16][4])
+		{
+			for (uint32_t channel_idx = 0; channel_idx < 4; ++channel_idx)
+			{
+				const int32_t first_value = first[channel_idx] << 1 | first_p_bit;
+				const int32_t second_value = second[channel_idx] << 1 | second_p_bit;
+				for (uint32_t palette_idx = 0; palette_idx < 16; ++palette_idx)
+				{
+					const auto weight = static_cast<int32_t>(bc7_weights[palette_idx]);
+					palette[palette_idx][channel_idx] = ((64 - weight) * first_value + weight * second_value + 32) >> 6;
+				}
+			}
+		}
+
+		struct Bc7Block
+		{
+			uint8_t endpoints[2][4];
+			uint8_t p_bits[2];
+			uint8_t indices[16];
+			float error;
+		};
+
+		void fit_bc7_block(const float (&texels)[16][4], const float (&first)[4], const float (&second)[4], Bc7Block& block)
+		{
+			quantize_bc7_endpoint(first, block.endpoints[0], block.p_bits[0]);
+			quantize_bc7_endpoint(second, block.endpoints[1], block.p_bits[1]);
+
+			int32_t palette[16][4];
+			bc7_palette(block.endpoints[0], block.p_bits[0], block.endpoints[1], block.p_bits[1], palette);
+			float direction[4];
+			float length_squared = 0.0f;
+			for (uint32_t channel_idx = 0; channel_idx < 4; ++channel_idx)
+			{
+				direction[channel_idx] = static_cast<float>(palette[15][channel_idx] - palette[0][channel_idx]);
+				length_squared += direction[channel_idx] * direction[channel_idx];
+			}
+
+			// The weights are nearly linear, so only the neighbours of the projected index can be closer
+			block.error = 0.0f;
+			for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+			{
+				float projection = 0.0f;
+				for (uint32_t channel_idx = 0; channel_idx < 4; ++channel_idx)
+				{
+					projection += (texels[texel_idx][channel_idx] - palette[0][channel_idx]) * direction[channel_idx];
+				}
+				const int32_t projected_idx = length_squared > 0.0f
+					? std::clamp(static_cast<int32_t>(projection / length_squared * 15.0f + 0.5f), 0, 15)
+					: 0;
+
+				float best_error = std::numeric_limits<float>::max();
+				for (int32_t palette_idx = std::max(projected_idx - 1, 0); palette_idx <= std::min(projected_idx + 1, 15); ++palette_idx)
+				{
+					float error = 0.0f;
+					for (uint32_t channel_idx = 0; channel_idx < 4; ++channel_idx)
+					{
+						const float difference = texels[texel_idx][channel_idx] - palette[palette_idx][channel_idx];
+						error += difference * difference;
+					}
+					if (error < best_error)
+					{
+						best_error = error;
+						block.indices[texel_idx] = static_cast<uint8_t>(palette_idx);
+					}
+				}
+				block.error += best_error;
+			}
+		}
+
+		void write_bits(uint8_t* output, uint32_t& bit_offset, uint32_t value, uint32_t bit_count)
+		{
+			for (uint32_t bit_idx = 0; bit_idx < bit_count; ++bit_idx, ++bit_offset)
+			{
+				output[bit_offset >> 3] |= static_cast<uint8_t>(((value >> bit_idx) & 1) << (bit_offset & 7));
+			}
+		}
+
+		uint32_t read_bits(const uint8_t* input, uint32_t& bit_offset, uint32_t bit_count)
+		{
+			uint32_t value = 0;
+			for (uint32_t bit_idx = 0; bit_idx < bit_count; ++bit_idx, ++bit_offset)
+			{
+				value |= static_cast<uint32_t>((input[bit_offset >> 3] >> (bit_offset & 7)) & 1) << bit_idx;
+			}
+			return value;
+		}
+
+		void encode_bc7_block(const uint8_t (&block)[16][4], uint8_t* output)
+		{
+			float texels[16][4];
+			for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+			{
+				for (uint32_t channel_idx = 0; channel_idx < 4; ++channel_idx)
+				{
+					texels[texel_idx][channel_idx] = block[texel_idx][channel_idx];
+				}
+			}
+
+			float first[4];
+			float second[4];
+			find_endpoints(texels, first, second);
+			Bc7Block best;
+			fit_bc7_block(texels, first, second, best);
+
+			float weights[16];
+			for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+			{
+				weights[texel_idx] = 1.0f - bc7_weights[best.indices[texel_idx]] / 64.0f;
+			}
+			if (solve_endpoints(texels, weights, first, second))
+			{
+				Bc7Block refined;
+				fit_bc7_block(texels, first, second, refined);
+				if (refined.error < best.error)
+				{
+					best = refined;
+				}
+			}
+
+			// The highest index bit of texel 0 is implicitly zero
+			if (best.indices[0] >= 8)
+			{
+				std::swap(best.endpoints[0], best.endpoints[1]);
+				std::swap(best.p_bits[0], best.p_bits[1]);
+				for (auto& index : best.indices)
+				{
+					index = static_cast<uint8_t>(15 - index);
+				}
+			}
+
+			std::memset(output, 0, 16);
+			uint32_t bit_offset = 0;
+			write_bits(output, bit_offset, 1 << 6, 7);
+			for (uint32_t channel_idx = 0; channel_idx < 4; ++channel_idx)
+			{
+				write_bits(output, bit_offset, best.endpoints[0][channel_idx], 7);
+				write_bits(output, bit_offset, best.endpoints[1][channel_idx], 7);
+			}
+			write_bits(output, bit_offset, best.p_bits[0], 1);
+			write_bits(output, bit_offset, best.p_bits[1], 1);
+			write_bits(output, bit_offset, best.indices[0], 3);
+			for (uint32_t texel_idx = 1; texel_idx < 16; ++texel_idx)
+			{
+				write_bits(output, bit_offset, best.indices[texel_idx], 4);
+			}
+			assert(bit_offset == 128);
+		}
+
+		void decode_color_block(const uint8_t* input, bool is_four_color_only, uint8_t (&block)[16][4])
+		{
+			uint16_t first;
+			uint16_t second;
+			uint32_t indices;
+			std::memcpy(&first, input, sizeof(first));
+			std::memcpy(&second, input + 2, sizeof(second));
+			std::memcpy(&indices, input + 4, sizeof(indices));
+
+			int32_t palette[4][4];
+			color_palette(first, second, is_four_color_only || first > second, palette);
+			for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+			{
+				for (uint32_t channel_idx = 0; channel_idx < 4; ++channel_idx)
+				{
+					block[texel_idx][channel_idx] = static_cast<uint8_t>(palette[(indices >> (2 * texel_idx)) & 3][channel_idx]);
+				}
+			}
+		}
+
+		void decode_channel_block(const uint8_t* input, uint32_t channel_idx, uint8_t (&block)[16][4])
+		{
+			int32_t palette[8];
+			channel_palette(input[0], input[1], palette);
+			uint64_t indices = 0;
+			for (uint32_t byte_idx = 0; byte_idx < 6; ++byte_idx)
+			{
+				indices |= static_cast<uint64_t>(input[2 + byte_idx]) << (8 * byte_idx);
+			}
+			for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+			{
+				block[texel_idx][channel_idx] = static_cast<uint8_t>(palette[(indices >> (3 * texel_idx)) & 7]);
+			}
+		}
+
+		void decode_bc7_block(const uint8_t* input, uint8_t (&block)[16][4])
+		{
+			uint32_t bit_offset = 0;
+			if (read_bits(input, bit_offset, 7) != 1 << 6)
+			{
+				std::memset(block, 0, sizeof(block));
+				return;
+			}
+
+			uint8_t endpoints[2][4];
+			for (uint32_t channel_idx = 0; channel_idx < 4; ++channel_idx)
+			{
+				endpoints[0][channel_idx] = static_cast<uint8_t>(read_bits(input, bit_offset, 7));
+				endpoints[1][channel_idx] = static_cast<uint8_t>(read_bits(input, bit_offset, 7));
+			}
+			const auto first_p_bit = static_cast<uint8_t>(read_bits(input, bit_offset, 1));
+			const auto second_p_bit = static_cast<uint8_t>(read_bits(input, bit_offset, 1));
+
+			int32_t palette[16][4];
+			bc7_palette(endpoints[0], first_p_bit, endpoints[1], second_p_bit, palette);
+			for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+			{
+				const uint32_t index = read_bits(input, bit_offset, texel_idx == 0 ? 3 : 4);
+				for (uint32_t channel_idx = 0; channel_idx < 4; ++channel_idx)
+				{
+					block[texel_idx][channel_idx] = static_cast<uint8_t>(palette[index][channel_idx]);
+				}
+			}
+		}
+
+		void load_block(const Image& image, uint32_t block_x, uint32_t block_y, uint8_t (&block)[16][4])
+		{
+			for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+			{
+				const uint32_t x = std::min(block_x * 4 + (texel_idx & 3), image.width - 1);
+				const uint32_t y = std::min(block_y * 4 + (texel_idx >> 2), image.height - 1);
+				std::memcpy(block[texel_idx], image.pixels.data() + (static_cast<size_t>(y) * image.width + x) * 4, 4);
+			}
+		}
+
+		void store_block(const uint8_t (&block)[16][4], uint32_t block_x, uint32_t block_y, Image& image)
+		{
+			for (uint32_t texel_idx = 0; texel_idx < 16; ++texel_idx)
+			{
+				const uint32_t x = block_x * 4 + (texel_idx & 3);
+				const uint32_t y = block_y * 4 + (texel_idx >> 2);
+				if (x < image.width && y < image.height)
+				{
+					std::memcpy(image.pixels.data() + (static_cast<size_t>(y) * image.width + x) * 4, block[texel_idx], 4);
+				}
+			}
+		}
+	}
+
+	void generate_mips(JobSystem& job_system, const Image& source, MipFilter mip_filter, bool is_srgb, std::vector<Image>& mips)
+	{
+		PROFILE_FUNCTION();
+
+		mips.clear();
+		mips.push_back(source);
+
+		const Filter filter = make_filter(mip_filter);
+		uint32_t source_width = source.width;
+		uint32_t source_height = source.height;
+		// The source image is decoded row by row while filtering the first level, later
+		// levels read the floats of the previous one
+		std::vector<float> source_texels;
+		std::vector<float> destination_texels;
+		bool is_first_level = true;
+
+		while (source_width > 1 || source_height > 1)
+		{
+			const uint32_t destination_width = std::max(1U, source_width / 2);
+			const uint32_t destination_height = std::max(1U, source_height / 2);
+			destination_texels.resize(static_cast<size_t>(destination_width) * destination_height * 4);
+			Image& mip = mips.emplace_back();
+			mip.width = destination_width;
+			mip.height = destination_height;
+			mip.pixels.resize(static_cast<size_t>(destination_width) * destination_height * 4);
+
+			// Texels repeated at both ends of a row so the horizontal taps never clamp
+			const auto left_padding = static_cast<uint32_t>(std::max(0, -filter.offset));
+			const int32_t last_tap = 2 * static_cast<int32_t>(destination_width - 1) + filter.offset + static_cast<int32_t>(filter.tap_count) - 1;
+			const auto right_padding = static_cast<uint32_t>(std::max(0, last_tap - static_cast<int32_t>(source_width - 1)));
+			const size_t source_row_floats = static_cast<size_t>(source_width) * 4;
+
+			job_system.parallel_for(destination_height, 0, [&](uint32_t begin, uint32_t end)
+			{
+				std::vector<float> row(static_cast<size_t>(left_padding + source_width + right_padding) * 4);
+				float* row_texels = row.data() + left_padding * 4;
+
+				// Decoded source rows, the taps of one destination row never share a slot
+				constexpr uint32_t decoded_row_count = max_tap_count + 2;
+				std::vector<float> decoded_rows(is_first_level ? decoded_row_count * source_row_floats : 0);
+				int32_t decoded_row_ys[decoded_row_count];
+				std::fill(std::begin(decoded_row_ys), std::end(decoded_row_ys), -1);
+				const auto source_row = [&](int32_t source_y) -> const float*
+				{
+					if (!is_first_level)
+					{
+						return source_texels.data() + source_y * source_row_floats;
+					}
+					const uint32_t slot = static_cast<uint32_t>(source_y) % decoded_row_count;
+					float* decoded_row = decoded_rows.data() + slot * source_row_floats;
+					if (decoded_row_ys[slot] != source_y)
+					{
+						decode_row(source.pixels.data() + source_y * source_row_floats, source_width, is_srgb, decoded_row);
+						decoded_row_ys[slot] = source_y;
+					}
+					return decoded_row;
+				};
+
+				for (uint32_t y = begin; y < end; ++y)
+				{
+					const float* rows[max_tap_count];
+					for (uint32_t tap_idx = 0; tap_idx < filter.tap_count; ++tap_idx)
+					{
+						rows[tap_idx] = source_row(std::clamp(2 * static_cast<int32_t>(y) + filter.offset + static_cast<int32_t>(tap_idx), 0, static_cast<int32_t>(source_height - 1)));
+					}
+					filter_vertical(rows, filter, source_width * 4, row_texels);
+
+					for (uint32_t padding_idx = 1; padding_idx <= left_padding; ++padding_idx)
+					{
+						std::memcpy(row_texels - padding_idx * 4, row_texels, 4 * sizeof(float));
+					}
+					for (uint32_t padding_idx = 0; padding_idx < right_padding; ++padding_idx)
+					{
+						std::memcpy(row_texels + (source_width + padding_idx) * 4, row_texels + (source_width - 1) * 4, 4 * sizeof(float));
+					}
+
+					const size_t destination_offset = static_cast<size_t>(y) * destination_width * 4;
+					filter_horizontal(row_texels + filter.offset * 4, filter, destination_width, destination_texels.data() + destination_offset);
+					encode_row(destination_texels.data() + destination_offset, destination_width, is_srgb, mip.pixels.data() + destination_offset);
+				}
+			});
+
+			source_texels.swap(destination_texels);
+			source_width = destination_width;
+			source_height = destination_height;
+			is_first_level = false;
+		}
+	}
+
+	void compress_blocks(JobSystem& job_system, const Image& image, TextureFormat format, std::vector<uint8_t>& blocks)
+	{
+		PROFILE_FUNCTION();
+		assert(is_block_compressed(format));
+
+		const uint32_t block_bytes = format_block_bytes(format);
+		const uint32_t blocks_wide = std::max(1U, (image.width + 3) / 4);
+		const uint32_t blocks_high = std::max(1U, (image.height + 3) / 4);
+		blocks.resize(static_cast<size_t>(blocks_wide) * blocks_high * block_bytes);
+
+		job_system.parallel_for(blocks_high, 0, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t block_y = begin; block_y < end; ++block_y)
+			{
+				for (uint32_t block_x = 0; block_x < blocks_wide; ++block_x)
+				{
+					uint8_t block[16][4];
+					load_block(image, block_x, block_y, block);
+					uint8_t* output = blocks.data() + (static_cast<size_t>(block_y) * blocks_wide + block_x) * block_bytes;
+					switch (format)
+					{
+					case TextureFormat::BC1Unorm:
+					case TextureFormat::BC1UnormSrgb:
+						encode_color_block(block, output);
+						break;
+					case TextureFormat::BC3Unorm:
+					case TextureFormat::BC3UnormSrgb:
+						encode_channel_block(block, 3, output);
+						encode_color_block(block, output + 8);
+						break;
+					case TextureFormat::BC5Unorm:
+						encode_channel_block(block, 0, output);
+						encode_channel_block(block, 1, output + 8);
+						break;
+					default:
+						encode_bc7_block(block, output);
+						break;
+					}
+				}
+			}
+		});
+	}
+
+	void decompress_blocks(const uint8_t* blocks, TextureFormat format, uint32_t width, uint32_t height, Image& image)
+	{
+		assert(is_block_compressed(format));
+
+		image.width = width;
+		image.height = height;
+		image.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+		const uint32_t block_bytes = format_block_bytes(format);
+		const uint32_t blocks_wide = std::max(1U, (width + 3) / 4);
+		const uint32_t blocks_high = std::max(1U, (height + 3) / 4);
+		for (uint32_t block_y = 0; block_y < blocks_high; ++block_y)
+		{
+			for (uint32_t block_x = 0; block_x < blocks_wide; ++block_x)
+			{
+				const uint8_t* input = blocks + (static_cast<size_t>(block_y) * blocks_wide + block_x) * block_bytes;
+				uint8_t block[16][4];
+				switch (format)
+				{
+				case TextureFormat::BC1Unorm:
+				case TextureFormat::BC1UnormSrgb:
+					decode_color_block(input, false, block);
+					break;
+				case TextureFormat::BC3Unorm:
+				case TextureFormat::BC3UnormSrgb:
+					decode_color_block(input + 8, true, block);
+					decode_channel_block(input, 3, block);
+					break;
+				case TextureFormat::BC5Unorm:
+					for (auto& texel : block)
+					{
+						texel[2] = 0;
+						texel[3] = 255;
+					}
+					decode_channel_block(input, 0, block);
+					decode_channel_block(input + 8, 1, block);
+					break;
+				default:
+					decode_bc7_block(input, block);
+					break;
+				}
+				store_block(block, block_x, block_y, image);
+			}
+		}
+	}
+
+	double compute_psnr(const Image& a, const Image& b, uint32_t channel_count)
+	{
+		assert(a.width == b.width && a.height == b.height);
+
+		double squared_error = 0.0;
+		const size_t texel_count = static_cast<size_t>(a.width) * a.height;
+		for (size_t texel_idx = 0; texel_idx < texel_count; ++texel_idx)
+		{
+			for (uint32_t channel_idx = 0; channel_idx < channel_count; ++channel_idx)
+			{
+				const double difference = static_cast<double>(a.pixels[texel_idx * 4 + channel_idx]) - b.pixels[texel_idx * 4 + channel_idx];
+				squared_error += difference * difference;
+			}
+		}
+
+		const double mean_squared_error = squared_error / (static_cast<double>(texel_count) * channel_count);
+		if (mean_squared_error == 0.0)
+		{
+			return std::numeric_limits<double>::infinity();
+		}
+		return 10.0 * std::log10(255.0 * 255.0 / mean_squared_error);
+	}
+
+}
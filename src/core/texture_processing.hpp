@@ -0,0 +1,47 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_TEXTURE_PROCESSING_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_TEXTURE_PROCESSING_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "texture.hpp"
+
+namespace Core
+{
+
+	class JobSystem;
+
+	// RGBA8 texels, rows tightly packed
+	struct Image
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<uint8_t> pixels;
+	};
+
+	enum class MipFilter : uint32_t
+	{
+		// Averages 2x2 texels, the last row and column of odd sizes are dropped
+		Box,
+		// Windowed sinc over 8x8 texels, sharper mips with a little ringing
+		Kaiser,
+	};
+
+	// The full chain down to 1x1, mips[0] is a copy of source. Each level is filtered from the
+	// previous one in floating point, in linear space for the color channels of sRGB images.
+	// Rows are spread over the job system.
+	void generate_mips(JobSystem& job_system, const Image& source, MipFilter filter, bool is_srgb, std::vector<Image>& mips);
+
+	// BC1, BC3, BC5 and BC7 or their sRGB variants, which encode the same bits. Blocks are
+	// stored row by row like in a DDS file, partial blocks repeat the edge texels.
+	// Rows of blocks are spread over the job system. BC7 only uses mode 6.
+	void compress_blocks(JobSystem& job_system, const Image& image, TextureFormat format, std::vector<uint8_t>& blocks);
+	// Decodes what compress_blocks writes, BC7 blocks in other modes than 6 decode to zero
+	void decompress_blocks(const uint8_t* blocks, TextureFormat format, uint32_t width, uint32_t height, Image& image);
+
+	// Over the first channel_count channels of two images of the same size, infinite when they match
+	double compute_psnr(const Image& a, const Image& b, uint32_t channel_count);
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_TEXTURE_PROCESSING_HPP
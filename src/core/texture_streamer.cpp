@@ -0,0 +1,279 @@
+#include "texture_streamer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "profiler.hpp"
+
+namespace Core
+{
+
+	double TextureStreamingStats::megabytes_per_second() const
+	{
+		return streaming_seconds > 0.0 ? static_cast<double>(uploaded_bytes) / 1e6 / streaming_seconds : 0.0;
+	}
+
+	double TextureStreamingStats::textures_per_second() const
+	{
+		return streaming_seconds > 0.0 ? completed_count / streaming_seconds : 0.0;
+	}
+
+	TextureStreamer::TextureStreamer(JobSystem& job_system, TextureStreamingBackend& backend, const TextureStreamerDesc& desc) :
+		m_job_system(job_system),
+		m_backend(backend),
+		m_desc(desc),
+		m_upload_ring(backend.upload_capacity())
+	{
+	}
+
+	TextureStreamer::~TextureStreamer()
+	{
+		m_job_system.wait(m_reads);
+		while (m_backend.completed_fence_value() < m_last_fence_value)
+		{
+			std::this_thread::yield();
+		}
+
+		for (auto& texture : m_textures)
+		{
+			if (texture.texture)
+			{
+				m_backend.destroy_texture(texture.texture);
+			}
+		}
+	}
+
+	uint32_t TextureStreamer::request(const std::string& path)
+	{
+		const auto texture_id = static_cast<uint32_t>(m_textures.size());
+		Texture& texture = m_textures.emplace_back();
+		texture.path = path;
+
+		if (m_stats.requested_count == 0)
+		{
+			m_first_request_ns = Profiler::now();
+		}
+		++m_stats.requested_count;
+		++m_pending_read_count;
+
+		m_job_system.submit_background([this, texture_id, path]()
+		{
+			PROFILE_ZONE("Read texture");
+
+			const uint64_t begin_ns = Profiler::now();
+			ReadResult result;
+			result.texture_id = texture_id;
+			result.data = std::make_unique<TextureData>();
+			if (!load_texture(path, *result.data, result.error, m_desc.read_mode))
+			{
+				result.data.reset();
+			}
+			else if (m_desc.read_mode == TextureReadMode::Mapped)
+			{
+				// Page faults belong on the I/O job, not on the render thread staging the mips
+				result.data->file.prefetch();
+			}
+			result.read_seconds = static_cast<double>(Profiler::now() - begin_ns) / 1e9;
+
+			std::lock_guard<std::mutex> lock(m_read_results_mutex);
+			m_read_results.push_back(std::move(result));
+		}, &m_reads);
+		return texture_id;
+	}
+
+	void TextureStreamer::update()
+	{
+		PROFILE_FUNCTION();
+
+		complete_copies();
+		create_textures();
+		stage_mips();
+	}
+
+	bool TextureStreamer::is_failed(uint32_t texture_id) const
+	{
+		return m_textures[texture_id].is_failed;
+	}
+
+	const std::string& TextureStreamer::error(uint32_t texture_id) const
+	{
+		return m_textures[texture_id].error;
+	}
+
+	bool TextureStreamer::is_complete(uint32_t texture_id) const
+	{
+		return m_textures[texture_id].texture && m_textures[texture_id].most_detailed_mip == 0;
+	}
+
+	uint32_t TextureStreamer::most_detailed_mip(uint32_t texture_id) const
+	{
+		return m_textures[texture_id].most_detailed_mip;
+	}
+
+	void* TextureStreamer::texture(uint32_t texture_id) const
+	{
+		return m_textures[texture_id].texture;
+	}
+
+	const TextureDesc& TextureStreamer::desc(uint32_t texture_id) const
+	{
+		return m_textures[texture_id].desc;
+	}
+
+	uint32_t TextureStreamer::pending_count() const
+	{
+		return m_stats.requested_count - m_stats.completed_count - m_stats.failed_count;
+	}
+
+	TextureStreamingStats TextureStreamer::stats() const
+	{
+		return m_stats;
+	}
+
+	void TextureStreamer::create_textures()
+	{
+		if (m_pending_read_count == 0)
+		{
+			return;
+		}
+
+		std::vector<ReadResult> results;
+		{
+			std::unique_lock<std::mutex> lock(m_read_results_mutex, std::try_to_lock);
+			if (lock.owns_lock())
+			{
+				results.swap(m_read_results);
+			}
+		}
+
+		for (auto& result : results)
+		{
+			--m_pending_read_count;
+			m_stats.read_seconds += result.read_seconds;
+
+			Texture& texture = m_textures[result.texture_id];
+			if (!result.data)
+			{
+				texture.is_failed = true;
+				texture.error = std::move(result.error);
+				++m_stats.failed_count;
+				continue;
+			}
+
+			m_stats.read_bytes += result.data->file_size;
+			texture.desc = result.data->desc;
+			texture.texture = m_backend.create_texture(texture.desc);
+			texture.next_staged_mip = texture.desc.mip_count - 1;
+			texture.most_detailed_mip = texture.desc.mip_count;
+			texture.data = std::move(result.data);
+			m_staging_queue.push_back(result.texture_id);
+		}
+	}
+
+	void TextureStreamer::complete_copies()
+	{
+		const uint64_t completed_fence_value = m_backend.completed_fence_value();
+		m_upload_ring.retire(completed_fence_value);
+
+		// Copies finish in submission order
+		while (!m_copies.empty() && m_copies.front().fence_value <= completed_fence_value)
+		{
+			const Copy& copy = m_copies.front();
+			Texture& texture = m_textures[copy.texture_id];
+			texture.most_detailed_mip = copy.mip_idx;
+			++m_stats.uploaded_mips;
+
+			if (copy.mip_idx == 0)
+			{
+				++m_stats.completed_count;
+				m_stats.streaming_seconds = static_cast<double>(Profiler::now() - m_first_request_ns) / 1e9;
+			}
+			m_copies.pop_front();
+		}
+	}
+
+	void TextureStreamer::stage_mips()
+	{
+		const size_t first_copy_idx = m_copies.size();
+		uint64_t staged_bytes = 0;
+		while (!m_staging_queue.empty() && staged_bytes < m_desc.max_upload_bytes_per_update)
+		{
+			const uint32_t texture_id = m_staging_queue.front();
+			m_staging_queue.pop_front();
+			if (!stage_mip(texture_id, staged_bytes))
+			{
+				// Out of upload memory until earlier copies finished
+				m_staging_queue.push_front(texture_id);
+				break;
+			}
+
+			// One mip per texture and round, the least detailed mips of all textures go first
+			if (m_textures[texture_id].data)
+			{
+				m_staging_queue.push_back(texture_id);
+			}
+		}
+
+		if (m_copies.size() == first_copy_idx)
+		{
+			return;
+		}
+
+		m_last_fence_value = m_backend.submit();
+		m_upload_ring.submit(m_last_fence_value);
+		for (size_t copy_idx = first_copy_idx; copy_idx < m_copies.size(); ++copy_idx)
+		{
+			m_copies[copy_idx].fence_value = m_last_fence_value;
+		}
+	}
+
+	bool TextureStreamer::stage_mip(uint32_t texture_id, uint64_t& staged_bytes)
+	{
+		Texture& texture = m_textures[texture_id];
+		const uint32_t mip_idx = texture.next_staged_mip;
+		const TextureFootprint footprint = m_backend.mip_footprint(texture.texture, mip_idx);
+		if (footprint.size > m_upload_ring.capacity())
+		{
+			texture.is_failed = true;
+			texture.error = texture.path + " has a mip larger than the upload ring";
+			texture.data.reset();
+			++m_stats.failed_count;
+			return true;
+		}
+
+		uint64_t upload_offset;
+		if (!m_upload_ring.allocate(footprint.size, m_backend.upload_alignment(), upload_offset))
+		{
+			return false;
+		}
+
+		// The GPU wants wider rows than the file has
+		const TextureMip& mip = texture.data->mips[mip_idx];
+		uint8_t* destination = m_backend.upload_memory() + upload_offset;
+		const uint32_t row_size = std::min(footprint.row_size, mip.row_pitch);
+		for (uint32_t row_idx = 0; row_idx < footprint.row_count; ++row_idx)
+		{
+			std::memcpy(
+				destination + static_cast<uint64_t>(row_idx) * footprint.row_pitch,
+				mip.data + static_cast<uint64_t>(row_idx) * mip.row_pitch,
+				row_size);
+		}
+
+		m_backend.copy_mip(texture.texture, mip_idx, upload_offset, footprint);
+		m_copies.push_back({ texture_id, mip_idx, 0 });
+		staged_bytes += footprint.size;
+		m_stats.uploaded_bytes += mip.size;
+
+		if (mip_idx == 0)
+		{
+			texture.data.reset();
+		}
+		else
+		{
+			--texture.next_staged_mip;
+		}
+		return true;
+	}
+
+}
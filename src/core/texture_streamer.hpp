@@ -0,0 +1,167 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_TEXTURE_STREAMER_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_TEXTURE_STREAMER_HPP
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "job_system.hpp"
+#include "texture.hpp"
+#include "upload_ring.hpp"
+
+namespace Core
+{
+
+	// Where a mip goes in upload memory, as the GPU wants to read it
+	struct TextureFootprint
+	{
+		uint32_t row_pitch = 0;
+		uint32_t row_count = 0;
+		// Bytes of a row that hold texels, the rest of row_pitch is padding
+		uint32_t row_size = 0;
+		uint64_t size = 0;
+	};
+
+	// The GPU side of streaming: textures, a persistently mapped staging buffer and a copy queue.
+	// Only called from the render thread.
+	class TextureStreamingBackend
+	{
+	public:
+		virtual ~TextureStreamingBackend() = default;
+
+		virtual uint8_t* upload_memory() = 0;
+		virtual uint64_t upload_capacity() const = 0;
+		// Of a mip's offset in upload memory
+		virtual uint64_t upload_alignment() const = 0;
+
+		virtual void* create_texture(const TextureDesc& desc) = 0;
+		// The GPU must be done with the texture
+		virtual void destroy_texture(void* texture) = 0;
+		virtual TextureFootprint mip_footprint(void* texture, uint32_t mip_idx) = 0;
+
+		virtual void copy_mip(void* texture, uint32_t mip_idx, uint64_t upload_offset, const TextureFootprint& footprint) = 0;
+		// Submits the copies recorded since the last call, returns the fence value signalled once they finished
+		virtual uint64_t submit() = 0;
+		virtual uint64_t completed_fence_value() = 0;
+	};
+
+	struct TextureStreamerDesc
+	{
+		// Staged per update(), so one frame does not spend all its time copying
+		uint64_t max_upload_bytes_per_update = 32 * 1024 * 1024;
+		// Mapped files are paged in by the read job and staged straight from the page cache
+		TextureReadMode read_mode = TextureReadMode::Mapped;
+	};
+
+	struct TextureStreamingStats
+	{
+		uint32_t requested_count = 0;
+		uint32_t completed_count = 0;
+		uint32_t failed_count = 0;
+		uint64_t read_bytes = 0;
+		uint64_t uploaded_bytes = 0;
+		uint64_t uploaded_mips = 0;
+		// Summed over the I/O jobs
+		double read_seconds = 0.0;
+		// From the first request to the last completed upload
+		double streaming_seconds = 0.0;
+
+		double megabytes_per_second() const;
+		double textures_per_second() const;
+	};
+
+	// Streams textures from disk to the GPU. Files are read and parsed by background jobs,
+	// the render thread then stages one mip at a time through an upload ring and the
+	// backend copies them on its own queue. Mips are uploaded least detailed first and
+	// become usable as soon as their copy finished, so textures sharpen over a few frames.
+	class TextureStreamer
+	{
+	public:
+		TextureStreamer(JobSystem& job_system, TextureStreamingBackend& backend, const TextureStreamerDesc& desc = {});
+		TextureStreamer(const TextureStreamer&) = delete;
+		TextureStreamer& operator=(const TextureStreamer&) = delete;
+		// Waits for the reads and copies still running and destroys the textures
+		~TextureStreamer();
+
+		uint32_t request(const std::string& path);
+
+		// Creates the textures of finished reads, stages and submits mips and picks up
+		// finished copies, call once per frame
+		void update();
+
+		bool is_failed(uint32_t texture_id) const;
+		const std::string& error(uint32_t texture_id) const;
+		// Everything up to mip 0 was copied
+		bool is_complete(uint32_t texture_id) const;
+		// The most detailed mip that can be sampled, mip_count while none can.
+		// Clamp the sampler's minimum LOD to it.
+		uint32_t most_detailed_mip(uint32_t texture_id) const;
+		// Null until the read finished
+		void* texture(uint32_t texture_id) const;
+		const TextureDesc& desc(uint32_t texture_id) const;
+
+		// Textures neither complete nor failed
+		uint32_t pending_count() const;
+		TextureStreamingStats stats() const;
+	private:
+		struct Texture
+		{
+			std::string path;
+			TextureDesc desc;
+			void* texture = nullptr;
+			// The file until every mip is staged
+			std::unique_ptr<TextureData> data;
+			// Counts down, the least detailed mip is staged first
+			uint32_t next_staged_mip = 0;
+			uint32_t most_detailed_mip = 0;
+			bool is_failed = false;
+			std::string error;
+		};
+
+		struct ReadResult
+		{
+			uint32_t texture_id;
+			std::unique_ptr<TextureData> data;
+			std::string error;
+			double read_seconds;
+		};
+
+		struct Copy
+		{
+			uint32_t texture_id;
+			uint32_t mip_idx;
+			uint64_t fence_value;
+		};
+
+		void create_textures();
+		void complete_copies();
+		void stage_mips();
+		// False when the ring is full
+		bool stage_mip(uint32_t texture_id, uint64_t& staged_bytes);
+
+		JobSystem& m_job_system;
+		TextureStreamingBackend& m_backend;
+		TextureStreamerDesc m_desc;
+		UploadRing m_upload_ring;
+
+		std::deque<Texture> m_textures;
+		// Textures with mips left to stage, served round robin
+		std::deque<uint32_t> m_staging_queue;
+		std::deque<Copy> m_copies;
+		uint32_t m_pending_read_count = 0;
+		uint64_t m_last_fence_value = 0;
+
+		TextureStreamingStats m_stats;
+		uint64_t m_first_request_ns = 0;
+
+		std::mutex m_read_results_mutex;
+		std::vector<ReadResult> m_read_results;
+		JobCounter m_reads;
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_TEXTURE_STREAMER_HPP
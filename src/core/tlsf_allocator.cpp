@@ -0,0 +1,350 @@
+#include "tlsf_allocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Core
+{
+
+	namespace
+	{
+		uint32_t find_last_set(uint64_t value)
+		{
+			assert(value != 0);
+#if defined(_MSC_VER)
+			unsigned long bit_idx;
+			_BitScanReverse64(&bit_idx, value);
+			return bit_idx;
+#else
+			return 63 - __builtin_clzll(value);
+#endif
+		}
+
+		uint32_t find_first_set(uint32_t value)
+		{
+			assert(value != 0);
+#if defined(_MSC_VER)
+			unsigned long bit_idx;
+			_BitScanForward(&bit_idx, value);
+			return bit_idx;
+#else
+			return __builtin_ctz(value);
+#endif
+		}
+	}
+
+	TlsfAllocator::TlsfAllocator(uint64_t size, uint64_t granularity)
+	{
+		assert(granularity != 0 && (granularity & (granularity - 1)) == 0);
+		m_granularity_shift = find_last_set(granularity);
+		m_size = size >> m_granularity_shift;
+		assert(m_size > 0 && find_last_set(m_size) < first_level_count + second_level_bits - 1);
+
+		for (auto& free_lists : m_free_lists)
+		{
+			std::fill(std::begin(free_lists), std::end(free_lists), invalid_block);
+		}
+
+		// The block at offset 0 is never merged away, the block walk starts there
+		const uint32_t block_idx = create_block();
+		m_blocks[block_idx].size = m_size;
+		insert_free_block(block_idx);
+	}
+
+	TlsfAllocation TlsfAllocator::allocate(uint64_t size, uint64_t alignment)
+	{
+		assert(size > 0);
+		assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+		const uint64_t granularity_mask = (uint64_t(1) << m_granularity_shift) - 1;
+		const uint64_t unit_size = (size + granularity_mask) >> m_granularity_shift;
+		const uint64_t unit_alignment = std::max<uint64_t>(alignment >> m_granularity_shift, 1);
+		if (unit_size > m_size)
+		{
+			return {};
+		}
+
+		// Any block this large has an aligned range of unit_size in it
+		const uint32_t block_idx = find_free_block(unit_size + unit_alignment - 1);
+		if (block_idx == invalid_block)
+		{
+			return {};
+		}
+		remove_free_block(block_idx);
+
+		uint32_t allocated_idx = block_idx;
+		const uint64_t offset = m_blocks[block_idx].offset;
+		const uint64_t padding = ((offset + unit_alignment - 1) & ~(unit_alignment - 1)) - offset;
+		if (padding > 0)
+		{
+			// The padding in front stays free
+			allocated_idx = split_block(block_idx, padding);
+			remove_free_block(allocated_idx);
+			insert_free_block(block_idx);
+		}
+		if (m_blocks[allocated_idx].size > unit_size)
+		{
+			split_block(allocated_idx, unit_size);
+		}
+
+		Block& block = m_blocks[allocated_idx];
+		block.is_free = false;
+		++m_allocation_count;
+
+		TlsfAllocation allocation;
+		allocation.offset = block.offset << m_granularity_shift;
+		allocation.size = block.size << m_granularity_shift;
+		allocation.block = allocated_idx;
+		return allocation;
+	}
+
+	void TlsfAllocator::free(const TlsfAllocation& allocation)
+	{
+		assert(allocation.is_valid());
+
+		uint32_t block_idx = allocation.block;
+		assert(!m_blocks[block_idx].is_free);
+		m_blocks[block_idx].is_free = true;
+		--m_allocation_count;
+
+		const uint32_t next_idx = m_blocks[block_idx].next_physical;
+		if (next_idx != invalid_block && m_blocks[next_idx].is_free)
+		{
+			remove_free_block(next_idx);
+			merge_with_next(block_idx);
+		}
+
+		const uint32_t previous_idx = m_blocks[block_idx].previous_physical;
+		if (previous_idx != invalid_block && m_blocks[previous_idx].is_free)
+		{
+			remove_free_block(previous_idx);
+			merge_with_next(previous_idx);
+			block_idx = previous_idx;
+		}
+
+		insert_free_block(block_idx);
+	}
+
+	bool TlsfAllocator::is_empty() const
+	{
+		return m_allocation_count == 0;
+	}
+
+	uint64_t TlsfAllocator::size() const
+	{
+		return m_size << m_granularity_shift;
+	}
+
+	TlsfStats TlsfAllocator::stats() const
+	{
+		TlsfStats stats;
+		stats.size = size();
+		stats.allocation_count = m_allocation_count;
+		for (uint32_t block_idx = 0; block_idx != invalid_block; block_idx = m_blocks[block_idx].next_physical)
+		{
+			const Block& block = m_blocks[block_idx];
+			if (block.is_free)
+			{
+				const uint64_t size = block.size << m_granularity_shift;
+				stats.free_bytes += size;
+				stats.largest_free_block = std::max(stats.largest_free_block, size);
+				++stats.free_block_count;
+			}
+		}
+		return stats;
+	}
+
+	void TlsfAllocator::bin_of(uint64_t size, uint32_t& first_level, uint32_t& second_level)
+	{
+		if (size < second_level_count)
+		{
+			first_level = 0;
+			second_level = static_cast<uint32_t>(size);
+			return;
+		}
+
+		const uint32_t last_set = find_last_set(size);
+		first_level = last_set - second_level_bits + 1;
+		second_level = static_cast<uint32_t>(size >> (last_set - second_level_bits)) - second_level_count;
+	}
+
+	void TlsfAllocator::search_bin_of(uint64_t size, uint32_t& first_level, uint32_t& second_level)
+	{
+		if (size >= second_level_count)
+		{
+			size += (uint64_t(1) << (find_last_set(size) - second_level_bits)) - 1;
+		}
+		bin_of(size, first_level, second_level);
+	}
+
+	uint32_t TlsfAllocator::find_free_block(uint64_t size) const
+	{
+		uint32_t first_level;
+		uint32_t second_level;
+		search_bin_of(size, first_level, second_level);
+		if (first_level >= first_level_count)
+		{
+			return find_free_block_in_bin(size);
+		}
+
+		uint32_t second_level_bitmap = m_second_level_bitmaps[first_level] & (~0U << second_level);
+		if (second_level_bitmap == 0)
+		{
+			// Any block of a larger size class fits
+			const uint32_t first_level_bitmap = first_level + 1 < first_level_count
+				? m_first_level_bitmap & (~0U << (first_level + 1))
+				: 0;
+			if (first_level_bitmap == 0)
+			{
+				return find_free_block_in_bin(size);
+			}
+			first_level = find_first_set(first_level_bitmap);
+			second_level_bitmap = m_second_level_bitmaps[first_level];
+		}
+
+		second_level = find_first_set(second_level_bitmap);
+		return m_free_lists[first_level][second_level];
+	}
+
+	uint32_t TlsfAllocator::find_free_block_in_bin(uint64_t size) const
+	{
+		uint32_t first_level;
+		uint32_t second_level;
+		bin_of(size, first_level, second_level);
+		if (first_level >= first_level_count)
+		{
+			return invalid_block;
+		}
+
+		for (
+			uint32_t block_idx = m_free_lists[first_level][second_level];
+			block_idx != invalid_block;
+			block_idx = m_blocks[block_idx].next_free)
+		{
+			if (m_blocks[block_idx].size >= size)
+			{
+				return block_idx;
+			}
+		}
+		return invalid_block;
+	}
+
+	void TlsfAllocator::insert_free_block(uint32_t block_idx)
+	{
+		uint32_t first_level;
+		uint32_t second_level;
+		bin_of(m_blocks[block_idx].size, first_level, second_level);
+
+		Block& block = m_blocks[block_idx];
+		const uint32_t head_idx = m_free_lists[first_level][second_level];
+		block.is_free = true;
+		block.previous_free = invalid_block;
+		block.next_free = head_idx;
+		if (head_idx != invalid_block)
+		{
+			m_blocks[head_idx].previous_free = block_idx;
+		}
+		m_free_lists[first_level][second_level] = block_idx;
+
+		m_first_level_bitmap |= 1U << first_level;
+		m_second_level_bitmaps[first_level] |= 1U << second_level;
+	}
+
+	void TlsfAllocator::remove_free_block(uint32_t block_idx)
+	{
+		uint32_t first_level;
+		uint32_t second_level;
+		bin_of(m_blocks[block_idx].size, first_level, second_level);
+
+		Block& block = m_blocks[block_idx];
+		if (block.previous_free != invalid_block)
+		{
+			m_blocks[block.previous_free].next_free = block.next_free;
+		}
+		else
+		{
+			m_free_lists[first_level][second_level] = block.next_free;
+			if (block.next_free == invalid_block)
+			{
+				m_second_level_bitmaps[first_level] &= ~(1U << second_level);
+				if (m_second_level_bitmaps[first_level] == 0)
+				{
+					m_first_level_bitmap &= ~(1U << first_level);
+				}
+			}
+		}
+		if (block.next_free != invalid_block)
+		{
+			m_blocks[block.next_free].previous_free = block.previous_free;
+		}
+		block.previous_free = invalid_block;
+		block.next_free = invalid_block;
+	}
+
+	uint32_t TlsfAllocator::split_block(uint32_t block_idx, uint64_t size)
+	{
+		// Creating the block may move m_blocks
+		const uint32_t rest_idx = create_block();
+		Block& block = m_blocks[block_idx];
+		Block& rest = m_blocks[rest_idx];
+		assert(block.size > size);
+
+		rest.offset = block.offset + size;
+		rest.size = block.size - size;
+		rest.previous_physical = block_idx;
+		rest.next_physical = block.next_physical;
+		if (block.next_physical != invalid_block)
+		{
+			m_blocks[block.next_physical].previous_physical = rest_idx;
+		}
+		block.next_physical = rest_idx;
+		block.size = size;
+
+		// The block after it is in use, free neighbours are always merged
+		insert_free_block(rest_idx);
+		return rest_idx;
+	}
+
+	void TlsfAllocator::merge_with_next(uint32_t block_idx)
+	{
+		Block& block = m_blocks[block_idx];
+		const uint32_t next_idx = block.next_physical;
+		const Block& next = m_blocks[next_idx];
+
+		block.size += next.size;
+		block.next_physical = next.next_physical;
+		if (next.next_physical != invalid_block)
+		{
+			m_blocks[next.next_physical].previous_physical = block_idx;
+		}
+		release_block(next_idx);
+	}
+
+	uint32_t TlsfAllocator::create_block()
+	{
+		uint32_t block_idx = m_unused_block;
+		if (block_idx != invalid_block)
+		{
+			m_unused_block = m_blocks[block_idx].next_free;
+			m_blocks[block_idx] = Block();
+		}
+		else
+		{
+			block_idx = static_cast<uint32_t>(m_blocks.size());
+			m_blocks.emplace_back();
+		}
+		return block_idx;
+	}
+
+	void TlsfAllocator::release_block(uint32_t block_idx)
+	{
+		m_blocks[block_idx] = Block();
+		m_blocks[block_idx].next_free = m_unused_block;
+		m_unused_block = block_idx;
+	}
+
+}
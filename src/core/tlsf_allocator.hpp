@@ -0,0 +1,102 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_TLSF_ALLOCATOR_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_TLSF_ALLOCATOR_HPP
+
+#include <cstdint>
+#include <vector>
+
+namespace Core
+{
+
+	struct TlsfAllocation
+	{
+		static constexpr uint32_t invalid_block = UINT32_MAX;
+
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		uint32_t block = invalid_block;
+
+		bool is_valid() const
+		{
+			return block != invalid_block;
+		}
+	};
+
+	struct TlsfStats
+	{
+		uint64_t size = 0;
+		uint64_t free_bytes = 0;
+		uint64_t largest_free_block = 0;
+		uint32_t allocation_count = 0;
+		uint32_t free_block_count = 0;
+	};
+
+	// Two level segregated fit allocator for memory it never touches itself, like GPU heaps.
+	// It hands out offsets into a range and keeps its bookkeeping on the side, allocate()
+	// and free() are O(1). Sizes are rounded up to the granularity, which also is the
+	// smallest alignment.
+	class TlsfAllocator
+	{
+	public:
+		// granularity has to be a power of two
+		TlsfAllocator(uint64_t size, uint64_t granularity);
+
+		// Invalid when no free block is large enough. alignment has to be a power of two.
+		TlsfAllocation allocate(uint64_t size, uint64_t alignment);
+		void free(const TlsfAllocation& allocation);
+
+		bool is_empty() const;
+		uint64_t size() const;
+		// Walks every block
+		TlsfStats stats() const;
+	private:
+		// Every size class is split into this many linearly spaced bins
+		static constexpr uint32_t second_level_bits = 4;
+		static constexpr uint32_t second_level_count = 1 << second_level_bits;
+		static constexpr uint32_t first_level_count = 32;
+		static constexpr uint32_t invalid_block = TlsfAllocation::invalid_block;
+
+		struct Block
+		{
+			// In units of the granularity
+			uint64_t offset = 0;
+			uint64_t size = 0;
+			// Neighbours in memory
+			uint32_t previous_physical = invalid_block;
+			uint32_t next_physical = invalid_block;
+			// Neighbours in the free list of its bin, or in the list of unused blocks
+			uint32_t previous_free = invalid_block;
+			uint32_t next_free = invalid_block;
+			bool is_free = false;
+		};
+
+		static void bin_of(uint64_t size, uint32_t& first_level, uint32_t& second_level);
+		// Rounds up so every block in the bin is at least size
+		static void search_bin_of(uint64_t size, uint32_t& first_level, uint32_t& second_level);
+
+		uint32_t find_free_block(uint64_t size) const;
+		// Only the blocks sharing the bin of size, some of them may be smaller. Lets the
+		// last few blocks of a nearly full range still be allocated exactly.
+		uint32_t find_free_block_in_bin(uint64_t size) const;
+		void insert_free_block(uint32_t block_idx);
+		void remove_free_block(uint32_t block_idx);
+		// The front part keeps block_idx, the rest becomes a new free block
+		uint32_t split_block(uint32_t block_idx, uint64_t size);
+		void merge_with_next(uint32_t block_idx);
+		uint32_t create_block();
+		void release_block(uint32_t block_idx);
+
+		uint64_t m_size;
+		uint32_t m_granularity_shift = 0;
+		uint32_t m_allocation_count = 0;
+
+		std::vector<Block> m_blocks;
+		uint32_t m_unused_block = invalid_block;
+
+		uint32_t m_first_level_bitmap = 0;
+		uint32_t m_second_level_bitmaps[first_level_count] = {};
+		uint32_t m_free_lists[first_level_count][second_level_count];
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_TLSF_ALLOCATOR_HPP
@@ -0,0 +1,233 @@
+#include "transform_hierarchy.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+#include "job_system.hpp"
+#include "profiler.hpp"
+
+namespace Core
+{
+
+	namespace
+	{
+		// Levels smaller than this are updated on the calling thread
+		constexpr uint32_t update_grain_size = 4096;
+
+		template<typename T>
+		void permute(std::vector<T>& values, const std::vector<uint32_t>& new_slots)
+		{
+			std::vector<T> sorted(values.size());
+			for (size_t slot = 0; slot < values.size(); ++slot)
+			{
+				sorted[new_slots[slot]] = values[slot];
+			}
+			values.swap(sorted);
+		}
+	}
+
+	uint32_t TransformHierarchy::add_node(uint32_t parent_id, const Transform& local)
+	{
+		assert(parent_id == invalid_node || parent_id < m_slots.size());
+		const auto node_id = static_cast<uint32_t>(m_slots.size());
+		const auto slot = static_cast<uint32_t>(m_node_ids.size());
+		const uint32_t parent_slot = parent_id == invalid_node ? invalid_node : m_slots[parent_id];
+
+		m_slots.push_back(slot);
+		m_node_ids.push_back(node_id);
+		m_parent_slots.push_back(parent_slot);
+		m_depths.push_back(parent_slot == invalid_node ? 0 : m_depths[parent_slot] + 1);
+		m_position_x.push_back(0.0f);
+		m_position_y.push_back(0.0f);
+		m_position_z.push_back(0.0f);
+		m_rotation_x.push_back(0.0f);
+		m_rotation_y.push_back(0.0f);
+		m_rotation_z.push_back(0.0f);
+		m_rotation_w.push_back(1.0f);
+		m_scale_x.push_back(1.0f);
+		m_scale_y.push_back(1.0f);
+		m_scale_z.push_back(1.0f);
+		m_world.emplace_back();
+		m_is_local_dirty.push_back(0);
+		m_is_world_changed.push_back(0);
+		set_local(node_id, local);
+
+		m_is_sorted = false;
+		return node_id;
+	}
+
+	void TransformHierarchy::set_local(uint32_t node_id, const Transform& local)
+	{
+		const uint32_t slot = m_slots[node_id];
+		m_position_x[slot] = local.position.x;
+		m_position_y[slot] = local.position.y;
+		m_position_z[slot] = local.position.z;
+		m_rotation_x[slot] = local.rotation.x;
+		m_rotation_y[slot] = local.rotation.y;
+		m_rotation_z[slot] = local.rotation.z;
+		m_rotation_w[slot] = local.rotation.w;
+		m_scale_x[slot] = local.scale.x;
+		m_scale_y[slot] = local.scale.y;
+		m_scale_z[slot] = local.scale.z;
+		m_is_local_dirty[slot] = 1;
+	}
+
+	Transform TransformHierarchy::local(uint32_t node_id) const
+	{
+		const uint32_t slot = m_slots[node_id];
+		Transform local;
+		local.position = { m_position_x[slot], m_position_y[slot], m_position_z[slot] };
+		local.rotation = { m_rotation_x[slot], m_rotation_y[slot], m_rotation_z[slot], m_rotation_w[slot] };
+		local.scale = { m_scale_x[slot], m_scale_y[slot], m_scale_z[slot] };
+		return local;
+	}
+
+	TransformUpdateStats TransformHierarchy::update(JobSystem& job_system)
+	{
+		PROFILE_ZONE("Update transforms");
+
+		if (!m_is_sorted)
+		{
+			sort_by_depth();
+		}
+
+		// A level only reads the flags and matrices of the one before it, which is complete
+		std::atomic<uint32_t> updated_count{ 0 };
+		uint32_t level_begin = 0;
+		for (const uint32_t level_end : m_level_ends)
+		{
+			const auto update_counted = [this, &updated_count, level_begin](uint32_t begin, uint32_t end)
+			{
+				updated_count.fetch_add(update_range(level_begin + begin, level_begin + end), std::memory_order_relaxed);
+			};
+
+			const uint32_t level_count = level_end - level_begin;
+			if (level_count <= update_grain_size)
+			{
+				update_counted(0, level_count);
+			}
+			else
+			{
+				job_system.parallel_for(level_count, update_grain_size, update_counted);
+			}
+			level_begin = level_end;
+		}
+
+		TransformUpdateStats stats;
+		stats.updated_count = updated_count.load(std::memory_order_relaxed);
+		stats.level_count = static_cast<uint32_t>(m_level_ends.size());
+		return stats;
+	}
+
+	const Float4x4& TransformHierarchy::world(uint32_t node_id) const
+	{
+		return m_world[m_slots[node_id]];
+	}
+
+	bool TransformHierarchy::is_world_changed(uint32_t node_id) const
+	{
+		return m_is_world_changed[m_slots[node_id]] != 0;
+	}
+
+	uint32_t TransformHierarchy::node_count() const
+	{
+		return static_cast<uint32_t>(m_slots.size());
+	}
+
+	void TransformHierarchy::sort_by_depth()
+	{
+		// Counting sort, which keeps siblings added together next to each other
+		const auto count = static_cast<uint32_t>(m_node_ids.size());
+		uint32_t level_count = 0;
+		for (const uint32_t depth : m_depths)
+		{
+			level_count = std::max(level_count, depth + 1);
+		}
+
+		m_level_ends.assign(level_count, 0);
+		for (const uint32_t depth : m_depths)
+		{
+			++m_level_ends[depth];
+		}
+		std::vector<uint32_t> level_cursors(level_count);
+		uint32_t level_begin = 0;
+		for (uint32_t depth = 0; depth < level_count; ++depth)
+		{
+			level_cursors[depth] = level_begin;
+			level_begin += m_level_ends[depth];
+			m_level_ends[depth] = level_begin;
+		}
+
+		std::vector<uint32_t> new_slots(count);
+		bool is_in_order = true;
+		for (uint32_t slot = 0; slot < count; ++slot)
+		{
+			new_slots[slot] = level_cursors[m_depths[slot]]++;
+			is_in_order &= new_slots[slot] == slot;
+		}
+		m_is_sorted = true;
+		if (is_in_order)
+		{
+			return;
+		}
+
+		for (uint32_t& parent_slot : m_parent_slots)
+		{
+			if (parent_slot != invalid_node)
+			{
+				parent_slot = new_slots[parent_slot];
+			}
+		}
+		permute(m_parent_slots, new_slots);
+		permute(m_depths, new_slots);
+		permute(m_position_x, new_slots);
+		permute(m_position_y, new_slots);
+		permute(m_position_z, new_slots);
+		permute(m_rotation_x, new_slots);
+		permute(m_rotation_y, new_slots);
+		permute(m_rotation_z, new_slots);
+		permute(m_rotation_w, new_slots);
+		permute(m_scale_x, new_slots);
+		permute(m_scale_y, new_slots);
+		permute(m_scale_z, new_slots);
+		permute(m_world, new_slots);
+		permute(m_is_local_dirty, new_slots);
+		permute(m_is_world_changed, new_slots);
+		permute(m_node_ids, new_slots);
+		for (uint32_t slot = 0; slot < count; ++slot)
+		{
+			m_slots[m_node_ids[slot]] = slot;
+		}
+	}
+
+	uint32_t TransformHierarchy::update_range(uint32_t begin, uint32_t end)
+	{
+		uint32_t updated_count = 0;
+		for (uint32_t slot = begin; slot < end; ++slot)
+		{
+			const uint32_t parent_slot = m_parent_slots[slot];
+			const bool is_parent_changed = parent_slot != invalid_node && m_is_world_changed[parent_slot] != 0;
+			const bool is_changed = m_is_local_dirty[slot] != 0 || is_parent_changed;
+			m_is_world_changed[slot] = is_changed ? 1 : 0;
+			if (!is_changed)
+			{
+				continue;
+			}
+			m_is_local_dirty[slot] = 0;
+			++updated_count;
+
+			Matrix world = matrix_affine(
+				vector_set(m_scale_x[slot], m_scale_y[slot], m_scale_z[slot], 0.0f),
+				vector_set(m_rotation_x[slot], m_rotation_y[slot], m_rotation_z[slot], m_rotation_w[slot]),
+				vector_set(m_position_x[slot], m_position_y[slot], m_position_z[slot], 0.0f));
+			if (parent_slot != invalid_node)
+			{
+				world = matrix_multiply(world, load(m_world[parent_slot]));
+			}
+			store(m_world[slot], world);
+		}
+		return updated_count;
+	}
+
+}
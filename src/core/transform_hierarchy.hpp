@@ -0,0 +1,88 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_TRANSFORM_HIERARCHY_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_TRANSFORM_HIERARCHY_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "simd_math.hpp"
+
+namespace Core
+{
+
+	class JobSystem;
+
+	// Scale, then rotation, then translation, relative to the parent
+	struct Transform
+	{
+		Float3 position = { 0.0f, 0.0f, 0.0f };
+		// Quaternion, w is the real part
+		Float4 rotation = { 0.0f, 0.0f, 0.0f, 1.0f };
+		Float3 scale = { 1.0f, 1.0f, 1.0f };
+	};
+
+	struct TransformUpdateStats
+	{
+		// Nodes whose world matrix was recomputed, because they or one of their ancestors changed
+		uint32_t updated_count = 0;
+		uint32_t level_count = 0;
+	};
+
+	// Local transforms and world matrices of a scene graph, one array per component, with
+	// the nodes sorted by depth. Every parent comes before its children, so update() is one
+	// pass over the arrays, in parallel within a level, and nodes nothing changed for are
+	// skipped. Only for one thread, update() spreads itself over the job system.
+	class TransformHierarchy
+	{
+	public:
+		static constexpr uint32_t invalid_node = UINT32_MAX;
+
+		// The parent has to exist already, invalid_node adds a root. Returns the id the
+		// other calls take, ids never change when nodes are sorted.
+		uint32_t add_node(uint32_t parent_id, const Transform& local = {});
+		void set_local(uint32_t node_id, const Transform& local);
+		Transform local(uint32_t node_id) const;
+
+		// Sorts the nodes added since the last call and recomputes the world matrices of
+		// the changed ones and their descendants
+		TransformUpdateStats update(JobSystem& job_system);
+
+		// Both as of the last update()
+		const Float4x4& world(uint32_t node_id) const;
+		bool is_world_changed(uint32_t node_id) const;
+
+		uint32_t node_count() const;
+	private:
+		void sort_by_depth();
+		// Returns how many world matrices it recomputed
+		uint32_t update_range(uint32_t begin, uint32_t end);
+
+		// Indexed by slot, the position in depth order
+		std::vector<uint32_t> m_parent_slots;
+		std::vector<uint32_t> m_depths;
+		std::vector<float> m_position_x;
+		std::vector<float> m_position_y;
+		std::vector<float> m_position_z;
+		std::vector<float> m_rotation_x;
+		std::vector<float> m_rotation_y;
+		std::vector<float> m_rotation_z;
+		std::vector<float> m_rotation_w;
+		std::vector<float> m_scale_x;
+		std::vector<float> m_scale_y;
+		std::vector<float> m_scale_z;
+		std::vector<Float4x4> m_world;
+		// Bytes rather than std::vector<bool>, jobs write neighbouring ones
+		std::vector<uint8_t> m_is_local_dirty;
+		std::vector<uint8_t> m_is_world_changed;
+		std::vector<uint32_t> m_node_ids;
+
+		// Indexed by node id
+		std::vector<uint32_t> m_slots;
+
+		// Slots of each depth end at m_level_ends[depth]
+		std::vector<uint32_t> m_level_ends;
+		bool m_is_sorted = true;
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_TRANSFORM_HIERARCHY_HPP
@@ -0,0 +1,96 @@
+#include "upload_ring.hpp"
+
+#include <cassert>
+
+namespace Core
+{
+
+	UploadRing::UploadRing(uint64_t capacity) :
+		m_capacity(capacity)
+	{
+	}
+
+	bool UploadRing::allocate(uint64_t size, uint64_t alignment, uint64_t& offset)
+	{
+		assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+		if (m_used_bytes == 0)
+		{
+			m_head = 0;
+			m_tail = 0;
+		}
+
+		const uint64_t aligned_head = (m_head + alignment - 1) & ~(alignment - 1);
+		uint64_t end;
+		if (m_head > m_tail || m_used_bytes == 0)
+		{
+			// Free space is behind the head up to the end, and in front of the tail
+			if (aligned_head + size <= m_capacity)
+			{
+				offset = aligned_head;
+				end = aligned_head + size;
+			}
+			else if (size <= m_tail)
+			{
+				offset = 0;
+				end = size;
+				// The skipped end belongs to this allocation
+				m_used_bytes += m_capacity - m_head;
+				m_unsubmitted_bytes += m_capacity - m_head;
+				m_head = 0;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else
+		{
+			// Wrapped, the free space is between head and tail
+			if (aligned_head + size > m_tail)
+			{
+				return false;
+			}
+			offset = aligned_head;
+			end = aligned_head + size;
+		}
+
+		m_used_bytes += end - m_head;
+		m_unsubmitted_bytes += end - m_head;
+		m_head = end;
+		return true;
+	}
+
+	void UploadRing::submit(uint64_t fence_value)
+	{
+		if (m_unsubmitted_bytes == 0)
+		{
+			return;
+		}
+		assert(m_submissions.empty() || m_submissions.back().fence_value <= fence_value);
+
+		m_submissions.push_back({ fence_value, m_head, m_unsubmitted_bytes });
+		m_unsubmitted_bytes = 0;
+	}
+
+	void UploadRing::retire(uint64_t completed_fence_value)
+	{
+		while (!m_submissions.empty() && m_submissions.front().fence_value <= completed_fence_value)
+		{
+			m_tail = m_submissions.front().end_offset;
+			m_used_bytes -= m_submissions.front().size;
+			m_submissions.pop_front();
+		}
+	}
+
+	uint64_t UploadRing::capacity() const
+	{
+		return m_capacity;
+	}
+
+	uint64_t UploadRing::used_bytes() const
+	{
+		return m_used_bytes;
+	}
+
+}
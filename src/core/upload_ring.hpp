@@ -0,0 +1,45 @@
+#ifndef DIRECTX_PLAYGROUND_SRC_CORE_UPLOAD_RING_HPP
+#define DIRECTX_PLAYGROUND_SRC_CORE_UPLOAD_RING_HPP
+
+#include <cstdint>
+#include <deque>
+
+namespace Core
+{
+
+	// Hands out ranges of a fixed size staging buffer in submission order. Everything
+	// allocated before submit() is reclaimed at once when its fence value completed.
+	// Allocations are contiguous, one that does not fit before the end wraps to the start.
+	class UploadRing
+	{
+	public:
+		explicit UploadRing(uint64_t capacity);
+
+		// False while the ring is too full, alignment has to be a power of two
+		bool allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+		void submit(uint64_t fence_value);
+		void retire(uint64_t completed_fence_value);
+
+		uint64_t capacity() const;
+		// Including alignment padding and the space skipped when wrapping
+		uint64_t used_bytes() const;
+	private:
+		struct Submission
+		{
+			uint64_t fence_value;
+			uint64_t end_offset;
+			uint64_t size;
+		};
+
+		uint64_t m_capacity;
+		// Where the next allocation goes and where the oldest live one starts
+		uint64_t m_head = 0;
+		uint64_t m_tail = 0;
+		uint64_t m_used_bytes = 0;
+		uint64_t m_unsubmitted_bytes = 0;
+		std::deque<Submission> m_submissions;
+	};
+
+}
+
+#endif //DIRECTX_PLAYGROUND_SRC_CORE_UPLOAD_RING_HPP
@@ -0,0 +1,1887 @@
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "core/benchmark.hpp"
+#include "core/bvh.hpp"
+#include "core/frustum_culling.hpp"
+#include "core/job_system.hpp"
+#include "core/mesh_import.hpp"
+#include "core/mesh_optimizer.hpp"
+#include "core/meshlet.hpp"
+#include "core/null_backend.hpp"
+#include "core/occlusion_culling.hpp"
+#include "core/profiler.hpp"
+#include "core/render_queue.hpp"
+#include "core/residency.hpp"
+#include "core/scene.hpp"
+#include "core/simd_math.hpp"
+#include "core/software_backend.hpp"
+#include "core/texture_processing.hpp"
+#include "core/texture_streamer.hpp"
+#include "core/tlsf_allocator.hpp"
+#include "core/transform_hierarchy.hpp"
+
+namespace
+{
+	struct HeadlessConfig
+	{
+		std::string backend_name = "null";
+		// 0 lets the job system pick
+		uint32_t thread_count = 0;
+		std::string image_path;
+		// Simulated allocations the residency manager juggles every frame, 0 turns it off
+		uint32_t residency_allocation_count = 0;
+		// Allocations and frees against a simulated GPU heap every frame, 0 turns it off
+		uint32_t allocator_operation_count = 0;
+		// Every .dds and .ktx2 file in it is streamed through the null copy backend
+		std::string texture_directory;
+		Core::TextureReadMode texture_read_mode = Core::TextureReadMode::Mapped;
+		// Width and height of a generated image that gets mips and every block format once, 0 turns it off
+		uint32_t texture_processing_size = 0;
+		// An OBJ file whose text parsing is compared with loading it converted to a .mesh
+		std::string mesh_path;
+		// An OBJ file that is split into meshlets, which are then culled from cameras around it
+		std::string meshlet_mesh_path;
+		// Points transformed by a view projection matrix one at a time and in batches, 0 turns it off
+		uint32_t math_vector_count = 0;
+		// Nodes of a random transform hierarchy that gets updated with a few dirty ratios, 0 turns it off
+		uint32_t transform_node_count = 0;
+		// Most objects frustum culled, from 100k up in steps of 10, 0 turns it off
+		uint32_t culling_object_count = 0;
+		// Most objects a BVH is built over and queried, from 10k up in steps of 10, 0 turns it off
+		uint32_t bvh_object_count = 0;
+		// Objects in the streets of a city whose buildings occlude them, 0 turns it off
+		uint32_t occlusion_object_count = 0;
+		// Draws with random state sorted by the render queue and submitted to a null backend, 0 turns it off
+		uint32_t render_queue_draw_count = 0;
+		// Jobs in each synthetic task graph run at 1, 2, 4... threads, 0 turns it off
+		uint32_t task_graph_job_count = 0;
+		// Empty profile zones recorded back to back to measure what one costs, 0 turns it off
+		uint32_t profiler_zone_count = 0;
+	};
+
+	// Pretends to be a GPU with half as much memory as all allocations together need.
+	// Objects point at the allocation sizes.
+	class SimulatedResidencyBackend : public Core::ResidencyBackend
+	{
+	public:
+		SimulatedResidencyBackend(uint64_t budget_bytes, uint64_t usage_bytes) :
+			m_budget{ budget_bytes, usage_bytes }
+		{
+		}
+
+		Core::MemoryBudget query_budget() override
+		{
+			return m_budget;
+		}
+
+		void evict(void* const* objects, uint32_t count) override
+		{
+			for (uint32_t object_idx = 0; object_idx < count; ++object_idx)
+			{
+				m_budget.usage_bytes -= *static_cast<const uint64_t*>(objects[object_idx]);
+			}
+		}
+
+		bool make_resident(void* const* objects, uint32_t count) override
+		{
+			for (uint32_t object_idx = 0; object_idx < count; ++object_idx)
+			{
+				m_budget.usage_bytes += *static_cast<const uint64_t*>(objects[object_idx]);
+			}
+			return true;
+		}
+	private:
+		Core::MemoryBudget m_budget;
+	};
+
+	class ResidencySimulation
+	{
+	public:
+		explicit ResidencySimulation(uint32_t allocation_count) :
+			m_random(1234),
+			m_sizes(allocation_count)
+		{
+			uint64_t total_bytes = 0;
+			std::uniform_int_distribution<uint64_t> size_distribution(1, 64);
+			for (auto& size : m_sizes)
+			{
+				size = size_distribution(m_random) * 64 * 1024;
+				total_bytes += size;
+			}
+
+			m_backend = std::make_unique<SimulatedResidencyBackend>(total_bytes / 2, total_bytes);
+			m_manager = std::make_unique<Core::ResidencyManager>(*m_backend);
+			m_allocation_ids.reserve(allocation_count);
+			for (auto& size : m_sizes)
+			{
+				m_allocation_ids.push_back(m_manager->track(&size, size));
+			}
+		}
+
+		// Every frame uses a window of allocations that slowly moves, plus a few random ones
+		void run_frame()
+		{
+			PROFILE_FUNCTION();
+
+			const uint64_t begin_ns = Core::Profiler::now();
+
+			++m_fence_value;
+			const auto allocation_count = static_cast<uint32_t>(m_allocation_ids.size());
+			const uint32_t window_size = std::max(1U, allocation_count / 8);
+			const uint32_t window_begin = static_cast<uint32_t>(m_fence_value * (window_size / 16 + 1) % allocation_count);
+			for (uint32_t allocation_idx = 0; allocation_idx < window_size; ++allocation_idx)
+			{
+				m_manager->use(m_allocation_ids[(window_begin + allocation_idx) % allocation_count], m_fence_value);
+			}
+			std::uniform_int_distribution<uint32_t> allocation_distribution(0, allocation_count - 1);
+			for (uint32_t allocation_idx = 0; allocation_idx < window_size / 16; ++allocation_idx)
+			{
+				m_manager->use(m_allocation_ids[allocation_distribution(m_random)], m_fence_value);
+			}
+
+			m_manager->make_resident();
+			// Like a renderer with two frames in flight
+			m_manager->update(m_fence_value > 2 ? m_fence_value - 2 : 0);
+
+			m_total_ns += Core::Profiler::now() - begin_ns;
+			++m_frame_count;
+		}
+
+		void print_summary() const
+		{
+			const auto& counters = m_manager->counters();
+			std::printf(
+				"%u tracked allocations: %.1f us/frame, %.1f evictions/frame, %.1f made resident/frame, %llu stalled evictions\n",
+				m_manager->allocation_count(),
+				static_cast<double>(m_total_ns) / 1e3 / m_frame_count,
+				static_cast<double>(counters.evictions) / m_frame_count,
+				static_cast<double>(counters.make_residents) / m_frame_count,
+				static_cast<unsigned long long>(counters.stalled_evictions));
+		}
+	private:
+		std::mt19937_64 m_random;
+		std::vector<uint64_t> m_sizes;
+		std::unique_ptr<SimulatedResidencyBackend> m_backend;
+		std::unique_ptr<Core::ResidencyManager> m_manager;
+		std::vector<uint32_t> m_allocation_ids;
+		uint64_t m_fence_value = 0;
+		uint64_t m_total_ns = 0;
+		uint64_t m_frame_count = 0;
+	};
+
+	// Churns through resources of GPU like sizes and alignments in a 1 GiB heap kept about
+	// three quarters full, measuring the operation latency and how fragmented it gets
+	class AllocatorSimulation
+	{
+	public:
+		explicit AllocatorSimulation(uint32_t operation_count) :
+			m_operation_count(operation_count),
+			m_random(1234),
+			m_allocator(heap_size, granularity)
+		{
+		}
+
+		void run_frame()
+		{
+			PROFILE_FUNCTION();
+
+			// Mostly buffers and small textures, sometimes a render target
+			std::uniform_int_distribution<uint64_t> size_distribution(1, 64 * granularity);
+			std::uniform_int_distribution<uint32_t> percent_distribution(0, 99);
+
+			for (uint32_t operation_idx = 0; operation_idx < m_operation_count; ++operation_idx)
+			{
+				const bool is_allocating = m_allocations.empty()
+					|| (m_used_bytes < heap_size / 4 * 3 && percent_distribution(m_random) < 60);
+				if (is_allocating)
+				{
+					const bool is_msaa = percent_distribution(m_random) < 5;
+					const uint64_t size = size_distribution(m_random);
+					const uint64_t alignment = is_msaa ? msaa_alignment : granularity;
+
+					const uint64_t begin_ns = Core::Profiler::now();
+					const auto allocation = m_allocator.allocate(size, alignment);
+					m_allocate_ns += Core::Profiler::now() - begin_ns;
+					++m_allocate_count;
+
+					if (!allocation.is_valid())
+					{
+						++m_failed_allocate_count;
+						continue;
+					}
+					m_used_bytes += allocation.size;
+					m_allocations.push_back(allocation);
+				}
+				else
+				{
+					std::uniform_int_distribution<size_t> allocation_distribution(0, m_allocations.size() - 1);
+					const size_t allocation_idx = allocation_distribution(m_random);
+					const auto allocation = m_allocations[allocation_idx];
+					m_allocations[allocation_idx] = m_allocations.back();
+					m_allocations.pop_back();
+
+					const uint64_t begin_ns = Core::Profiler::now();
+					m_allocator.free(allocation);
+					m_free_ns += Core::Profiler::now() - begin_ns;
+					++m_free_count;
+					m_used_bytes -= allocation.size;
+				}
+			}
+		}
+
+		void print_summary() const
+		{
+			// The share of free memory unusable for an allocation of the largest free block's size
+			const auto stats = m_allocator.stats();
+			const double fragmentation = stats.free_bytes > 0
+				? 1.0 - static_cast<double>(stats.largest_free_block) / stats.free_bytes
+				: 0.0;
+			std::printf(
+				"TLSF: %.0f ns/allocate, %.0f ns/free, %llu failed allocations, %u allocations in %u MiB, %u free blocks, %.1f%% fragmentation\n",
+				static_cast<double>(m_allocate_ns) / std::max<uint64_t>(m_allocate_count, 1),
+				static_cast<double>(m_free_ns) / std::max<uint64_t>(m_free_count, 1),
+				static_cast<unsigned long long>(m_failed_allocate_count),
+				stats.allocation_count,
+				static_cast<uint32_t>((stats.size - stats.free_bytes) >> 20),
+				stats.free_block_count,
+				fragmentation * 100.0);
+		}
+	private:
+		static constexpr uint64_t heap_size = uint64_t(1) << 30;
+		// D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT and D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT
+		static constexpr uint64_t granularity = 64 * 1024;
+		static constexpr uint64_t msaa_alignment = 4 * 1024 * 1024;
+
+		uint32_t m_operation_count;
+		std::mt19937_64 m_random;
+		Core::TlsfAllocator m_allocator;
+		std::vector<Core::TlsfAllocation> m_allocations;
+		uint64_t m_used_bytes = 0;
+
+		uint64_t m_allocate_ns = 0;
+		uint64_t m_free_ns = 0;
+		uint64_t m_allocate_count = 0;
+		uint64_t m_free_count = 0;
+		uint64_t m_failed_allocate_count = 0;
+	};
+
+	// Generates mips and compresses an image with gradients, noise and hard edges once,
+	// outside the frame loop like authoring tools would
+	class TextureProcessingBenchmark
+	{
+	public:
+		explicit TextureProcessingBenchmark(uint32_t size)
+		{
+			m_image.width = size;
+			m_image.height = size;
+			m_image.pixels.resize(static_cast<size_t>(size) * size * 4);
+
+			std::mt19937 random(7);
+			std::uniform_int_distribution<int32_t> noise_distribution(-3, 3);
+			for (uint32_t y = 0; y < size; ++y)
+			{
+				for (uint32_t x = 0; x < size; ++x)
+				{
+					const float u = static_cast<float>(x) / size;
+					const float v = static_cast<float>(y) / size;
+					const bool is_inside_circle = (u - 0.5f) * (u - 0.5f) + (v - 0.5f) * (v - 0.5f) < 0.1f;
+					const float wave = 0.5f + 0.5f * std::sin(u * 40.0f + std::sin(v * 13.0f) * 4.0f);
+					const int32_t texel[4] = {
+						static_cast<int32_t>(u * 255.0f),
+						static_cast<int32_t>(wave * 200.0f),
+						is_inside_circle ? 230 : static_cast<int32_t>(v * 128.0f),
+						static_cast<int32_t>((1.0f - v) * 255.0f),
+					};
+					uint8_t* destination = m_image.pixels.data() + (static_cast<size_t>(y) * size + x) * 4;
+					for (uint32_t channel_idx = 0; channel_idx < 4; ++channel_idx)
+					{
+						destination[channel_idx] = static_cast<uint8_t>(std::clamp(texel[channel_idx] + noise_distribution(random), 0, 255));
+					}
+				}
+			}
+		}
+
+		void run(Core::JobSystem& job_system) const
+		{
+			const double megapixels = static_cast<double>(m_image.width) * m_image.height / 1e6;
+
+			const std::pair<Core::MipFilter, const char*> filters[] = {
+				{ Core::MipFilter::Box, "box" },
+				{ Core::MipFilter::Kaiser, "Kaiser" },
+			};
+			for (const auto& [filter, name] : filters)
+			{
+				std::vector<Core::Image> mips;
+				const uint64_t begin_ns = Core::Profiler::now();
+				Core::generate_mips(job_system, m_image, filter, true, mips);
+				const double seconds = static_cast<double>(Core::Profiler::now() - begin_ns) / 1e9;
+				std::printf("%ux%u sRGB %s mips: %u levels in %.1f ms, %.1f MPix/s\n",
+					m_image.width, m_image.height, name, static_cast<uint32_t>(mips.size()), seconds * 1e3, megapixels / seconds);
+			}
+
+			// Channels the format keeps, PSNR ignores the rest
+			const std::tuple<Core::TextureFormat, const char*, uint32_t> formats[] = {
+				{ Core::TextureFormat::BC1Unorm, "BC1", 3 },
+				{ Core::TextureFormat::BC3Unorm, "BC3", 4 },
+				{ Core::TextureFormat::BC5Unorm, "BC5", 2 },
+				{ Core::TextureFormat::BC7Unorm, "BC7", 4 },
+			};
+			for (const auto& [format, name, channel_count] : formats)
+			{
+				std::vector<uint8_t> blocks;
+				const uint64_t begin_ns = Core::Profiler::now();
+				Core::compress_blocks(job_system, m_image, format, blocks);
+				const double seconds = static_cast<double>(Core::Profiler::now() - begin_ns) / 1e9;
+
+				Core::Image decoded;
+				Core::decompress_blocks(blocks.data(), format, m_image.width, m_image.height, decoded);
+				std::printf("%ux%u %s: %.1f ms, %.1f MPix/s, %.2f dB PSNR\n",
+					m_image.width, m_image.height, name, seconds * 1e3, megapixels / seconds, Core::compute_psnr(m_image, decoded, channel_count));
+			}
+		}
+	private:
+		Core::Image m_image;
+	};
+
+	// Parses an OBJ file, converts it and maps the .mesh, best of a few runs each with a
+	// warm page cache, so the comparison is parsing against not parsing
+	class MeshLoadBenchmark
+	{
+	public:
+		explicit MeshLoadBenchmark(const std::string& obj_path) :
+			m_obj_path(obj_path),
+			m_mesh_path((std::filesystem::temp_directory_path() / std::filesystem::path(obj_path).stem()).string() + ".mesh")
+		{
+		}
+
+		bool run(std::string& error) const
+		{
+			Core::MeshImport imported_mesh;
+			uint64_t parse_ns = UINT64_MAX;
+			for (uint32_t run_idx = 0; run_idx < run_count; ++run_idx)
+			{
+				const uint64_t begin_ns = Core::Profiler::now();
+				if (!Core::parse_obj(m_obj_path, imported_mesh, error))
+				{
+					return false;
+				}
+				parse_ns = std::min(parse_ns, Core::Profiler::now() - begin_ns);
+			}
+			if (!Core::write_mesh(m_mesh_path, imported_mesh, error))
+			{
+				return false;
+			}
+
+			// What an upload costs on top of loading: the sections copied into staging memory
+			std::vector<uint8_t> upload_memory;
+			uint64_t load_ns = UINT64_MAX;
+			Core::MeshData mesh;
+			for (uint32_t run_idx = 0; run_idx < run_count; ++run_idx)
+			{
+				const uint64_t begin_ns = Core::Profiler::now();
+				mesh = Core::MeshData();
+				if (!Core::load_mesh(m_mesh_path, mesh, error))
+				{
+					return false;
+				}
+				const size_t vertex_bytes = static_cast<size_t>(mesh.header.vertex_count) * sizeof(Core::MeshVertex);
+				const size_t index_bytes = static_cast<size_t>(mesh.header.index_count) * mesh.header.index_size;
+				upload_memory.resize(vertex_bytes + index_bytes);
+				std::memcpy(upload_memory.data(), mesh.vertices, vertex_bytes);
+				std::memcpy(upload_memory.data() + vertex_bytes, mesh.indices, index_bytes);
+				load_ns = std::min(load_ns, Core::Profiler::now() - begin_ns);
+			}
+
+			std::printf(
+				"%u vertices, %u triangles: OBJ (%.1f MB) parsed in %.1f ms, .mesh (%.1f MB) mapped and copied in %.2f ms, %.0fx faster\n",
+				mesh.header.vertex_count,
+				mesh.header.index_count / 3,
+				static_cast<double>(std::filesystem::file_size(m_obj_path)) / 1e6,
+				static_cast<double>(parse_ns) / 1e6,
+				static_cast<double>(mesh.header.file_size) / 1e6,
+				static_cast<double>(load_ns) / 1e6,
+				static_cast<double>(parse_ns) / std::max<uint64_t>(load_ns, 1));
+			return true;
+		}
+	private:
+		static constexpr uint32_t run_count = 3;
+
+		std::string m_obj_path;
+		std::string m_mesh_path;
+	};
+
+	// Builds meshlets for an OBJ file, best of a few runs, then culls them from cameras
+	// circling the mesh at a few distances, from close enough to see only part of it
+	class MeshletBenchmark
+	{
+	public:
+		explicit MeshletBenchmark(const std::string& obj_path) :
+			m_obj_path(obj_path)
+		{
+		}
+
+		bool run(std::string& error) const
+		{
+			Core::MeshImport mesh;
+			if (!Core::parse_obj(m_obj_path, mesh, error))
+			{
+				return false;
+			}
+			Core::optimize_mesh(mesh);
+
+			uint64_t build_ns = UINT64_MAX;
+			for (uint32_t run_idx = 0; run_idx < run_count; ++run_idx)
+			{
+				const uint64_t begin_ns = Core::Profiler::now();
+				Core::build_meshlets(mesh);
+				build_ns = std::min(build_ns, Core::Profiler::now() - begin_ns);
+			}
+
+			float bounds_min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float bounds_max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (const auto& vertex : mesh.vertices)
+			{
+				for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+				{
+					bounds_min[axis_idx] = std::min(bounds_min[axis_idx], vertex.position[axis_idx]);
+					bounds_max[axis_idx] = std::max(bounds_max[axis_idx], vertex.position[axis_idx]);
+				}
+			}
+			const float center[3] = {
+				(bounds_min[0] + bounds_max[0]) * 0.5f,
+				(bounds_min[1] + bounds_max[1]) * 0.5f,
+				(bounds_min[2] + bounds_max[2]) * 0.5f,
+			};
+			const float radius = std::max(0.5f * std::sqrt(
+				(bounds_max[0] - bounds_min[0]) * (bounds_max[0] - bounds_min[0])
+				+ (bounds_max[1] - bounds_min[1]) * (bounds_max[1] - bounds_min[1])
+				+ (bounds_max[2] - bounds_min[2]) * (bounds_max[2] - bounds_min[2])), 1e-3f);
+
+			const auto meshlet_count = static_cast<uint32_t>(mesh.meshlets.size());
+			std::vector<uint32_t> visible_meshlets(meshlet_count);
+			Core::MeshletCullStats total_stats;
+			uint64_t cull_ns = 0;
+			for (uint32_t view_idx = 0; view_idx < view_count; ++view_idx)
+			{
+				const float angle = 6.2831853f * static_cast<float>(view_idx) / view_count;
+				const float distance = radius * (0.7f + 0.5f * static_cast<float>(view_idx % 4));
+				const float position[3] = {
+					center[0] + std::cos(angle) * distance,
+					center[1] + radius * 0.3f,
+					center[2] + std::sin(angle) * distance,
+				};
+				const float forward[3] = { center[0] - position[0], center[1] - position[1], center[2] - position[2] };
+				const float up[3] = { 0.0f, 1.0f, 0.0f };
+				const Core::MeshletCullView view = Core::make_meshlet_cull_view(position, forward, up, 1.0f, 16.0f / 9.0f, radius * 0.01f, radius * 10.0f);
+
+				const uint64_t begin_ns = Core::Profiler::now();
+				const Core::MeshletCullStats stats = Core::cull_meshlets(mesh.meshlets.data(), meshlet_count, view, visible_meshlets.data());
+				cull_ns += Core::Profiler::now() - begin_ns;
+				total_stats.visible_count += stats.visible_count;
+				total_stats.frustum_culled_count += stats.frustum_culled_count;
+				total_stats.cone_culled_count += stats.cone_culled_count;
+			}
+
+			const double meshlet_divisor = std::max(meshlet_count, 1U);
+			const double tested_count = static_cast<double>(meshlet_count) * view_count;
+			std::printf(
+				"%u meshlets, %.1f vertices and %.1f triangles on average, built in %.1f ms, %.1f Mtriangles/s\n",
+				meshlet_count,
+				static_cast<double>(mesh.meshlet_vertices.size()) / meshlet_divisor,
+				static_cast<double>(mesh.indices.size() / 3) / meshlet_divisor,
+				static_cast<double>(build_ns) / 1e6,
+				static_cast<double>(mesh.indices.size() / 3) / std::max(static_cast<double>(build_ns), 1.0) * 1e3);
+			std::printf(
+				"%u views culled in %.2f ms, %.1f Mmeshlets/s: %.1f%% visible, %.1f%% outside the frustum, %.1f%% facing away\n",
+				view_count,
+				static_cast<double>(cull_ns) / 1e6,
+				tested_count / std::max(static_cast<double>(cull_ns), 1.0) * 1e3,
+				100.0 * total_stats.visible_count / std::max(tested_count, 1.0),
+				100.0 * total_stats.frustum_culled_count / std::max(tested_count, 1.0),
+				100.0 * total_stats.cone_culled_count / std::max(tested_count, 1.0));
+			return true;
+		}
+	private:
+		static constexpr uint32_t run_count = 3;
+		static constexpr uint32_t view_count = 256;
+
+		std::string m_obj_path;
+	};
+
+	// Transforms the same points by a view projection matrix with plain scalar code, one
+	// Core::Vector at a time and with the SoA batch kernel, best of a few runs each
+	class MathBenchmark
+	{
+	public:
+		explicit MathBenchmark(uint32_t vector_count) :
+			m_positions(vector_count),
+			m_x(vector_count),
+			m_y(vector_count),
+			m_z(vector_count)
+		{
+			std::mt19937 random(11);
+			std::uniform_real_distribution<float> distribution(-50.0f, 50.0f);
+			for (uint32_t vector_idx = 0; vector_idx < vector_count; ++vector_idx)
+			{
+				m_positions[vector_idx] = { distribution(random), distribution(random), distribution(random) };
+				m_x[vector_idx] = m_positions[vector_idx].x;
+				m_y[vector_idx] = m_positions[vector_idx].y;
+				m_z[vector_idx] = m_positions[vector_idx].z;
+			}
+		}
+
+		void run() const
+		{
+			const size_t vector_count = m_positions.size();
+			const Core::Matrix view = Core::matrix_look_to_lh(
+				Core::vector_set(10.0f, 20.0f, -80.0f, 1.0f),
+				Core::normalize3(Core::vector_set(-0.1f, -0.2f, 1.0f, 0.0f)),
+				Core::vector_set(0.0f, 1.0f, 0.0f, 0.0f));
+			const Core::Matrix projection = Core::matrix_perspective_fov_lh(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+			Core::Float4x4 view_projection;
+			Core::store(view_projection, Core::matrix_multiply(view, projection));
+			const Core::Matrix view_projection_matrix = Core::load(view_projection);
+
+			std::vector<Core::Float4> scalar_results(vector_count);
+			const uint64_t scalar_ns = best_of([&]()
+			{
+				const Core::Float4* rows = view_projection.rows;
+				for (size_t vector_idx = 0; vector_idx < vector_count; ++vector_idx)
+				{
+					const Core::Float3& position = m_positions[vector_idx];
+					Core::Float4& result = scalar_results[vector_idx];
+					result.x = position.x * rows[0].x + position.y * rows[1].x + position.z * rows[2].x + rows[3].x;
+					result.y = position.x * rows[0].y + position.y * rows[1].y + position.z * rows[2].y + rows[3].y;
+					result.z = position.x * rows[0].z + position.y * rows[1].z + position.z * rows[2].z + rows[3].z;
+					result.w = position.x * rows[0].w + position.y * rows[1].w + position.z * rows[2].w + rows[3].w;
+				}
+			});
+
+			std::vector<Core::Float4> vector_results(vector_count);
+			const uint64_t vector_ns = best_of([&]()
+			{
+				for (size_t vector_idx = 0; vector_idx < vector_count; ++vector_idx)
+				{
+					const Core::Vector position = Core::load(m_positions[vector_idx], 1.0f);
+					Core::store(vector_results[vector_idx], Core::vector_transform(position, view_projection_matrix));
+				}
+			});
+
+			std::vector<float> batch_x(vector_count);
+			std::vector<float> batch_y(vector_count);
+			std::vector<float> batch_z(vector_count);
+			std::vector<float> batch_w(vector_count);
+			const uint64_t batch_ns = best_of([&]()
+			{
+				Core::transform_points(
+					view_projection,
+					{ m_x.data(), m_y.data(), m_z.data() },
+					vector_count,
+					{ batch_x.data(), batch_y.data(), batch_z.data(), batch_w.data() });
+			});
+
+			// Relative to the magnitude, the three only differ in the order of the additions
+			float max_error = 0.0f;
+			for (size_t vector_idx = 0; vector_idx < vector_count; ++vector_idx)
+			{
+				const Core::Float4& expected = scalar_results[vector_idx];
+				const float scale = 1.0f + std::fabs(expected.x) + std::fabs(expected.y) + std::fabs(expected.z) + std::fabs(expected.w);
+				const float errors[] = {
+					std::fabs(vector_results[vector_idx].x - expected.x),
+					std::fabs(vector_results[vector_idx].y - expected.y),
+					std::fabs(vector_results[vector_idx].z - expected.z),
+					std::fabs(vector_results[vector_idx].w - expected.w),
+					std::fabs(batch_x[vector_idx] - expected.x),
+					std::fabs(batch_y[vector_idx] - expected.y),
+					std::fabs(batch_z[vector_idx] - expected.z),
+					std::fabs(batch_w[vector_idx] - expected.w),
+				};
+				for (const float error : errors)
+				{
+					max_error = std::max(max_error, error / scale);
+				}
+			}
+
+			const auto print = [vector_count, scalar_ns](const char* name, uint64_t ns)
+			{
+				std::printf("%zu points %s: %.2f ms, %.1f Mvectors/s, %.2fx scalar\n",
+					vector_count,
+					name,
+					static_cast<double>(ns) / 1e6,
+					static_cast<double>(vector_count) / std::max(static_cast<double>(ns), 1.0) * 1e3,
+					static_cast<double>(scalar_ns) / std::max(static_cast<double>(ns), 1.0));
+			};
+			print("scalar", scalar_ns);
+			print("per vector", vector_ns);
+			print("SoA batch", batch_ns);
+			std::printf("Largest relative difference to scalar: %g\n", static_cast<double>(max_error));
+		}
+	private:
+		static constexpr uint32_t run_count = 5;
+
+		template<typename Function>
+		static uint64_t best_of(const Function& function)
+		{
+			uint64_t best_ns = UINT64_MAX;
+			for (uint32_t run_idx = 0; run_idx < run_count; ++run_idx)
+			{
+				const uint64_t begin_ns = Core::Profiler::now();
+				function();
+				best_ns = std::min(best_ns, Core::Profiler::now() - begin_ns);
+			}
+			return best_ns;
+		}
+
+		std::vector<Core::Float3> m_positions;
+		std::vector<float> m_x;
+		std::vector<float> m_y;
+		std::vector<float> m_z;
+	};
+
+	// Updates the world matrices of a random hierarchy with none, 1% and all local transforms
+	// changed before every update, best of a few runs each. A changed node also updates its
+	// descendants, so more than 1% are recomputed in the second case.
+	class TransformHierarchyBenchmark
+	{
+	public:
+		explicit TransformHierarchyBenchmark(uint32_t node_count) :
+			m_random(13)
+		{
+			// Every node picks a random earlier one as its parent, which makes a deep hierarchy,
+			// 30 levels for a million nodes, with parents spread all over the arrays
+			const uint32_t root_count = std::min(node_count, 64U);
+			for (uint32_t node_idx = 0; node_idx < node_count; ++node_idx)
+			{
+				const uint32_t parent_id = node_idx < root_count
+					? Core::TransformHierarchy::invalid_node
+					: std::uniform_int_distribution<uint32_t>(0, node_idx - 1)(m_random);
+				m_hierarchy.add_node(parent_id, random_transform());
+			}
+		}
+
+		void run(Core::JobSystem& job_system)
+		{
+			const uint32_t node_count = m_hierarchy.node_count();
+			uint64_t begin_ns = Core::Profiler::now();
+			const Core::TransformUpdateStats first_stats = m_hierarchy.update(job_system);
+			std::printf("%u transform nodes in %u levels, sorted and updated in %.2f ms\n",
+				node_count, first_stats.level_count, static_cast<double>(Core::Profiler::now() - begin_ns) / 1e6);
+
+			const std::pair<double, const char*> dirty_ratios[] = {
+				{ 0.0, "0%" },
+				{ 0.01, "1%" },
+				{ 1.0, "100%" },
+			};
+			std::uniform_int_distribution<uint32_t> node_distribution(0, node_count - 1);
+			for (const auto& [dirty_ratio, name] : dirty_ratios)
+			{
+				const auto dirty_count = static_cast<uint32_t>(node_count * dirty_ratio);
+				uint64_t best_ns = UINT64_MAX;
+				Core::TransformUpdateStats stats;
+				for (uint32_t run_idx = 0; run_idx < run_count; ++run_idx)
+				{
+					for (uint32_t dirty_idx = 0; dirty_idx < dirty_count; ++dirty_idx)
+					{
+						const uint32_t node_id = dirty_count == node_count ? dirty_idx : node_distribution(m_random);
+						m_hierarchy.set_local(node_id, random_transform());
+					}
+
+					begin_ns = Core::Profiler::now();
+					stats = m_hierarchy.update(job_system);
+					best_ns = std::min(best_ns, Core::Profiler::now() - begin_ns);
+				}
+				std::printf("%s dirty: %.2f ms, %u world matrices recomputed, %.1f Mnodes/s\n",
+					name,
+					static_cast<double>(best_ns) / 1e6,
+					stats.updated_count,
+					static_cast<double>(node_count) / std::max(static_cast<double>(best_ns), 1.0) * 1e3);
+			}
+		}
+	private:
+		static constexpr uint32_t run_count = 5;
+
+		Core::Transform random_transform()
+		{
+			std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+			Core::Transform transform;
+			transform.position = { distribution(m_random) * 10.0f, distribution(m_random) * 10.0f, distribution(m_random) * 10.0f };
+			const Core::Vector axis = Core::normalize3(Core::vector_set(distribution(m_random), distribution(m_random), 1.0f, 0.0f));
+			Core::store(transform.rotation, Core::quaternion_rotation_axis(axis, distribution(m_random) * 3.1415927f));
+			const float scale = 1.0f + distribution(m_random) * 0.1f;
+			transform.scale = { scale, scale, scale };
+			return transform;
+		}
+
+		std::mt19937 m_random;
+		Core::TransformHierarchy m_hierarchy;
+	};
+
+	// Culls random spheres and boxes filling a cube around the camera with a plain loop
+	// that stops at the first plane an object is behind, then with the SIMD kernels on
+	// one thread and on the job system, best of a few runs each
+	class FrustumCullingBenchmark
+	{
+	public:
+		explicit FrustumCullingBenchmark(uint32_t object_count) :
+			m_center_x(object_count),
+			m_center_y(object_count),
+			m_center_z(object_count),
+			m_radius(object_count),
+			m_extent_x(object_count),
+			m_extent_y(object_count),
+			m_extent_z(object_count)
+		{
+			std::mt19937 random(17);
+			std::uniform_real_distribution<float> position_distribution(-1000.0f, 1000.0f);
+			std::uniform_real_distribution<float> size_distribution(0.5f, 5.0f);
+			for (uint32_t object_idx = 0; object_idx < object_count; ++object_idx)
+			{
+				m_center_x[object_idx] = position_distribution(random);
+				m_center_y[object_idx] = position_distribution(random);
+				m_center_z[object_idx] = position_distribution(random);
+				m_radius[object_idx] = size_distribution(random);
+				m_extent_x[object_idx] = size_distribution(random);
+				m_extent_y[object_idx] = size_distribution(random);
+				m_extent_z[object_idx] = size_distribution(random);
+			}
+		}
+
+		void run(Core::JobSystem& job_system) const
+		{
+			const Core::Matrix view = Core::matrix_look_to_lh(
+				Core::vector_set(0.0f, 0.0f, 0.0f, 1.0f),
+				Core::normalize3(Core::vector_set(0.3f, 0.1f, 1.0f, 0.0f)),
+				Core::vector_set(0.0f, 1.0f, 0.0f, 0.0f));
+			const Core::Matrix projection = Core::matrix_perspective_fov_lh(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+			Core::Float4x4 view_projection;
+			Core::store(view_projection, Core::matrix_multiply(view, projection));
+			const Core::Frustum frustum = Core::make_frustum(view_projection);
+
+			const Core::SphereBounds spheres = { m_center_x.data(), m_center_y.data(), m_center_z.data(), m_radius.data() };
+			const Core::AabbBounds aabbs = {
+				m_center_x.data(), m_center_y.data(), m_center_z.data(),
+				m_extent_x.data(), m_extent_y.data(), m_extent_z.data(),
+			};
+
+			const auto max_count = static_cast<uint32_t>(m_center_x.size());
+			std::vector<uint32_t> visible_indices(max_count);
+			for (uint64_t count = std::min(max_count, 100000U); count <= max_count; count *= 10)
+			{
+				const auto object_count = static_cast<uint32_t>(count);
+				uint32_t scalar_visible_count = 0;
+				uint32_t simd_visible_count = 0;
+				uint32_t parallel_visible_count = 0;
+
+				const uint64_t scalar_sphere_ns = best_of([&]()
+				{
+					scalar_visible_count = cull_scalar(frustum, object_count, visible_indices.data(), [&](uint32_t object_idx, const Core::Float4& plane)
+					{
+						return distance(plane, object_idx) + m_radius[object_idx];
+					});
+				});
+				const uint64_t simd_sphere_ns = best_of([&]()
+				{
+					simd_visible_count = Core::cull_spheres(frustum, spheres, object_count, visible_indices.data());
+				});
+				const uint64_t parallel_sphere_ns = best_of([&]()
+				{
+					parallel_visible_count = Core::cull_spheres(job_system, frustum, spheres, object_count, visible_indices.data());
+				});
+				print("spheres", object_count, scalar_visible_count, simd_visible_count, parallel_visible_count,
+					scalar_sphere_ns, simd_sphere_ns, parallel_sphere_ns);
+
+				const uint64_t scalar_aabb_ns = best_of([&]()
+				{
+					scalar_visible_count = cull_scalar(frustum, object_count, visible_indices.data(), [&](uint32_t object_idx, const Core::Float4& plane)
+					{
+						return distance(plane, object_idx)
+							+ std::fabs(plane.x) * m_extent_x[object_idx]
+							+ std::fabs(plane.y) * m_extent_y[object_idx]
+							+ std::fabs(plane.z) * m_extent_z[object_idx];
+					});
+				});
+				const uint64_t simd_aabb_ns = best_of([&]()
+				{
+					simd_visible_count = Core::cull_aabbs(frustum, aabbs, object_count, visible_indices.data());
+				});
+				const uint64_t parallel_aabb_ns = best_of([&]()
+				{
+					parallel_visible_count = Core::cull_aabbs(job_system, frustum, aabbs, object_count, visible_indices.data());
+				});
+				print("AABBs", object_count, scalar_visible_count, simd_visible_count, parallel_visible_count,
+					scalar_aabb_ns, simd_aabb_ns, parallel_aabb_ns);
+			}
+		}
+	private:
+		static constexpr uint32_t run_count = 3;
+
+		template<typename Function>
+		static uint64_t best_of(const Function& function)
+		{
+			uint64_t best_ns = UINT64_MAX;
+			for (uint32_t run_idx = 0; run_idx < run_count; ++run_idx)
+			{
+				const uint64_t begin_ns = Core::Profiler::now();
+				function();
+				best_ns = std::min(best_ns, Core::Profiler::now() - begin_ns);
+			}
+			return best_ns;
+		}
+
+		template<typename Function>
+		static uint32_t cull_scalar(const Core::Frustum& frustum, uint32_t object_count, uint32_t* visible_indices, const Function& plane_distance)
+		{
+			uint32_t visible_count = 0;
+			for (uint32_t object_idx = 0; object_idx < object_count; ++object_idx)
+			{
+				bool is_visible = true;
+				for (const Core::Float4& plane : frustum.planes)
+				{
+					if (plane_distance(object_idx, plane) < 0.0f)
+					{
+						is_visible = false;
+						break;
+					}
+				}
+				if (is_visible)
+				{
+					visible_indices[visible_count++] = object_idx;
+				}
+			}
+			return visible_count;
+		}
+
+		static void print(
+			const char* name,
+			uint32_t object_count,
+			uint32_t scalar_visible_count,
+			uint32_t simd_visible_count,
+			uint32_t parallel_visible_count,
+			uint64_t scalar_ns,
+			uint64_t simd_ns,
+			uint64_t parallel_ns)
+		{
+			const auto objects_per_second = [object_count](uint64_t ns)
+			{
+				return static_cast<double>(object_count) / std::max(static_cast<double>(ns), 1.0) * 1e3;
+			};
+			std::printf("%u %s, %u visible%s: scalar %.1f, SIMD %.1f (%.2fx), job system %.1f Mobjects/s (%.2fx)\n",
+				object_count,
+				name,
+				simd_visible_count,
+				scalar_visible_count == simd_visible_count && parallel_visible_count == simd_visible_count ? "" : " (MISMATCH)",
+				objects_per_second(scalar_ns),
+				objects_per_second(simd_ns),
+				static_cast<double>(scalar_ns) / std::max(static_cast<double>(simd_ns), 1.0),
+				objects_per_second(parallel_ns),
+				static_cast<double>(scalar_ns) / std::max(static_cast<double>(parallel_ns), 1.0));
+		}
+
+		float distance(const Core::Float4& plane, uint32_t object_idx) const
+		{
+			return plane.x * m_center_x[object_idx] + plane.y * m_center_y[object_idx] + plane.z * m_center_z[object_idx] + plane.w;
+		}
+
+		std::vector<float> m_center_x;
+		std::vector<float> m_center_y;
+		std::vector<float> m_center_z;
+		std::vector<float> m_radius;
+		std::vector<float> m_extent_x;
+		std::vector<float> m_extent_y;
+		std::vector<float> m_extent_z;
+	};
+
+	// Builds a BVH over random boxes at the same density for every count, refits it after
+	// moving them, then culls views from the middle and casts rays, both compared with
+	// testing every box
+	class BvhBenchmark
+	{
+	public:
+		explicit BvhBenchmark(uint32_t max_object_count) :
+			m_max_object_count(max_object_count)
+		{
+		}
+
+		void run(Core::JobSystem& job_system) const
+		{
+			for (uint64_t count = std::min(m_max_object_count, 10000U); count <= m_max_object_count; count *= 10)
+			{
+				run(job_system, static_cast<uint32_t>(count));
+			}
+		}
+	private:
+		static constexpr uint32_t view_count = 16;
+		static constexpr uint32_t ray_count = 10000;
+		// Rays are also tested against every box, which takes long for many boxes
+		static constexpr uint32_t brute_force_ray_count = 64;
+
+		void run(Core::JobSystem& job_system, uint32_t object_count) const
+		{
+			std::mt19937 random(19);
+			const float half_size = 10.0f * std::cbrt(static_cast<float>(object_count));
+			std::uniform_real_distribution<float> position_distribution(-half_size, half_size);
+			std::uniform_real_distribution<float> size_distribution(0.5f, 5.0f);
+			std::vector<Core::Aabb> bounds(object_count);
+			for (Core::Aabb& aabb : bounds)
+			{
+				aabb.min = { position_distribution(random), position_distribution(random), position_distribution(random) };
+				aabb.max = { aabb.min.x + size_distribution(random), aabb.min.y + size_distribution(random), aabb.min.z + size_distribution(random) };
+			}
+
+			Core::Bvh bvh;
+			uint64_t begin_ns = Core::Profiler::now();
+			bvh.build(job_system, bounds.data(), object_count);
+			const uint64_t build_ns = Core::Profiler::now() - begin_ns;
+
+			std::uniform_real_distribution<float> offset_distribution(-1.0f, 1.0f);
+			for (Core::Aabb& aabb : bounds)
+			{
+				const Core::Float3 offset = { offset_distribution(random), offset_distribution(random), offset_distribution(random) };
+				aabb.min = { aabb.min.x + offset.x, aabb.min.y + offset.y, aabb.min.z + offset.z };
+				aabb.max = { aabb.max.x + offset.x, aabb.max.y + offset.y, aabb.max.z + offset.z };
+			}
+			begin_ns = Core::Profiler::now();
+			bvh.refit(bounds.data());
+			const uint64_t refit_ns = Core::Profiler::now() - begin_ns;
+			std::printf("%u objects: BVH built in %.2f ms on %u threads, %zu nodes, SAH cost %.1f, refit in %.2f ms\n",
+				object_count,
+				static_cast<double>(build_ns) / 1e6,
+				job_system.worker_count() + 1,
+				bvh.nodes().size(),
+				bvh.sah_cost(),
+				static_cast<double>(refit_ns) / 1e6);
+
+			cull_views(bvh, bounds);
+			cast_rays(bvh, bounds, random, half_size);
+		}
+
+		static void cull_views(const Core::Bvh& bvh, const std::vector<Core::Aabb>& bounds)
+		{
+			const auto object_count = static_cast<uint32_t>(bounds.size());
+			std::vector<float> center_x(object_count);
+			std::vector<float> center_y(object_count);
+			std::vector<float> center_z(object_count);
+			std::vector<float> extent_x(object_count);
+			std::vector<float> extent_y(object_count);
+			std::vector<float> extent_z(object_count);
+			for (uint32_t object_idx = 0; object_idx < object_count; ++object_idx)
+			{
+				const Core::Aabb& aabb = bounds[object_idx];
+				center_x[object_idx] = (aabb.min.x + aabb.max.x) * 0.5f;
+				center_y[object_idx] = (aabb.min.y + aabb.max.y) * 0.5f;
+				center_z[object_idx] = (aabb.min.z + aabb.max.z) * 0.5f;
+				extent_x[object_idx] = (aabb.max.x - aabb.min.x) * 0.5f;
+				extent_y[object_idx] = (aabb.max.y - aabb.min.y) * 0.5f;
+				extent_z[object_idx] = (aabb.max.z - aabb.min.z) * 0.5f;
+			}
+			const Core::AabbBounds aabbs = { center_x.data(), center_y.data(), center_z.data(), extent_x.data(), extent_y.data(), extent_z.data() };
+
+			std::vector<uint32_t> visible_indices(object_count);
+			uint64_t bvh_ns = 0;
+			uint64_t brute_force_ns = 0;
+			uint64_t visible_count = 0;
+			uint32_t mismatch_count = 0;
+			for (uint32_t view_idx = 0; view_idx < view_count; ++view_idx)
+			{
+				const float angle = 6.2831853f * static_cast<float>(view_idx) / view_count;
+				const Core::Matrix view = Core::matrix_look_to_lh(
+					Core::vector_set(0.0f, 0.0f, 0.0f, 1.0f),
+					Core::vector_set(std::cos(angle), 0.2f, std::sin(angle), 0.0f),
+					Core::vector_set(0.0f, 1.0f, 0.0f, 0.0f));
+				Core::Float4x4 view_projection;
+				Core::store(view_projection, Core::matrix_multiply(view, Core::matrix_perspective_fov_lh(1.0f, 16.0f / 9.0f, 0.1f, 500.0f)));
+				const Core::Frustum frustum = Core::make_frustum(view_projection);
+
+				uint64_t begin_ns = Core::Profiler::now();
+				const uint32_t bvh_visible_count = bvh.cull(frustum, visible_indices.data());
+				bvh_ns += Core::Profiler::now() - begin_ns;
+
+				begin_ns = Core::Profiler::now();
+				const uint32_t brute_force_visible_count = Core::cull_aabbs(frustum, aabbs, object_count, visible_indices.data());
+				brute_force_ns += Core::Profiler::now() - begin_ns;
+
+				visible_count += bvh_visible_count;
+				mismatch_count += bvh_visible_count != brute_force_visible_count ? 1 : 0;
+			}
+			std::printf("  %u views, %.1f visible on average%s: BVH %.3f ms, SIMD over every box %.3f ms per view (%.1fx)\n",
+				view_count,
+				static_cast<double>(visible_count) / view_count,
+				mismatch_count == 0 ? "" : " (MISMATCH)",
+				static_cast<double>(bvh_ns) / 1e6 / view_count,
+				static_cast<double>(brute_force_ns) / 1e6 / view_count,
+				static_cast<double>(brute_force_ns) / std::max(static_cast<double>(bvh_ns), 1.0));
+		}
+
+		static void cast_rays(const Core::Bvh& bvh, const std::vector<Core::Aabb>& bounds, std::mt19937& random, float half_size)
+		{
+			std::uniform_real_distribution<float> position_distribution(-half_size, half_size);
+			std::uniform_real_distribution<float> direction_distribution(-1.0f, 1.0f);
+			std::vector<std::pair<Core::Float3, Core::Float3>> rays(ray_count);
+			for (auto& [origin, direction] : rays)
+			{
+				origin = { position_distribution(random), position_distribution(random), position_distribution(random) };
+				direction = { direction_distribution(random), direction_distribution(random), direction_distribution(random) };
+			}
+			const float max_distance = half_size * 4.0f;
+
+			uint32_t hit_count = 0;
+			uint64_t begin_ns = Core::Profiler::now();
+			for (const auto& [origin, direction] : rays)
+			{
+				Core::BvhRayHit hit;
+				hit_count += bvh.raycast(origin, direction, max_distance, hit) ? 1 : 0;
+			}
+			const uint64_t bvh_ns = Core::Profiler::now() - begin_ns;
+
+			uint32_t mismatch_count = 0;
+			begin_ns = Core::Profiler::now();
+			for (uint32_t ray_idx = 0; ray_idx < brute_force_ray_count; ++ray_idx)
+			{
+				const auto& [origin, direction] = rays[ray_idx];
+				const Core::Float3 inverse_direction = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+				float closest_distance = max_distance;
+				bool is_hit = false;
+				for (const Core::Aabb& aabb : bounds)
+				{
+					const float x0 = (aabb.min.x - origin.x) * inverse_direction.x;
+					const float x1 = (aabb.max.x - origin.x) * inverse_direction.x;
+					const float y0 = (aabb.min.y - origin.y) * inverse_direction.y;
+					const float y1 = (aabb.max.y - origin.y) * inverse_direction.y;
+					const float z0 = (aabb.min.z - origin.z) * inverse_direction.z;
+					const float z1 = (aabb.max.z - origin.z) * inverse_direction.z;
+					const float entry = std::max({ std::min(x0, x1), std::min(y0, y1), std::min(z0, z1), 0.0f });
+					const float exit = std::min({ std::max(x0, x1), std::max(y0, y1), std::max(z0, z1), closest_distance });
+					if (entry <= exit)
+					{
+						closest_distance = entry;
+						is_hit = true;
+					}
+				}
+
+				Core::BvhRayHit hit;
+				const bool is_bvh_hit = bvh.raycast(origin, direction, max_distance, hit);
+				mismatch_count += is_hit != is_bvh_hit || (is_hit && hit.distance != closest_distance) ? 1 : 0;
+			}
+			const uint64_t brute_force_ns = Core::Profiler::now() - begin_ns;
+
+			std::printf("  %u rays, %.1f%% hit%s: BVH %.2f Mrays/s, every box %.4f Mrays/s\n",
+				ray_count,
+				100.0 * hit_count / ray_count,
+				mismatch_count == 0 ? "" : " (MISMATCH)",
+				static_cast<double>(ray_count) / std::max(static_cast<double>(bvh_ns), 1.0) * 1e3,
+				static_cast<double>(brute_force_ray_count) / std::max(static_cast<double>(brute_force_ns), 1.0) * 1e3);
+		}
+
+		uint32_t m_max_object_count;
+	};
+
+	// Scatters objects over the streets of a grid of buildings and looks down the streets
+	// from eye height. Per view the buildings that look largest are rasterized into the
+	// occlusion buffer, then the objects are culled by the BVH with and without it.
+	class OcclusionBenchmark
+	{
+	public:
+		explicit OcclusionBenchmark(uint32_t object_count) :
+			m_object_count(object_count)
+		{
+		}
+
+		void run(Core::JobSystem& job_system) const
+		{
+			std::mt19937 random(23);
+			std::uniform_real_distribution<float> height_distribution(10.0f, 60.0f);
+			std::vector<Core::Aabb> buildings;
+			buildings.reserve(grid_size * grid_size);
+			for (uint32_t row = 0; row < grid_size; ++row)
+			{
+				for (uint32_t column = 0; column < grid_size; ++column)
+				{
+					const float x = static_cast<float>(column) * block_size;
+					const float z = static_cast<float>(row) * block_size;
+					buildings.push_back({ { x, 0.0f, z }, { x + building_size, height_distribution(random), z + building_size } });
+				}
+			}
+
+			// Moved out of the buildings onto the street next to them
+			const float city_size = block_size * grid_size;
+			std::uniform_real_distribution<float> position_distribution(0.0f, city_size);
+			std::uniform_real_distribution<float> street_distribution(building_size, block_size - 2.0f);
+			std::uniform_real_distribution<float> size_distribution(0.3f, 2.0f);
+			std::vector<Core::Aabb> objects(m_object_count);
+			for (Core::Aabb& object : objects)
+			{
+				float x = position_distribution(random);
+				const float z = position_distribution(random);
+				if (std::fmod(x, block_size) < building_size && std::fmod(z, block_size) < building_size)
+				{
+					x = std::floor(x / block_size) * block_size + street_distribution(random);
+				}
+				const float size = size_distribution(random);
+				object = { { x, 0.0f, z }, { x + size, size, z + size } };
+			}
+
+			Core::Bvh building_bvh;
+			building_bvh.build(job_system, buildings.data(), static_cast<uint32_t>(buildings.size()));
+			Core::Bvh object_bvh;
+			object_bvh.build(job_system, objects.data(), m_object_count);
+
+			// A unit cube scaled onto every building, clockwise seen from outside
+			static constexpr uint32_t cube_indices[36] = {
+				2, 3, 1, 2, 1, 0,
+				7, 6, 4, 7, 4, 5,
+				6, 2, 0, 6, 0, 4,
+				3, 7, 5, 3, 5, 1,
+				0, 1, 5, 0, 5, 4,
+				2, 6, 7, 2, 7, 3,
+			};
+			Core::Float3 cube_positions[8];
+			for (uint32_t corner_idx = 0; corner_idx < 8; ++corner_idx)
+			{
+				cube_positions[corner_idx] = {
+					static_cast<float>(corner_idx & 1),
+					static_cast<float>((corner_idx >> 1) & 1),
+					static_cast<float>((corner_idx >> 2) & 1),
+				};
+			}
+
+			Core::OcclusionBuffer occlusion_buffer;
+			std::vector<uint32_t> candidate_indices(buildings.size());
+			std::vector<std::pair<float, uint32_t>> candidates;
+			std::vector<uint32_t> visible_indices(m_object_count);
+			uint64_t select_ns = 0;
+			uint64_t frustum_ns = 0;
+			uint64_t occlusion_ns = 0;
+			Core::OcclusionStats total_stats;
+			uint64_t frustum_visible_count = 0;
+			uint64_t occlusion_visible_count = 0;
+			for (uint32_t view_idx = 0; view_idx < view_count; ++view_idx)
+			{
+				// From street crossings, along the streets and diagonally
+				const float street_middle = (building_size + block_size) * 0.5f;
+				const float eye_x = static_cast<float>(view_idx % 4 + 2) * block_size + street_middle;
+				const float eye_z = static_cast<float>(view_idx / 4 + 2) * block_size + street_middle;
+				const float angle = 0.7853982f * static_cast<float>(view_idx) * 0.5f;
+				const Core::Matrix view = Core::matrix_look_to_lh(
+					Core::vector_set(eye_x, eye_height, eye_z, 1.0f),
+					Core::vector_set(std::cos(angle), 0.0f, std::sin(angle), 0.0f),
+					Core::vector_set(0.0f, 1.0f, 0.0f, 0.0f));
+				Core::Float4x4 view_projection;
+				Core::store(view_projection, Core::matrix_multiply(view, Core::matrix_perspective_fov_lh(1.0f, 16.0f / 9.0f, 0.1f, city_size)));
+				const Core::Frustum frustum = Core::make_frustum(view_projection);
+
+				// By size over distance, roughly how much of the screen they cover
+				uint64_t begin_ns = Core::Profiler::now();
+				const uint32_t candidate_count = building_bvh.cull(frustum, candidate_indices.data());
+				candidates.clear();
+				for (uint32_t candidate_idx = 0; candidate_idx < candidate_count; ++candidate_idx)
+				{
+					const Core::Aabb& building = buildings[candidate_indices[candidate_idx]];
+					const float dx = std::max({ building.min.x - eye_x, 0.0f, eye_x - building.max.x });
+					const float dz = std::max({ building.min.z - eye_z, 0.0f, eye_z - building.max.z });
+					const float size = building.max.y - building.min.y + building_size;
+					candidates.emplace_back(-size / std::max(std::sqrt(dx * dx + dz * dz), 1.0f), candidate_indices[candidate_idx]);
+				}
+				const size_t occluder_count = std::min<size_t>(candidates.size(), max_occluder_count);
+				std::partial_sort(candidates.begin(), candidates.begin() + occluder_count, candidates.end());
+				select_ns += Core::Profiler::now() - begin_ns;
+
+				occlusion_buffer.begin(view_projection);
+				for (size_t occluder_idx = 0; occluder_idx < occluder_count; ++occluder_idx)
+				{
+					const Core::Aabb& building = buildings[candidates[occluder_idx].second];
+					Core::Float4x4 world;
+					Core::store(world, Core::matrix_affine(
+						Core::vector_set(building.max.x - building.min.x, building.max.y - building.min.y, building.max.z - building.min.z, 0.0f),
+						Core::quaternion_identity(),
+						Core::vector_set(building.min.x, building.min.y, building.min.z, 0.0f)));
+					occlusion_buffer.add_occluder(world, cube_positions, 8, cube_indices, 36);
+				}
+				const Core::OcclusionStats& stats = occlusion_buffer.stats();
+				total_stats.clear_ns += stats.clear_ns;
+				total_stats.transform_ns += stats.transform_ns;
+				total_stats.rasterize_ns += stats.rasterize_ns;
+				total_stats.occluder_triangle_count += stats.occluder_triangle_count;
+				total_stats.rasterized_triangle_count += stats.rasterized_triangle_count;
+
+				begin_ns = Core::Profiler::now();
+				frustum_visible_count += object_bvh.cull(frustum, visible_indices.data());
+				frustum_ns += Core::Profiler::now() - begin_ns;
+
+				begin_ns = Core::Profiler::now();
+				occlusion_visible_count += object_bvh.cull(frustum, visible_indices.data(), &occlusion_buffer);
+				occlusion_ns += Core::Profiler::now() - begin_ns;
+			}
+
+			const auto per_view_ms = [](uint64_t ns)
+			{
+				return static_cast<double>(ns) / 1e6 / view_count;
+			};
+			std::printf("Occlusion culling %u objects behind %zu buildings, %ux%u buffer, %u views\n",
+				m_object_count,
+				buildings.size(),
+				occlusion_buffer.width(),
+				occlusion_buffer.height(),
+				view_count);
+			std::printf("  %.1f occluder triangles, %.1f rasterized per view: select %.3f ms, clear %.3f ms, transform %.3f ms, rasterize %.3f ms\n",
+				static_cast<double>(total_stats.occluder_triangle_count) / view_count,
+				static_cast<double>(total_stats.rasterized_triangle_count) / view_count,
+				per_view_ms(select_ns),
+				per_view_ms(total_stats.clear_ns),
+				per_view_ms(total_stats.transform_ns),
+				per_view_ms(total_stats.rasterize_ns));
+			std::printf("  %.1f objects in the frustum, %.1f after occlusion (%.1f%% culled): frustum %.3f ms, frustum and occlusion %.3f ms per view\n",
+				static_cast<double>(frustum_visible_count) / view_count,
+				static_cast<double>(occlusion_visible_count) / view_count,
+				100.0 - 100.0 * static_cast<double>(occlusion_visible_count) / std::max(static_cast<double>(frustum_visible_count), 1.0),
+				per_view_ms(frustum_ns),
+				per_view_ms(occlusion_ns));
+		}
+	private:
+		static constexpr uint32_t grid_size = 32;
+		static constexpr float block_size = 30.0f;
+		static constexpr float building_size = 20.0f;
+		static constexpr float eye_height = 1.8f;
+		static constexpr uint32_t view_count = 8;
+		static constexpr uint32_t max_occluder_count = 64;
+
+		uint32_t m_object_count;
+	};
+
+	// Sorts draws with random layers, passes, pipelines, materials and depths one thread and
+	// on the job system, compared with std::sort, then submits them to a null backend in
+	// the order they were made and sorted to count the state changes
+	class RenderQueueBenchmark
+	{
+	public:
+		explicit RenderQueueBenchmark(uint32_t draw_count) :
+			m_draw_count(draw_count)
+		{
+		}
+
+		void run(Core::JobSystem& job_system) const
+		{
+			std::mt19937 random(29);
+			std::uniform_int_distribution<uint32_t> layer_distribution(0, 9);
+			std::uniform_int_distribution<uint32_t> pass_distribution(0, 2);
+			std::uniform_int_distribution<uint32_t> pipeline_distribution(0, pipeline_count - 1);
+			std::uniform_int_distribution<uint32_t> material_distribution(0, material_count - 1);
+			std::uniform_real_distribution<float> depth_distribution(0.0f, 1.0f);
+			std::vector<std::pair<uint64_t, Core::DrawItem>> draws(m_draw_count);
+			for (auto& [sort_key, item] : draws)
+			{
+				// One in ten on the overlay layer, the last pass blends
+				const uint32_t layer = layer_distribution(random) == 0 ? 1 : 0;
+				const uint32_t pass = pass_distribution(random);
+				item = { pipeline_distribution(random), material_distribution(random), 3, 0 };
+				const float depth = depth_distribution(random);
+				sort_key = pass == 2 ?
+					Core::make_blended_sort_key(layer, pass, item.pipeline, item.material, depth) :
+					Core::make_sort_key(layer, pass, item.pipeline, item.material, depth);
+			}
+
+			Core::RenderQueue render_queue;
+			const auto fill = [&]()
+			{
+				render_queue.clear();
+				for (const auto& [sort_key, item] : draws)
+				{
+					render_queue.add(sort_key, item);
+				}
+			};
+			const auto best_of = [&](const auto& function)
+			{
+				uint64_t best_ns = UINT64_MAX;
+				for (uint32_t run_idx = 0; run_idx < run_count; ++run_idx)
+				{
+					fill();
+					const uint64_t begin_ns = Core::Profiler::now();
+					function();
+					best_ns = std::min(best_ns, Core::Profiler::now() - begin_ns);
+				}
+				return best_ns;
+			};
+
+			std::vector<std::pair<uint64_t, uint32_t>> reference(m_draw_count);
+			const uint64_t std_sort_ns = best_of([&]()
+			{
+				for (uint32_t draw_idx = 0; draw_idx < m_draw_count; ++draw_idx)
+				{
+					reference[draw_idx] = { draws[draw_idx].first, draw_idx };
+				}
+				std::sort(reference.begin(), reference.end());
+			});
+			const uint64_t radix_ns = best_of([&]()
+			{
+				render_queue.sort();
+			});
+			const uint64_t parallel_radix_ns = best_of([&]()
+			{
+				render_queue.sort(job_system);
+			});
+
+			// Ties keep the order they were added in, like the index breaks them for std::sort
+			uint32_t mismatch_count = 0;
+			for (uint32_t position = 0; position < m_draw_count; ++position)
+			{
+				const Core::DrawItem& item = render_queue.item(position);
+				const Core::DrawItem& expected = draws[reference[position].second].second;
+				mismatch_count += render_queue.sort_key(position) != reference[position].first ||
+					item.pipeline != expected.pipeline || item.material != expected.material ? 1 : 0;
+			}
+
+			const auto keys_per_second = [this](uint64_t ns)
+			{
+				return static_cast<double>(m_draw_count) / std::max(static_cast<double>(ns), 1.0) * 1e3;
+			};
+			std::printf("Render queue of %u draws%s: std::sort %.1f, radix %.1f, radix on %u threads %.1f Mkeys/s\n",
+				m_draw_count,
+				mismatch_count == 0 ? "" : " (MISMATCH)",
+				keys_per_second(std_sort_ns),
+				keys_per_second(radix_ns),
+				job_system.worker_count() + 1,
+				keys_per_second(parallel_radix_ns));
+
+			fill();
+			submit(render_queue, "in the order made");
+			render_queue.sort(job_system);
+			submit(render_queue, "sorted");
+		}
+	private:
+		static constexpr uint32_t run_count = 3;
+		static constexpr uint32_t pipeline_count = 64;
+		static constexpr uint32_t material_count = 4096;
+
+		static void submit(const Core::RenderQueue& render_queue, const char* order)
+		{
+			Core::NullBackend backend;
+			const float clear_color[4] = {};
+			backend.begin_frame();
+			backend.clear(clear_color);
+			const uint64_t begin_ns = Core::Profiler::now();
+			const Core::RenderQueueStats stats = render_queue.submit(backend);
+			const uint64_t submit_ns = Core::Profiler::now() - begin_ns;
+			backend.end_frame();
+			std::printf("  submitted %s in %.2f ms: %u pipeline and %u material changes for %u draws, %.1f MB of commands\n",
+				order,
+				static_cast<double>(submit_ns) / 1e6,
+				stats.pipeline_change_count,
+				stats.material_change_count,
+				stats.draw_count,
+				static_cast<double>(backend.command_stream().size()) / (1024.0 * 1024.0));
+		}
+
+		uint32_t m_draw_count;
+	};
+
+	// Runs synthetic task graphs of equal jobs on job systems of 1, 2, 4... threads up to the
+	// hardware thread count: independent jobs, a binary fork/join tree whose jobs wait on
+	// their children, and stages that each wait for the previous one like a frame does
+	class TaskGraphBenchmark
+	{
+	public:
+		explicit TaskGraphBenchmark(uint32_t job_count) :
+			m_job_count(job_count)
+		{
+		}
+
+		void run() const
+		{
+			const uint32_t max_thread_count = std::max(std::thread::hardware_concurrency(), 2U);
+			std::printf("Task graphs of %u jobs of %u iterations each\n", m_job_count, work_iteration_count);
+
+			double single_thread_ms[3] = {};
+			for (uint32_t thread_count = 1; thread_count <= max_thread_count; thread_count *= 2)
+			{
+				Core::JobSystemDesc desc;
+				desc.worker_count = thread_count - 1;
+				Core::JobSystem job_system(desc);
+
+				const double graph_ms[3] = {
+					best_of([&]() { run_independent(job_system); }),
+					best_of([&]() { run_fork_join(job_system, m_job_count); }),
+					best_of([&]() { run_stages(job_system); }),
+				};
+				if (thread_count == 1)
+				{
+					std::copy(graph_ms, graph_ms + 3, single_thread_ms);
+				}
+				std::printf("  %u threads: independent %.2f ms (%.2fx), fork/join %.2f ms (%.2fx), %u stages %.2f ms (%.2fx)\n",
+					thread_count,
+					graph_ms[0],
+					single_thread_ms[0] / graph_ms[0],
+					graph_ms[1],
+					single_thread_ms[1] / graph_ms[1],
+					stage_count,
+					graph_ms[2],
+					single_thread_ms[2] / graph_ms[2]);
+			}
+		}
+	private:
+		static constexpr uint32_t run_count = 5;
+		static constexpr uint32_t work_iteration_count = 2000;
+		static constexpr uint32_t stage_count = 8;
+
+		// A few microseconds of arithmetic the compiler can not drop
+		static void work(uint32_t seed)
+		{
+			static std::atomic<uint64_t> sink{ 0 };
+			uint64_t state = seed;
+			for (uint32_t iteration = 0; iteration < work_iteration_count; ++iteration)
+			{
+				state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+			}
+			sink.fetch_add(state, std::memory_order_relaxed);
+		}
+
+		void run_independent(Core::JobSystem& job_system) const
+		{
+			Core::JobCounter counter;
+			for (uint32_t job_idx = 0; job_idx < m_job_count; ++job_idx)
+			{
+				job_system.submit([job_idx]() { work(job_idx); }, &counter);
+			}
+			job_system.wait(counter);
+		}
+
+		// Splits until single jobs are left, each inner job waits for its two halves
+		static void run_fork_join(Core::JobSystem& job_system, uint32_t job_count)
+		{
+			if (job_count <= 1)
+			{
+				work(job_count);
+				return;
+			}
+			Core::JobCounter counter;
+			job_system.submit([&job_system, job_count]() { run_fork_join(job_system, job_count / 2); }, &counter);
+			job_system.submit([&job_system, job_count]() { run_fork_join(job_system, job_count - job_count / 2); }, &counter);
+			job_system.wait(counter);
+		}
+
+		void run_stages(Core::JobSystem& job_system) const
+		{
+			const uint32_t stage_job_count = std::max(m_job_count / stage_count, 1U);
+			for (uint32_t stage_idx = 0; stage_idx < stage_count; ++stage_idx)
+			{
+				job_system.parallel_for(stage_job_count, 1, [](uint32_t begin, uint32_t end)
+				{
+					for (uint32_t job_idx = begin; job_idx < end; ++job_idx)
+					{
+						work(job_idx);
+					}
+				});
+			}
+		}
+
+		template<typename Function>
+		static double best_of(const Function& function)
+		{
+			uint64_t best_ns = UINT64_MAX;
+			for (uint32_t run_idx = 0; run_idx < run_count; ++run_idx)
+			{
+				const uint64_t begin_ns = Core::Profiler::now();
+				function();
+				best_ns = std::min(best_ns, Core::Profiler::now() - begin_ns);
+			}
+			return static_cast<double>(best_ns) / 1e6;
+		}
+
+		uint32_t m_job_count;
+	};
+
+	// Records empty zones back to back and reads the clock as often, so the cost of a zone
+	// and how much of it the two clock reads are can be told apart
+	class ProfilerOverheadBenchmark
+	{
+	public:
+		explicit ProfilerOverheadBenchmark(uint32_t zone_count) :
+			m_zone_count(zone_count)
+		{
+		}
+
+		void run() const
+		{
+			const uint64_t clock_ns = best_of([&]()
+			{
+				for (uint32_t read_idx = 0; read_idx < m_zone_count * 2; ++read_idx)
+				{
+					Core::Profiler::now();
+				}
+			});
+			const uint64_t zone_ns = best_of([&]()
+			{
+				for (uint32_t zone_idx = 0; zone_idx < m_zone_count; ++zone_idx)
+				{
+					// The class rather than PROFILE_ZONE, so it is measured even when zones are compiled out
+					Core::ProfileZone zone("Empty zone");
+				}
+			});
+
+			std::printf("Profiler overhead over %u empty zones: %.1f ns per zone, of which %.1f ns for its two clock reads\n",
+				m_zone_count,
+				static_cast<double>(zone_ns) / m_zone_count,
+				static_cast<double>(clock_ns) / m_zone_count);
+		}
+	private:
+		static constexpr uint32_t run_count = 5;
+
+		template<typename Function>
+		static uint64_t best_of(const Function& function)
+		{
+			uint64_t best_ns = UINT64_MAX;
+			for (uint32_t run_idx = 0; run_idx < run_count; ++run_idx)
+			{
+				const uint64_t begin_ns = Core::Profiler::now();
+				function();
+				best_ns = std::min(best_ns, Core::Profiler::now() - begin_ns);
+			}
+			return best_ns;
+		}
+
+		uint32_t m_zone_count;
+	};
+
+	// Options on top of the benchmark ones: --backend=null|software, --threads=N, --image=PATH,
+	// --residency=N, --allocator=N, --textures=DIRECTORY, --texture-read=mapped|buffered,
+	// --texture-processing=SIZE, --mesh=PATH.obj, --meshlets=PATH.obj, --math=COUNT,
+	// --transforms=COUNT, --culling=COUNT, --bvh=COUNT, --occlusion=COUNT, --render-queue=COUNT,
+	// --task-graph=COUNT, --profiler-overhead=COUNT
+	HeadlessConfig parse_headless_config(int argc, const char** argv)
+	{
+		HeadlessConfig config;
+		for (int argument_idx = 1; argument_idx < argc; ++argument_idx)
+		{
+			const std::string argument = argv[argument_idx];
+			const auto value_of = [&argument](const char* option) -> const char*
+			{
+				const size_t length = std::strlen(option);
+				return argument.compare(0, length, option) == 0 ? argument.c_str() + length : nullptr;
+			};
+
+			if (const char* value = value_of("--backend="))
+			{
+				config.backend_name = value;
+			}
+			else if (const char* value = value_of("--threads="))
+			{
+				config.thread_count = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			}
+			else if (const char* value = value_of("--image="))
+			{
+				config.image_path = value;
+			}
+			else if (const char* value = value_of("--residency="))
+			{
+				config.residency_allocation_count = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			}
+			else if (const char* value = value_of("--allocator="))
+			{
+				config.allocator_operation_count = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			}
+			else if (const char* value = value_of("--textures="))
+			{
+				config.texture_directory = value;
+			}
+			else if (const char* value = value_of("--texture-processing="))
+			{
+				config.texture_processing_size = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			}
+			else if (const char* value = value_of("--mesh="))
+			{
+				config.mesh_path = value;
+			}
+			else if (const char* value = value_of("--meshlets="))
+			{
+				config.meshlet_mesh_path = value;
+			}
+			else if (const char* value = value_of("--math="))
+			{
+				config.math_vector_count = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			}
+			else if (const char* value = value_of("--transforms="))
+			{
+				config.transform_node_count = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			}
+			else if (const char* value = value_of("--culling="))
+			{
+				config.culling_object_count = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			}
+			else if (const char* value = value_of("--bvh="))
+			{
+				config.bvh_object_count = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			}
+			else if (const char* value = value_of("--occlusion="))
+			{
+				config.occlusion_object_count = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			}
+			else if (const char* value = value_of("--render-queue="))
+			{
+				config.render_queue_draw_count = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			}
+			else if (const char* value = value_of("--task-graph="))
+			{
+				config.task_graph_job_count = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			}
+			else if (const char* value = value_of("--profiler-overhead="))
+			{
+				config.profiler_zone_count = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			}
+			else if (const char* value = value_of("--texture-read="))
+			{
+				config.texture_read_mode = std::strcmp(value, "buffered") == 0 ? Core::TextureReadMode::Buffered : Core::TextureReadMode::Mapped;
+			}
+		}
+		return config;
+	}
+}
+
+// Runs the benchmark loop against a backend that needs neither a window nor a GPU,
+// so the frame loop and everything it drives can be measured on any host
+int main(int argc, const char** argv)
+{
+	PROFILE_THREAD_NAME("Main");
+
+	auto benchmark_config = Core::parse_benchmark_config(argc, argv);
+	benchmark_config.is_enabled = true;
+	const auto headless_config = parse_headless_config(argc, argv);
+
+	Core::JobSystemDesc job_system_desc;
+	// The main thread helps out while waiting, so it counts as one of the threads
+	if (headless_config.thread_count > 0)
+	{
+		job_system_desc.worker_count = headless_config.thread_count - 1;
+	}
+	Core::JobSystem job_system(job_system_desc);
+
+	std::unique_ptr<Core::NullBackend> null_backend;
+	std::unique_ptr<Core::SoftwareBackend> software_backend;
+	Core::RenderBackend* backend = nullptr;
+	if (headless_config.backend_name == "software")
+	{
+		software_backend = std::make_unique<Core::SoftwareBackend>(job_system);
+		backend = software_backend.get();
+	}
+	else if (headless_config.backend_name == "null")
+	{
+		null_backend = std::make_unique<Core::NullBackend>();
+		backend = null_backend.get();
+	}
+	else
+	{
+		std::fprintf(stderr, "Unknown backend %s\n", headless_config.backend_name.c_str());
+		return 1;
+	}
+
+	Core::BenchmarkRecorder benchmark_recorder(benchmark_config);
+	Core::RenderQueue render_queue;
+
+	std::unique_ptr<ResidencySimulation> residency_simulation;
+	if (headless_config.residency_allocation_count > 0)
+	{
+		residency_simulation = std::make_unique<ResidencySimulation>(headless_config.residency_allocation_count);
+	}
+	std::unique_ptr<AllocatorSimulation> allocator_simulation;
+	if (headless_config.allocator_operation_count > 0)
+	{
+		allocator_simulation = std::make_unique<AllocatorSimulation>(headless_config.allocator_operation_count);
+	}
+
+	std::unique_ptr<Core::NullTextureStreamingBackend> texture_streaming_backend;
+	std::unique_ptr<Core::TextureStreamer> texture_streamer;
+	if (!headless_config.texture_directory.empty())
+	{
+		texture_streaming_backend = std::make_unique<Core::NullTextureStreamingBackend>();
+		Core::TextureStreamerDesc texture_streamer_desc;
+		texture_streamer_desc.read_mode = headless_config.texture_read_mode;
+		texture_streamer = std::make_unique<Core::TextureStreamer>(job_system, *texture_streaming_backend, texture_streamer_desc);
+
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(headless_config.texture_directory, error))
+		{
+			if (entry.path().extension() == ".dds" || entry.path().extension() == ".ktx2")
+			{
+				texture_streamer->request(entry.path().string());
+			}
+		}
+	}
+
+	while (!benchmark_recorder.is_finished())
+	{
+		PROFILE_ZONE("Frame");
+		benchmark_recorder.begin_frame();
+		Core::render_scene(*backend, benchmark_config.scene, render_queue);
+		if (residency_simulation)
+		{
+			residency_simulation->run_frame();
+		}
+		if (allocator_simulation)
+		{
+			allocator_simulation->run_frame();
+		}
+		if (texture_streamer)
+		{
+			texture_streamer->update();
+		}
+		benchmark_recorder.end_cpu_work();
+		backend->present();
+		benchmark_recorder.end_frame();
+	}
+
+	if (!benchmark_recorder.write_json(backend->name()))
+	{
+		std::fprintf(stderr, "Failed to write %s\n", benchmark_config.output_path.c_str());
+		return 1;
+	}
+	std::printf("%u frames written to %s\n", benchmark_recorder.recorded_frame_count(), benchmark_config.output_path.c_str());
+
+	if (null_backend)
+	{
+		const auto& counters = null_backend->counters();
+		std::printf(
+			"%llu commands (%llu bytes): %llu clears, %llu pipeline and %llu material changes, %llu draws, %llu vertices\n",
+			static_cast<unsigned long long>(counters.commands),
+			static_cast<unsigned long long>(counters.command_bytes),
+			static_cast<unsigned long long>(counters.clears),
+			static_cast<unsigned long long>(counters.pipeline_changes),
+			static_cast<unsigned long long>(counters.material_changes),
+			static_cast<unsigned long long>(counters.draws),
+			static_cast<unsigned long long>(counters.vertices));
+	}
+
+	if (residency_simulation)
+	{
+		residency_simulation->print_summary();
+	}
+	if (allocator_simulation)
+	{
+		allocator_simulation->print_summary();
+	}
+
+	if (texture_streamer)
+	{
+		// Textures still streaming when the frames ran out are finished outside the benchmark
+		while (texture_streamer->pending_count() > 0)
+		{
+			texture_streamer->update();
+			std::this_thread::yield();
+		}
+
+		const auto stats = texture_streamer->stats();
+		for (uint32_t texture_id = 0; texture_id < stats.requested_count; ++texture_id)
+		{
+			if (texture_streamer->is_failed(texture_id))
+			{
+				std::fprintf(stderr, "%s\n", texture_streamer->error(texture_id).c_str());
+			}
+		}
+		std::printf(
+			"%u textures (%.1f MB, %llu mips) in %.3f s: %.1f MB/s, %.1f textures/s, %.1f MB/s per read job, %llu copy submits\n",
+			stats.completed_count,
+			static_cast<double>(stats.uploaded_bytes) / 1e6,
+			static_cast<unsigned long long>(stats.uploaded_mips),
+			stats.streaming_seconds,
+			stats.megabytes_per_second(),
+			stats.textures_per_second(),
+			stats.read_seconds > 0.0 ? static_cast<double>(stats.read_bytes) / 1e6 / stats.read_seconds : 0.0,
+			static_cast<unsigned long long>(texture_streaming_backend->counters().submits));
+	}
+
+	if (headless_config.texture_processing_size > 0)
+	{
+		TextureProcessingBenchmark(headless_config.texture_processing_size).run(job_system);
+	}
+
+	if (!headless_config.mesh_path.empty())
+	{
+		std::string error;
+		if (!MeshLoadBenchmark(headless_config.mesh_path).run(error))
+		{
+			std::fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+	}
+
+	if (!headless_config.meshlet_mesh_path.empty())
+	{
+		std::string error;
+		if (!MeshletBenchmark(headless_config.meshlet_mesh_path).run(error))
+		{
+			std::fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+	}
+
+	if (headless_config.math_vector_count > 0)
+	{
+		MathBenchmark(headless_config.math_vector_count).run();
+	}
+
+	if (headless_config.transform_node_count > 0)
+	{
+		TransformHierarchyBenchmark(headless_config.transform_node_count).run(job_system);
+	}
+
+	if (headless_config.culling_object_count > 0)
+	{
+		FrustumCullingBenchmark(headless_config.culling_object_count).run(job_system);
+	}
+
+	if (headless_config.bvh_object_count > 0)
+	{
+		BvhBenchmark(headless_config.bvh_object_count).run(job_system);
+	}
+
+	if (headless_config.occlusion_object_count > 0)
+	{
+		OcclusionBenchmark(headless_config.occlusion_object_count).run(job_system);
+	}
+
+	if (headless_config.render_queue_draw_count > 0)
+	{
+		RenderQueueBenchmark(headless_config.render_queue_draw_count).run(job_system);
+	}
+
+	if (headless_config.task_graph_job_count > 0)
+	{
+		TaskGraphBenchmark(headless_config.task_graph_job_count).run();
+	}
+
+	if (headless_config.profiler_zone_count > 0)
+	{
+		ProfilerOverheadBenchmark(headless_config.profiler_zone_count).run();
+	}
+
+	if (software_backend)
+	{
+		// Counters include the warmup frames, scale them down to the recorded ones
+		const auto& counters = software_backend->counters();
+		const double total_frames = benchmark_config.warmup_frame_count + benchmark_recorder.recorded_frame_count();
+		const double recorded_share = benchmark_recorder.recorded_frame_count() / total_frames;
+		const double seconds = benchmark_recorder.recorded_seconds();
+		std::printf(
+			"%u threads: %.0f triangles/s, %.1f Mpixels/s\n",
+			job_system.worker_count() + 1,
+			counters.triangles_rasterized * recorded_share / seconds,
+			counters.pixels_shaded * recorded_share / seconds / 1e6);
+
+		if (!headless_config.image_path.empty() && !software_backend->write_image(headless_config.image_path))
+		{
+			std::fprintf(stderr, "Failed to write %s\n", headless_config.image_path.c_str());
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include "core/mesh_import.hpp"
+#include "core/mesh_optimizer.hpp"
+#include "core/meshlet.hpp"
+#include "core/profiler.hpp"
+
+namespace
+{
+	void print_cache_stats(const char* label, const Core::MeshImport& mesh)
+	{
+		const Core::VertexCacheStats stats = Core::analyze_vertex_cache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+		std::printf("%s: ACMR %.3f, ATVR %.3f\n", label, stats.acmr, stats.atvr);
+	}
+}
+
+// Converts a Wavefront OBJ file into the .mesh format the renderers map and upload as is,
+// with the triangles and vertices reordered for the post-transform cache and overdraw and
+// split into meshlets
+int main(int argc, const char** argv)
+{
+	if (argc != 3)
+	{
+		std::fprintf(stderr, "Usage: %s INPUT.obj OUTPUT.mesh\n", argv[0]);
+		return 1;
+	}
+
+	const std::string input_path = argv[1];
+	const std::string output_path = argv[2];
+
+	Core::MeshImport mesh;
+	std::string error;
+	const uint64_t begin_ns = Core::Profiler::now();
+	if (!Core::parse_obj(input_path, mesh, error))
+	{
+		std::fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+	const uint64_t parsed_ns = Core::Profiler::now();
+	print_cache_stats("Imported", mesh);
+	Core::optimize_mesh(mesh);
+	const uint64_t optimized_ns = Core::Profiler::now();
+	print_cache_stats("Optimized", mesh);
+	Core::build_meshlets(mesh);
+	const uint64_t meshlets_built_ns = Core::Profiler::now();
+	std::printf(
+		"%zu meshlets, %.1f vertices and %.1f triangles on average\n",
+		mesh.meshlets.size(),
+		static_cast<double>(mesh.meshlet_vertices.size()) / static_cast<double>(std::max<size_t>(mesh.meshlets.size(), 1)),
+		static_cast<double>(mesh.indices.size() / 3) / static_cast<double>(std::max<size_t>(mesh.meshlets.size(), 1)));
+	if (!Core::write_mesh(output_path, mesh, error))
+	{
+		std::fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+	const uint64_t written_ns = Core::Profiler::now();
+
+	std::printf(
+		"%s: %zu vertices, %zu triangles, %zu submeshes, parsed in %.1f ms, optimized in %.1f ms, meshlets built in %.1f ms, written in %.1f ms\n",
+		output_path.c_str(),
+		mesh.vertices.size(),
+		mesh.indices.size() / 3,
+		mesh.submeshes.size(),
+		static_cast<double>(parsed_ns - begin_ns) / 1e6,
+		static_cast<double>(optimized_ns - parsed_ns) / 1e6,
+		static_cast<double>(meshlets_built_ns - optimized_ns) / 1e6,
+		static_cast<double>(written_ns - meshlets_built_ns) / 1e6);
+	return 0;
+}
@@ -1,12 +1,21 @@
+// FEATURES: INSTANCING
+
 struct VSOut
 {
 	float4 col : Color;
 	float4 pos : SV_Position;
 };
 
+#if INSTANCING
+VSOut main(float4 col : Color, float2 pos : Position, float2 offset : InstanceOffset)
+#else
 VSOut main(float4 col : Color, float2 pos : Position)
+#endif
 {
 	VSOut vsout;
+#if INSTANCING
+	pos += offset;
+#endif
 	vsout.pos = float4(pos.x, pos.y, 0.0f, 1.0f);
 	vsout.col = col;
 	return vsout;
@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "core/bvh.hpp"
+#include "core/job_system.hpp"
+#include "test.hpp"
+
+namespace
+{
+	constexpr float pi = 3.14159265358979f;
+	// Bounds closer to a plane than this may go either way depending on how the math rounds
+	constexpr float boundary_tolerance = 1e-3f;
+
+	// Clusters of boxes of very different sizes, like a scene with props around buildings
+	std::vector<Core::Aabb> make_bounds(uint32_t count, uint32_t seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> cluster_coordinate(-100.0f, 100.0f);
+		std::normal_distribution<float> offset(0.0f, 8.0f);
+		std::uniform_real_distribution<float> size_exponent(-2.0f, 2.5f);
+
+		std::vector<Core::Aabb> bounds;
+		Core::Float3 cluster_center = {};
+		for (uint32_t primitive_idx = 0; primitive_idx < count; ++primitive_idx)
+		{
+			if (primitive_idx % 50 == 0)
+			{
+				cluster_center = { cluster_coordinate(random), cluster_coordinate(random) * 0.2f, cluster_coordinate(random) };
+			}
+			const Core::Float3 center = { cluster_center.x + offset(random), cluster_center.y + offset(random), cluster_center.z + offset(random) };
+			const Core::Float3 extent = { std::exp2(size_exponent(random)), std::exp2(size_exponent(random)), std::exp2(size_exponent(random)) };
+			bounds.push_back({
+				{ center.x - extent.x, center.y - extent.y, center.z - extent.z },
+				{ center.x + extent.x, center.y + extent.y, center.z + extent.z } });
+		}
+		return bounds;
+	}
+
+	bool contains(const Core::Float3& outer_min, const Core::Float3& outer_max, const Core::Aabb& inner)
+	{
+		return outer_min.x <= inner.min.x && outer_min.y <= inner.min.y && outer_min.z <= inner.min.z
+			&& outer_max.x >= inner.max.x && outer_max.y >= inner.max.y && outer_max.z >= inner.max.z;
+	}
+
+	// Children after their parent and inside its bounds, every primitive in exactly one leaf
+	bool is_well_formed(const Core::Bvh& bvh, const std::vector<Core::Aabb>& bounds)
+	{
+		const auto& nodes = bvh.nodes();
+		const auto& primitive_indices = bvh.primitive_indices();
+		if (primitive_indices.size() != bounds.size() || bvh.primitive_bounds().size() != bounds.size())
+		{
+			return false;
+		}
+		std::vector<uint32_t> sorted_indices = primitive_indices;
+		std::sort(sorted_indices.begin(), sorted_indices.end());
+		for (uint32_t primitive_idx = 0; primitive_idx < sorted_indices.size(); ++primitive_idx)
+		{
+			if (sorted_indices[primitive_idx] != primitive_idx)
+			{
+				return false;
+			}
+		}
+
+		std::vector<uint32_t> leaf_counts(bounds.size(), 0);
+		for (uint32_t node_idx = 0; node_idx < nodes.size(); ++node_idx)
+		{
+			const Core::BvhNode& node = nodes[node_idx];
+			if (node.count == 0)
+			{
+				if (node.first <= node_idx || node.first + 1 >= nodes.size())
+				{
+					return false;
+				}
+				for (const uint32_t child_idx : { node.first, node.first + 1 })
+				{
+					if (!contains(node.min, node.max, { nodes[child_idx].min, nodes[child_idx].max }))
+					{
+						return false;
+					}
+				}
+				continue;
+			}
+
+			if (node.count > Core::Bvh::max_leaf_size || node.first + node.count > bounds.size())
+			{
+				return false;
+			}
+			for (uint32_t primitive_idx = node.first; primitive_idx < node.first + node.count; ++primitive_idx)
+			{
+				const Core::Aabb& primitive_bounds = bvh.primitive_bounds()[primitive_idx];
+				const Core::Aabb& expected_bounds = bounds[primitive_indices[primitive_idx]];
+				if (!contains(node.min, node.max, primitive_bounds)
+					|| !contains(primitive_bounds.min, primitive_bounds.max, expected_bounds)
+					|| !contains(expected_bounds.min, expected_bounds.max, primitive_bounds))
+				{
+					return false;
+				}
+				++leaf_counts[primitive_idx];
+			}
+		}
+		return std::all_of(leaf_counts.begin(), leaf_counts.end(), [](uint32_t count)
+		{
+			return count == 1;
+		});
+	}
+
+	Core::Frustum make_camera_frustum(const Core::Float3& position, const Core::Float3& direction)
+	{
+		const Core::Matrix view = Core::matrix_look_to_lh(Core::load(position, 1.0f), Core::load(direction, 0.0f), Core::vector_set(0.0f, 1.0f, 0.0f, 0.0f));
+		const Core::Matrix projection = Core::matrix_perspective_fov_lh(pi / 3.0f, 16.0f / 9.0f, 0.5f, 80.0f);
+		Core::Float4x4 view_projection;
+		Core::store(view_projection, Core::matrix_multiply(view, projection));
+		return Core::make_frustum(view_projection);
+	}
+
+	// The smallest signed distance of the box over the planes, negative outside of one
+	float frustum_margin(const Core::Frustum& frustum, const Core::Aabb& bounds)
+	{
+		float margin = FLT_MAX;
+		for (const Core::Float4& plane : frustum.planes)
+		{
+			const float center = plane.x * (bounds.min.x + bounds.max.x) * 0.5f + plane.y * (bounds.min.y + bounds.max.y) * 0.5f + plane.z * (bounds.min.z + bounds.max.z) * 0.5f + plane.w;
+			const float radius = std::abs(plane.x) * (bounds.max.x - bounds.min.x) * 0.5f + std::abs(plane.y) * (bounds.max.y - bounds.min.y) * 0.5f + std::abs(plane.z) * (bounds.max.z - bounds.min.z) * 0.5f;
+			margin = std::min(margin, center + radius);
+		}
+		return margin;
+	}
+
+	// Every box clearly inside and none clearly outside, each once
+	bool culls_like_brute_force(const Core::Bvh& bvh, const Core::Frustum& frustum, const std::vector<Core::Aabb>& bounds)
+	{
+		std::vector<uint32_t> visible_indices(bounds.size());
+		visible_indices.resize(bvh.cull(frustum, visible_indices.data()));
+		std::sort(visible_indices.begin(), visible_indices.end());
+		if (std::adjacent_find(visible_indices.begin(), visible_indices.end()) != visible_indices.end())
+		{
+			return false;
+		}
+
+		for (uint32_t primitive_idx = 0; primitive_idx < bounds.size(); ++primitive_idx)
+		{
+			const float margin = frustum_margin(frustum, bounds[primitive_idx]);
+			const bool is_visible = std::binary_search(visible_indices.begin(), visible_indices.end(), primitive_idx);
+			if ((margin > boundary_tolerance && !is_visible) || (margin < -boundary_tolerance && is_visible))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Slab test in double, 0 from inside, negative for a miss
+	double ray_distance(const Core::Float3& origin, const Core::Float3& direction, const Core::Aabb& bounds)
+	{
+		const double origins[3] = { origin.x, origin.y, origin.z };
+		const double directions[3] = { direction.x, direction.y, direction.z };
+		const double mins[3] = { bounds.min.x, bounds.min.y, bounds.min.z };
+		const double maxs[3] = { bounds.max.x, bounds.max.y, bounds.max.z };
+		double entry = 0.0;
+		double exit = DBL_MAX;
+		for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+		{
+			if (directions[axis_idx] == 0.0)
+			{
+				if (origins[axis_idx] < mins[axis_idx] || origins[axis_idx] > maxs[axis_idx])
+				{
+					return -1.0;
+				}
+				continue;
+			}
+			const double t0 = (mins[axis_idx] - origins[axis_idx]) / directions[axis_idx];
+			const double t1 = (maxs[axis_idx] - origins[axis_idx]) / directions[axis_idx];
+			entry = std::max(entry, std::min(t0, t1));
+			exit = std::min(exit, std::max(t0, t1));
+		}
+		return entry <= exit ? entry : -1.0;
+	}
+
+	// The closest box the ray reaches within max_distance, and that hit's distance
+	bool raycasts_like_brute_force(const Core::Bvh& bvh, const std::vector<Core::Aabb>& bounds, const Core::Float3& origin, const Core::Float3& direction, float max_distance)
+	{
+		double closest_distance = DBL_MAX;
+		for (const Core::Aabb& primitive_bounds : bounds)
+		{
+			const double distance = ray_distance(origin, direction, primitive_bounds);
+			if (distance >= 0.0 && distance <= max_distance)
+			{
+				closest_distance = std::min(closest_distance, distance);
+			}
+		}
+
+		Core::BvhRayHit hit = {};
+		const bool is_hit = bvh.raycast(origin, direction, max_distance, hit);
+		const double tolerance = 1e-4 * std::max(1.0, closest_distance);
+		if (closest_distance == DBL_MAX)
+		{
+			// Grazing the limit may go either way
+			return !is_hit || hit.distance >= max_distance - tolerance;
+		}
+		if (!is_hit)
+		{
+			return closest_distance >= max_distance - tolerance;
+		}
+		// Ties may pick either box, the distance is what counts
+		return std::abs(hit.distance - closest_distance) <= tolerance
+			&& std::abs(ray_distance(origin, direction, bounds[hit.primitive_idx]) - closest_distance) <= tolerance;
+	}
+}
+
+TEST_CASE(bvh, builds_a_well_formed_tree)
+{
+	Core::JobSystem job_system(Core::JobSystemDesc{ 3 });
+	for (const uint32_t count : { 1U, 7U, 8U, 9U, 100U, 20000U })
+	{
+		const auto bounds = make_bounds(count, count);
+		Core::Bvh bvh;
+		bvh.build(job_system, bounds.data(), count);
+		CHECK(is_well_formed(bvh, bounds));
+		CHECK(bvh.sah_cost() > 0.0f);
+	}
+
+	// All centroids in one place can not be split by SAH, leaves still stay small
+	const std::vector<Core::Aabb> stacked(100, Core::Aabb{ { -1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, 1.0f } });
+	Core::Bvh bvh;
+	bvh.build(job_system, stacked.data(), static_cast<uint32_t>(stacked.size()));
+	CHECK(is_well_formed(bvh, stacked));
+}
+
+TEST_CASE(bvh, culls_like_brute_force)
+{
+	Core::JobSystem job_system(Core::JobSystemDesc{ 3 });
+	const auto bounds = make_bounds(20000, 1);
+	Core::Bvh bvh;
+	bvh.build(job_system, bounds.data(), static_cast<uint32_t>(bounds.size()));
+
+	std::mt19937 random(4);
+	std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+	for (uint32_t view_idx = 0; view_idx < 20; ++view_idx)
+	{
+		const Core::Float3 position = { coordinate(random) * 100.0f, coordinate(random) * 20.0f, coordinate(random) * 100.0f };
+		const Core::Float3 direction = { coordinate(random), coordinate(random) * 0.3f, coordinate(random) };
+		CHECK(culls_like_brute_force(bvh, make_camera_frustum(position, direction), bounds));
+	}
+
+	Core::Bvh empty_bvh;
+	empty_bvh.build(job_system, nullptr, 0);
+	uint32_t visible_index = 0;
+	CHECK(empty_bvh.cull(make_camera_frustum({ 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }), &visible_index) == 0);
+}
+
+TEST_CASE(bvh, refits_moved_primitives)
+{
+	Core::JobSystem job_system(Core::JobSystemDesc{ 3 });
+	auto bounds = make_bounds(5000, 2);
+	Core::Bvh bvh;
+	bvh.build(job_system, bounds.data(), static_cast<uint32_t>(bounds.size()));
+
+	std::mt19937 random(6);
+	std::normal_distribution<float> movement(0.0f, 5.0f);
+	for (uint32_t frame_idx = 0; frame_idx < 5; ++frame_idx)
+	{
+		for (Core::Aabb& primitive_bounds : bounds)
+		{
+			const Core::Float3 offset = { movement(random), movement(random), movement(random) };
+			primitive_bounds.min = { primitive_bounds.min.x + offset.x, primitive_bounds.min.y + offset.y, primitive_bounds.min.z + offset.z };
+			primitive_bounds.max = { primitive_bounds.max.x + offset.x, primitive_bounds.max.y + offset.y, primitive_bounds.max.z + offset.z };
+		}
+		bvh.refit(bounds.data());
+		CHECK(is_well_formed(bvh, bounds));
+		CHECK(culls_like_brute_force(bvh, make_camera_frustum({ 0.0f, 5.0f, -120.0f }, { 0.1f, 0.0f, 1.0f }), bounds));
+		CHECK(raycasts_like_brute_force(bvh, bounds, { -150.0f, 0.0f, 3.0f }, { 1.0f, 0.01f, 0.0f }, 1000.0f));
+	}
+}
+
+TEST_CASE(bvh, raycasts_like_brute_force)
+{
+	Core::JobSystem job_system(Core::JobSystemDesc{ 3 });
+	const auto bounds = make_bounds(10000, 3);
+	Core::Bvh bvh;
+	bvh.build(job_system, bounds.data(), static_cast<uint32_t>(bounds.size()));
+
+	std::mt19937 random(8);
+	std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> max_distance(1.0f, 300.0f);
+	uint32_t hit_count = 0;
+	for (uint32_t ray_idx = 0; ray_idx < 2000; ++ray_idx)
+	{
+		const Core::Float3 origin = { coordinate(random) * 150.0f, coordinate(random) * 30.0f, coordinate(random) * 150.0f };
+		// Unnormalized, with some axis aligned ones that divide by zero
+		Core::Float3 direction = { coordinate(random) * 3.0f, coordinate(random), coordinate(random) * 3.0f };
+		if (ray_idx % 10 == 0)
+		{
+			direction = { ray_idx % 20 == 0 ? 2.0f : 0.0f, 0.0f, ray_idx % 20 == 0 ? 0.0f : -0.5f };
+		}
+		const float ray_max_distance = max_distance(random);
+		CHECK(raycasts_like_brute_force(bvh, bounds, origin, direction, ray_max_distance));
+
+		Core::BvhRayHit hit = {};
+		hit_count += bvh.raycast(origin, direction, ray_max_distance, hit) ? 1 : 0;
+	}
+	CHECK(hit_count > 100);
+}
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "core/file_watcher.hpp"
+#include "test.hpp"
+
+namespace
+{
+	void write_file(const std::filesystem::path& path, const std::string& text)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << text;
+	}
+
+	bool contains(const std::vector<std::string>& file_names, const std::string& file_name)
+	{
+		return std::find(file_names.begin(), file_names.end(), file_name) != file_names.end();
+	}
+}
+
+TEST_CASE(file_watcher, is_invalid_for_a_missing_directory)
+{
+	Tests::TemporaryDirectory directory;
+	Core::FileWatcher watcher((directory.path() / "missing").string());
+
+	CHECK(!watcher.is_valid());
+	CHECK(watcher.poll().empty());
+}
+
+TEST_CASE(file_watcher, reports_nothing_without_changes)
+{
+	Tests::TemporaryDirectory directory;
+	write_file(directory.path() / "existing.hlsl", "before");
+	Core::FileWatcher watcher(directory.path().string());
+
+	CHECK(watcher.is_valid());
+	CHECK(watcher.poll().empty());
+}
+
+TEST_CASE(file_watcher, reports_created_and_written_files)
+{
+	Tests::TemporaryDirectory directory;
+	write_file(directory.path() / "written.hlsl", "before");
+	Core::FileWatcher watcher(directory.path().string());
+
+	write_file(directory.path() / "written.hlsl", "after");
+	write_file(directory.path() / "created.hlsli", "new");
+
+	const auto changed_files = watcher.poll();
+	CHECK(changed_files.size() == 2);
+	CHECK(contains(changed_files, "written.hlsl"));
+	CHECK(contains(changed_files, "created.hlsli"));
+	CHECK(watcher.poll().empty());
+}
+
+TEST_CASE(file_watcher, reports_a_file_once_per_poll)
+{
+	Tests::TemporaryDirectory directory;
+	Core::FileWatcher watcher(directory.path().string());
+
+	// An editor saving in several steps
+	for (int write_idx = 0; write_idx < 5; ++write_idx)
+	{
+		write_file(directory.path() / "main.hlsl", std::string(static_cast<size_t>(write_idx + 1), 'x'));
+	}
+
+	const auto changed_files = watcher.poll();
+	CHECK(changed_files.size() == 1);
+	CHECK(contains(changed_files, "main.hlsl"));
+}
+
+TEST_CASE(file_watcher, reports_files_moved_into_the_directory)
+{
+	Tests::TemporaryDirectory directory;
+	Tests::TemporaryDirectory elsewhere;
+	Core::FileWatcher watcher(directory.path().string());
+
+	// Saving to a temporary file and renaming it over the original
+	write_file(elsewhere.path() / "main.hlsl.tmp", "saved");
+	std::error_code error;
+	std::filesystem::rename(elsewhere.path() / "main.hlsl.tmp", directory.path() / "main.hlsl", error);
+	if (error)
+	{
+		// Temp directories on different file systems, nothing to test
+		return;
+	}
+
+	const auto changed_files = watcher.poll();
+	CHECK(changed_files.size() == 1);
+	CHECK(contains(changed_files, "main.hlsl"));
+}
+
+TEST_CASE(file_watcher, ignores_subdirectories)
+{
+	Tests::TemporaryDirectory directory;
+	Core::FileWatcher watcher(directory.path().string());
+
+	std::filesystem::create_directory(directory.path() / "nested");
+	write_file(directory.path() / "nested" / "main.hlsl", "nested");
+
+	CHECK(watcher.poll().empty());
+}
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "core/frustum_culling.hpp"
+#include "core/job_system.hpp"
+#include "test.hpp"
+
+namespace
+{
+	constexpr float pi = 3.14159265358979f;
+	// Bounds closer to a plane than this may go either way in SIMD and scalar float math
+	constexpr float boundary_tolerance = 1e-3f;
+
+	Core::Float4x4 make_view_projection(const Core::Float3& position, const Core::Float3& direction)
+	{
+		const Core::Matrix view = Core::matrix_look_to_lh(Core::load(position, 1.0f), Core::load(direction, 0.0f), Core::vector_set(0.0f, 1.0f, 0.0f, 0.0f));
+		const Core::Matrix projection = Core::matrix_perspective_fov_lh(pi / 3.0f, 16.0f / 9.0f, 0.5f, 60.0f);
+		Core::Float4x4 view_projection;
+		Core::store(view_projection, Core::matrix_multiply(view, projection));
+		return view_projection;
+	}
+
+	float plane_distance(const Core::Float4& plane, float x, float y, float z)
+	{
+		return plane.x * x + plane.y * y + plane.z * z + plane.w;
+	}
+
+	// The smallest signed distance of the bounds over the planes, negative outside of one
+	float sphere_margin(const Core::Frustum& frustum, float x, float y, float z, float radius)
+	{
+		float margin = INFINITY;
+		for (const Core::Float4& plane : frustum.planes)
+		{
+			margin = std::min(margin, plane_distance(plane, x, y, z) + radius);
+		}
+		return margin;
+	}
+
+	float aabb_margin(const Core::Frustum& frustum, float x, float y, float z, float extent_x, float extent_y, float extent_z)
+	{
+		float margin = INFINITY;
+		for (const Core::Float4& plane : frustum.planes)
+		{
+			// The corner furthest along the plane's normal
+			const float radius = std::abs(plane.x) * extent_x + std::abs(plane.y) * extent_y + std::abs(plane.z) * extent_z;
+			margin = std::min(margin, plane_distance(plane, x, y, z) + radius);
+		}
+		return margin;
+	}
+
+	struct Objects
+	{
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+		std::vector<float> radius;
+		std::vector<float> extent_x;
+		std::vector<float> extent_y;
+		std::vector<float> extent_z;
+
+		Core::SphereBounds spheres() const
+		{
+			return { x.data(), y.data(), z.data(), radius.data() };
+		}
+
+		Core::AabbBounds aabbs() const
+		{
+			return { x.data(), y.data(), z.data(), extent_x.data(), extent_y.data(), extent_z.data() };
+		}
+	};
+
+	// Spread all around the camera, flattened vertically
+	Objects make_objects(uint32_t count, uint32_t seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> coordinate(-70.0f, 70.0f);
+		std::uniform_real_distribution<float> size(0.1f, 3.0f);
+		Objects objects;
+		for (uint32_t object_idx = 0; object_idx < count; ++object_idx)
+		{
+			objects.x.push_back(coordinate(random));
+			objects.y.push_back(coordinate(random) * 0.3f);
+			objects.z.push_back(coordinate(random));
+			objects.radius.push_back(size(random));
+			objects.extent_x.push_back(size(random));
+			objects.extent_y.push_back(size(random));
+			objects.extent_z.push_back(size(random));
+		}
+		return objects;
+	}
+
+	// Visible indices are increasing, include every object clearly inside and none clearly outside
+	template<typename Margin>
+	bool matches_brute_force(const std::vector<uint32_t>& visible_indices, uint32_t count, Margin&& margin)
+	{
+		if (!std::is_sorted(visible_indices.begin(), visible_indices.end())
+			|| std::adjacent_find(visible_indices.begin(), visible_indices.end()) != visible_indices.end())
+		{
+			return false;
+		}
+		for (uint32_t object_idx = 0; object_idx < count; ++object_idx)
+		{
+			const float object_margin = margin(object_idx);
+			const bool is_visible = std::binary_search(visible_indices.begin(), visible_indices.end(), object_idx);
+			if ((object_margin > boundary_tolerance && !is_visible) || (object_margin < -boundary_tolerance && is_visible))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::vector<uint32_t> cull_spheres(const Core::Frustum& frustum, const Objects& objects, uint32_t count, Core::JobSystem* job_system = nullptr)
+	{
+		std::vector<uint32_t> visible_indices(count);
+		const uint32_t visible_count = job_system
+			? Core::cull_spheres(*job_system, frustum, objects.spheres(), count, visible_indices.data())
+			: Core::cull_spheres(frustum, objects.spheres(), count, visible_indices.data());
+		visible_indices.resize(visible_count);
+		return visible_indices;
+	}
+
+	std::vector<uint32_t> cull_aabbs(const Core::Frustum& frustum, const Objects& objects, uint32_t count, Core::JobSystem* job_system = nullptr)
+	{
+		std::vector<uint32_t> visible_indices(count);
+		const uint32_t visible_count = job_system
+			? Core::cull_aabbs(*job_system, frustum, objects.aabbs(), count, visible_indices.data())
+			: Core::cull_aabbs(frustum, objects.aabbs(), count, visible_indices.data());
+		visible_indices.resize(visible_count);
+		return visible_indices;
+	}
+}
+
+TEST_CASE(frustum_culling, makes_planes_of_the_clip_volume)
+{
+	const Core::Float4x4 view_projection = make_view_projection({ 3.0f, 1.0f, -2.0f }, { 1.0f, -0.2f, 2.0f });
+	const Core::Frustum frustum = Core::make_frustum(view_projection);
+	for (const Core::Float4& plane : frustum.planes)
+	{
+		CHECK(std::abs(std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z) - 1.0f) < 1e-5f);
+	}
+
+	// Inside all planes exactly when the projected point is inside the clip volume
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> coordinate(-80.0f, 80.0f);
+	uint32_t inside_count = 0;
+	for (uint32_t point_idx = 0; point_idx < 10000; ++point_idx)
+	{
+		const Core::Float4 point = { coordinate(random), coordinate(random), coordinate(random), 1.0f };
+		Core::Float4 clip;
+		Core::store(clip, Core::vector_transform(Core::load(point), Core::load(view_projection)));
+		const float clip_margin = std::min({ clip.w + clip.x, clip.w - clip.x, clip.w + clip.y, clip.w - clip.y, clip.z, clip.w - clip.z });
+		const float plane_margin = sphere_margin(frustum, point.x, point.y, point.z, 0.0f);
+		if (std::abs(clip_margin) > 1e-2f)
+		{
+			CHECK((clip_margin > 0.0f) == (plane_margin > 0.0f));
+			inside_count += clip_margin > 0.0f ? 1 : 0;
+		}
+	}
+	CHECK(inside_count > 100);
+}
+
+TEST_CASE(frustum_culling, culls_like_brute_force)
+{
+	const Core::Frustum frustum = Core::make_frustum(make_view_projection({ 0.0f, 0.0f, 0.0f }, { 0.3f, 0.1f, 1.0f }));
+	const Objects objects = make_objects(5000, 2);
+
+	// Every remainder of the 4 and 8 wide loops, and then many
+	for (const uint32_t count : { 0U, 1U, 3U, 4U, 5U, 7U, 8U, 9U, 15U, 17U, 5000U })
+	{
+		CHECK(matches_brute_force(cull_spheres(frustum, objects, count), count, [&](uint32_t idx)
+		{
+			return sphere_margin(frustum, objects.x[idx], objects.y[idx], objects.z[idx], objects.radius[idx]);
+		}));
+		CHECK(matches_brute_force(cull_aabbs(frustum, objects, count), count, [&](uint32_t idx)
+		{
+			return aabb_margin(frustum, objects.x[idx], objects.y[idx], objects.z[idx], objects.extent_x[idx], objects.extent_y[idx], objects.extent_z[idx]);
+		}));
+	}
+	CHECK(cull_spheres(frustum, objects, 5000).size() > 200);
+}
+
+TEST_CASE(frustum_culling, culls_the_same_on_the_job_system)
+{
+	Core::JobSystem job_system(Core::JobSystemDesc{ 3 });
+	const Core::Frustum frustum = Core::make_frustum(make_view_projection({ 1.0f, 2.0f, 3.0f }, { -1.0f, 0.0f, 0.5f }));
+	const Objects objects = make_objects(20000, 3);
+
+	for (const uint32_t count : { 0U, 13U, 1000U, 20000U })
+	{
+		CHECK(cull_spheres(frustum, objects, count, &job_system) == cull_spheres(frustum, objects, count));
+		CHECK(cull_aabbs(frustum, objects, count, &job_system) == cull_aabbs(frustum, objects, count));
+	}
+}
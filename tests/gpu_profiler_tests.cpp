@@ -0,0 +1,233 @@
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include "core/gpu_profiler.hpp"
+#include "test.hpp"
+
+namespace
+{
+	constexpr uint32_t fake_slot_count = 3;
+	constexpr uint32_t fake_max_timestamps = 8;
+
+	// Hands out ticks of frame_idx * 1000 + timestamp_idx * 10 at one tick per
+	// nanosecond, and only reads a slot back once the test marked it done
+	class FakeQuerySource : public Core::GpuQuerySource
+	{
+	public:
+		uint32_t frame_slot_count() const override
+		{
+			return fake_slot_count;
+		}
+
+		uint32_t max_timestamps_per_frame() const override
+		{
+			return fake_max_timestamps;
+		}
+
+		void begin_frame(uint32_t frame_slot) override
+		{
+			m_slots[frame_slot].frame_idx = m_frame_idx;
+			m_slots[frame_slot].is_done = false;
+		}
+
+		void write_timestamp(uint32_t frame_slot, uint32_t timestamp_idx) override
+		{
+			m_slots[frame_slot].ticks[timestamp_idx] = m_frame_idx * 1000 + timestamp_idx * 10;
+		}
+
+		void end_frame(uint32_t /*frame_slot*/, uint32_t /*timestamp_count*/) override
+		{
+			++m_frame_idx;
+		}
+
+		bool read_timestamps(uint32_t frame_slot, uint32_t /*timestamp_count*/, Core::GpuTimestamps& timestamps) override
+		{
+			const auto& slot = m_slots[frame_slot];
+			if (!slot.is_done)
+			{
+				return false;
+			}
+			timestamps = { slot.ticks.data(), 1000000000, 0, 0, is_reliable };
+			return true;
+		}
+
+		void finish_slot(uint32_t frame_slot)
+		{
+			m_slots[frame_slot].is_done = true;
+		}
+
+		void finish_all()
+		{
+			for (uint32_t frame_slot = 0; frame_slot < fake_slot_count; ++frame_slot)
+			{
+				finish_slot(frame_slot);
+			}
+		}
+
+		bool is_reliable = true;
+	private:
+		struct Slot
+		{
+			std::array<uint64_t, fake_max_timestamps> ticks = {};
+			uint64_t frame_idx = 0;
+			bool is_done = false;
+		};
+
+		std::array<Slot, fake_slot_count> m_slots;
+		uint64_t m_frame_idx = 0;
+	};
+
+	void record_frame(Core::GpuProfiler& profiler)
+	{
+		// Not GPU_PROFILE_ZONE, which compiles away without DIRECTX_PLAYGROUND_PROFILE
+		profiler.begin_frame();
+		profiler.end_region(profiler.begin_region("Frame"));
+		profiler.end_frame();
+	}
+}
+
+TEST_CASE(gpu_profiler, resolves_regions_on_the_cpu_timeline)
+{
+	FakeQuerySource source;
+	Core::GpuProfiler profiler(source);
+
+	profiler.begin_frame();
+	const uint32_t outer = profiler.begin_region("Outer");
+	const uint32_t inner = profiler.begin_region("Inner");
+	profiler.end_region(inner);
+	profiler.end_region(outer);
+	profiler.end_frame();
+
+	source.finish_all();
+	profiler.begin_frame();
+
+	const auto& regions = profiler.resolved_regions();
+	CHECK(profiler.resolved_frame_idx() == 0);
+	CHECK(regions.size() == 2);
+	if (regions.size() == 2)
+	{
+		CHECK(regions[0].begin_ns == 0 && regions[0].end_ns == 10);
+		CHECK(regions[1].begin_ns == 20 && regions[1].end_ns == 30);
+	}
+	profiler.end_frame();
+}
+
+TEST_CASE(gpu_profiler, resolves_pending_frames_oldest_first)
+{
+	FakeQuerySource source;
+	Core::GpuProfiler profiler(source);
+
+	// Every slot is pending when the GPU catches up all at once
+	Core::Profiler::clear();
+	for (uint32_t frame_idx = 0; frame_idx < fake_slot_count; ++frame_idx)
+	{
+		record_frame(profiler);
+	}
+	source.finish_all();
+	profiler.begin_frame();
+
+	CHECK(profiler.resolved_frame_idx() == fake_slot_count - 1);
+	CHECK(profiler.resolved_regions().size() == 1);
+	if (!profiler.resolved_regions().empty())
+	{
+		CHECK(profiler.resolved_regions()[0].begin_ns == (fake_slot_count - 1) * 1000);
+	}
+	CHECK(profiler.dropped_frame_count() == 0);
+	profiler.end_frame();
+
+	// The trace gets them in frame order as well
+	std::vector<uint64_t> begin_ns;
+	for (const auto& event : Core::Profiler::collect())
+	{
+		if (std::strcmp(event.name, "Frame") == 0)
+		{
+			begin_ns.push_back(event.begin_ns);
+		}
+	}
+	CHECK(begin_ns.size() == fake_slot_count);
+	for (size_t event_idx = 1; event_idx < begin_ns.size(); ++event_idx)
+	{
+		CHECK(begin_ns[event_idx - 1] < begin_ns[event_idx]);
+	}
+}
+
+TEST_CASE(gpu_profiler, never_goes_back_to_an_older_frame)
+{
+	FakeQuerySource source;
+	Core::GpuProfiler profiler(source);
+
+	for (uint32_t frame_idx = 0; frame_idx < fake_slot_count; ++frame_idx)
+	{
+		record_frame(profiler);
+	}
+
+	// Only the newest frame is done, the oldest one gets dropped for its slot
+	source.finish_slot(fake_slot_count - 1);
+	record_frame(profiler);
+	CHECK(profiler.resolved_frame_idx() == fake_slot_count - 1);
+	CHECK(profiler.dropped_frame_count() == 1);
+
+	// Frame 1 finishing late must not replace the regions of frame 2
+	source.finish_slot(1);
+	profiler.begin_frame();
+	CHECK(profiler.resolved_frame_idx() == fake_slot_count - 1);
+	if (!profiler.resolved_regions().empty())
+	{
+		CHECK(profiler.resolved_regions()[0].begin_ns == (fake_slot_count - 1) * 1000);
+	}
+	CHECK(profiler.dropped_frame_count() == 1);
+	profiler.end_frame();
+}
+
+TEST_CASE(gpu_profiler, drops_frames_that_are_not_done_in_time)
+{
+	FakeQuerySource source;
+	Core::GpuProfiler profiler(source);
+
+	for (uint32_t frame_idx = 0; frame_idx < fake_slot_count * 2; ++frame_idx)
+	{
+		record_frame(profiler);
+	}
+
+	CHECK(profiler.dropped_frame_count() == fake_slot_count);
+	CHECK(profiler.resolved_regions().empty());
+}
+
+TEST_CASE(gpu_profiler, drops_unreliable_frames)
+{
+	FakeQuerySource source;
+	source.is_reliable = false;
+	Core::GpuProfiler profiler(source);
+
+	record_frame(profiler);
+	source.finish_all();
+	profiler.begin_frame();
+
+	CHECK(profiler.dropped_frame_count() == 1);
+	CHECK(profiler.resolved_regions().empty());
+	profiler.end_frame();
+}
+
+TEST_CASE(gpu_profiler, ignores_regions_past_the_timestamp_budget)
+{
+	FakeQuerySource source;
+	Core::GpuProfiler profiler(source);
+
+	profiler.begin_frame();
+	std::vector<uint32_t> regions;
+	for (uint32_t region_idx = 0; region_idx < fake_max_timestamps; ++region_idx)
+	{
+		regions.push_back(profiler.begin_region("Region"));
+	}
+	for (auto region = regions.rbegin(); region != regions.rend(); ++region)
+	{
+		profiler.end_region(*region);
+	}
+	profiler.end_frame();
+
+	source.finish_all();
+	profiler.begin_frame();
+	CHECK(profiler.resolved_regions().size() == fake_max_timestamps / 2);
+	profiler.end_frame();
+}
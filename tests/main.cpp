@@ -0,0 +1,98 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "test.hpp"
+
+namespace Tests
+{
+
+	namespace
+	{
+		struct TestCase
+		{
+			const char* suite;
+			const char* name;
+			TestFunction function;
+		};
+
+		// A function local static, registrations run during static initialization
+		std::vector<TestCase>& test_cases()
+		{
+			static std::vector<TestCase> cases;
+			return cases;
+		}
+
+		int failure_count = 0;
+	}
+
+	TestRegistration::TestRegistration(const char* suite, const char* name, TestFunction function)
+	{
+		test_cases().push_back({ suite, name, function });
+	}
+
+	void report_failure(const char* file, int line, const char* condition)
+	{
+		std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, condition);
+		++failure_count;
+	}
+
+	TemporaryDirectory::TemporaryDirectory()
+	{
+		static std::atomic<uint32_t> s_directory_idx{ 0 };
+
+		// Unique across runs of ctest in parallel as well
+		const auto ticks = std::chrono::steady_clock::now().time_since_epoch().count();
+		m_path = std::filesystem::temp_directory_path()
+			/ ("playground_tests_" + std::to_string(ticks) + "_" + std::to_string(s_directory_idx++));
+		std::filesystem::create_directories(m_path);
+	}
+
+	TemporaryDirectory::~TemporaryDirectory()
+	{
+		std::error_code error;
+		std::filesystem::remove_all(m_path, error);
+	}
+
+	const std::filesystem::path& TemporaryDirectory::path() const
+	{
+		return m_path;
+	}
+
+}
+
+// Usage: playground_tests [SUITE], without a suite every test runs
+int main(int argc, char** argv)
+{
+	const char* suite = argc > 1 ? argv[1] : nullptr;
+
+	int run_count = 0;
+	int failed_test_count = 0;
+	for (const auto& test_case : Tests::test_cases())
+	{
+		if (suite && std::strcmp(suite, test_case.suite) != 0)
+		{
+			continue;
+		}
+
+		const int failures_before = Tests::failure_count;
+		test_case.function();
+		const bool has_failed = Tests::failure_count != failures_before;
+		std::printf("%s %s.%s\n", has_failed ? "FAIL" : "ok  ", test_case.suite, test_case.name);
+		failed_test_count += has_failed ? 1 : 0;
+		++run_count;
+	}
+
+	// A typo in the suite name must not pass as an empty run
+	if (run_count == 0)
+	{
+		std::fprintf(stderr, "No tests in suite %s\n", suite ? suite : "(all)");
+		return 1;
+	}
+
+	std::printf("%d of %d tests failed\n", failed_test_count, run_count);
+	return failed_test_count == 0 ? 0 : 1;
+}
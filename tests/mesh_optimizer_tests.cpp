@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "core/mesh_optimizer.hpp"
+#include "test.hpp"
+#include "test_meshes.hpp"
+
+namespace
+{
+	// The triangles of the grid in a random order
+	Core::MeshImport make_shuffled_grid(uint32_t quad_count)
+	{
+		Core::MeshImport mesh = Tests::make_grid(quad_count);
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (size_t index_idx = 0; index_idx < mesh.indices.size(); index_idx += 3)
+		{
+			triangles.push_back({ mesh.indices[index_idx], mesh.indices[index_idx + 1], mesh.indices[index_idx + 2] });
+		}
+		std::mt19937 random(43);
+		std::shuffle(triangles.begin(), triangles.end(), random);
+
+		mesh.indices.clear();
+		for (const auto& triangle : triangles)
+		{
+			mesh.indices.insert(mesh.indices.end(), triangle.begin(), triangle.end());
+		}
+		return mesh;
+	}
+
+	float acmr_of(const Core::MeshImport& mesh)
+	{
+		return Core::analyze_vertex_cache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size()).acmr;
+	}
+}
+
+TEST_CASE(mesh_optimizer, analyzes_a_fifo_cache)
+{
+	// Two triangles sharing an edge transform four vertices
+	const uint32_t indices[] = { 0, 1, 2, 2, 1, 3 };
+	const Core::VertexCacheStats stats = Core::analyze_vertex_cache(indices, 6, 4);
+	CHECK(stats.transformed_vertex_count == 4);
+	CHECK(stats.acmr == 2.0f);
+	CHECK(stats.atvr == 1.0f);
+
+	// With a single entry the second triangle only finds vertex 2
+	const Core::VertexCacheStats tiny_cache_stats = Core::analyze_vertex_cache(indices, 6, 4, 1);
+	CHECK(tiny_cache_stats.transformed_vertex_count == 5);
+}
+
+TEST_CASE(mesh_optimizer, vertex_cache_order_keeps_the_triangles)
+{
+	Core::MeshImport mesh = make_shuffled_grid(64);
+	const auto triangles = Tests::position_triangles(mesh.vertices, mesh.indices.data(), mesh.indices.size());
+	const float shuffled_acmr = acmr_of(mesh);
+
+	Core::optimize_vertex_cache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+
+	CHECK(Tests::position_triangles(mesh.vertices, mesh.indices.data(), mesh.indices.size()) == triangles);
+	// A regular grid gets close to 0.5, a shuffled one is near 3
+	CHECK(shuffled_acmr > 2.5f);
+	CHECK(acmr_of(mesh) < 0.8f);
+}
+
+TEST_CASE(mesh_optimizer, overdraw_order_keeps_the_triangles_and_the_acmr_threshold)
+{
+	constexpr float threshold = 1.05f;
+
+	Core::MeshImport mesh = Tests::make_sphere(32, 64);
+	Core::optimize_vertex_cache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+	const auto triangles = Tests::position_triangles(mesh.vertices, mesh.indices.data(), mesh.indices.size());
+	const float cache_acmr = acmr_of(mesh);
+
+	Core::optimize_overdraw(mesh.indices.data(), mesh.indices.size(), mesh.vertices, threshold);
+
+	CHECK(Tests::position_triangles(mesh.vertices, mesh.indices.data(), mesh.indices.size()) == triangles);
+	CHECK(acmr_of(mesh) <= cache_acmr * threshold);
+}
+
+TEST_CASE(mesh_optimizer, vertex_fetch_order_follows_the_indices)
+{
+	Core::MeshImport mesh = make_shuffled_grid(16);
+	// Unused, dropped
+	mesh.vertices.push_back({ { 2.0f, 2.0f, 2.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f } });
+	const size_t used_vertex_count = mesh.vertices.size() - 1;
+	const auto triangles = Tests::position_triangles(mesh.vertices, mesh.indices.data(), mesh.indices.size());
+
+	Core::optimize_vertex_fetch(mesh);
+
+	CHECK(mesh.vertices.size() == used_vertex_count);
+	CHECK(Tests::position_triangles(mesh.vertices, mesh.indices.data(), mesh.indices.size()) == triangles);
+	uint32_t next_vertex = 0;
+	bool is_first_use_order = true;
+	for (const uint32_t index : mesh.indices)
+	{
+		is_first_use_order = is_first_use_order && index <= next_vertex;
+		next_vertex = std::max(next_vertex, index + 1);
+	}
+	CHECK(is_first_use_order);
+}
+
+TEST_CASE(mesh_optimizer, optimize_mesh_keeps_every_submesh)
+{
+	// Two submeshes, the second one is the sphere
+	Core::MeshImport mesh = make_shuffled_grid(16);
+	const Core::MeshImport sphere = Tests::make_sphere(8, 16);
+	const auto grid_vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+	Core::Submesh submesh;
+	submesh.first_index = static_cast<uint32_t>(mesh.indices.size());
+	submesh.index_count = static_cast<uint32_t>(sphere.indices.size());
+	submesh.material_idx = 1;
+	mesh.submeshes.push_back(submesh);
+	mesh.vertices.insert(mesh.vertices.end(), sphere.vertices.begin(), sphere.vertices.end());
+	for (const uint32_t index : sphere.indices)
+	{
+		mesh.indices.push_back(index + grid_vertex_count);
+	}
+
+	std::vector<std::vector<Tests::PositionTriangle>> triangles;
+	for (const auto& original : mesh.submeshes)
+	{
+		triangles.push_back(Tests::position_triangles(mesh.vertices, mesh.indices.data() + original.first_index, original.index_count));
+	}
+
+	Core::optimize_mesh(mesh);
+
+	CHECK(mesh.submeshes.size() == 2);
+	for (size_t submesh_idx = 0; submesh_idx < mesh.submeshes.size() && submesh_idx < triangles.size(); ++submesh_idx)
+	{
+		const auto& optimized = mesh.submeshes[submesh_idx];
+		CHECK(Tests::position_triangles(mesh.vertices, mesh.indices.data() + optimized.first_index, optimized.index_count) == triangles[submesh_idx]);
+	}
+}
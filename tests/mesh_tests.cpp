@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "core/mesh.hpp"
+#include "core/mesh_import.hpp"
+#include "core/meshlet.hpp"
+#include "test.hpp"
+#include "test_meshes.hpp"
+
+namespace
+{
+	std::vector<uint8_t> read_file(const std::filesystem::path& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void write_file(const std::filesystem::path& path, const std::vector<uint8_t>& bytes)
+	{
+		std::ofstream file(path, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+	}
+
+	template<typename T>
+	void patch(std::vector<uint8_t>& bytes, size_t offset, T value)
+	{
+		std::memcpy(bytes.data() + offset, &value, sizeof(value));
+	}
+
+	bool load(const std::filesystem::path& path, Core::MeshData& mesh)
+	{
+		std::string error;
+		const bool is_loaded = Core::load_mesh(path.string(), mesh, error);
+		CHECK(is_loaded || !error.empty());
+		return is_loaded;
+	}
+
+	uint32_t index_at(const Core::MeshData& mesh, size_t index_idx)
+	{
+		if (mesh.header.index_size == 2)
+		{
+			return static_cast<const uint16_t*>(mesh.indices)[index_idx];
+		}
+		return static_cast<const uint32_t*>(mesh.indices)[index_idx];
+	}
+
+	// Everything write_mesh() quantized comes back within the precision of its encoding
+	bool round_trips(const Core::MeshImport& import, const Core::MeshData& mesh)
+	{
+		const Core::MeshHeader& header = mesh.header;
+		if (header.vertex_count != import.vertices.size()
+			|| header.index_count != import.indices.size()
+			|| header.submesh_count != import.submeshes.size())
+		{
+			return false;
+		}
+
+		for (size_t vertex_idx = 0; vertex_idx < import.vertices.size(); ++vertex_idx)
+		{
+			const Core::ImportedVertex& expected = import.vertices[vertex_idx];
+			const Core::MeshVertex& vertex = mesh.vertices[vertex_idx];
+
+			float position[3];
+			float normal[3];
+			Core::decode_position(header, vertex, position);
+			Core::decode_octahedral(vertex.normal, normal);
+			for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+			{
+				// Rounding is off by half a unorm step at most, the float math adds a little
+				const float position_tolerance = header.position_scale[axis_idx] / 65535.0f + 1e-6f;
+				if (std::abs(position[axis_idx] - expected.position[axis_idx]) > position_tolerance
+					|| std::abs(normal[axis_idx] - expected.normal[axis_idx]) > 1e-3f)
+				{
+					return false;
+				}
+			}
+			for (uint32_t uv_idx = 0; uv_idx < 2; ++uv_idx)
+			{
+				if (std::abs(Core::half_to_float(vertex.uv[uv_idx]) - expected.uv[uv_idx]) > 1e-3f)
+				{
+					return false;
+				}
+			}
+		}
+
+		for (size_t index_idx = 0; index_idx < import.indices.size(); ++index_idx)
+		{
+			if (index_at(mesh, index_idx) != import.indices[index_idx])
+			{
+				return false;
+			}
+		}
+
+		for (size_t submesh_idx = 0; submesh_idx < import.submeshes.size(); ++submesh_idx)
+		{
+			const Core::Submesh& expected = import.submeshes[submesh_idx];
+			const Core::Submesh& submesh = mesh.submeshes[submesh_idx];
+			if (submesh.first_index != expected.first_index
+				|| submesh.index_count != expected.index_count
+				|| submesh.material_idx != expected.material_idx)
+			{
+				return false;
+			}
+
+			// Bounds of the unquantized positions the submesh's indices reach
+			for (uint32_t axis_idx = 0; axis_idx < 3; ++axis_idx)
+			{
+				float bounds_min = FLT_MAX;
+				float bounds_max = -FLT_MAX;
+				for (uint32_t index_idx = expected.first_index; index_idx < expected.first_index + expected.index_count; ++index_idx)
+				{
+					bounds_min = std::min(bounds_min, import.vertices[import.indices[index_idx]].position[axis_idx]);
+					bounds_max = std::max(bounds_max, import.vertices[import.indices[index_idx]].position[axis_idx]);
+				}
+				if (submesh.bounds_min[axis_idx] != bounds_min || submesh.bounds_max[axis_idx] != bounds_max)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
+
+TEST_CASE(mesh, round_trips_vertices_indices_and_submeshes)
+{
+	Tests::TemporaryDirectory directory;
+	const auto path = directory.path() / "sphere.mesh";
+
+	// Two materials, each on one half of the triangles
+	Core::MeshImport import = Tests::make_sphere(12, 24);
+	const auto half_index_count = static_cast<uint32_t>(import.indices.size() / 6 * 3);
+	import.submeshes[0].index_count = half_index_count;
+	Core::Submesh second_half;
+	second_half.first_index = half_index_count;
+	second_half.index_count = static_cast<uint32_t>(import.indices.size()) - half_index_count;
+	second_half.material_idx = 1;
+	import.submeshes.push_back(second_half);
+
+	std::string error;
+	CHECK(Core::write_mesh(path.string(), import, error));
+	Core::MeshData mesh;
+	CHECK(load(path, mesh));
+	CHECK(mesh.header.index_size == 2);
+	CHECK(mesh.header.file_size == std::filesystem::file_size(path));
+	CHECK(round_trips(import, mesh));
+	CHECK(mesh.header.meshlet_count == 0);
+}
+
+TEST_CASE(mesh, round_trips_32_bit_indices)
+{
+	Tests::TemporaryDirectory directory;
+	const auto path = directory.path() / "grid.mesh";
+
+	// 257 x 257 vertices do not fit 16 bit indices
+	const Core::MeshImport import = Tests::make_grid(256);
+	std::string error;
+	CHECK(Core::write_mesh(path.string(), import, error));
+	Core::MeshData mesh;
+	CHECK(load(path, mesh));
+	CHECK(mesh.header.index_size == 4);
+	CHECK(round_trips(import, mesh));
+}
+
+TEST_CASE(mesh, rejects_truncated_and_foreign_files)
+{
+	Tests::TemporaryDirectory directory;
+	const auto path = directory.path() / "grid.mesh";
+
+	const Core::MeshImport import = Tests::make_grid(4);
+	std::string error;
+	CHECK(Core::write_mesh(path.string(), import, error));
+	const auto bytes = read_file(path);
+
+	for (size_t size = 0; size < bytes.size(); ++size)
+	{
+		write_file(path, std::vector<uint8_t>(bytes.begin(), bytes.begin() + size));
+		Core::MeshData mesh;
+		CHECK(!load(path, mesh));
+	}
+
+	const auto loads_with = [&](size_t offset, auto value)
+	{
+		auto patched = bytes;
+		patch(patched, offset, value);
+		write_file(path, patched);
+		Core::MeshData mesh;
+		return load(path, mesh);
+	};
+	CHECK(loads_with(offsetof(Core::MeshHeader, magic), Core::MeshHeader::magic_value));
+	CHECK(!loads_with(offsetof(Core::MeshHeader, magic), uint32_t(0)));
+	CHECK(!loads_with(offsetof(Core::MeshHeader, version), Core::MeshHeader::current_version - 1));
+	CHECK(!loads_with(offsetof(Core::MeshHeader, index_size), uint32_t(3)));
+	CHECK(!loads_with(offsetof(Core::MeshHeader, vertex_count), UINT32_MAX));
+	CHECK(!loads_with(offsetof(Core::MeshHeader, index_offset), uint64_t(bytes.size() + 16)));
+	CHECK(!loads_with(offsetof(Core::MeshHeader, file_size), uint64_t(bytes.size() + 1)));
+}
+
+TEST_CASE(mesh, rejects_meshlet_sections_outside_the_file)
+{
+	Tests::TemporaryDirectory directory;
+	const auto path = directory.path() / "sphere.mesh";
+
+	Core::MeshImport import = Tests::make_sphere(8, 16);
+	Core::build_meshlets(import);
+	std::string error;
+	CHECK(Core::write_mesh(path.string(), import, error));
+	const auto bytes = read_file(path);
+
+	Core::MeshData mesh;
+	CHECK(load(path, mesh));
+	CHECK(mesh.header.meshlet_count == import.meshlets.size());
+	CHECK(std::memcmp(mesh.meshlets, import.meshlets.data(), import.meshlets.size() * sizeof(Core::Meshlet)) == 0);
+	CHECK(std::memcmp(mesh.meshlet_vertices, import.meshlet_vertices.data(), import.meshlet_vertices.size() * sizeof(uint32_t)) == 0);
+	CHECK(std::memcmp(mesh.meshlet_triangles, import.meshlet_triangles.data(), import.meshlet_triangles.size()) == 0);
+
+	const auto loads_with = [&](size_t offset, auto value)
+	{
+		auto patched = bytes;
+		patch(patched, offset, value);
+		write_file(path, patched);
+		Core::MeshData patched_mesh;
+		return load(path, patched_mesh);
+	};
+
+	CHECK(!loads_with(offsetof(Core::MeshHeader, meshlet_count), UINT32_MAX));
+	CHECK(!loads_with(offsetof(Core::MeshHeader, meshlet_vertex_count), UINT32_MAX));
+	// The triangles are the last section
+	CHECK(!loads_with(offsetof(Core::MeshHeader, meshlet_triangle_size), uint32_t(import.meshlet_triangles.size() + 4)));
+	CHECK(!loads_with(offsetof(Core::MeshHeader, meshlet_triangle_size), uint32_t(import.meshlet_triangles.size() - 2)));
+
+	CHECK(!loads_with(offsetof(Core::MeshHeader, meshlet_offset), uint64_t(bytes.size() + 16)));
+	CHECK(!loads_with(offsetof(Core::MeshHeader, meshlet_vertex_offset), UINT64_MAX - 15));
+	CHECK(!loads_with(offsetof(Core::MeshHeader, meshlet_triangle_offset), uint64_t(bytes.size())));
+	// Sections are 16 byte aligned
+	const uint64_t meshlet_offset = mesh.header.meshlet_offset;
+	CHECK(!loads_with(offsetof(Core::MeshHeader, meshlet_offset), meshlet_offset + 4));
+}
@@ -0,0 +1,158 @@
+#include <cmath>
+#include <vector>
+
+#include "core/mesh_optimizer.hpp"
+#include "core/meshlet.hpp"
+#include "test.hpp"
+#include "test_meshes.hpp"
+
+namespace
+{
+	// The index list the meshlets of the submesh draw
+	std::vector<uint32_t> meshlet_indices(const Core::MeshImport& mesh, const Core::Submesh& submesh)
+	{
+		std::vector<uint32_t> indices;
+		for (uint32_t meshlet_idx = submesh.first_meshlet; meshlet_idx < submesh.first_meshlet + submesh.meshlet_count; ++meshlet_idx)
+		{
+			const Core::Meshlet& meshlet = mesh.meshlets[meshlet_idx];
+			for (uint32_t corner_idx = 0; corner_idx < meshlet.triangle_count * 3; ++corner_idx)
+			{
+				const uint8_t local_vertex = mesh.meshlet_triangles[meshlet.triangle_offset + corner_idx];
+				indices.push_back(mesh.meshlet_vertices[meshlet.vertex_offset + local_vertex]);
+			}
+		}
+		return indices;
+	}
+
+	bool is_well_formed(const Core::MeshImport& mesh, const Core::Meshlet& meshlet)
+	{
+		if (meshlet.vertex_count == 0 || meshlet.vertex_count > Core::Meshlet::max_vertices
+			|| meshlet.triangle_count == 0 || meshlet.triangle_count > Core::Meshlet::max_triangles
+			|| meshlet.triangle_offset % 4 != 0
+			|| meshlet.vertex_offset + meshlet.vertex_count > mesh.meshlet_vertices.size()
+			|| meshlet.triangle_offset + meshlet.triangle_count * 3 > mesh.meshlet_triangles.size())
+		{
+			return false;
+		}
+		for (uint32_t corner_idx = 0; corner_idx < meshlet.triangle_count * 3; ++corner_idx)
+		{
+			if (mesh.meshlet_triangles[meshlet.triangle_offset + corner_idx] >= meshlet.vertex_count)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool is_in_bounding_sphere(const Core::MeshImport& mesh, const Core::Meshlet& meshlet)
+	{
+		for (uint32_t vertex_idx = 0; vertex_idx < meshlet.vertex_count; ++vertex_idx)
+		{
+			const float* position = mesh.vertices[mesh.meshlet_vertices[meshlet.vertex_offset + vertex_idx]].position;
+			const float offset[3] = { position[0] - meshlet.center[0], position[1] - meshlet.center[1], position[2] - meshlet.center[2] };
+			if (std::sqrt(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]) > meshlet.radius * 1.0001f + 1e-6f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	Core::MeshImport make_optimized_sphere()
+	{
+		Core::MeshImport mesh = Tests::make_sphere(32, 64);
+		Core::optimize_mesh(mesh);
+		Core::build_meshlets(mesh);
+		return mesh;
+	}
+}
+
+TEST_CASE(meshlet, meshlets_cover_every_triangle_once)
+{
+	const Core::MeshImport mesh = make_optimized_sphere();
+	const Core::Submesh& submesh = mesh.submeshes[0];
+
+	CHECK(submesh.meshlet_count > 0);
+	CHECK(submesh.first_meshlet + submesh.meshlet_count == mesh.meshlets.size());
+
+	uint32_t malformed_count = 0;
+	for (const auto& meshlet : mesh.meshlets)
+	{
+		malformed_count += is_well_formed(mesh, meshlet) ? 0 : 1;
+	}
+	CHECK(malformed_count == 0);
+	if (malformed_count == 0)
+	{
+		const auto indices = meshlet_indices(mesh, submesh);
+		CHECK(Tests::position_triangles(mesh.vertices, indices.data(), indices.size())
+			== Tests::position_triangles(mesh.vertices, mesh.indices.data() + submesh.first_index, submesh.index_count));
+	}
+
+	// A closed mesh should mostly fill them
+	const uint32_t triangle_count = submesh.index_count / 3;
+	CHECK(submesh.meshlet_count <= (triangle_count + Core::Meshlet::max_triangles - 1) / Core::Meshlet::max_triangles * 2);
+}
+
+TEST_CASE(meshlet, bounding_spheres_contain_their_vertices)
+{
+	const Core::MeshImport mesh = make_optimized_sphere();
+
+	uint32_t outside_count = 0;
+	for (const auto& meshlet : mesh.meshlets)
+	{
+		outside_count += is_in_bounding_sphere(mesh, meshlet) ? 0 : 1;
+	}
+	CHECK(outside_count == 0);
+}
+
+TEST_CASE(meshlet, cones_cull_meshlets_facing_away)
+{
+	Core::MeshImport mesh = Tests::make_grid(32);
+	Core::optimize_mesh(mesh);
+	Core::build_meshlets(mesh);
+	const auto meshlet_count = static_cast<uint32_t>(mesh.meshlets.size());
+	std::vector<uint32_t> visible_meshlets(meshlet_count);
+
+	// The grid faces +z, from below every meshlet faces away
+	const float up[3] = { 0.0f, 1.0f, 0.0f };
+	const float above[3] = { 0.5f, 0.5f, 2.0f };
+	const float down[3] = { 0.0f, 0.0f, -1.0f };
+	const float below[3] = { 0.5f, 0.5f, -2.0f };
+	const float forward[3] = { 0.0f, 0.0f, 1.0f };
+	const auto above_view = Core::make_meshlet_cull_view(above, down, up, 1.5f, 1.0f, 0.1f, 10.0f);
+	const auto below_view = Core::make_meshlet_cull_view(below, forward, up, 1.5f, 1.0f, 0.1f, 10.0f);
+
+	const auto above_stats = Core::cull_meshlets(mesh.meshlets.data(), meshlet_count, above_view, visible_meshlets.data());
+	CHECK(above_stats.visible_count == meshlet_count);
+
+	const auto below_stats = Core::cull_meshlets(mesh.meshlets.data(), meshlet_count, below_view, visible_meshlets.data());
+	CHECK(below_stats.cone_culled_count == meshlet_count);
+	CHECK(below_stats.visible_count == 0);
+}
+
+TEST_CASE(meshlet, frustum_culls_meshlets_out_of_view)
+{
+	const Core::MeshImport mesh = make_optimized_sphere();
+	const auto meshlet_count = static_cast<uint32_t>(mesh.meshlets.size());
+	std::vector<uint32_t> visible_meshlets(meshlet_count);
+
+	// Looking away from the sphere
+	const float position[3] = { 0.0f, 0.0f, 5.0f };
+	const float forward[3] = { 0.0f, 0.0f, 1.0f };
+	const float up[3] = { 0.0f, 1.0f, 0.0f };
+	const auto away_view = Core::make_meshlet_cull_view(position, forward, up, 1.0f, 1.0f, 0.1f, 100.0f);
+	const auto away_stats = Core::cull_meshlets(mesh.meshlets.data(), meshlet_count, away_view, visible_meshlets.data());
+	CHECK(away_stats.frustum_culled_count == meshlet_count);
+
+	// Looking at it only the near half can be visible, and the cones find most of the far half
+	const float backward[3] = { 0.0f, 0.0f, -1.0f };
+	const auto toward_view = Core::make_meshlet_cull_view(position, backward, up, 1.0f, 1.0f, 0.1f, 100.0f);
+	const auto toward_stats = Core::cull_meshlets(mesh.meshlets.data(), meshlet_count, toward_view, visible_meshlets.data());
+	CHECK(toward_stats.frustum_culled_count == 0);
+	CHECK(toward_stats.visible_count > 0);
+	CHECK(toward_stats.cone_culled_count > meshlet_count / 4);
+	for (uint32_t visible_idx = 0; visible_idx < toward_stats.visible_count; ++visible_idx)
+	{
+		CHECK(Core::is_meshlet_visible(mesh.meshlets[visible_meshlets[visible_idx]], toward_view));
+	}
+}
@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "core/bvh.hpp"
+#include "core/job_system.hpp"
+#include "core/occlusion_culling.hpp"
+#include "test.hpp"
+
+namespace
+{
+	constexpr float pi = 3.14159265358979f;
+	constexpr float vertical_fov = pi / 3.0f;
+	constexpr float aspect_ratio = 2.0f;
+	constexpr float near_z = 0.5f;
+	constexpr float far_z = 100.0f;
+
+	// A camera at the origin looking down +z, with y up
+	Core::Float4x4 make_view_projection()
+	{
+		const Core::Matrix view = Core::matrix_look_to_lh(
+			Core::vector_set(0.0f, 0.0f, 0.0f, 1.0f), Core::vector_set(0.0f, 0.0f, 1.0f, 0.0f), Core::vector_set(0.0f, 1.0f, 0.0f, 0.0f));
+		Core::Float4x4 view_projection;
+		Core::store(view_projection, Core::matrix_multiply(view, Core::matrix_perspective_fov_lh(vertical_fov, aspect_ratio, near_z, far_z)));
+		return view_projection;
+	}
+
+	Core::Float4x4 to_float4x4(const Core::Matrix& matrix)
+	{
+		Core::Float4x4 result;
+		Core::store(result, matrix);
+		return result;
+	}
+
+	// 20 x 10 around the z axis at z, clockwise seen from the camera
+	struct Wall
+	{
+		float half_width = 10.0f;
+		float half_height = 5.0f;
+		float z = 20.0f;
+
+		std::vector<Core::Float3> positions() const
+		{
+			return {
+				{ -half_width, half_height, z },
+				{ half_width, half_height, z },
+				{ half_width, -half_height, z },
+				{ -half_width, -half_height, z },
+			};
+		}
+
+		float depth() const
+		{
+			return far_z / (far_z - near_z) * (z - near_z) / z;
+		}
+	};
+
+	const uint32_t wall_indices[] = { 0, 1, 2, 0, 2, 3 };
+	const uint32_t back_facing_wall_indices[] = { 0, 2, 1, 0, 3, 2 };
+
+	void add_wall(Core::OcclusionBuffer& buffer, const Wall& wall, const uint32_t* indices = wall_indices, const Core::Matrix& world = Core::matrix_identity())
+	{
+		const auto positions = wall.positions();
+		buffer.add_occluder(to_float4x4(world), positions.data(), static_cast<uint32_t>(positions.size()), indices, 6);
+	}
+
+	// The depth a pixel center sees of the wall computed by ray casting, and whether it is
+	// too close to the wall's edges for rasterization rules to matter
+	struct ReferencePixel
+	{
+		float depth;
+		bool is_edge;
+	};
+
+	ReferencePixel reference_pixel(const Core::OcclusionBuffer& buffer, const Wall& wall, uint32_t x, uint32_t y)
+	{
+		const float ndc_x = (static_cast<float>(x) + 0.5f) / static_cast<float>(buffer.width()) * 2.0f - 1.0f;
+		const float ndc_y = 1.0f - (static_cast<float>(y) + 0.5f) / static_cast<float>(buffer.height()) * 2.0f;
+		const float tan_half_fov = std::tan(vertical_fov * 0.5f);
+		const float world_x = ndc_x * tan_half_fov * aspect_ratio * wall.z;
+		const float world_y = ndc_y * tan_half_fov * wall.z;
+
+		// One and a half pixels, in world units at the wall
+		const float edge_x = 1.5f * 2.0f / static_cast<float>(buffer.width()) * tan_half_fov * aspect_ratio * wall.z;
+		const float edge_y = 1.5f * 2.0f / static_cast<float>(buffer.height()) * tan_half_fov * wall.z;
+		const float distance_x = std::abs(std::abs(world_x) - wall.half_width);
+		const float distance_y = std::abs(std::abs(world_y) - wall.half_height);
+		const bool is_inside = std::abs(world_x) < wall.half_width && std::abs(world_y) < wall.half_height;
+		const bool is_edge = (distance_x < edge_x && std::abs(world_y) < wall.half_height + edge_y)
+			|| (distance_y < edge_y && std::abs(world_x) < wall.half_width + edge_x);
+		return { is_inside ? wall.depth() : 1.0f, is_edge };
+	}
+
+	// The same rectangle test as the buffer against a ray cast depth buffer, with the
+	// edge pixels either covered or not. Bounds reaching past the near plane are visible.
+	bool is_visible_reference(const Core::OcclusionBuffer& buffer, const Wall& wall, const Core::Aabb& bounds, bool are_edges_covered)
+	{
+		const Core::Matrix view_projection = Core::load(make_view_projection());
+		float min_x = INFINITY;
+		float max_x = -INFINITY;
+		float min_y = INFINITY;
+		float max_y = -INFINITY;
+		float min_depth = INFINITY;
+		for (uint32_t corner_idx = 0; corner_idx < 8; ++corner_idx)
+		{
+			Core::Float4 clip;
+			Core::store(clip, Core::vector_transform(Core::vector_set(
+				(corner_idx & 1) ? bounds.max.x : bounds.min.x,
+				(corner_idx & 2) ? bounds.max.y : bounds.min.y,
+				(corner_idx & 4) ? bounds.max.z : bounds.min.z,
+				1.0f), view_projection));
+			if (clip.z < 0.0f)
+			{
+				return true;
+			}
+			min_x = std::min(min_x, clip.x / clip.w);
+			max_x = std::max(max_x, clip.x / clip.w);
+			min_y = std::min(min_y, clip.y / clip.w);
+			max_y = std::max(max_y, clip.y / clip.w);
+			min_depth = std::min(min_depth, clip.z / clip.w);
+		}
+
+		// Every pixel the rectangle touches
+		const auto first_pixel = [](float coordinate, uint32_t size)
+		{
+			return static_cast<int32_t>(std::clamp(std::floor(coordinate), 0.0f, static_cast<float>(size)));
+		};
+		const auto end_pixel = [](float coordinate, uint32_t size)
+		{
+			return static_cast<int32_t>(std::clamp(std::floor(coordinate) + 1.0f, 0.0f, static_cast<float>(size)));
+		};
+		const float half_width = static_cast<float>(buffer.width()) * 0.5f;
+		const float half_height = static_cast<float>(buffer.height()) * 0.5f;
+		for (int32_t y = first_pixel((1.0f - max_y) * half_height, buffer.height()); y < end_pixel((1.0f - min_y) * half_height, buffer.height()); ++y)
+		{
+			for (int32_t x = first_pixel((min_x + 1.0f) * half_width, buffer.width()); x < end_pixel((max_x + 1.0f) * half_width, buffer.width()); ++x)
+			{
+				const ReferencePixel pixel = reference_pixel(buffer, wall, static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+				const float depth = pixel.is_edge ? (are_edges_covered ? wall.depth() : 1.0f) : pixel.depth;
+				if (depth >= min_depth)
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	Core::Aabb make_box(float x, float y, float z, float half_size)
+	{
+		return { { x - half_size, y - half_size, z - half_size }, { x + half_size, y + half_size, z + half_size } };
+	}
+}
+
+TEST_CASE(occlusion_culling, rasterizes_the_depth_of_occluders)
+{
+	Core::OcclusionBuffer buffer;
+	buffer.begin(make_view_projection());
+	const Wall wall;
+	add_wall(buffer, wall);
+	CHECK(buffer.stats().occluder_triangle_count == 2);
+	CHECK(buffer.stats().rasterized_triangle_count == 2);
+
+	uint32_t covered_count = 0;
+	for (uint32_t y = 0; y < buffer.height(); ++y)
+	{
+		for (uint32_t x = 0; x < buffer.width(); ++x)
+		{
+			const ReferencePixel pixel = reference_pixel(buffer, wall, x, y);
+			const float depth = buffer.depth()[y * buffer.width() + x];
+			if (!pixel.is_edge)
+			{
+				CHECK(std::abs(depth - pixel.depth) < 1e-4f);
+				covered_count += pixel.depth < 1.0f ? 1 : 0;
+			}
+		}
+	}
+	CHECK(covered_count > 1000);
+
+	// Moved there by its world matrix instead, the depth is the same
+	Core::OcclusionBuffer moved_buffer;
+	moved_buffer.begin(make_view_projection());
+	Wall local_wall;
+	local_wall.z = 5.0f;
+	add_wall(moved_buffer, local_wall, wall_indices, Core::matrix_translation(0.0f, 0.0f, wall.z - local_wall.z));
+	bool is_same_depth = true;
+	for (uint32_t pixel_idx = 0; pixel_idx < buffer.width() * buffer.height(); ++pixel_idx)
+	{
+		is_same_depth = is_same_depth && std::abs(buffer.depth()[pixel_idx] - moved_buffer.depth()[pixel_idx]) < 1e-4f;
+	}
+	CHECK(is_same_depth);
+}
+
+TEST_CASE(occlusion_culling, skips_back_faces_and_occluders_behind_the_camera)
+{
+	Core::OcclusionBuffer buffer;
+	buffer.begin(make_view_projection());
+	add_wall(buffer, Wall(), back_facing_wall_indices);
+	Wall wall_behind;
+	wall_behind.z = -20.0f;
+	add_wall(buffer, wall_behind);
+	CHECK(buffer.stats().occluder_triangle_count == 4);
+	CHECK(buffer.stats().rasterized_triangle_count == 0);
+	CHECK(std::all_of(buffer.depth(), buffer.depth() + buffer.width() * buffer.height(), [](float depth)
+	{
+		return depth == 1.0f;
+	}));
+	CHECK(buffer.is_visible(make_box(0.0f, 0.0f, 40.0f, 1.0f)));
+
+	// A floor crossing the near plane covers what is behind its visible part
+	Core::OcclusionBuffer near_buffer;
+	near_buffer.begin(make_view_projection());
+	const Core::Float3 floor_positions[] = { { -50.0f, -1.0f, -10.0f }, { -50.0f, -1.0f, 50.0f }, { 50.0f, -1.0f, 50.0f }, { 50.0f, -1.0f, -10.0f } };
+	const uint32_t floor_indices[] = { 0, 1, 2, 0, 2, 3 };
+	near_buffer.add_occluder(to_float4x4(Core::matrix_identity()), floor_positions, 4, floor_indices, 6);
+	CHECK(near_buffer.stats().rasterized_triangle_count > 0);
+	const Core::Aabb below_floor = { { -1.0f, -5.0f, 20.0f }, { 1.0f, -3.0f, 22.0f } };
+	const Core::Aabb above_floor = { { -1.0f, 0.0f, 20.0f }, { 1.0f, 2.0f, 22.0f } };
+	CHECK(!near_buffer.is_visible(below_floor));
+	CHECK(near_buffer.is_visible(above_floor));
+}
+
+TEST_CASE(occlusion_culling, culls_like_a_ray_cast_depth_buffer)
+{
+	Core::OcclusionBuffer buffer;
+	buffer.begin(make_view_projection());
+	const Wall wall;
+	add_wall(buffer, wall);
+
+	// In front of, behind and beside the wall, off screen and across the near plane
+	CHECK(buffer.is_visible(make_box(0.0f, 0.0f, 15.0f, 1.0f)));
+	CHECK(!buffer.is_visible(make_box(0.0f, 0.0f, 40.0f, 1.0f)));
+	CHECK(buffer.is_visible(make_box(25.0f, 0.0f, 40.0f, 3.0f)));
+	CHECK(!buffer.is_visible(make_box(0.0f, 200.0f, 40.0f, 1.0f)));
+	CHECK(buffer.is_visible(make_box(0.0f, 0.0f, 0.5f, 1.0f)));
+
+	std::mt19937 random(9);
+	std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> size(0.1f, 3.0f);
+	std::vector<Core::Aabb> bounds;
+	for (uint32_t box_idx = 0; box_idx < 5000; ++box_idx)
+	{
+		const float z = 1.0f + (coordinate(random) + 1.0f) * 40.0f;
+		bounds.push_back(make_box(coordinate(random) * z * 1.2f, coordinate(random) * z * 0.6f, z, size(random)));
+	}
+
+	uint32_t compared_count = 0;
+	uint32_t hidden_count = 0;
+	std::vector<uint32_t> expected_indices;
+	for (uint32_t box_idx = 0; box_idx < bounds.size(); ++box_idx)
+	{
+		const bool is_visible = buffer.is_visible(bounds[box_idx]);
+		expected_indices.insert(expected_indices.end(), is_visible ? 1 : 0, box_idx);
+
+		// Either way when only the wall's edges decide
+		const bool is_visible_uncovered = is_visible_reference(buffer, wall, bounds[box_idx], false);
+		if (is_visible_uncovered == is_visible_reference(buffer, wall, bounds[box_idx], true))
+		{
+			CHECK(is_visible == is_visible_uncovered);
+			++compared_count;
+			hidden_count += is_visible ? 0 : 1;
+		}
+	}
+	CHECK(compared_count > 4000);
+	CHECK(hidden_count > 100);
+
+	std::vector<uint32_t> visible_indices(bounds.size());
+	visible_indices.resize(buffer.cull(bounds.data(), static_cast<uint32_t>(bounds.size()), visible_indices.data()));
+	CHECK(visible_indices == expected_indices);
+}
+
+TEST_CASE(occlusion_culling, skips_hidden_bvh_nodes)
+{
+	Core::OcclusionBuffer buffer;
+	buffer.begin(make_view_projection());
+	add_wall(buffer, Wall());
+
+	std::vector<Core::Aabb> bounds;
+	for (uint32_t box_idx = 0; box_idx < 200; ++box_idx)
+	{
+		// Half hidden behind the wall, half to its right
+		const float x = box_idx % 2 == 0 ? static_cast<float>(box_idx % 10) - 5.0f : 28.0f + static_cast<float>(box_idx % 10) * 0.5f;
+		bounds.push_back(make_box(x, static_cast<float>(box_idx % 7) * 0.5f - 1.5f, 30.0f + static_cast<float>(box_idx) * 0.1f, 0.4f));
+	}
+	Core::JobSystem job_system(Core::JobSystemDesc{ 0 });
+	Core::Bvh bvh;
+	bvh.build(job_system, bounds.data(), static_cast<uint32_t>(bounds.size()));
+
+	// All in the frustum, so the BVH finds the same as testing every box against the buffer
+	const Core::Frustum frustum = Core::make_frustum(make_view_projection());
+	std::vector<uint32_t> visible_indices(bounds.size());
+	visible_indices.resize(bvh.cull(frustum, visible_indices.data(), &buffer));
+	std::sort(visible_indices.begin(), visible_indices.end());
+
+	std::vector<uint32_t> expected_indices;
+	for (uint32_t box_idx = 0; box_idx < bounds.size(); ++box_idx)
+	{
+		if (buffer.is_visible(bounds[box_idx]))
+		{
+			expected_indices.push_back(box_idx);
+		}
+	}
+	CHECK(visible_indices == expected_indices);
+	CHECK(visible_indices.size() == 100);
+}
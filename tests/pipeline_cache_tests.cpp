@@ -0,0 +1,201 @@
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <utility>
+
+#include "core/pipeline_cache.hpp"
+#include "test.hpp"
+
+namespace
+{
+	// Pipelines are ints holding the first byte of the vertex shader, an empty vertex
+	// shader fails. Compiles of a held version block until it is released.
+	class FakeCompiler : public Core::PipelineCompiler
+	{
+	public:
+		std::shared_ptr<void> compile(const Core::PipelineDesc& desc) override
+		{
+			const int version = desc.vertex_shader.empty() ? 0 : desc.vertex_shader[0];
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_condition.wait(lock, [this, &desc, version]
+				{
+					return m_held.count({ desc.name, version }) == 0;
+				});
+			}
+
+			if (version == 0)
+			{
+				return nullptr;
+			}
+			++m_live_object_count;
+			return std::shared_ptr<void>(new int(version), [this](void* object)
+			{
+				delete static_cast<int*>(object);
+				--m_live_object_count;
+			});
+		}
+
+		void hold(const std::string& name, int version)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_held.insert({ name, version });
+		}
+
+		void release(const std::string& name, int version)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_held.erase({ name, version });
+			}
+			m_condition.notify_all();
+		}
+
+		int live_object_count() const
+		{
+			return m_live_object_count.load();
+		}
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		std::set<std::pair<std::string, int>> m_held;
+		std::atomic<int> m_live_object_count{ 0 };
+	};
+
+	Core::PipelineDesc make_desc(const std::string& name, int version)
+	{
+		Core::PipelineDesc desc;
+		desc.name = name;
+		if (version != 0)
+		{
+			desc.vertex_shader.push_back(static_cast<unsigned char>(version));
+		}
+		return desc;
+	}
+
+	int version_of(void* pipeline)
+	{
+		return pipeline ? *static_cast<int*>(pipeline) : 0;
+	}
+
+	Core::JobSystemDesc two_workers()
+	{
+		// Enough for a held compile and one that finishes
+		Core::JobSystemDesc desc;
+		desc.worker_count = 2;
+		return desc;
+	}
+}
+
+TEST_CASE(pipeline_cache, resolves_the_fallback_while_compiling)
+{
+	Core::JobSystem job_system(two_workers());
+	FakeCompiler compiler;
+	Core::PipelineCache cache(job_system, compiler, 2);
+
+	const uint32_t fallback_id = cache.request(make_desc("Fallback", 1));
+	cache.wait_idle();
+	CHECK(cache.is_ready(fallback_id));
+
+	compiler.hold("Lit", 2);
+	const uint32_t pipeline_id = cache.request(make_desc("Lit", 2), fallback_id);
+	cache.begin_frame();
+
+	CHECK(!cache.is_ready(pipeline_id));
+	CHECK(version_of(cache.resolve(pipeline_id)) == 1);
+	CHECK(cache.counters().fallback_resolves == 1);
+	CHECK(cache.pending_compile_count() == 1);
+
+	compiler.release("Lit", 2);
+	cache.wait_idle();
+
+	CHECK(cache.is_ready(pipeline_id));
+	CHECK(version_of(cache.resolve(pipeline_id)) == 2);
+	CHECK(cache.pending_compile_count() == 0);
+	CHECK(cache.counters().ready_resolves == 1);
+}
+
+TEST_CASE(pipeline_cache, skips_draws_without_a_ready_pipeline)
+{
+	Core::JobSystem job_system(two_workers());
+	FakeCompiler compiler;
+	Core::PipelineCache cache(job_system, compiler, 2);
+
+	compiler.hold("Lit", 1);
+	const uint32_t pipeline_id = cache.request(make_desc("Lit", 1));
+	cache.begin_frame();
+
+	CHECK(cache.resolve(pipeline_id) == nullptr);
+	CHECK(cache.counters().skipped_resolves == 1);
+
+	compiler.release("Lit", 1);
+	cache.wait_idle();
+}
+
+TEST_CASE(pipeline_cache, drops_results_of_a_stale_generation)
+{
+	Core::JobSystem job_system(two_workers());
+	FakeCompiler compiler;
+	Core::PipelineCache cache(job_system, compiler, 2);
+
+	// The first version finishes after the recompile that replaced it
+	compiler.hold("Lit", 1);
+	const uint32_t pipeline_id = cache.request(make_desc("Lit", 1));
+	cache.recompile(pipeline_id, make_desc("Lit", 2));
+	CHECK(Tests::wait_until([&cache, pipeline_id]
+	{
+		cache.begin_frame();
+		return cache.is_ready(pipeline_id);
+	}));
+	CHECK(version_of(cache.resolve(pipeline_id)) == 2);
+
+	compiler.release("Lit", 1);
+	cache.wait_idle();
+
+	CHECK(version_of(cache.resolve(pipeline_id)) == 2);
+	CHECK(cache.stats(pipeline_id).compile_count == 2);
+	CHECK(cache.pending_compile_count() == 0);
+	// The stale object is released along with its result
+	CHECK(compiler.live_object_count() == 1);
+}
+
+TEST_CASE(pipeline_cache, keeps_the_previous_pipeline_when_a_recompile_fails)
+{
+	Core::JobSystem job_system(two_workers());
+	FakeCompiler compiler;
+	Core::PipelineCache cache(job_system, compiler, 2);
+
+	const uint32_t pipeline_id = cache.request(make_desc("Lit", 1));
+	cache.wait_idle();
+	cache.recompile(pipeline_id, make_desc("Lit", 0));
+	cache.wait_idle();
+
+	CHECK(cache.is_failed(pipeline_id));
+	CHECK(version_of(cache.resolve(pipeline_id)) == 1);
+	CHECK(cache.stats(pipeline_id).failed_compile_count == 1);
+}
+
+TEST_CASE(pipeline_cache, retires_replaced_pipelines_after_the_frames_in_flight)
+{
+	constexpr uint32_t frames_in_flight = 2;
+
+	Core::JobSystem job_system(two_workers());
+	FakeCompiler compiler;
+	Core::PipelineCache cache(job_system, compiler, frames_in_flight);
+
+	const uint32_t pipeline_id = cache.request(make_desc("Lit", 1));
+	cache.wait_idle();
+	cache.recompile(pipeline_id, make_desc("Lit", 2));
+	cache.wait_idle();
+
+	// The GPU may still be drawing with version 1 for frames_in_flight frames
+	CHECK(version_of(cache.resolve(pipeline_id)) == 2);
+	for (uint32_t frame_idx = 0; frame_idx < frames_in_flight; ++frame_idx)
+	{
+		cache.begin_frame();
+		CHECK(compiler.live_object_count() == 2);
+	}
+	cache.begin_frame();
+	CHECK(compiler.live_object_count() == 1);
+}
@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/profiler.hpp"
+#include "test.hpp"
+
+namespace
+{
+	uint32_t count_events(const std::vector<Core::ProfileEvent>& events, const char* name)
+	{
+		return static_cast<uint32_t>(std::count_if(events.begin(), events.end(), [name](const Core::ProfileEvent& event)
+		{
+			return std::string(event.name) == name;
+		}));
+	}
+}
+
+TEST_CASE(profiler, keeps_the_events_of_exited_threads)
+{
+	Core::Profiler::clear();
+
+	// One after another, so every thread after the first can take over a ring buffer
+	for (uint32_t thread_idx = 0; thread_idx < 8; ++thread_idx)
+	{
+		std::thread thread([thread_idx]()
+		{
+			Core::Profiler::set_thread_name("Exited");
+			for (uint32_t event_idx = 0; event_idx <= thread_idx; ++event_idx)
+			{
+				Core::Profiler::record("exited thread event", event_idx, event_idx + 1);
+			}
+		});
+		thread.join();
+	}
+	// A thread that outlives its first ring buffer keeps only the newest events
+	std::thread thread([]()
+	{
+		for (uint32_t event_idx = 0; event_idx < Core::Profiler::ring_buffer_capacity + 10; ++event_idx)
+		{
+			Core::Profiler::record(event_idx < 10 ? "overwritten event" : "kept event", event_idx, event_idx + 1);
+		}
+	});
+	thread.join();
+	Core::Profiler::record("running thread event", 0, 1);
+
+	std::vector<Core::ProfileEvent> events = Core::Profiler::collect();
+	CHECK(count_events(events, "exited thread event") == 36);
+	CHECK(count_events(events, "overwritten event") == 0);
+	CHECK(count_events(events, "kept event") == Core::Profiler::ring_buffer_capacity);
+	CHECK(count_events(events, "running thread event") == 1);
+
+	// Oldest first within every thread
+	bool is_ordered = true;
+	const Core::ProfileEvent* previous = nullptr;
+	for (const Core::ProfileEvent& event : events)
+	{
+		if (std::string(event.name) != "exited thread event" && std::string(event.name) != "kept event")
+		{
+			continue;
+		}
+		if (previous && previous->track == event.track)
+		{
+			is_ordered = is_ordered && event.begin_ns > previous->begin_ns;
+		}
+		previous = &event;
+	}
+	CHECK(is_ordered);
+
+	Core::Profiler::clear();
+	events = Core::Profiler::collect();
+	CHECK(count_events(events, "exited thread event") == 0);
+	CHECK(count_events(events, "kept event") == 0);
+}
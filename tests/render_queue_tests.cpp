@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "core/job_system.hpp"
+#include "core/render_backend.hpp"
+#include "core/render_queue.hpp"
+#include "test.hpp"
+
+namespace
+{
+	// Records the state every draw was made with
+	class RecordingBackend : public Core::RenderBackend
+	{
+	public:
+		struct Draw
+		{
+			uint32_t pipeline;
+			uint32_t material;
+			uint32_t first_vertex;
+		};
+
+		const char* name() const override
+		{
+			return "Recording";
+		}
+
+		const Core::GpuProfiler* gpu_profiler() const override
+		{
+			return nullptr;
+		}
+
+		void begin_frame() override {}
+		void clear(const float /*color*/[4]) override {}
+
+		void set_pipeline(uint32_t pipeline_idx) override
+		{
+			m_pipeline = pipeline_idx;
+			++pipeline_change_count;
+		}
+
+		void set_material(uint32_t material_idx) override
+		{
+			m_material = material_idx;
+			++material_change_count;
+		}
+
+		void draw(uint32_t /*vertex_count*/, uint32_t first_vertex) override
+		{
+			draws.push_back({ m_pipeline, m_material, first_vertex });
+		}
+
+		void end_frame() override {}
+		void present() override {}
+
+		std::vector<Draw> draws;
+		uint32_t pipeline_change_count = 0;
+		uint32_t material_change_count = 0;
+	private:
+		uint32_t m_pipeline = UINT32_MAX;
+		uint32_t m_material = UINT32_MAX;
+	};
+
+	enum class KeyKind
+	{
+		Random,
+		// Only a few bits differ, most digits are skipped
+		Scene,
+		Equal,
+	};
+
+	// The draw index goes into first_vertex, so the sorted order can be checked against std::stable_sort
+	void fill_queue(Core::RenderQueue& render_queue, uint32_t draw_count, KeyKind key_kind, std::vector<std::pair<uint64_t, uint32_t>>& reference)
+	{
+		std::mt19937_64 random(50);
+		for (uint32_t draw_idx = 0; draw_idx < draw_count; ++draw_idx)
+		{
+			const uint32_t pipeline = draw_idx % 7;
+			const uint32_t material = draw_idx % 5;
+			uint64_t sort_key = 42;
+			if (key_kind == KeyKind::Random)
+			{
+				sort_key = random();
+			}
+			else if (key_kind == KeyKind::Scene)
+			{
+				sort_key = Core::make_sort_key(0, draw_idx % 2, pipeline, material, static_cast<float>(random() % 1000) / 1000.0f);
+			}
+			render_queue.add(sort_key, { pipeline, material, 3, draw_idx });
+			reference.push_back({ sort_key, draw_idx });
+		}
+		std::stable_sort(reference.begin(), reference.end(), [](const auto& left, const auto& right)
+		{
+			return left.first < right.first;
+		});
+	}
+
+	bool matches(const Core::RenderQueue& render_queue, const std::vector<std::pair<uint64_t, uint32_t>>& reference)
+	{
+		if (render_queue.size() != reference.size())
+		{
+			return false;
+		}
+		for (uint32_t position = 0; position < render_queue.size(); ++position)
+		{
+			const Core::DrawItem& item = render_queue.item(position);
+			const uint32_t draw_idx = reference[position].second;
+			if (render_queue.sort_key(position) != reference[position].first
+				|| item.first_vertex != draw_idx || item.pipeline != draw_idx % 7 || item.material != draw_idx % 5)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+TEST_CASE(render_queue, sort_keys_order_the_fields)
+{
+	const uint32_t max_pipeline = (1U << Core::sort_key_pipeline_bits) - 1;
+	const uint32_t max_material = (1U << Core::sort_key_material_bits) - 1;
+
+	CHECK(Core::make_sort_key(0, 0, 0, 0, 0.1f) < Core::make_sort_key(0, 0, 0, 0, 0.2f));
+	CHECK(Core::make_sort_key(0, 0, 0, 1, 0.0f) > Core::make_sort_key(0, 0, 0, 0, 1.0f));
+	CHECK(Core::make_sort_key(0, 0, 1, 0, 0.0f) > Core::make_sort_key(0, 0, 0, max_material, 1.0f));
+	CHECK(Core::make_sort_key(0, 1, 0, 0, 0.0f) > Core::make_sort_key(0, 0, max_pipeline, max_material, 1.0f));
+	CHECK(Core::make_sort_key(1, 0, 0, 0, 0.0f) > Core::make_sort_key(0, 15, max_pipeline, max_material, 1.0f));
+
+	// Depth is clamped
+	CHECK(Core::make_sort_key(0, 0, 0, 0, -1.0f) == Core::make_sort_key(0, 0, 0, 0, 0.0f));
+	CHECK(Core::make_sort_key(0, 0, 0, 0, 2.0f) == Core::make_sort_key(0, 0, 0, 0, 1.0f));
+
+	// Blended passes go back to front before anything else
+	CHECK(Core::make_blended_sort_key(0, 2, 5, 5, 0.9f) < Core::make_blended_sort_key(0, 2, 0, 0, 0.1f));
+	CHECK(Core::make_blended_sort_key(0, 2, 0, 1, 0.5f) > Core::make_blended_sort_key(0, 2, 0, 0, 0.5f));
+}
+
+TEST_CASE(render_queue, sort_is_stable_and_matches_std_stable_sort)
+{
+	Core::JobSystem job_system;
+
+	uint32_t mismatch_count = 0;
+	// Up to past the threshold where sorting goes parallel
+	for (const uint32_t draw_count : { 0U, 1U, 2U, 100U, 65535U, 65536U, 200001U })
+	{
+		for (const KeyKind key_kind : { KeyKind::Random, KeyKind::Scene, KeyKind::Equal })
+		{
+			for (const bool is_parallel : { false, true })
+			{
+				Core::RenderQueue render_queue;
+				std::vector<std::pair<uint64_t, uint32_t>> reference;
+				fill_queue(render_queue, draw_count, key_kind, reference);
+				if (is_parallel)
+				{
+					render_queue.sort(job_system);
+				}
+				else
+				{
+					render_queue.sort();
+				}
+				mismatch_count += matches(render_queue, reference) ? 0 : 1;
+			}
+		}
+	}
+	CHECK(mismatch_count == 0);
+}
+
+TEST_CASE(render_queue, sorts_again_after_more_draws_and_after_clear)
+{
+	Core::RenderQueue render_queue;
+	render_queue.add(5, { 0, 0, 3, 0 });
+	render_queue.add(3, { 0, 0, 3, 1 });
+	render_queue.sort();
+	render_queue.add(4, { 0, 0, 3, 2 });
+	render_queue.sort();
+
+	CHECK(render_queue.size() == 3);
+	CHECK(render_queue.item(0).first_vertex == 1);
+	CHECK(render_queue.item(1).first_vertex == 2);
+	CHECK(render_queue.item(2).first_vertex == 0);
+
+	render_queue.clear();
+	CHECK(render_queue.size() == 0);
+	render_queue.add(9, { 0, 0, 3, 3 });
+	render_queue.add(9, { 0, 0, 3, 4 });
+	render_queue.sort();
+	CHECK(render_queue.item(0).first_vertex == 3 && render_queue.item(1).first_vertex == 4);
+}
+
+TEST_CASE(render_queue, submit_sets_state_only_when_it_changes)
+{
+	Core::RenderQueue render_queue;
+	std::vector<std::pair<uint64_t, uint32_t>> reference;
+	fill_queue(render_queue, 1000, KeyKind::Scene, reference);
+
+	// In the order added every draw changes both
+	RecordingBackend unsorted_backend;
+	const Core::RenderQueueStats unsorted_stats = render_queue.submit(unsorted_backend);
+	CHECK(unsorted_stats.draw_count == 1000);
+	CHECK(unsorted_stats.pipeline_change_count == 1000);
+	CHECK(unsorted_backend.draws.front().first_vertex == 0 && unsorted_backend.draws.back().first_vertex == 999);
+
+	render_queue.sort();
+	RecordingBackend backend;
+	const Core::RenderQueueStats stats = render_queue.submit(backend);
+
+	CHECK(stats.draw_count == 1000);
+	CHECK(stats.pipeline_change_count == backend.pipeline_change_count);
+	CHECK(stats.material_change_count == backend.material_change_count);
+	// Two passes of seven pipelines, and the materials within them
+	CHECK(stats.pipeline_change_count == 14);
+	CHECK(stats.material_change_count <= 14 * 5);
+
+	bool is_drawn_with_its_state = backend.draws.size() == 1000;
+	for (uint32_t position = 0; is_drawn_with_its_state && position < 1000; ++position)
+	{
+		const Core::DrawItem& item = render_queue.item(position);
+		const RecordingBackend::Draw& draw = backend.draws[position];
+		is_drawn_with_its_state = draw.first_vertex == item.first_vertex && draw.pipeline == item.pipeline && draw.material == item.material;
+	}
+	CHECK(is_drawn_with_its_state);
+}
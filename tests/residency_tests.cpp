@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <vector>
+
+#include "core/residency.hpp"
+#include "test.hpp"
+
+namespace
+{
+	// Objects are indices into its allocations, the usage is their resident size plus
+	// whatever other applications are made to use
+	class FakeResidencyBackend : public Core::ResidencyBackend
+	{
+	public:
+		Core::MemoryBudget query_budget() override
+		{
+			uint64_t usage_bytes = other_usage_bytes;
+			for (size_t allocation_idx = 0; allocation_idx < m_sizes.size(); ++allocation_idx)
+			{
+				usage_bytes += m_is_resident[allocation_idx] ? m_sizes[allocation_idx] : 0;
+			}
+			return { budget_bytes, usage_bytes };
+		}
+
+		void evict(void* const* objects, uint32_t count) override
+		{
+			for (uint32_t object_idx = 0; object_idx < count; ++object_idx)
+			{
+				const size_t allocation_idx = index_of(objects[object_idx]);
+				m_is_resident[allocation_idx] = false;
+				evicted.push_back(allocation_idx);
+			}
+		}
+
+		bool make_resident(void* const* objects, uint32_t count) override
+		{
+			for (uint32_t object_idx = 0; object_idx < count; ++object_idx)
+			{
+				m_is_resident[index_of(objects[object_idx])] = true;
+			}
+			return true;
+		}
+
+		void* create(uint64_t size)
+		{
+			m_sizes.push_back(size);
+			m_is_resident.push_back(true);
+			return object_of(m_sizes.size() - 1);
+		}
+
+		static void* object_of(size_t allocation_idx)
+		{
+			// Never null
+			return reinterpret_cast<void*>(allocation_idx + 1);
+		}
+
+		static size_t index_of(void* object)
+		{
+			return reinterpret_cast<size_t>(object) - 1;
+		}
+
+		uint64_t budget_bytes = 1000;
+		uint64_t other_usage_bytes = 0;
+		std::vector<size_t> evicted;
+	private:
+		std::vector<uint64_t> m_sizes;
+		std::vector<bool> m_is_resident;
+	};
+
+	// count allocations of size bytes, allocation N used by the submission signalling fence N + 1
+	std::vector<uint32_t> track_allocations(Core::ResidencyManager& manager, FakeResidencyBackend& backend, uint32_t count, uint64_t size)
+	{
+		std::vector<uint32_t> allocation_ids;
+		for (uint32_t allocation_idx = 0; allocation_idx < count; ++allocation_idx)
+		{
+			allocation_ids.push_back(manager.track(backend.create(size), size));
+			manager.use(allocation_ids.back(), allocation_idx + 1);
+		}
+		return allocation_ids;
+	}
+}
+
+TEST_CASE(residency, evicts_the_least_recently_used_first)
+{
+	FakeResidencyBackend backend;
+	Core::ResidencyManager manager(backend);
+	const auto allocation_ids = track_allocations(manager, backend, 10, 100);
+
+	// Allocation 0 is the most recently used now
+	manager.use(allocation_ids[0], 11);
+	backend.other_usage_bytes = 50;
+	manager.update(11);
+
+	// 1050 bytes used, down to 850 takes two
+	CHECK(backend.evicted == std::vector<size_t>({ 1, 2 }));
+	CHECK(manager.is_resident(allocation_ids[0]));
+	CHECK(!manager.is_resident(allocation_ids[1]));
+	CHECK(manager.resident_bytes() == 800);
+	CHECK(manager.counters().evicted_bytes == 200);
+}
+
+TEST_CASE(residency, evicts_between_the_threshold_and_the_target_only)
+{
+	FakeResidencyBackend backend;
+	Core::ResidencyManager manager(backend);
+	track_allocations(manager, backend, 9, 100);
+
+	// 940 of 1000 is under the 95% threshold
+	backend.other_usage_bytes = 40;
+	manager.update(9);
+	CHECK(backend.evicted.empty());
+	CHECK(manager.counters().over_budget_updates == 0);
+
+	// 960 is over it, evicting goes on down to the 85% target, not just under the threshold
+	backend.other_usage_bytes = 60;
+	manager.update(9);
+	CHECK(backend.evicted.size() == 2);
+	CHECK(manager.budget().usage_bytes == 760);
+
+	// Growing back up to the threshold evicts nothing
+	backend.other_usage_bytes = 250;
+	manager.update(9);
+	CHECK(backend.evicted.size() == 2);
+	CHECK(manager.counters().over_budget_updates == 1);
+	CHECK(manager.counters().stalled_evictions == 0);
+}
+
+TEST_CASE(residency, evicts_only_what_the_gpu_finished_with)
+{
+	FakeResidencyBackend backend;
+	Core::ResidencyManager manager(backend);
+	const auto allocation_ids = track_allocations(manager, backend, 10, 100);
+
+	// Way over budget, but the GPU only finished the first three submissions
+	backend.budget_bytes = 500;
+	manager.update(3);
+
+	CHECK(backend.evicted == std::vector<size_t>({ 0, 1, 2 }));
+	CHECK(manager.is_resident(allocation_ids[3]));
+	CHECK(manager.counters().stalled_evictions == 1);
+
+	manager.update(5);
+	CHECK(backend.evicted == std::vector<size_t>({ 0, 1, 2, 3, 4 }));
+	CHECK(manager.counters().stalled_evictions == 2);
+}
+
+TEST_CASE(residency, keeps_allocations_until_their_copies_finished)
+{
+	FakeResidencyBackend backend;
+	Core::ResidencyManager manager(backend);
+	// The direct queue finished with all of them, the copy queue still writes allocation 1
+	std::vector<uint32_t> allocation_ids;
+	for (uint32_t allocation_idx = 0; allocation_idx < 10; ++allocation_idx)
+	{
+		allocation_ids.push_back(manager.track(backend.create(100), 100));
+		if (allocation_idx == 1)
+		{
+			manager.use(allocation_ids.back(), allocation_idx + 1, 7);
+		}
+		else
+		{
+			manager.use(allocation_ids.back(), allocation_idx + 1);
+		}
+	}
+
+	backend.budget_bytes = 800;
+	manager.update(10, 6);
+
+	// Down to 680 takes four, skipping the one being copied to
+	CHECK(backend.evicted == std::vector<size_t>({ 0, 2, 3, 4 }));
+	CHECK(manager.is_resident(allocation_ids[1]));
+
+	// Evicted first once the copy queue passed it
+	backend.evicted.clear();
+	backend.budget_bytes = 600;
+	manager.update(10, 7);
+	CHECK(backend.evicted == std::vector<size_t>({ 1 }));
+}
+
+TEST_CASE(residency, makes_evicted_allocations_resident_before_use)
+{
+	FakeResidencyBackend backend;
+	Core::ResidencyManager manager(backend);
+	const auto allocation_ids = track_allocations(manager, backend, 10, 100);
+
+	backend.other_usage_bytes = 100;
+	manager.update(10);
+	CHECK(!manager.is_resident(allocation_ids[0]));
+
+	manager.use(allocation_ids[0], 11);
+	manager.use(allocation_ids[0], 12);
+	CHECK(!manager.is_resident(allocation_ids[0]));
+	CHECK(manager.make_resident());
+	CHECK(manager.is_resident(allocation_ids[0]));
+	CHECK(manager.counters().make_residents == 1);
+
+	// Back at the end of the LRU order
+	backend.evicted.clear();
+	backend.other_usage_bytes = 300;
+	manager.update(12);
+	CHECK(std::find(backend.evicted.begin(), backend.evicted.end(), 0) == backend.evicted.end());
+}
+
+TEST_CASE(residency, reuses_untracked_allocation_ids)
+{
+	FakeResidencyBackend backend;
+	Core::ResidencyManager manager(backend);
+	const auto allocation_ids = track_allocations(manager, backend, 3, 100);
+
+	manager.untrack(allocation_ids[1]);
+	CHECK(manager.allocation_count() == 2);
+	CHECK(manager.resident_bytes() == 200);
+
+	const uint32_t allocation_id = manager.track(backend.create(50), 50);
+	CHECK(allocation_id == allocation_ids[1]);
+	CHECK(manager.resident_bytes() == 250);
+}
@@ -0,0 +1,162 @@
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "core/shader_hot_reload.hpp"
+#include "test.hpp"
+
+namespace
+{
+	void write_file(const std::filesystem::path& path, const std::string& text)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << text;
+	}
+
+	// The bytecode is the source, which fails to compile when it says "error"
+	bool fake_compile(const std::string& path, const Core::ShaderSource& source, std::vector<unsigned char>& bytecode, std::string& errors)
+	{
+		std::ifstream file(path, std::ios::binary);
+		const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if (text.find("error") != std::string::npos)
+		{
+			errors = source.file_name + ": error";
+			return false;
+		}
+		bytecode.assign(text.begin(), text.end());
+		return true;
+	}
+
+	std::string to_string(const std::vector<unsigned char>& bytecode)
+	{
+		return std::string(bytecode.begin(), bytecode.end());
+	}
+
+	// Writes the sources before the watcher starts, so they do not count as changes
+	const std::filesystem::path& write_sources(const std::filesystem::path& directory)
+	{
+		write_file(directory / "main.vert.hlsl", "vertex");
+		write_file(directory / "main.pix.hlsl", "pixel");
+		return directory;
+	}
+
+	struct HotReloadFixture
+	{
+		HotReloadFixture() :
+			hot_reload(write_sources(directory.path()).string(), fake_compile)
+		{
+			vertex_shader_id = hot_reload.add_shader({ "main.vert.hlsl", "vs_6_0", "main", {} });
+			pixel_shader_id = hot_reload.add_shader({ "main.pix.hlsl", "ps_6_0", "main", {} });
+			// Changes before the watcher exists go unnoticed
+			CHECK(Tests::wait_until([this] { return hot_reload.is_watching(); }));
+		}
+
+		bool wait_for_compiles(uint64_t count)
+		{
+			return Tests::wait_until([this, count] { return hot_reload.compile_count() >= count; });
+		}
+
+		Tests::TemporaryDirectory directory;
+		Core::ShaderHotReload hot_reload;
+		uint32_t vertex_shader_id = 0;
+		uint32_t pixel_shader_id = 0;
+	};
+}
+
+TEST_CASE(shader_hot_reload, recompiles_a_changed_shader)
+{
+	HotReloadFixture fixture;
+
+	write_file(fixture.directory.path() / "main.pix.hlsl", "pixel 2");
+	CHECK(fixture.wait_for_compiles(1));
+
+	const auto reloads = fixture.hot_reload.take_reloads();
+	CHECK(reloads.size() == 1);
+	if (reloads.size() == 1)
+	{
+		CHECK(reloads[0].shader_id == fixture.pixel_shader_id);
+		CHECK(reloads[0].is_compiled);
+		CHECK(to_string(reloads[0].bytecode) == "pixel 2");
+	}
+	CHECK(fixture.hot_reload.take_reloads().empty());
+}
+
+TEST_CASE(shader_hot_reload, recompiles_every_shader_when_an_include_changes)
+{
+	HotReloadFixture fixture;
+
+	write_file(fixture.directory.path() / "common.hlsli", "shared");
+	CHECK(fixture.wait_for_compiles(2));
+
+	const auto reloads = fixture.hot_reload.take_reloads();
+	CHECK(reloads.size() == 2);
+	if (reloads.size() == 2)
+	{
+		CHECK(reloads[0].shader_id == fixture.vertex_shader_id);
+		CHECK(reloads[1].shader_id == fixture.pixel_shader_id);
+	}
+}
+
+TEST_CASE(shader_hot_reload, keeps_a_pending_success_when_a_later_compile_fails)
+{
+	HotReloadFixture fixture;
+
+	write_file(fixture.directory.path() / "main.vert.hlsl", "vertex 2");
+	CHECK(fixture.wait_for_compiles(1));
+	write_file(fixture.directory.path() / "main.vert.hlsl", "vertex error");
+	CHECK(fixture.wait_for_compiles(2));
+
+	const auto reloads = fixture.hot_reload.take_reloads();
+	CHECK(reloads.size() == 2);
+	if (reloads.size() == 2)
+	{
+		CHECK(reloads[0].shader_id == fixture.vertex_shader_id && reloads[0].is_compiled);
+		CHECK(to_string(reloads[0].bytecode) == "vertex 2");
+		CHECK(reloads[1].shader_id == fixture.vertex_shader_id && !reloads[1].is_compiled);
+		CHECK(reloads[1].errors == "main.vert.hlsl: error");
+	}
+	CHECK(fixture.hot_reload.failed_compile_count() == 1);
+}
+
+TEST_CASE(shader_hot_reload, drops_a_pending_failure_after_a_success)
+{
+	HotReloadFixture fixture;
+
+	write_file(fixture.directory.path() / "main.vert.hlsl", "vertex error");
+	CHECK(fixture.wait_for_compiles(1));
+	write_file(fixture.directory.path() / "main.vert.hlsl", "vertex 2");
+	CHECK(fixture.wait_for_compiles(2));
+	write_file(fixture.directory.path() / "main.vert.hlsl", "vertex 3");
+	CHECK(fixture.wait_for_compiles(3));
+
+	const auto reloads = fixture.hot_reload.take_reloads();
+	CHECK(reloads.size() == 1);
+	if (reloads.size() == 1)
+	{
+		CHECK(reloads[0].is_compiled);
+		CHECK(to_string(reloads[0].bytecode) == "vertex 3");
+	}
+}
+
+TEST_CASE(shader_hot_reload, compiles_once_for_a_burst_of_saves)
+{
+	HotReloadFixture fixture;
+
+	for (int write_idx = 0; write_idx < 5; ++write_idx)
+	{
+		write_file(fixture.directory.path() / "main.pix.hlsl", "pixel " + std::to_string(write_idx));
+	}
+	CHECK(fixture.wait_for_compiles(1));
+
+	// A few more polls to catch a second compile
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	CHECK(fixture.hot_reload.compile_count() == 1);
+
+	const auto reloads = fixture.hot_reload.take_reloads();
+	CHECK(reloads.size() == 1);
+	if (reloads.size() == 1)
+	{
+		CHECK(to_string(reloads[0].bytecode) == "pixel 4");
+	}
+}
@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "core/simd_math.hpp"
+#include "test.hpp"
+
+namespace
+{
+	constexpr float pi = 3.14159265358979f;
+
+	Core::Float4 to_float4(Core::Vector value)
+	{
+		Core::Float4 result;
+		Core::store(result, value);
+		return result;
+	}
+
+	bool near(float a, float b, float tolerance = 1e-5f)
+	{
+		return std::abs(a - b) <= tolerance * std::max(1.0f, std::abs(b));
+	}
+
+	bool near(Core::Vector value, const Core::Float4& expected, float tolerance = 1e-5f)
+	{
+		const Core::Float4 lanes = to_float4(value);
+		return near(lanes.x, expected.x, tolerance) && near(lanes.y, expected.y, tolerance)
+			&& near(lanes.z, expected.z, tolerance) && near(lanes.w, expected.w, tolerance);
+	}
+
+	bool near(const Core::Matrix& matrix, const Core::Float4x4& expected, float tolerance = 1e-5f)
+	{
+		for (uint32_t row_idx = 0; row_idx < 4; ++row_idx)
+		{
+			if (!near(matrix.rows[row_idx], expected.rows[row_idx], tolerance))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	float element(const Core::Float4x4& matrix, uint32_t row_idx, uint32_t column_idx)
+	{
+		return (&matrix.rows[row_idx].x)[column_idx];
+	}
+
+	Core::Float4x4 to_float4x4(const Core::Matrix& matrix)
+	{
+		Core::Float4x4 result;
+		Core::store(result, matrix);
+		return result;
+	}
+
+	// The textbook row vector times matrix products everything is compared against
+	Core::Float4 reference_transform(const Core::Float4& value, const Core::Float4x4& matrix)
+	{
+		const float lanes[4] = { value.x, value.y, value.z, value.w };
+		float result[4] = {};
+		for (uint32_t column_idx = 0; column_idx < 4; ++column_idx)
+		{
+			for (uint32_t row_idx = 0; row_idx < 4; ++row_idx)
+			{
+				result[column_idx] += lanes[row_idx] * element(matrix, row_idx, column_idx);
+			}
+		}
+		return { result[0], result[1], result[2], result[3] };
+	}
+
+	Core::Float4x4 reference_multiply(const Core::Float4x4& a, const Core::Float4x4& b)
+	{
+		Core::Float4x4 result;
+		for (uint32_t row_idx = 0; row_idx < 4; ++row_idx)
+		{
+			result.rows[row_idx] = reference_transform(a.rows[row_idx], b);
+		}
+		return result;
+	}
+
+	class RandomValues
+	{
+	public:
+		float next(float min = -4.0f, float max = 4.0f)
+		{
+			return std::uniform_real_distribution<float>(min, max)(m_random);
+		}
+
+		Core::Float4 next_float4()
+		{
+			return { next(), next(), next(), next() };
+		}
+
+		Core::Float4x4 next_float4x4()
+		{
+			return { { next_float4(), next_float4(), next_float4(), next_float4() } };
+		}
+
+		Core::Vector next_rotation()
+		{
+			const Core::Vector axis = Core::normalize3(Core::vector_set(next(), next(), next(), 0.0f));
+			return Core::quaternion_rotation_axis(axis, next(-pi, pi));
+		}
+	private:
+		std::mt19937 m_random{ 11 };
+	};
+}
+
+TEST_CASE(simd_math, computes_lane_wise_like_scalar_code)
+{
+	RandomValues random;
+	for (uint32_t iteration = 0; iteration < 100; ++iteration)
+	{
+		const Core::Float4 a = random.next_float4();
+		Core::Float4 b = random.next_float4();
+		b.w = b.w == 0.0f ? 1.0f : b.w;
+		const Core::Vector va = Core::load(a);
+		const Core::Vector vb = Core::load(b);
+
+		CHECK(near(Core::vector_add(va, vb), { a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w }));
+		CHECK(near(Core::vector_subtract(va, vb), { a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w }));
+		CHECK(near(Core::vector_multiply(va, vb), { a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w }));
+		CHECK(near(Core::vector_divide(va, vb), { a.x / b.x, a.y / b.y, a.z / b.z, a.w / b.w }));
+		CHECK(near(Core::vector_min(va, vb), { std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z), std::min(a.w, b.w) }));
+		CHECK(near(Core::vector_max(va, vb), { std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z), std::max(a.w, b.w) }));
+		CHECK(near(Core::vector_negate(va), { -a.x, -a.y, -a.z, -a.w }));
+		CHECK(near(Core::swizzle<3, 0, 2, 1>(va), { a.w, a.x, a.z, a.y }));
+		CHECK(near(Core::splat_lane<2>(va), { a.z, a.z, a.z, a.z }));
+		CHECK(Core::get_lane<1>(va) == a.y);
+
+		CHECK(near(Core::dot3(va, vb), a.x * b.x + a.y * b.y + a.z * b.z, 1e-4f));
+		CHECK(near(Core::dot4(va, vb), a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w, 1e-4f));
+		CHECK(near(Core::cross3(va, vb), { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x, 0.0f }, 1e-4f));
+		CHECK(near(Core::length3(va), std::sqrt(a.x * a.x + a.y * a.y + a.z * a.z)));
+		CHECK(near(Core::length3(Core::normalize3(va)), 1.0f));
+	}
+
+	CHECK(near(Core::normalize3(Core::vector_zero()), { 0.0f, 0.0f, 0.0f, 0.0f }));
+}
+
+TEST_CASE(simd_math, multiplies_and_inverts_matrices)
+{
+	RandomValues random;
+	for (uint32_t iteration = 0; iteration < 100; ++iteration)
+	{
+		const Core::Float4x4 a = random.next_float4x4();
+		const Core::Float4x4 b = random.next_float4x4();
+		const Core::Float4 value = random.next_float4();
+
+		CHECK(near(Core::matrix_multiply(Core::load(a), Core::load(b)), reference_multiply(a, b), 1e-4f));
+		CHECK(near(Core::vector_transform(Core::load(value), Core::load(a)), reference_transform(value, a), 1e-4f));
+
+		const Core::Float4x4 transposed = to_float4x4(Core::matrix_transpose(Core::load(a)));
+		bool is_transposed = true;
+		for (uint32_t row_idx = 0; row_idx < 4; ++row_idx)
+		{
+			for (uint32_t column_idx = 0; column_idx < 4; ++column_idx)
+			{
+				is_transposed = is_transposed && element(transposed, row_idx, column_idx) == element(a, column_idx, row_idx);
+			}
+		}
+		CHECK(is_transposed);
+
+		// Well conditioned: a rotation, scale and translation
+		const Core::Matrix affine = Core::matrix_affine(
+			Core::vector_set(random.next(0.5f, 2.0f), random.next(0.5f, 2.0f), random.next(0.5f, 2.0f), 0.0f),
+			random.next_rotation(),
+			Core::load(random.next_float4()));
+		const Core::Matrix product = Core::matrix_multiply(affine, Core::matrix_inverse(affine));
+		CHECK(near(product, to_float4x4(Core::matrix_identity()), 1e-4f));
+	}
+}
+
+TEST_CASE(simd_math, rotates_by_quaternions_and_their_matrices_alike)
+{
+	// A quarter turn around z takes x to y
+	const Core::Vector quarter_turn = Core::quaternion_rotation_axis(Core::vector_set(0.0f, 0.0f, 1.0f, 0.0f), pi * 0.5f);
+	CHECK(near(Core::quaternion_rotate(Core::vector_set(1.0f, 0.0f, 0.0f, 0.0f), quarter_turn), { 0.0f, 1.0f, 0.0f, 0.0f }));
+
+	RandomValues random;
+	for (uint32_t iteration = 0; iteration < 100; ++iteration)
+	{
+		const Core::Vector a = random.next_rotation();
+		const Core::Vector b = random.next_rotation();
+		const Core::Vector value = Core::vector_set(random.next(), random.next(), random.next(), 1.0f);
+		const Core::Float4 rotated = to_float4(Core::quaternion_rotate(value, a));
+
+		CHECK(near(Core::vector_transform(value, Core::matrix_rotation_quaternion(a)), rotated, 1e-4f));
+		CHECK(near(Core::length3(Core::quaternion_rotate(value, a)), Core::length3(value), 1e-4f));
+		CHECK(near(Core::quaternion_rotate(Core::load(rotated), Core::quaternion_conjugate(a)), to_float4(value), 1e-4f));
+
+		// a first, then b, the same order as the matrices
+		const Core::Float4 twice_rotated = to_float4(Core::quaternion_rotate(Core::load(rotated), b));
+		CHECK(near(Core::quaternion_rotate(value, Core::quaternion_multiply(a, b)), twice_rotated, 1e-4f));
+		const Core::Matrix matrices = Core::matrix_multiply(Core::matrix_rotation_quaternion(a), Core::matrix_rotation_quaternion(b));
+		CHECK(near(Core::vector_transform(value, matrices), twice_rotated, 1e-4f));
+	}
+}
+
+TEST_CASE(simd_math, slerps_along_the_shorter_arc)
+{
+	const Core::Vector axis = Core::vector_set(0.0f, 1.0f, 0.0f, 0.0f);
+	const Core::Vector from = Core::quaternion_identity();
+	const Core::Vector to = Core::quaternion_rotation_axis(axis, pi * 0.8f);
+
+	CHECK(near(Core::quaternion_slerp(from, to, 0.0f), to_float4(from)));
+	CHECK(near(Core::quaternion_slerp(from, to, 1.0f), to_float4(to)));
+	for (const float t : { 0.25f, 0.5f, 0.9f })
+	{
+		const Core::Float4 expected = to_float4(Core::quaternion_rotation_axis(axis, pi * 0.8f * t));
+		CHECK(near(Core::quaternion_slerp(from, to, t), expected, 1e-4f));
+		// -to is the same rotation
+		CHECK(near(Core::quaternion_slerp(from, Core::vector_negate(to), t), expected, 1e-4f));
+	}
+}
+
+TEST_CASE(simd_math, projects_and_views_like_direct3d)
+{
+	const Core::Matrix projection = Core::matrix_perspective_fov_lh(pi * 0.5f, 2.0f, 0.5f, 100.0f);
+	const auto project = [&](float x, float y, float z)
+	{
+		const Core::Float4 clip = to_float4(Core::vector_transform(Core::vector_set(x, y, z, 1.0f), projection));
+		return Core::Float4{ clip.x / clip.w, clip.y / clip.w, clip.z / clip.w, clip.w };
+	};
+	CHECK(near(project(0.0f, 0.0f, 0.5f).z, 0.0f));
+	CHECK(near(project(0.0f, 0.0f, 100.0f).z, 1.0f));
+	// 90 degrees vertically at an aspect ratio of 2 reach the top at y = z and the right at x = 2 z
+	CHECK(near(project(20.0f, 10.0f, 10.0f).x, 1.0f));
+	CHECK(near(project(20.0f, 10.0f, 10.0f).y, 1.0f));
+
+	const Core::Vector position = Core::vector_set(1.0f, 2.0f, 3.0f, 1.0f);
+	const Core::Vector direction = Core::vector_set(0.0f, 0.0f, -2.0f, 0.0f);
+	const Core::Matrix view = Core::matrix_look_to_lh(position, direction, Core::vector_set(0.0f, 1.0f, 0.0f, 0.0f));
+	CHECK(near(Core::vector_transform(position, view), { 0.0f, 0.0f, 0.0f, 1.0f }));
+	CHECK(near(Core::vector_transform(Core::vector_add(position, direction), view), { 0.0f, 0.0f, 2.0f, 1.0f }));
+	// Left handed: looking down -z with y up, +x ends up on the left
+	CHECK(near(Core::vector_transform(Core::vector_set(2.0f, 2.0f, 3.0f, 1.0f), view), { -1.0f, 0.0f, 0.0f, 1.0f }));
+}
+
+TEST_CASE(simd_math, transforms_batches_of_any_count)
+{
+	RandomValues random;
+	const Core::Float4x4 matrix = random.next_float4x4();
+
+	// Every remainder of the 4 and 8 wide kernels
+	for (size_t count = 0; count <= 19; ++count)
+	{
+		std::vector<float> x(count);
+		std::vector<float> y(count);
+		std::vector<float> z(count);
+		for (size_t idx = 0; idx < count; ++idx)
+		{
+			x[idx] = random.next();
+			y[idx] = random.next();
+			z[idx] = random.next();
+		}
+
+		// One more than count, which the kernels must not write
+		std::vector<float> out_x(count + 1, -1.0f);
+		std::vector<float> out_y(count + 1, -1.0f);
+		std::vector<float> out_z(count + 1, -1.0f);
+		std::vector<float> out_w(count + 1, -1.0f);
+		Core::transform_points(matrix, { x.data(), y.data(), z.data() }, count, { out_x.data(), out_y.data(), out_z.data(), out_w.data() });
+		for (size_t idx = 0; idx < count; ++idx)
+		{
+			const Core::Float4 expected = reference_transform({ x[idx], y[idx], z[idx], 1.0f }, matrix);
+			CHECK(near(out_x[idx], expected.x, 1e-4f) && near(out_y[idx], expected.y, 1e-4f)
+				&& near(out_z[idx], expected.z, 1e-4f) && near(out_w[idx], expected.w, 1e-4f));
+		}
+		CHECK(out_x[count] == -1.0f && out_y[count] == -1.0f && out_z[count] == -1.0f && out_w[count] == -1.0f);
+
+		Core::transform_directions(matrix, { x.data(), y.data(), z.data() }, count, { out_x.data(), out_y.data(), out_z.data() });
+		for (size_t idx = 0; idx < count; ++idx)
+		{
+			const Core::Float4 expected = reference_transform({ x[idx], y[idx], z[idx], 0.0f }, matrix);
+			CHECK(near(out_x[idx], expected.x, 1e-4f) && near(out_y[idx], expected.y, 1e-4f) && near(out_z[idx], expected.z, 1e-4f));
+		}
+		CHECK(out_x[count] == -1.0f && out_y[count] == -1.0f && out_z[count] == -1.0f);
+	}
+}
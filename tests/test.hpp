@@ -0,0 +1,70 @@
+#ifndef DIRECTX_PLAYGROUND_TESTS_TEST_HPP
+#define DIRECTX_PLAYGROUND_TESTS_TEST_HPP
+
+// A minimal test harness: TEST_CASE(suite, name) registers a function, CHECK
+// reports a failed condition and keeps going. playground_tests SUITE runs one
+// suite, which is what every ctest entry does.
+
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+namespace Tests
+{
+
+	using TestFunction = void (*)();
+
+	struct TestRegistration
+	{
+		TestRegistration(const char* suite, const char* name, TestFunction function);
+	};
+
+	void report_failure(const char* file, int line, const char* condition);
+
+	// A fresh directory under the system temp directory, removed with its contents
+	class TemporaryDirectory
+	{
+	public:
+		TemporaryDirectory();
+		TemporaryDirectory(const TemporaryDirectory&) = delete;
+		TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+		~TemporaryDirectory();
+
+		const std::filesystem::path& path() const;
+	private:
+		std::filesystem::path m_path;
+	};
+
+	// For results of background threads: false when condition() is still false after timeout
+	template<typename Condition>
+	bool wait_until(Condition&& condition, std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+	{
+		const auto deadline = std::chrono::steady_clock::now() + timeout;
+		while (!condition())
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				return false;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		return true;
+	}
+
+}
+
+#define TEST_CASE(suite, name) \
+	static void suite##_##name(); \
+	static const Tests::TestRegistration suite##_##name##_registration(#suite, #name, suite##_##name); \
+	static void suite##_##name()
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			Tests::report_failure(__FILE__, __LINE__, #condition); \
+		} \
+	} while (false)
+
+#endif //DIRECTX_PLAYGROUND_TESTS_TEST_HPP
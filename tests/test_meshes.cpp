@@ -0,0 +1,107 @@
+#include "test_meshes.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Tests
+{
+
+	Core::MeshImport make_grid(uint32_t quad_count)
+	{
+		Core::MeshImport mesh;
+		const uint32_t row_size = quad_count + 1;
+		for (uint32_t y = 0; y < row_size; ++y)
+		{
+			for (uint32_t x = 0; x < row_size; ++x)
+			{
+				const float u = static_cast<float>(x) / static_cast<float>(quad_count);
+				const float v = static_cast<float>(y) / static_cast<float>(quad_count);
+				mesh.vertices.push_back({ { u, v, 0.0f }, { 0.0f, 0.0f, 1.0f }, { u, v } });
+			}
+		}
+		for (uint32_t y = 0; y < quad_count; ++y)
+		{
+			for (uint32_t x = 0; x < quad_count; ++x)
+			{
+				const uint32_t corner = y * row_size + x;
+				mesh.indices.insert(mesh.indices.end(), { corner, corner + 1, corner + row_size + 1 });
+				mesh.indices.insert(mesh.indices.end(), { corner, corner + row_size + 1, corner + row_size });
+			}
+		}
+
+		Core::Submesh submesh;
+		submesh.index_count = static_cast<uint32_t>(mesh.indices.size());
+		mesh.submeshes.push_back(submesh);
+		return mesh;
+	}
+
+	Core::MeshImport make_sphere(uint32_t ring_count, uint32_t segment_count)
+	{
+		constexpr float pi = 3.14159265358979f;
+
+		// The poles get a ring of segment_count + 1 vertices as well, the seam is duplicated
+		Core::MeshImport mesh;
+		for (uint32_t ring_idx = 0; ring_idx <= ring_count; ++ring_idx)
+		{
+			const float theta = pi * static_cast<float>(ring_idx) / static_cast<float>(ring_count);
+			for (uint32_t segment_idx = 0; segment_idx <= segment_count; ++segment_idx)
+			{
+				const float phi = 2.0f * pi * static_cast<float>(segment_idx) / static_cast<float>(segment_count);
+				const float position[3] = { std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta) };
+				mesh.vertices.push_back({
+					{ position[0], position[1], position[2] },
+					{ position[0], position[1], position[2] },
+					{ static_cast<float>(segment_idx) / static_cast<float>(segment_count), static_cast<float>(ring_idx) / static_cast<float>(ring_count) } });
+			}
+		}
+
+		const uint32_t row_size = segment_count + 1;
+		for (uint32_t ring_idx = 0; ring_idx < ring_count; ++ring_idx)
+		{
+			for (uint32_t segment_idx = 0; segment_idx < segment_count; ++segment_idx)
+			{
+				const uint32_t corner = ring_idx * row_size + segment_idx;
+				// Rings run from +z to -z, so going down a ring and along phi is counter clockwise outside
+				if (ring_idx > 0)
+				{
+					mesh.indices.insert(mesh.indices.end(), { corner, corner + row_size, corner + 1 });
+				}
+				if (ring_idx + 1 < ring_count)
+				{
+					mesh.indices.insert(mesh.indices.end(), { corner + 1, corner + row_size, corner + row_size + 1 });
+				}
+			}
+		}
+
+		Core::Submesh submesh;
+		submesh.index_count = static_cast<uint32_t>(mesh.indices.size());
+		mesh.submeshes.push_back(submesh);
+		return mesh;
+	}
+
+	std::vector<PositionTriangle> position_triangles(const std::vector<Core::ImportedVertex>& vertices, const uint32_t* indices, size_t index_count)
+	{
+		std::vector<PositionTriangle> triangles;
+		for (size_t index_idx = 0; index_idx + 2 < index_count; index_idx += 3)
+		{
+			std::array<std::array<float, 3>, 3> corners;
+			for (uint32_t corner_idx = 0; corner_idx < 3; ++corner_idx)
+			{
+				const float* position = vertices[indices[index_idx + corner_idx]].position;
+				corners[corner_idx] = { position[0], position[1], position[2] };
+			}
+			const auto first = std::min_element(corners.begin(), corners.end());
+			std::rotate(corners.begin(), first, corners.end());
+
+			PositionTriangle triangle;
+			for (uint32_t corner_idx = 0; corner_idx < 3; ++corner_idx)
+			{
+				std::copy(corners[corner_idx].begin(), corners[corner_idx].end(), triangle.begin() + corner_idx * 3);
+			}
+			triangles.push_back(triangle);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+}
@@ -0,0 +1,27 @@
+#ifndef DIRECTX_PLAYGROUND_TESTS_TEST_MESHES_HPP
+#define DIRECTX_PLAYGROUND_TESTS_TEST_MESHES_HPP
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "core/mesh_import.hpp"
+
+namespace Tests
+{
+
+	// quad_count x quad_count quads over [0, 1] x [0, 1] at z = 0, counter clockwise
+	// seen from +z, in one submesh
+	Core::MeshImport make_grid(uint32_t quad_count);
+	// A closed UV sphere of radius 1 around the origin, counter clockwise seen from outside
+	Core::MeshImport make_sphere(uint32_t ring_count, uint32_t segment_count);
+
+	// The triangles by vertex position, each rotated to start at its smallest corner so
+	// that renumbering and reordering compare equal but flipping the winding does not.
+	// Sorted, for comparing two lists as sets.
+	using PositionTriangle = std::array<float, 9>;
+	std::vector<PositionTriangle> position_triangles(const std::vector<Core::ImportedVertex>& vertices, const uint32_t* indices, size_t index_count);
+
+}
+
+#endif //DIRECTX_PLAYGROUND_TESTS_TEST_MESHES_HPP
@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "core/job_system.hpp"
+#include "core/texture_processing.hpp"
+#include "test.hpp"
+
+namespace
+{
+	// Gradients, a hard edged disc and a little noise, like the headless benchmark's image
+	Core::Image make_image(uint32_t width, uint32_t height)
+	{
+		Core::Image image;
+		image.width = width;
+		image.height = height;
+		image.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+		std::mt19937 random(3);
+		std::uniform_int_distribution<int32_t> noise_distribution(-2, 2);
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				const float u = (x + 0.5f) / width;
+				const float v = (y + 0.5f) / height;
+				const bool is_inside_disc = (u - 0.5f) * (u - 0.5f) + (v - 0.5f) * (v - 0.5f) < 0.1f;
+				const int32_t texel[4] = {
+					static_cast<int32_t>(u * 255.0f),
+					static_cast<int32_t>(v * 255.0f),
+					is_inside_disc ? 220 : 40,
+					static_cast<int32_t>((1.0f - u * v) * 255.0f),
+				};
+				uint8_t* destination = image.pixels.data() + (static_cast<size_t>(y) * width + x) * 4;
+				for (uint32_t channel_idx = 0; channel_idx < 4; ++channel_idx)
+				{
+					destination[channel_idx] = static_cast<uint8_t>(std::clamp(texel[channel_idx] + noise_distribution(random), 0, 255));
+				}
+			}
+		}
+		return image;
+	}
+
+	Core::Image make_constant_image(uint32_t width, uint32_t height, const uint8_t (&texel)[4])
+	{
+		Core::Image image;
+		image.width = width;
+		image.height = height;
+		for (size_t texel_idx = 0; texel_idx < static_cast<size_t>(width) * height; ++texel_idx)
+		{
+			image.pixels.insert(image.pixels.end(), std::begin(texel), std::end(texel));
+		}
+		return image;
+	}
+
+	// Largest difference of any channel of two images of the same size
+	int32_t max_difference(const Core::Image& a, const Core::Image& b)
+	{
+		int32_t difference = 0;
+		for (size_t byte_idx = 0; byte_idx < a.pixels.size(); ++byte_idx)
+		{
+			difference = std::max(difference, std::abs(a.pixels[byte_idx] - b.pixels[byte_idx]));
+		}
+		return difference;
+	}
+
+	// The box filtered chain of a linear image, each level averaged from the unrounded previous one
+	std::vector<Core::Image> reference_box_mips(const Core::Image& source)
+	{
+		std::vector<Core::Image> mips = { source };
+		std::vector<float> texels(source.pixels.begin(), source.pixels.end());
+		uint32_t width = source.width;
+		uint32_t height = source.height;
+		while (width > 1 || height > 1)
+		{
+			const uint32_t mip_width = std::max(1U, width / 2);
+			const uint32_t mip_height = std::max(1U, height / 2);
+			std::vector<float> mip_texels(static_cast<size_t>(mip_width) * mip_height * 4);
+			Core::Image& mip = mips.emplace_back();
+			mip.width = mip_width;
+			mip.height = mip_height;
+			mip.pixels.resize(mip_texels.size());
+
+			for (uint32_t y = 0; y < mip_height; ++y)
+			{
+				for (uint32_t x = 0; x < mip_width; ++x)
+				{
+					for (uint32_t channel_idx = 0; channel_idx < 4; ++channel_idx)
+					{
+						// A dimension of 1 averages the single row or column with itself
+						float sum = 0.0f;
+						for (uint32_t tap_idx = 0; tap_idx < 4; ++tap_idx)
+						{
+							const uint32_t source_x = std::min(x * 2 + tap_idx % 2, width - 1);
+							const uint32_t source_y = std::min(y * 2 + tap_idx / 2, height - 1);
+							sum += texels[(static_cast<size_t>(source_y) * width + source_x) * 4 + channel_idx];
+						}
+						const size_t destination_idx = (static_cast<size_t>(y) * mip_width + x) * 4 + channel_idx;
+						mip_texels[destination_idx] = sum / 4.0f;
+						mip.pixels[destination_idx] = static_cast<uint8_t>(std::lround(sum / 4.0f));
+					}
+				}
+			}
+			texels.swap(mip_texels);
+			width = mip_width;
+			height = mip_height;
+		}
+		return mips;
+	}
+}
+
+TEST_CASE(texture_processing, generates_the_full_chain_of_box_filtered_mips)
+{
+	Core::JobSystem job_system(Core::JobSystemDesc{ 2 });
+
+	// Odd sizes drop their last row and column
+	for (const auto& [width, height] : { std::pair(64U, 32U), std::pair(37U, 10U), std::pair(1U, 9U) })
+	{
+		const Core::Image source = make_image(width, height);
+		std::vector<Core::Image> mips;
+		Core::generate_mips(job_system, source, Core::MipFilter::Box, false, mips);
+
+		const auto expected = reference_box_mips(source);
+		CHECK(mips.size() == expected.size());
+		for (size_t mip_idx = 0; mip_idx < std::min(mips.size(), expected.size()); ++mip_idx)
+		{
+			CHECK(mips[mip_idx].width == expected[mip_idx].width);
+			CHECK(mips[mip_idx].height == expected[mip_idx].height);
+			CHECK(mips[mip_idx].pixels.size() == expected[mip_idx].pixels.size());
+			CHECK(mips[mip_idx].pixels.size() != expected[mip_idx].pixels.size() || max_difference(mips[mip_idx], expected[mip_idx]) <= 1);
+		}
+		CHECK(mips.back().width == 1 && mips.back().height == 1);
+	}
+}
+
+TEST_CASE(texture_processing, keeps_constant_images_constant)
+{
+	Core::JobSystem job_system(Core::JobSystemDesc{ 2 });
+	const uint8_t texel[4] = { 200, 90, 13, 128 };
+	const Core::Image source = make_constant_image(48, 20, texel);
+
+	// The Kaiser taps add up to one, and sRGB decoding and encoding round trips
+	for (const auto filter : { Core::MipFilter::Box, Core::MipFilter::Kaiser })
+	{
+		for (const bool is_srgb : { false, true })
+		{
+			std::vector<Core::Image> mips;
+			Core::generate_mips(job_system, source, filter, is_srgb, mips);
+			for (const auto& mip : mips)
+			{
+				CHECK(max_difference(mip, make_constant_image(mip.width, mip.height, texel)) <= 1);
+			}
+		}
+	}
+}
+
+TEST_CASE(texture_processing, filters_srgb_color_in_linear_space)
+{
+	Core::JobSystem job_system(Core::JobSystemDesc{ 0 });
+
+	// Black and white columns average to linear 0.5, which is 188 in sRGB and not 128.
+	// Alpha is linear in either case.
+	Core::Image source = make_constant_image(2, 2, { 0, 0, 0, 0 });
+	for (const size_t texel_idx : { 1, 3 })
+	{
+		std::fill_n(source.pixels.begin() + texel_idx * 4, 4, uint8_t(255));
+	}
+
+	std::vector<Core::Image> mips;
+	Core::generate_mips(job_system, source, Core::MipFilter::Box, true, mips);
+	CHECK(mips.size() == 2);
+	CHECK(std::abs(mips[1].pixels[0] - 188) <= 1);
+	CHECK(std::abs(mips[1].pixels[3] - 128) <= 1);
+
+	Core::generate_mips(job_system, source, Core::MipFilter::Box, false, mips);
+	CHECK(std::abs(mips[1].pixels[0] - 128) <= 1);
+}
+
+TEST_CASE(texture_processing, does_not_depend_on_the_worker_count)
+{
+	Core::JobSystem inline_job_system(Core::JobSystemDesc{ 0 });
+	Core::JobSystem job_system(Core::JobSystemDesc{ 3 });
+	const Core::Image source = make_image(70, 45);
+
+	for (const auto filter : { Core::MipFilter::Box, Core::MipFilter::Kaiser })
+	{
+		std::vector<Core::Image> expected;
+		std::vector<Core::Image> mips;
+		Core::generate_mips(inline_job_system, source, filter, true, expected);
+		Core::generate_mips(job_system, source, filter, true, mips);
+		CHECK(mips.size() == expected.size());
+		for (size_t mip_idx = 0; mip_idx < std::min(mips.size(), expected.size()); ++mip_idx)
+		{
+			CHECK(mips[mip_idx].pixels == expected[mip_idx].pixels);
+		}
+	}
+
+	for (const auto format : { Core::TextureFormat::BC1Unorm, Core::TextureFormat::BC7Unorm })
+	{
+		std::vector<uint8_t> expected;
+		std::vector<uint8_t> blocks;
+		Core::compress_blocks(inline_job_system, source, format, expected);
+		Core::compress_blocks(job_system, source, format, blocks);
+		CHECK(blocks == expected);
+	}
+}
+
+TEST_CASE(texture_processing, compresses_blocks_within_their_quality)
+{
+	Core::JobSystem job_system(Core::JobSystemDesc{ 2 });
+	// Partial blocks on the right and bottom
+	const Core::Image source = make_image(66, 35);
+
+	// Channels the format keeps and the PSNR it at least reaches on the test image
+	const std::tuple<Core::TextureFormat, uint32_t, double> formats[] = {
+		{ Core::TextureFormat::BC1Unorm, 3, 32.0 },
+		{ Core::TextureFormat::BC3Unorm, 4, 32.0 },
+		{ Core::TextureFormat::BC5Unorm, 2, 38.0 },
+		{ Core::TextureFormat::BC7Unorm, 4, 38.0 },
+		{ Core::TextureFormat::BC7UnormSrgb, 4, 38.0 },
+	};
+	for (const auto& [format, channel_count, min_psnr] : formats)
+	{
+		std::vector<uint8_t> blocks;
+		Core::compress_blocks(job_system, source, format, blocks);
+		CHECK(blocks.size() == 17 * 9 * Core::format_block_bytes(format));
+
+		Core::Image decoded;
+		Core::decompress_blocks(blocks.data(), format, source.width, source.height, decoded);
+		CHECK(decoded.width == source.width && decoded.height == source.height);
+		CHECK(Core::compute_psnr(source, decoded, channel_count) >= min_psnr);
+	}
+}
+
+TEST_CASE(texture_processing, compresses_constant_blocks_almost_exactly)
+{
+	Core::JobSystem job_system(Core::JobSystemDesc{ 0 });
+	const uint8_t texel[4] = { 97, 180, 33, 210 };
+	const Core::Image source = make_constant_image(8, 8, texel);
+
+	// BC1 endpoints are 5:6:5, interpolating between two of them gets within a few steps
+	const std::pair<Core::TextureFormat, int32_t> formats[] = {
+		{ Core::TextureFormat::BC1Unorm, 3 },
+		{ Core::TextureFormat::BC3Unorm, 3 },
+		{ Core::TextureFormat::BC5Unorm, 1 },
+		{ Core::TextureFormat::BC7Unorm, 1 },
+	};
+	for (const auto& [format, max_error] : formats)
+	{
+		std::vector<uint8_t> blocks;
+		Core::compress_blocks(job_system, source, format, blocks);
+		Core::Image decoded;
+		Core::decompress_blocks(blocks.data(), format, source.width, source.height, decoded);
+
+		const uint32_t channel_count = format == Core::TextureFormat::BC1Unorm ? 3 : format == Core::TextureFormat::BC5Unorm ? 2 : 4;
+		for (size_t texel_idx = 0; texel_idx < 64; ++texel_idx)
+		{
+			for (uint32_t channel_idx = 0; channel_idx < channel_count; ++channel_idx)
+			{
+				CHECK(std::abs(decoded.pixels[texel_idx * 4 + channel_idx] - texel[channel_idx]) <= max_error);
+			}
+		}
+	}
+
+	CHECK(std::isinf(Core::compute_psnr(source, source, 4)));
+}
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "core/job_system.hpp"
+#include "core/null_backend.hpp"
+#include "core/texture_streamer.hpp"
+#include "test.hpp"
+
+namespace
+{
+	// Copies read the upload memory only when their fence completes, like a GPU running
+	// behind, so staging over memory that is still being copied from shows up as wrong texels
+	class DeferredCopyBackend : public Core::NullTextureStreamingBackend
+	{
+	public:
+		explicit DeferredCopyBackend(uint64_t upload_capacity) :
+			NullTextureStreamingBackend(upload_capacity)
+		{
+		}
+
+		void copy_mip(void* texture, uint32_t mip_idx, uint64_t upload_offset, const Core::TextureFootprint& footprint) override
+		{
+			NullTextureStreamingBackend::copy_mip(texture, mip_idx, upload_offset, footprint);
+			m_pending_copies.push_back({ texture, mip_idx, upload_offset, footprint, m_submitted_fence_value + 1 });
+			++m_unsubmitted_copy_count;
+		}
+
+		uint64_t submit() override
+		{
+			m_submitted_fence_value = NullTextureStreamingBackend::submit();
+			max_copies_per_submit = std::max(max_copies_per_submit, m_unsubmitted_copy_count);
+			m_unsubmitted_copy_count = 0;
+			return m_submitted_fence_value;
+		}
+
+		uint64_t completed_fence_value() override
+		{
+			return m_completed_fence_value;
+		}
+
+		void complete(uint64_t fence_value)
+		{
+			while (!m_pending_copies.empty() && m_pending_copies.front().fence_value <= fence_value)
+			{
+				const PendingCopy& copy = m_pending_copies.front();
+				const Core::TextureFootprint& footprint = copy.footprint;
+				std::vector<uint8_t>& texels = m_copied_mips[{ copy.texture, copy.mip_idx }];
+				texels.resize(static_cast<size_t>(footprint.row_size) * footprint.row_count);
+				for (uint32_t row_idx = 0; row_idx < footprint.row_count; ++row_idx)
+				{
+					const uint8_t* source = upload_memory() + copy.upload_offset + static_cast<uint64_t>(row_idx) * footprint.row_pitch;
+					std::copy(source, source + footprint.row_size, texels.data() + static_cast<size_t>(row_idx) * footprint.row_size);
+				}
+				m_pending_copies.pop_front();
+			}
+			m_completed_fence_value = std::max(m_completed_fence_value, fence_value);
+		}
+
+		uint64_t submitted_fence_value() const
+		{
+			return m_submitted_fence_value;
+		}
+
+		// Tightly packed rows, null until the copy ran
+		const std::vector<uint8_t>* copied_mip(void* texture, uint32_t mip_idx) const
+		{
+			const auto it = m_copied_mips.find({ texture, mip_idx });
+			return it != m_copied_mips.end() ? &it->second : nullptr;
+		}
+
+		uint32_t max_copies_per_submit = 0;
+	private:
+		struct PendingCopy
+		{
+			void* texture;
+			uint32_t mip_idx;
+			uint64_t upload_offset;
+			Core::TextureFootprint footprint;
+			uint64_t fence_value;
+		};
+
+		std::deque<PendingCopy> m_pending_copies;
+		std::map<std::pair<void*, uint32_t>, std::vector<uint8_t>> m_copied_mips;
+		uint64_t m_submitted_fence_value = 0;
+		uint64_t m_completed_fence_value = 0;
+		uint32_t m_unsubmitted_copy_count = 0;
+	};
+
+	// Every byte different from its neighbours and from the same byte of the other mips
+	struct TestTexture
+	{
+		Core::TextureDesc desc;
+		std::vector<std::vector<uint8_t>> storage;
+	};
+
+	TestTexture write_texture(const std::filesystem::path& path, Core::TextureFormat format, uint32_t width, uint32_t height, uint32_t mip_count)
+	{
+		TestTexture texture;
+		texture.desc = { format, width, height, mip_count };
+		std::vector<Core::TextureMip> mips;
+		for (uint32_t mip_idx = 0; mip_idx < mip_count; ++mip_idx)
+		{
+			Core::TextureMip mip;
+			mip.width = std::max(1U, width >> mip_idx);
+			mip.height = std::max(1U, height >> mip_idx);
+			Core::compute_mip_pitch(format, mip.width, mip.height, mip.row_pitch, mip.row_count);
+			mip.size = static_cast<uint64_t>(mip.row_pitch) * mip.row_count;
+
+			std::vector<uint8_t> bytes(mip.size);
+			for (size_t byte_idx = 0; byte_idx < bytes.size(); ++byte_idx)
+			{
+				bytes[byte_idx] = static_cast<uint8_t>(byte_idx * 7 + mip_idx * 31 + width);
+			}
+			texture.storage.push_back(std::move(bytes));
+			mips.push_back(mip);
+		}
+		for (uint32_t mip_idx = 0; mip_idx < mip_count; ++mip_idx)
+		{
+			mips[mip_idx].data = texture.storage[mip_idx].data();
+		}
+		CHECK(Core::write_dds(path.string(), texture.desc, mips));
+		return texture;
+	}
+
+	// Renders frames until nothing is pending, the copies of a frame complete during the next.
+	// Mips only become usable after their copies ran and never get less detailed.
+	bool stream_all(Core::TextureStreamer& streamer, DeferredCopyBackend& backend, uint32_t texture_count)
+	{
+		std::vector<uint32_t> most_detailed_mips(texture_count, UINT32_MAX);
+		uint64_t last_frame_fence_value = 0;
+		bool is_consistent = true;
+		const bool is_done = Tests::wait_until([&]()
+		{
+			backend.complete(last_frame_fence_value);
+			last_frame_fence_value = backend.submitted_fence_value();
+			streamer.update();
+
+			for (uint32_t texture_id = 0; texture_id < texture_count; ++texture_id)
+			{
+				if (!streamer.texture(texture_id))
+				{
+					continue;
+				}
+				const uint32_t most_detailed_mip = streamer.most_detailed_mip(texture_id);
+				is_consistent = is_consistent && most_detailed_mip <= most_detailed_mips[texture_id];
+				for (uint32_t mip_idx = most_detailed_mip; mip_idx < streamer.desc(texture_id).mip_count; ++mip_idx)
+				{
+					is_consistent = is_consistent && backend.copied_mip(streamer.texture(texture_id), mip_idx);
+				}
+				most_detailed_mips[texture_id] = most_detailed_mip;
+			}
+			return streamer.pending_count() == 0;
+		});
+		backend.complete(backend.submitted_fence_value());
+		return is_done && is_consistent;
+	}
+}
+
+TEST_CASE(texture_streamer, streams_every_mip_intact)
+{
+	Tests::TemporaryDirectory directory;
+	std::vector<TestTexture> textures;
+	std::vector<std::string> paths;
+	const auto add_texture = [&](Core::TextureFormat format, uint32_t width, uint32_t height, uint32_t mip_count)
+	{
+		paths.push_back((directory.path() / ("texture" + std::to_string(paths.size()) + ".dds")).string());
+		textures.push_back(write_texture(paths.back(), format, width, height, mip_count));
+	};
+	// Rows narrower than the pitch alignment, block rows, a single texel and a partial chain
+	add_texture(Core::TextureFormat::RGBA8Unorm, 300, 200, 9);
+	add_texture(Core::TextureFormat::BC1Unorm, 256, 256, 9);
+	add_texture(Core::TextureFormat::BC7UnormSrgb, 64, 32, 7);
+	add_texture(Core::TextureFormat::RGBA8UnormSrgb, 1, 1, 1);
+	add_texture(Core::TextureFormat::BC3Unorm, 128, 512, 4);
+
+	for (const Core::TextureReadMode read_mode : { Core::TextureReadMode::Mapped, Core::TextureReadMode::Buffered })
+	{
+		Core::JobSystem job_system(Core::JobSystemDesc{ 2 });
+		// Smaller than all mips together, so staging waits for copies to finish and wraps
+		DeferredCopyBackend backend(512 * 1024);
+		Core::TextureStreamerDesc desc;
+		desc.max_upload_bytes_per_update = 128 * 1024;
+		desc.read_mode = read_mode;
+		Core::TextureStreamer streamer(job_system, backend, desc);
+
+		for (const std::string& path : paths)
+		{
+			streamer.request(path);
+		}
+		CHECK(stream_all(streamer, backend, static_cast<uint32_t>(textures.size())));
+
+		uint64_t mip_count = 0;
+		uint64_t mip_bytes = 0;
+		for (uint32_t texture_id = 0; texture_id < textures.size(); ++texture_id)
+		{
+			const TestTexture& texture = textures[texture_id];
+			CHECK(!streamer.is_failed(texture_id));
+			CHECK(streamer.is_complete(texture_id));
+			CHECK(streamer.most_detailed_mip(texture_id) == 0);
+			CHECK(streamer.desc(texture_id).format == texture.desc.format);
+			CHECK(streamer.desc(texture_id).mip_count == texture.desc.mip_count);
+			for (uint32_t mip_idx = 0; mip_idx < texture.desc.mip_count; ++mip_idx)
+			{
+				const std::vector<uint8_t>* copied_mip = backend.copied_mip(streamer.texture(texture_id), mip_idx);
+				CHECK(copied_mip && *copied_mip == texture.storage[mip_idx]);
+				mip_bytes += texture.storage[mip_idx].size();
+			}
+			mip_count += texture.desc.mip_count;
+		}
+
+		const Core::TextureStreamingStats stats = streamer.stats();
+		CHECK(stats.requested_count == textures.size());
+		CHECK(stats.completed_count == textures.size());
+		CHECK(stats.failed_count == 0);
+		CHECK(stats.uploaded_mips == mip_count);
+		CHECK(stats.uploaded_bytes == mip_bytes);
+		CHECK(backend.counters().textures == textures.size());
+		CHECK(backend.counters().submits > 1);
+	}
+}
+
+TEST_CASE(texture_streamer, waits_for_copies_before_using_mips)
+{
+	Tests::TemporaryDirectory directory;
+	const std::string path = (directory.path() / "texture.dds").string();
+	const TestTexture texture = write_texture(path, Core::TextureFormat::RGBA8Unorm, 64, 64, 7);
+
+	Core::JobSystem job_system(Core::JobSystemDesc{ 1 });
+	DeferredCopyBackend backend(1024 * 1024);
+	Core::TextureStreamerDesc desc;
+	// Stops after the first mip staged
+	desc.max_upload_bytes_per_update = 1;
+	Core::TextureStreamer streamer(job_system, backend, desc);
+	const uint32_t texture_id = streamer.request(path);
+
+	CHECK(Tests::wait_until([&]()
+	{
+		streamer.update();
+		return streamer.texture(texture_id) != nullptr;
+	}));
+	for (uint32_t frame_idx = 0; frame_idx < 10; ++frame_idx)
+	{
+		streamer.update();
+	}
+	// Every mip staged one per update, none usable while the copies did not run
+	CHECK(backend.counters().copies == 7);
+	CHECK(backend.max_copies_per_submit == 1);
+	CHECK(streamer.most_detailed_mip(texture_id) == 7);
+	CHECK(!streamer.is_complete(texture_id));
+	CHECK(streamer.pending_count() == 1);
+
+	// The least detailed mips first
+	backend.complete(backend.submitted_fence_value() - 3);
+	streamer.update();
+	CHECK(streamer.most_detailed_mip(texture_id) == 3);
+	CHECK(!streamer.is_complete(texture_id));
+
+	backend.complete(backend.submitted_fence_value());
+	streamer.update();
+	CHECK(streamer.is_complete(texture_id));
+	CHECK(streamer.pending_count() == 0);
+	CHECK(*backend.copied_mip(streamer.texture(texture_id), 0) == texture.storage[0]);
+}
+
+TEST_CASE(texture_streamer, reports_failed_textures)
+{
+	Tests::TemporaryDirectory directory;
+	const std::string missing_path = (directory.path() / "missing.dds").string();
+	const std::string large_path = (directory.path() / "large.dds").string();
+	const std::string small_path = (directory.path() / "small.dds").string();
+	write_texture(large_path, Core::TextureFormat::RGBA8Unorm, 256, 256, 9);
+	const TestTexture small_texture = write_texture(small_path, Core::TextureFormat::RGBA8Unorm, 32, 32, 6);
+
+	Core::JobSystem job_system(Core::JobSystemDesc{ 1 });
+	// Holds the small texture and all but mip 0 of the large one
+	DeferredCopyBackend backend(128 * 1024);
+	Core::TextureStreamer streamer(job_system, backend);
+	const uint32_t missing_id = streamer.request(missing_path);
+	const uint32_t large_id = streamer.request(large_path);
+	const uint32_t small_id = streamer.request(small_path);
+	CHECK(stream_all(streamer, backend, 3));
+
+	CHECK(streamer.is_failed(missing_id));
+	CHECK(!streamer.error(missing_id).empty());
+	CHECK(streamer.texture(missing_id) == nullptr);
+
+	// The mips that fit were still uploaded
+	CHECK(streamer.is_failed(large_id));
+	CHECK(streamer.error(large_id).find("larger than the upload ring") != std::string::npos);
+	CHECK(!streamer.is_complete(large_id));
+	CHECK(streamer.most_detailed_mip(large_id) == 1);
+
+	CHECK(!streamer.is_failed(small_id));
+	CHECK(streamer.is_complete(small_id));
+	CHECK(*backend.copied_mip(streamer.texture(small_id), 0) == small_texture.storage[0]);
+
+	const Core::TextureStreamingStats stats = streamer.stats();
+	CHECK(stats.failed_count == 2);
+	CHECK(stats.completed_count == 1);
+	CHECK(streamer.pending_count() == 0);
+}
@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "core/texture.hpp"
+#include "test.hpp"
+
+namespace
+{
+	// Byte offsets into the files, DDS fields count the magic in front of the header
+	constexpr size_t dds_height_offset = 12;
+	constexpr size_t dds_width_offset = 16;
+	constexpr size_t dds_mip_count_offset = 28;
+	constexpr size_t ktx2_header_size = 80;
+	constexpr size_t ktx2_level_size = 24;
+	// VK_FORMAT_R8G8B8A8_UNORM
+	constexpr uint32_t vk_format_rgba8 = 37;
+
+	std::vector<uint8_t> read_file(const std::filesystem::path& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void write_file(const std::filesystem::path& path, const std::vector<uint8_t>& bytes)
+	{
+		std::ofstream file(path, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+	}
+
+	template<typename T>
+	void patch(std::vector<uint8_t>& bytes, size_t offset, T value)
+	{
+		std::memcpy(bytes.data() + offset, &value, sizeof(value));
+	}
+
+	// A full mip chain of the format, every byte different from its neighbours
+	struct TestTexture
+	{
+		Core::TextureDesc desc;
+		std::vector<std::vector<uint8_t>> storage;
+		std::vector<Core::TextureMip> mips;
+	};
+
+	TestTexture make_texture(Core::TextureFormat format, uint32_t width, uint32_t height, uint32_t mip_count)
+	{
+		TestTexture texture;
+		texture.desc = { format, width, height, mip_count };
+		for (uint32_t mip_idx = 0; mip_idx < mip_count; ++mip_idx)
+		{
+			Core::TextureMip mip;
+			mip.width = std::max(1U, width >> mip_idx);
+			mip.height = std::max(1U, height >> mip_idx);
+			Core::compute_mip_pitch(format, mip.width, mip.height, mip.row_pitch, mip.row_count);
+			mip.size = static_cast<uint64_t>(mip.row_pitch) * mip.row_count;
+
+			std::vector<uint8_t> bytes(mip.size);
+			for (size_t byte_idx = 0; byte_idx < bytes.size(); ++byte_idx)
+			{
+				bytes[byte_idx] = static_cast<uint8_t>(byte_idx * 7 + mip_idx);
+			}
+			texture.storage.push_back(std::move(bytes));
+			texture.mips.push_back(mip);
+		}
+		for (uint32_t mip_idx = 0; mip_idx < mip_count; ++mip_idx)
+		{
+			texture.mips[mip_idx].data = texture.storage[mip_idx].data();
+		}
+		return texture;
+	}
+
+	bool matches(const TestTexture& expected, const Core::TextureData& texture)
+	{
+		if (texture.desc.format != expected.desc.format
+			|| texture.desc.width != expected.desc.width
+			|| texture.desc.height != expected.desc.height
+			|| texture.desc.mip_count != expected.desc.mip_count
+			|| texture.mips.size() != expected.mips.size())
+		{
+			return false;
+		}
+		for (size_t mip_idx = 0; mip_idx < texture.mips.size(); ++mip_idx)
+		{
+			const auto& mip = texture.mips[mip_idx];
+			const auto& expected_mip = expected.mips[mip_idx];
+			if (mip.width != expected_mip.width
+				|| mip.height != expected_mip.height
+				|| mip.row_pitch != expected_mip.row_pitch
+				|| mip.row_count != expected_mip.row_count
+				|| mip.size != expected_mip.size
+				|| std::memcmp(mip.data, expected_mip.data, mip.size) != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// KTX2 with the levels stored back to back after the level index, most detailed first
+	std::vector<uint8_t> make_ktx2(const TestTexture& texture)
+	{
+		constexpr uint8_t identifier[12] = { 0xab, 0x4b, 0x54, 0x58, 0x20, 0x32, 0x30, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a };
+
+		std::vector<uint8_t> bytes(ktx2_header_size + ktx2_level_size * texture.desc.mip_count);
+		std::memcpy(bytes.data(), identifier, sizeof(identifier));
+		patch<uint32_t>(bytes, 12, vk_format_rgba8);
+		patch<uint32_t>(bytes, 16, 1);
+		patch<uint32_t>(bytes, 20, texture.desc.width);
+		patch<uint32_t>(bytes, 24, texture.desc.height);
+		patch<uint32_t>(bytes, 36, 1);
+		patch<uint32_t>(bytes, 40, texture.desc.mip_count);
+
+		for (uint32_t mip_idx = 0; mip_idx < texture.desc.mip_count; ++mip_idx)
+		{
+			const size_t level_offset = ktx2_header_size + ktx2_level_size * mip_idx;
+			patch<uint64_t>(bytes, level_offset, bytes.size());
+			patch<uint64_t>(bytes, level_offset + 8, texture.mips[mip_idx].size);
+			patch<uint64_t>(bytes, level_offset + 16, texture.mips[mip_idx].size);
+			bytes.insert(bytes.end(), texture.storage[mip_idx].begin(), texture.storage[mip_idx].end());
+		}
+		return bytes;
+	}
+
+	bool load(const std::filesystem::path& path, Core::TextureData& texture, std::string& error, Core::TextureReadMode mode = Core::TextureReadMode::Mapped)
+	{
+		return Core::load_texture(path.string(), texture, error, mode);
+	}
+}
+
+TEST_CASE(texture, round_trips_dds)
+{
+	Tests::TemporaryDirectory directory;
+	const auto path = directory.path() / "texture.dds";
+
+	for (const Core::TextureFormat format : { Core::TextureFormat::RGBA8Unorm, Core::TextureFormat::BC1Unorm, Core::TextureFormat::BC7UnormSrgb })
+	{
+		// Not a power of two, mips of BC formats get smaller than a block
+		const TestTexture expected = make_texture(format, 20, 6, 5);
+		CHECK(Core::write_dds(path.string(), expected.desc, expected.mips));
+
+		for (const auto mode : { Core::TextureReadMode::Mapped, Core::TextureReadMode::Buffered })
+		{
+			Core::TextureData texture;
+			std::string error;
+			CHECK(load(path, texture, error, mode));
+			CHECK(matches(expected, texture));
+		}
+	}
+}
+
+TEST_CASE(texture, rejects_truncated_dds)
+{
+	Tests::TemporaryDirectory directory;
+	const auto path = directory.path() / "texture.dds";
+	const TestTexture expected = make_texture(Core::TextureFormat::RGBA8Unorm, 8, 8, 4);
+	CHECK(Core::write_dds(path.string(), expected.desc, expected.mips));
+	const auto bytes = read_file(path);
+
+	// Every cut through the header or the mips
+	for (size_t size = 0; size < bytes.size(); ++size)
+	{
+		write_file(path, std::vector<uint8_t>(bytes.begin(), bytes.begin() + size));
+		Core::TextureData texture;
+		std::string error;
+		CHECK(!load(path, texture, error, Core::TextureReadMode::Buffered));
+		CHECK(!error.empty());
+	}
+}
+
+TEST_CASE(texture, rejects_dds_sizes_out_of_range)
+{
+	Tests::TemporaryDirectory directory;
+	const auto path = directory.path() / "texture.dds";
+	const TestTexture expected = make_texture(Core::TextureFormat::RGBA8Unorm, 8, 4, 4);
+	CHECK(Core::write_dds(path.string(), expected.desc, expected.mips));
+	const auto bytes = read_file(path);
+
+	const auto loads_with = [&](size_t offset, uint32_t value)
+	{
+		auto patched = bytes;
+		patch(patched, offset, value);
+		write_file(path, patched);
+		Core::TextureData texture;
+		std::string error;
+		return load(path, texture, error);
+	};
+
+	// 8x4 has 4 mips, a mip index of 32 and more would shift the width out of range
+	CHECK(loads_with(dds_mip_count_offset, 4));
+	CHECK(!loads_with(dds_mip_count_offset, 5));
+	CHECK(!loads_with(dds_mip_count_offset, 40));
+	CHECK(!loads_with(dds_mip_count_offset, UINT32_MAX));
+
+	CHECK(!loads_with(dds_width_offset, 0));
+	CHECK(!loads_with(dds_height_offset, 0));
+	// Row pitches of these overflow 32 bits
+	CHECK(!loads_with(dds_width_offset, 1U << 30));
+	CHECK(!loads_with(dds_height_offset, UINT32_MAX));
+}
+
+TEST_CASE(texture, round_trips_ktx2)
+{
+	Tests::TemporaryDirectory directory;
+	const auto path = directory.path() / "texture.ktx2";
+	const TestTexture expected = make_texture(Core::TextureFormat::RGBA8Unorm, 16, 4, 5);
+	write_file(path, make_ktx2(expected));
+
+	Core::TextureData texture;
+	std::string error;
+	CHECK(load(path, texture, error));
+	CHECK(matches(expected, texture));
+}
+
+TEST_CASE(texture, rejects_corrupt_ktx2)
+{
+	Tests::TemporaryDirectory directory;
+	const auto path = directory.path() / "texture.ktx2";
+	const auto bytes = make_ktx2(make_texture(Core::TextureFormat::RGBA8Unorm, 16, 4, 5));
+
+	const auto loads = [&](const std::vector<uint8_t>& file_bytes)
+	{
+		write_file(path, file_bytes);
+		Core::TextureData texture;
+		std::string error;
+		const bool is_loaded = load(path, texture, error);
+		CHECK(is_loaded || !error.empty());
+		return is_loaded;
+	};
+	const auto patched = [&](size_t offset, auto value)
+	{
+		auto patched_bytes = bytes;
+		patch(patched_bytes, offset, value);
+		return patched_bytes;
+	};
+
+	for (size_t size = 0; size < bytes.size(); ++size)
+	{
+		CHECK(!loads(std::vector<uint8_t>(bytes.begin(), bytes.begin() + size)));
+	}
+
+	// Level count past what 16x4 allows and past the level index in the file
+	CHECK(!loads(patched(40, uint32_t(6))));
+	CHECK(!loads(patched(40, uint32_t(64))));
+	CHECK(!loads(patched(20, uint32_t(0))));
+	CHECK(!loads(patched(20, uint32_t(1) << 20)));
+
+	// Levels outside the file, wrapping around or shorter than the mip
+	const size_t last_level_offset = ktx2_header_size + ktx2_level_size * 4;
+	CHECK(!loads(patched(last_level_offset, uint64_t(bytes.size()))));
+	CHECK(!loads(patched(last_level_offset, UINT64_MAX)));
+	CHECK(!loads(patched(last_level_offset + 8, UINT64_MAX)));
+	CHECK(!loads(patched(last_level_offset + 8, uint64_t(0))));
+}
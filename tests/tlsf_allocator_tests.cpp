@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "core/tlsf_allocator.hpp"
+#include "test.hpp"
+
+namespace
+{
+	constexpr uint64_t heap_size = 64ULL << 20;
+	constexpr uint64_t granularity = 256;
+
+	struct LiveAllocation
+	{
+		Core::TlsfAllocation allocation;
+		uint64_t requested_size;
+		uint64_t alignment;
+	};
+
+	// Live allocations are inside the range, aligned, large enough and do not overlap,
+	// and together with the free blocks they add up to the whole range
+	bool is_consistent(const Core::TlsfAllocator& allocator, std::vector<LiveAllocation> live)
+	{
+		std::sort(live.begin(), live.end(), [](const LiveAllocation& a, const LiveAllocation& b)
+		{
+			return a.allocation.offset < b.allocation.offset;
+		});
+
+		uint64_t allocated_bytes = 0;
+		uint64_t end = 0;
+		for (const auto& entry : live)
+		{
+			const auto& allocation = entry.allocation;
+			if (allocation.offset < end
+				|| allocation.offset % entry.alignment != 0
+				|| allocation.offset % granularity != 0
+				|| allocation.size < entry.requested_size
+				|| allocation.offset + allocation.size > allocator.size())
+			{
+				return false;
+			}
+			end = allocation.offset + allocation.size;
+			allocated_bytes += allocation.size;
+		}
+
+		const Core::TlsfStats stats = allocator.stats();
+		return stats.allocation_count == live.size() && stats.free_bytes + allocated_bytes == allocator.size();
+	}
+
+	void free_all(Core::TlsfAllocator& allocator, std::vector<LiveAllocation>& live, std::mt19937& random)
+	{
+		std::shuffle(live.begin(), live.end(), random);
+		for (const auto& entry : live)
+		{
+			allocator.free(entry.allocation);
+		}
+		live.clear();
+	}
+
+	bool is_one_free_block(const Core::TlsfAllocator& allocator)
+	{
+		const Core::TlsfStats stats = allocator.stats();
+		return allocator.is_empty()
+			&& stats.free_block_count == 1
+			&& stats.largest_free_block == allocator.size()
+			&& stats.free_bytes == allocator.size();
+	}
+}
+
+TEST_CASE(tlsf_allocator, random_allocations_stay_disjoint_and_aligned)
+{
+	std::mt19937 random(38);
+	std::uniform_int_distribution<uint64_t> size_distribution(1, 2 << 20);
+	// 256 B up to 64 KB
+	std::uniform_int_distribution<uint32_t> alignment_shift_distribution(8, 16);
+	std::bernoulli_distribution allocate_distribution(0.6);
+
+	Core::TlsfAllocator allocator(heap_size, granularity);
+	std::vector<LiveAllocation> live;
+
+	for (uint32_t round_idx = 0; round_idx < 4; ++round_idx)
+	{
+		uint32_t failed_allocation_count = 0;
+		for (uint32_t step_idx = 0; step_idx < 5000; ++step_idx)
+		{
+			if (live.empty() || allocate_distribution(random))
+			{
+				const uint64_t size = size_distribution(random);
+				const uint64_t alignment = 1ULL << alignment_shift_distribution(random);
+				const Core::TlsfAllocation allocation = allocator.allocate(size, alignment);
+				if (allocation.is_valid())
+				{
+					live.push_back({ allocation, size, alignment });
+				}
+				else
+				{
+					++failed_allocation_count;
+				}
+			}
+			else
+			{
+				const size_t live_idx = std::uniform_int_distribution<size_t>(0, live.size() - 1)(random);
+				allocator.free(live[live_idx].allocation);
+				live[live_idx] = live.back();
+				live.pop_back();
+			}
+
+			if (step_idx % 64 == 0 && !is_consistent(allocator, live))
+			{
+				CHECK(is_consistent(allocator, live));
+				return;
+			}
+		}
+		CHECK(is_consistent(allocator, live));
+		// The mix of sizes has to fill the range now and then for the test to mean anything
+		CHECK(failed_allocation_count > 0);
+
+		free_all(allocator, live, random);
+		CHECK(is_one_free_block(allocator));
+	}
+}
+
+TEST_CASE(tlsf_allocator, fills_the_range_exactly)
+{
+	std::mt19937 random(380);
+	Core::TlsfAllocator allocator(1 << 20, granularity);
+	std::vector<LiveAllocation> live;
+
+	// The last blocks only fit exactly, from their own bin
+	while (true)
+	{
+		const Core::TlsfAllocation allocation = allocator.allocate(granularity, granularity);
+		if (!allocation.is_valid())
+		{
+			break;
+		}
+		live.push_back({ allocation, granularity, granularity });
+	}
+
+	CHECK(live.size() == (1 << 20) / granularity);
+	CHECK(allocator.stats().free_bytes == 0);
+	CHECK(is_consistent(allocator, live));
+
+	free_all(allocator, live, random);
+	CHECK(is_one_free_block(allocator));
+}
+
+TEST_CASE(tlsf_allocator, rejects_what_does_not_fit)
+{
+	Core::TlsfAllocator allocator(1 << 20, granularity);
+
+	CHECK(!allocator.allocate((1 << 20) + 1, granularity).is_valid());
+
+	const Core::TlsfAllocation allocation = allocator.allocate(1 << 20, granularity);
+	CHECK(allocation.is_valid() && allocation.offset == 0 && allocation.size == (1 << 20));
+	CHECK(!allocator.allocate(1, 1).is_valid());
+
+	allocator.free(allocation);
+	CHECK(is_one_free_block(allocator));
+}
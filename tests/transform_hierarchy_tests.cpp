@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "core/job_system.hpp"
+#include "core/transform_hierarchy.hpp"
+#include "test.hpp"
+
+namespace
+{
+	// The hierarchy as added, recomposed recursively from the locals
+	struct ReferenceNode
+	{
+		uint32_t parent_id;
+		Core::Transform local;
+	};
+
+	Core::Matrix local_matrix(const Core::Transform& local)
+	{
+		return Core::matrix_affine(Core::load(local.scale, 0.0f), Core::load(local.rotation), Core::load(local.position, 1.0f));
+	}
+
+	Core::Matrix reference_world(const std::vector<ReferenceNode>& nodes, uint32_t node_id)
+	{
+		const ReferenceNode& node = nodes[node_id];
+		if (node.parent_id == Core::TransformHierarchy::invalid_node)
+		{
+			return local_matrix(node.local);
+		}
+		// The local transform first, then the parent's world
+		return Core::matrix_multiply(local_matrix(node.local), reference_world(nodes, node.parent_id));
+	}
+
+	bool is_descendant_or_self(const std::vector<ReferenceNode>& nodes, uint32_t node_id, uint32_t ancestor_id)
+	{
+		for (uint32_t id = node_id; id != Core::TransformHierarchy::invalid_node; id = nodes[id].parent_id)
+		{
+			if (id == ancestor_id)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	uint32_t depth_of(const std::vector<ReferenceNode>& nodes, uint32_t node_id)
+	{
+		uint32_t depth = 0;
+		for (uint32_t id = nodes[node_id].parent_id; id != Core::TransformHierarchy::invalid_node; id = nodes[id].parent_id)
+		{
+			++depth;
+		}
+		return depth;
+	}
+
+	bool matches_reference(const Core::TransformHierarchy& hierarchy, const std::vector<ReferenceNode>& nodes)
+	{
+		for (uint32_t node_id = 0; node_id < nodes.size(); ++node_id)
+		{
+			Core::Float4x4 expected;
+			Core::store(expected, reference_world(nodes, node_id));
+			const Core::Float4x4& world = hierarchy.world(node_id);
+			for (uint32_t row_idx = 0; row_idx < 4; ++row_idx)
+			{
+				const float* row = &world.rows[row_idx].x;
+				const float* expected_row = &expected.rows[row_idx].x;
+				for (uint32_t column_idx = 0; column_idx < 4; ++column_idx)
+				{
+					// Deep chains multiply the rounding errors up
+					if (std::abs(row[column_idx] - expected_row[column_idx]) > 1e-3f * std::max(1.0f, std::abs(expected_row[column_idx])))
+					{
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	class RandomScene
+	{
+	public:
+		Core::Transform next_local()
+		{
+			std::uniform_real_distribution<float> coordinate(-2.0f, 2.0f);
+			std::uniform_real_distribution<float> scale(0.8f, 1.25f);
+			Core::Transform local;
+			local.position = { coordinate(m_random), coordinate(m_random), coordinate(m_random) };
+			const Core::Vector axis = Core::normalize3(Core::vector_set(coordinate(m_random), coordinate(m_random), coordinate(m_random), 0.0f));
+			Core::store(local.rotation, Core::quaternion_rotation_axis(axis, coordinate(m_random)));
+			local.scale = { scale(m_random), scale(m_random), scale(m_random) };
+			return local;
+		}
+
+		// A root for every tenth node, otherwise any earlier node, so that ids and depths interleave
+		void add_nodes(Core::TransformHierarchy& hierarchy, std::vector<ReferenceNode>& nodes, uint32_t count)
+		{
+			for (uint32_t node_idx = 0; node_idx < count; ++node_idx)
+			{
+				uint32_t parent_id = Core::TransformHierarchy::invalid_node;
+				if (!nodes.empty() && std::uniform_int_distribution<uint32_t>(0, 9)(m_random) != 0)
+				{
+					parent_id = std::uniform_int_distribution<uint32_t>(0, static_cast<uint32_t>(nodes.size()) - 1)(m_random);
+				}
+				const Core::Transform local = next_local();
+				CHECK(hierarchy.add_node(parent_id, local) == nodes.size());
+				nodes.push_back({ parent_id, local });
+			}
+		}
+
+		uint32_t next_node(const std::vector<ReferenceNode>& nodes)
+		{
+			return std::uniform_int_distribution<uint32_t>(0, static_cast<uint32_t>(nodes.size()) - 1)(m_random);
+		}
+	private:
+		std::mt19937 m_random{ 5 };
+	};
+}
+
+TEST_CASE(transform_hierarchy, matches_recursive_composition)
+{
+	Core::JobSystem job_system(Core::JobSystemDesc{ 3 });
+	Core::TransformHierarchy hierarchy;
+	std::vector<ReferenceNode> nodes;
+	RandomScene scene;
+	scene.add_nodes(hierarchy, nodes, 2000);
+
+	const Core::TransformUpdateStats stats = hierarchy.update(job_system);
+	CHECK(stats.updated_count == nodes.size());
+	uint32_t max_depth = 0;
+	for (uint32_t node_id = 0; node_id < nodes.size(); ++node_id)
+	{
+		max_depth = std::max(max_depth, depth_of(nodes, node_id));
+	}
+	CHECK(stats.level_count == max_depth + 1);
+	CHECK(hierarchy.node_count() == nodes.size());
+	CHECK(matches_reference(hierarchy, nodes));
+}
+
+TEST_CASE(transform_hierarchy, updates_changed_nodes_and_their_descendants_only)
+{
+	Core::JobSystem job_system(Core::JobSystemDesc{ 3 });
+	Core::TransformHierarchy hierarchy;
+	std::vector<ReferenceNode> nodes;
+	RandomScene scene;
+	scene.add_nodes(hierarchy, nodes, 1000);
+	hierarchy.update(job_system);
+
+	CHECK(hierarchy.update(job_system).updated_count == 0);
+	for (uint32_t node_id = 0; node_id < nodes.size(); ++node_id)
+	{
+		CHECK(!hierarchy.is_world_changed(node_id));
+	}
+
+	for (uint32_t round = 0; round < 5; ++round)
+	{
+		std::vector<uint32_t> changed_ids;
+		for (uint32_t change_idx = 0; change_idx < 3; ++change_idx)
+		{
+			const uint32_t node_id = scene.next_node(nodes);
+			nodes[node_id].local = scene.next_local();
+			hierarchy.set_local(node_id, nodes[node_id].local);
+			changed_ids.push_back(node_id);
+		}
+
+		const Core::TransformUpdateStats stats = hierarchy.update(job_system);
+		uint32_t expected_count = 0;
+		for (uint32_t node_id = 0; node_id < nodes.size(); ++node_id)
+		{
+			const bool is_changed = std::any_of(changed_ids.begin(), changed_ids.end(), [&](uint32_t changed_id)
+			{
+				return is_descendant_or_self(nodes, node_id, changed_id);
+			});
+			CHECK(hierarchy.is_world_changed(node_id) == is_changed);
+			expected_count += is_changed ? 1 : 0;
+		}
+		CHECK(stats.updated_count == expected_count);
+		CHECK(matches_reference(hierarchy, nodes));
+	}
+}
+
+TEST_CASE(transform_hierarchy, keeps_ids_when_nodes_are_added_later)
+{
+	Core::JobSystem job_system(Core::JobSystemDesc{ 0 });
+	Core::TransformHierarchy hierarchy;
+	std::vector<ReferenceNode> nodes;
+	RandomScene scene;
+
+	// New nodes under old ones resort the levels, existing ones keep their ids and worlds
+	for (uint32_t round = 0; round < 4; ++round)
+	{
+		scene.add_nodes(hierarchy, nodes, 300);
+		const Core::TransformUpdateStats stats = hierarchy.update(job_system);
+		CHECK(stats.updated_count == 300);
+		CHECK(matches_reference(hierarchy, nodes));
+	}
+
+	for (uint32_t node_id = 0; node_id < nodes.size(); ++node_id)
+	{
+		const Core::Transform local = hierarchy.local(node_id);
+		CHECK(local.position.x == nodes[node_id].local.position.x);
+		CHECK(local.rotation.w == nodes[node_id].local.rotation.w);
+		CHECK(local.scale.z == nodes[node_id].local.scale.z);
+	}
+}
+
+TEST_CASE(transform_hierarchy, does_not_depend_on_the_worker_count)
+{
+	Core::JobSystem inline_job_system(Core::JobSystemDesc{ 0 });
+	Core::JobSystem job_system(Core::JobSystemDesc{ 3 });
+	Core::TransformHierarchy inline_hierarchy;
+	Core::TransformHierarchy hierarchy;
+	std::vector<ReferenceNode> nodes;
+	std::vector<ReferenceNode> same_nodes;
+	RandomScene scene;
+	RandomScene same_scene;
+	scene.add_nodes(inline_hierarchy, nodes, 1500);
+	same_scene.add_nodes(hierarchy, same_nodes, 1500);
+
+	inline_hierarchy.update(inline_job_system);
+	hierarchy.update(job_system);
+	for (uint32_t node_id = 0; node_id < nodes.size(); ++node_id)
+	{
+		CHECK(std::memcmp(&inline_hierarchy.world(node_id), &hierarchy.world(node_id), sizeof(Core::Float4x4)) == 0);
+	}
+}
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <deque>
+#include <random>
+
+#include "core/upload_ring.hpp"
+#include "test.hpp"
+
+namespace
+{
+	struct LiveRange
+	{
+		uint64_t offset;
+		uint64_t size;
+		// Zero until submitted
+		uint64_t fence_value;
+	};
+
+	bool overlaps(const LiveRange& a, const LiveRange& b)
+	{
+		return a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+	}
+}
+
+TEST_CASE(upload_ring, allocates_aligned_ranges_in_order)
+{
+	Core::UploadRing ring(1024);
+	CHECK(ring.capacity() == 1024);
+	CHECK(ring.used_bytes() == 0);
+
+	uint64_t offset;
+	CHECK(ring.allocate(100, 1, offset) && offset == 0);
+	CHECK(ring.allocate(100, 256, offset) && offset == 256);
+	// The padding counts as used
+	CHECK(ring.used_bytes() == 356);
+	CHECK(ring.allocate(668, 1, offset) && offset == 356);
+	CHECK(ring.used_bytes() == 1024);
+	CHECK(!ring.allocate(1, 1, offset));
+
+	// Nothing comes back before the fence completed
+	ring.submit(1);
+	ring.retire(0);
+	CHECK(!ring.allocate(1, 1, offset));
+	ring.retire(1);
+	CHECK(ring.used_bytes() == 0);
+	CHECK(ring.allocate(1024, 512, offset) && offset == 0);
+}
+
+TEST_CASE(upload_ring, wraps_to_the_start)
+{
+	Core::UploadRing ring(1000);
+	uint64_t offset;
+	CHECK(ring.allocate(400, 1, offset) && offset == 0);
+	ring.submit(1);
+	CHECK(ring.allocate(400, 1, offset) && offset == 400);
+	ring.submit(2);
+	ring.retire(1);
+	CHECK(ring.used_bytes() == 400);
+
+	// 300 does not fit behind 800, the skipped end is used until the fence completed
+	CHECK(ring.allocate(300, 1, offset) && offset == 0);
+	CHECK(ring.used_bytes() == 900);
+	CHECK(!ring.allocate(101, 1, offset));
+	CHECK(ring.allocate(100, 1, offset) && offset == 300);
+	ring.submit(3);
+
+	ring.retire(2);
+	CHECK(ring.used_bytes() == 600);
+	CHECK(!ring.allocate(601, 1, offset));
+	ring.retire(3);
+	CHECK(ring.used_bytes() == 0);
+}
+
+TEST_CASE(upload_ring, never_hands_out_live_memory)
+{
+	constexpr uint64_t capacity = 64 * 1024;
+	Core::UploadRing ring(capacity);
+	std::mt19937 random(11);
+	std::uniform_int_distribution<uint64_t> size(1, 9000);
+	std::uniform_int_distribution<uint32_t> alignment_shift(0, 9);
+	std::uniform_int_distribution<uint32_t> action(0, 9);
+
+	std::deque<LiveRange> live_ranges;
+	uint64_t next_fence_value = 1;
+	uint64_t completed_fence_value = 0;
+	uint32_t allocated_count = 0;
+	uint32_t full_count = 0;
+	for (uint32_t step = 0; step < 20000; ++step)
+	{
+		const uint32_t next_action = action(random);
+		if (next_action < 6)
+		{
+			const uint64_t alignment = 1ULL << alignment_shift(random);
+			const uint64_t allocation_size = size(random);
+			uint64_t offset;
+			if (!ring.allocate(allocation_size, alignment, offset))
+			{
+				++full_count;
+				continue;
+			}
+			const LiveRange allocated = { offset, allocation_size, 0 };
+			CHECK(offset % alignment == 0);
+			CHECK(offset + allocation_size <= capacity);
+			CHECK(std::none_of(live_ranges.begin(), live_ranges.end(), [&](const LiveRange& live_range)
+			{
+				return overlaps(live_range, allocated);
+			}));
+			live_ranges.push_back(allocated);
+			++allocated_count;
+		}
+		else if (next_action < 8)
+		{
+			for (LiveRange& live_range : live_ranges)
+			{
+				live_range.fence_value = live_range.fence_value == 0 ? next_fence_value : live_range.fence_value;
+			}
+			ring.submit(next_fence_value++);
+		}
+		else
+		{
+			completed_fence_value = std::uniform_int_distribution<uint64_t>(completed_fence_value, next_fence_value - 1)(random);
+			ring.retire(completed_fence_value);
+			live_ranges.erase(std::remove_if(live_ranges.begin(), live_ranges.end(), [&](const LiveRange& live_range)
+			{
+				return live_range.fence_value != 0 && live_range.fence_value <= completed_fence_value;
+			}), live_ranges.end());
+		}
+
+		uint64_t live_bytes = 0;
+		for (const LiveRange& live_range : live_ranges)
+		{
+			live_bytes += live_range.size;
+		}
+		CHECK(ring.used_bytes() >= live_bytes);
+		CHECK(ring.used_bytes() <= capacity);
+	}
+	CHECK(allocated_count > 5000);
+	CHECK(full_count > 100);
+
+	// Once everything completed the whole ring is free again
+	ring.submit(next_fence_value);
+	ring.retire(next_fence_value);
+	CHECK(ring.used_bytes() == 0);
+	uint64_t offset;
+	CHECK(ring.allocate(capacity, 1, offset) && offset == 0);
+}